@@ -0,0 +1,214 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dataconv_main.cc
+ * Converts ViewTouch data files between the text and binary formats
+ */
+
+#include "data_file.hh"
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+struct Parameter
+{
+    DataFileFormat format = DataFileFormat::Binary;  // target format
+    bool compress         = false;                   // compress output
+    bool verbose          = false;                   // verbose mode
+    std::vector<std::string> files;
+};
+
+/*********************************************************************
+ * PROTOTYPES
+ ********************************************************************/
+int ConvertFile(const std::string &path, const Parameter &param);
+Parameter ParseArguments(const int argc, const char* const argv[]);
+void ShowHelp(const std::string &progname);
+
+// data_file.cc reports through this hook
+int ReportError(const std::string &message)
+{
+    std::cerr << message << '\n';
+    return 0;
+}
+
+
+/*********************************************************************
+ * MAIN
+ ********************************************************************/
+int main(int argc, const char* argv[])
+{
+    Parameter param = ParseArguments(argc, argv);
+    if (param.files.empty())
+        ShowHelp(argv[0]);
+
+    int failed = 0;
+    for (const std::string &path : param.files)
+    {
+        if (ConvertFile(path, param))
+            ++failed;
+    }
+    return (failed > 0) ? 1 : 0;
+}
+
+
+/*********************************************************************
+ * SUBROUTINES
+ ********************************************************************/
+
+/****
+ * ConvertFile:  copies every field of 'path' into a temporary file in
+ *   the target format and renames it over the original.  Fields from
+ *   text files are carried as raw tokens (the text format does not
+ *   record value types); vt_main writes fully typed fields the next
+ *   time it saves the file.  The original is only replaced once every
+ *   field has been read and written cleanly.
+ ****/
+int ConvertFile(const std::string &path, const Parameter &param)
+{
+    InputDataFile infile;
+    int version = 0;
+    if (infile.Open(path, version))
+        return 1;
+
+    if (infile.IsLegacyEncoding())
+    {
+        std::cerr << "Skipping '" << path << "': pre-1998 encoding is not converted" << '\n';
+        return 1;
+    }
+
+    const std::string tmp_path = path + ".conv";
+    OutputDataFile outfile;
+    if (outfile.Open(tmp_path, version, param.compress ? 1 : 0, param.format))
+        return 1;
+
+    int fields = 0;
+    bool failed = false;
+    DataFileField field;
+    while (infile.ReadField(field) == 0)
+    {
+        if (outfile.WriteField(field))
+        {
+            std::cerr << "Write failed for '" << tmp_path << "'" << '\n';
+            failed = true;
+            break;
+        }
+        ++fields;
+    }
+    if (infile.IsCorrupt())
+    {
+        std::cerr << "Read failed for '" << path << "', left unchanged" << '\n';
+        failed = true;
+    }
+    infile.Close();
+    if (outfile.Close() && !failed)
+    {
+        std::cerr << "Write failed for '" << tmp_path << "'" << '\n';
+        failed = true;
+    }
+
+    // the converted file keeps the original's owner and permissions
+    struct stat original{};
+    if (!failed && ::stat(path.c_str(), &original) == 0)
+    {
+        if (::chown(tmp_path.c_str(), original.st_uid, original.st_gid) != 0)
+            ::chown(tmp_path.c_str(), static_cast<uid_t>(-1), original.st_gid);
+        if (::chmod(tmp_path.c_str(), original.st_mode & 07777) != 0)
+        {
+            perror(("Failed to set the mode of " + tmp_path).c_str());
+            failed = true;
+        }
+    }
+
+    if (failed)
+    {
+        std::remove(tmp_path.c_str());
+        return 1;
+    }
+
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+    {
+        perror(("Failed to replace " + path).c_str());
+        std::remove(tmp_path.c_str());
+        return 1;
+    }
+
+    if (param.verbose)
+        std::cout << path << ": " << fields << " fields (version " << version << ")" << '\n';
+    return 0;
+}
+
+/****
+ * ShowHelp:
+ ****/
+void ShowHelp(const std::string &progname)
+{
+    std::cout << '\n'
+              << "Usage:  " << progname << " [OPTIONS] FILE..." << '\n'
+              << "  -b          Convert to the binary format (default)" << '\n'
+              << "  -t          Convert to the text format" << '\n'
+              << "  -z          Compress the output" << '\n'
+              << "  -h          Show this help screen" << '\n'
+              << "  -v          Verbose mode" << '\n'
+              << '\n'
+              << "Files are converted in place.  Stop vt_main first." << '\n'
+              << '\n';
+    exit(1);
+}
+
+/****
+ * ParseArguments: Walk through the arguments, collecting options
+ *   and file names.
+ ****/
+Parameter ParseArguments(const int argc, const char* const argv[])
+{
+    Parameter param;
+    // start at 1, first command line argument past binary name
+    for (int idx = 1; idx < argc; idx++)
+    {
+        const std::string arg = argv[idx];
+        if (arg.empty())
+            continue;
+
+        if (arg[0] != '-')
+            param.files.push_back(arg);
+        else if (arg == "-b")
+            param.format = DataFileFormat::Binary;
+        else if (arg == "-t")
+            param.format = DataFileFormat::Text;
+        else if (arg == "-z")
+            param.compress = true;
+        else if (arg == "-v")
+            param.verbose = true;
+        else if (arg == "-h")
+            ShowHelp(argv[0]);
+        else
+        {
+            std::cout << "Unrecognized parameter '" << arg << "'" << '\n';
+            ShowHelp(argv[0]);
+        }
+    }
+    return param;
+}
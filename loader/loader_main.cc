@@ -50,6 +50,8 @@ static int shadow_blur_radius = 1;
 #include <unistd.h>
 // standard libraries
 #include <csignal>
+#include <cstdlib>
+#include <string>
 #include <iostream>
 #include <fstream>
 
@@ -563,6 +565,7 @@ int main(int argc, genericChar* argv[])
     int net_off = 0;
     int purge = 0;
     int notrace = 0;
+    int load_threads = 0;
     const char* data_path = nullptr;
 
     for (int i = 1; i < argc; ++i)
@@ -573,6 +576,7 @@ int main(int argc, genericChar* argv[])
                    " path    or -p <dirname> specify data directory\n"
                    " help    or -h           display this help message\n"
                    " netoff  or -n           no network devices started\n"
+                   " --load-threads <count>  threads loading data at startup (0 = one per core)\n"
 #if DEBUG
                    " notrace or -t           disable FnTrace, debug mode only\n"
 #endif
@@ -597,6 +601,16 @@ int main(int argc, genericChar* argv[])
         {
             purge = 1;
         }
+        else if (strcmp(argv[i], "--load-threads") == 0)
+        {
+            ++i;
+            if (i >= argc)
+            {
+                logmsg(LOG_ERR, "No thread count given");
+                return 1;
+            }
+            load_threads = atoi(argv[i]);
+        }
 #if DEBUG
         else if (strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "notrace") == 0)
         {
@@ -653,6 +667,11 @@ int main(int argc, genericChar* argv[])
         write(SocketNo, "purge", 6);
     if (notrace)
         write(SocketNo, "notrace", 8);
+    if (load_threads > 0)
+    {
+        const std::string command = "loadthreads " + std::to_string(load_threads);
+        write(SocketNo, command.c_str(), command.size() + 1);
+    }
     write(SocketNo, "done", 5);
 
     // Read Status Messages
@@ -26,6 +26,7 @@
 #include "report.hh"
 #include "drawer.hh"
 #include "data_file.hh"
+#include "check_journal.hh"
 #include "system.hh"
 #include "settings.hh"
 #include "main/data/settings_enums.hh"
@@ -45,6 +46,7 @@
 #include <sys/types.h>
 #include <dirent.h>
 #include <sys/file.h>
+#include <unistd.h>
 #include <cstring>
 #include <cmath>
 #include <list>
@@ -162,6 +164,8 @@ Check::Check()
     , archive(nullptr)
     , current_sub(nullptr)
     , user_current(0)
+    , dirty(0)
+    , live(0)
     , serial_number(0)
     , call_center_id(0)
     , time_open(SystemTime)
@@ -205,6 +209,8 @@ Check::Check(Settings * /*settings*/, int customer_type, Employee *employee)
     , archive(nullptr)
     , current_sub(nullptr)
     , user_current(0)
+    , dirty(0)
+    , live(0)
     , serial_number(0)
     , call_center_id(0)
     , time_open(SystemTime)
@@ -330,12 +336,10 @@ int Check::Save()
     vt::Logger::debug("Saving check #{} - Serial: {}, Table: {}", 
                       checknum, serial_number, Table());
     
-    // Mark check data as dirty for persistence tracking
-    GetDataPersistenceManager().MarkDataDirty("checks");
-    
     if (archive)
     {
         archive->changed = 1;
+        GetDataPersistenceManager().MarkDataDirty("archives");
         vt::Logger::debug("Check #{} marked in archive", checknum);
         return 0;
     }
@@ -343,10 +347,12 @@ int Check::Save()
     {
         int result = MasterSystem->SaveCheck(this);
         if (result == 0) {
-            // Mark as clean after successful save
-            GetDataPersistenceManager().MarkDataClean("checks");
+            dirty = 0;
             vt::Logger::info("Check #{} saved successfully", checknum);
         } else {
+            // left for the next auto-save to retry
+            dirty = 1;
+            GetDataPersistenceManager().MarkDataDirty("checks");
             vt::Logger::error("Failed to save check #{}", checknum);
         }
         return result;
@@ -355,6 +361,17 @@ int Check::Save()
         return 0;
 }
 
+/****
+ * Changed:  Order and payment edits end in Update(), which calls this, so
+ *   the auto-save writes the check even if nothing Save()s it.  Only the
+ *   check's own flag is set; the auto-save looks for it.
+ ****/
+void Check::Changed()
+{
+    if (archive == nullptr && copy == 0)
+        dirty = 1;
+}
+
 int Check::Read(Settings *settings, InputDataFile &infile, int version)
 {
     FnTrace("Check::Read()");
@@ -383,6 +400,51 @@ int Check::Read(Settings *settings, InputDataFile &infile, int version)
         return 1;
     }
 
+    int error = ReadHeader(infile, version);
+
+    int numsubchecks = 0;
+    error += infile.Read(numsubchecks);
+    if (error)
+    {
+        ReportError(GlobalTranslate("Error in reading general check data"));
+        printf("Error in reading general check data");
+        return error;
+    }
+
+    if (numsubchecks < 10000 && error == 0)  // sanity check
+    {
+        int i;
+        for (i = 0; i < numsubchecks; ++i)
+        {
+            if (infile.end_of_file)
+            {
+                ReportError(GlobalTranslate("Unexpected end of SubChecks in Check"));
+                return 1;
+            }
+            
+            auto sc = std::make_unique<SubCheck>();
+            error += sc->Read(settings, infile, version);
+            if (error)
+            {
+                return error;
+            }
+            
+            sc->check_type = type;
+            Add(sc.release());
+        }
+    }
+
+    dirty = 0;  // just as it was written
+    return error;
+}
+
+/****
+ * ReadHeader:  Reads everything Check::Read() reads ahead of the
+ *  subchecks.  The check journal replays header changes through here.
+ ****/
+int Check::ReadHeader(InputDataFile &infile, int version)
+{
+    FnTrace("Check::ReadHeader()");
     int error = 0;
     error += infile.Read(serial_number);
     error += infile.Read(time_open);
@@ -472,39 +534,6 @@ int Check::Read(Settings *settings, InputDataFile &infile, int version)
         error += infile.Read(label);
     if (version >= 24)
         error += infile.Read(call_center_id);
-
-    int numsubchecks = 0;
-    error += infile.Read(numsubchecks);
-    if (error)
-    {
-        ReportError(GlobalTranslate("Error in reading general check data"));
-        printf("Error in reading general check data");
-        return error;
-    }
-
-    if (numsubchecks < 10000 && error == 0)  // sanity check
-    {
-        int i;
-        for (i = 0; i < numsubchecks; ++i)
-        {
-            if (infile.end_of_file)
-            {
-                ReportError(GlobalTranslate("Unexpected end of SubChecks in Check"));
-                return 1;
-            }
-            
-            auto sc = std::make_unique<SubCheck>();
-            error += sc->Read(settings, infile, version);
-            if (error)
-            {
-                return error;
-            }
-            
-            sc->check_type = type;
-            Add(sc.release());
-        }
-    }
-
     return error;
 }
 
@@ -555,6 +584,19 @@ int Check::Write(OutputDataFile &datFile, int version)
         return 1;
     }
 
+    int error = WriteHeader(datFile, version);
+    error += datFile.Write(SubCount(), 1);
+    for (SubCheck *sc = SubList(); sc != nullptr; sc = sc->next)
+    {
+        error += sc->Write(datFile, version);
+    }
+
+    return error;
+}
+
+int Check::WriteHeader(OutputDataFile &datFile, int version)
+{
+    FnTrace("Check::WriteHeader()");
     // Write version 7-9
     int error = 0;
     error += datFile.Write(serial_number);
@@ -612,13 +654,81 @@ int Check::Write(OutputDataFile &datFile, int version)
 
     // Write Version 19 stuff
     error += datFile.Write(call_center_id);
+    return error;
+}
 
-    error += datFile.Write(SubCount(), 1);
+/****
+ * WriteImage:  Lays the check out part by part for the check journal,
+ *  as Check::Write() writes it less the counts.
+ ****/
+int Check::WriteImage(JournalImage &image)
+{
+    FnTrace("Check::WriteImage()");
+    OutputDataFile scratch;
+    if (scratch.OpenMemory())
+        return 1;
+
+    std::size_t mark = 0;
+    auto take = [&scratch, &mark](JournalPart &part, int parts) {
+        const std::string_view text = scratch.Contents();
+        part.text.assign(text.substr(mark));
+        part.version = CHECK_VERSION;
+        part.parts = parts;
+        mark = text.size();
+    };
+
+    image.subs.clear();
+    int error = WriteHeader(scratch, CHECK_VERSION);
+    take(image.header, 1);
     for (SubCheck *sc = SubList(); sc != nullptr; sc = sc->next)
     {
-        error += sc->Write(datFile, version);
+        JournalSub &sub = image.subs.emplace_back();
+        error += sc->WriteHead(scratch, CHECK_VERSION);
+        take(sub.head, 1);
+        for (Order *order = sc->OrderList(); order != nullptr; order = order->next)
+        {
+            int parts = 1;
+            error += order->Write(scratch, CHECK_VERSION);
+            for (Order *mod = order->modifier_list; mod != nullptr; mod = mod->next)
+            {
+                error += mod->Write(scratch, CHECK_VERSION);
+                ++parts;
+            }
+            take(sub.orders.emplace_back(), parts);
+        }
+        for (Payment *pmnt = sc->PaymentList(); pmnt != nullptr; pmnt = pmnt->next)
+        {
+            error += pmnt->Write(scratch, CHECK_VERSION);
+            take(sub.payments.emplace_back(), 1);
+        }
+        error += sc->WriteTail(scratch, CHECK_VERSION);
+        take(sub.tail, 1);
     }
+    return error;
+}
 
+/****
+ * ReadImage:  Replaces the check's contents with a journal image, as
+ *  Check::Read() would read them from the check's file.
+ ****/
+int Check::ReadImage(Settings *settings, const JournalImage &image)
+{
+    FnTrace("Check::ReadImage()");
+    Purge();
+    InputDataFile header;
+    int error = header.OpenMemory(image.header.text);
+    error += ReadHeader(header, image.header.version);
+    for (const JournalSub &sub : image.subs)
+    {
+        if (error)
+            break;
+        auto sc = std::make_unique<SubCheck>();
+        error += sc->ReadImage(sub);
+        SubCheck *added = sc.get();
+        Add(sc.release());
+        added->FigureTotals(settings);
+    }
+    dirty = 0;  // the journal holds it; a checkpoint writes its file
     return error;
 }
 
@@ -634,13 +744,18 @@ int Check::Add(SubCheck *sc)
         sc->number = 1;
         
     sc->check_type = type;
+    sc->parent = this;
 
+    Changed();
     return sub_list.AddToTail(sc);
 }
 
 int Check::Remove(SubCheck *sc)
 {
     FnTrace("Check::Remove()");
+    Changed();
+    if (sc && sc->parent == this)
+        sc->parent = nullptr;
     return sub_list.Remove(sc);
 }
 
@@ -648,6 +763,7 @@ int Check::Purge()
 {
     FnTrace("Check::Purge()");
     sub_list.Purge();
+    Changed();
     return 0;
 }
 
@@ -666,7 +782,18 @@ int Check::DestroyFile()
     if (filename.empty())
         return 1; // no file to destroy
 
-    int result = DeleteFile(filename.Value());
+    // a check saved only to the journal has no file yet
+    if (MasterSystem && MasterSystem->check_journal.IsOpen())
+        MasterSystem->check_journal.Drop(serial_number);
+
+    // a save still waiting to be renamed into place would bring it back
+    const int pending = DataFileForget(filename.Value());
+
+    int result = 0;
+    if (access(filename.Value(), F_OK) == 0)
+        result = DeleteFile(filename.Value());
+    else if (!pending && (MasterSystem == nullptr || !MasterSystem->check_journal.IsOpen()))
+        result = 1;
     if (result)
         ReportError(GlobalTranslate("Error in deleting check"));
 
@@ -1004,6 +1131,13 @@ int Check::Update(Settings *settings)
         }
         sc = ptr;
     }
+
+    Changed();
+    if (archive == nullptr && copy == 0 && MasterSystem)
+    {
+        MasterSystem->IndexCheck(this);
+        MasterSystem->UpdateLiveTotals(this);
+    }
     return 0;
 }
 
@@ -3065,7 +3199,11 @@ const genericChar* Check::Table(const genericChar* set)
     FnTrace("Check::Table()");
 
     if (set != nullptr)
+    {
         label.Set(set);
+        if (archive == nullptr && copy == 0 && MasterSystem)
+            MasterSystem->IndexCheck(this);
+    }
 
     return label.Value();
 }
@@ -3295,6 +3433,7 @@ const genericChar* Check::Extension(const genericChar* set)
 SubCheck::SubCheck()
     : next(nullptr)
     , fore(nullptr)
+    , parent(nullptr)
     , number(0)
     , archive(nullptr)
     , id(0)
@@ -3415,14 +3554,9 @@ int SubCheck::Read(Settings *settings, InputDataFile &infile, int version)
     FnTrace("SubCheck::Read()");
     // See Check::Read() for Version Notes
     int count = 0;
-    int error = 0;
+    int error = ReadHead(infile, version);
     int i;
 
-    error += infile.Read(status);
-    error += infile.Read(settle_user);
-    error += infile.Read(settle_time);
-    error += infile.Read(drawer_id);
-
     error += infile.Read(count);
     if (count < 10000 && error == 0)
     {
@@ -3476,6 +3610,30 @@ int SubCheck::Read(Settings *settings, InputDataFile &infile, int version)
         }
     }
 
+    error += ReadTail(infile, version);
+
+    if (error == 0)
+        FigureTotals(settings);
+    else
+        ReportError(GlobalTranslate("Error in reading subcheck"));
+    return error;
+}
+
+int SubCheck::ReadHead(InputDataFile &infile, int /*version*/)
+{
+    FnTrace("SubCheck::ReadHead()");
+    int error = 0;
+    error += infile.Read(status);
+    error += infile.Read(settle_user);
+    error += infile.Read(settle_time);
+    error += infile.Read(drawer_id);
+    return error;
+}
+
+int SubCheck::ReadTail(InputDataFile &infile, int version)
+{
+    FnTrace("SubCheck::ReadTail()");
+    int error = 0;
     if (version >= 17)
         error += infile.Read(tax_exempt);
     if (version >= 18)
@@ -3486,11 +3644,6 @@ int SubCheck::Read(Settings *settings, InputDataFile &infile, int version)
         error += infile.Read(tab_total);
     if (version >= 25)
         error += infile.Read(delivery_charge);
-
-    if (error == 0)
-        FigureTotals(settings);
-    else
-        ReportError(GlobalTranslate("Error in reading subcheck"));
     return error;
 }
 
@@ -3500,12 +3653,7 @@ int SubCheck::Write(OutputDataFile &outfile, int version)
     if (version < 7)
         return 1;
 
-    // Write version 7
-    int error = 0;
-    error += outfile.Write(status);
-    error += outfile.Write(settle_user);
-    error += outfile.Write(settle_time);
-    error += outfile.Write(drawer_id, 1);
+    int error = WriteHead(outfile, version);
 
     error += outfile.Write(OrderCount(), 1);
     for (Order *order = OrderList(); order != nullptr; order = order->next)
@@ -3523,14 +3671,81 @@ int SubCheck::Write(OutputDataFile &outfile, int version)
         error += payptr->Write(outfile, version);
     }
 
+    error += WriteTail(outfile, version);
+    return error;
+}
+
+int SubCheck::WriteHead(OutputDataFile &outfile, int /*version*/)
+{
+    FnTrace("SubCheck::WriteHead()");
+    // Write version 7
+    int error = 0;
+    error += outfile.Write(status);
+    error += outfile.Write(settle_user);
+    error += outfile.Write(settle_time);
+    error += outfile.Write(drawer_id, 1);
+    return error;
+}
+
+int SubCheck::WriteTail(OutputDataFile &outfile, int /*version*/)
+{
+    FnTrace("SubCheck::WriteTail()");
+    int error = 0;
     error += outfile.Write(tax_exempt);
     error += outfile.Write(new_QST_method);
     error += outfile.Write(tab_total);
     error += outfile.Write(delivery_charge);
+    return error;
+}
+
+int SubCheck::ReadImage(const JournalSub &sub)
+{
+    FnTrace("SubCheck::ReadImage()");
+    InputDataFile head;
+    int error = head.OpenMemory(sub.head.text);
+    error += ReadHead(head, sub.head.version);
+
+    for (const JournalPart &part : sub.orders)
+    {
+        InputDataFile infile;
+        error += infile.OpenMemory(part.text);
+        for (int record = 0; record < part.parts && error == 0; ++record)
+        {
+            auto order = std::make_unique<Order>();
+            error += order->Read(infile, part.version);
+            if (error == 0 && Add(order.release(), nullptr))
+                ReportError(GlobalTranslate("Error in adding order"));
+        }
+    }
+
+    for (const JournalPart &part : sub.payments)
+    {
+        InputDataFile infile;
+        error += infile.OpenMemory(part.text);
+        auto pmnt = std::make_unique<Payment>();
+        pmnt->drawer_id = drawer_id;
+        error += pmnt->Read(infile, part.version);
+        if (error == 0 && Add(pmnt.release(), nullptr))
+            ReportError(GlobalTranslate("Error in adding payment"));
+    }
 
+    InputDataFile tail;
+    error += tail.OpenMemory(sub.tail.text);
+    error += ReadTail(tail, sub.tail.version);
     return error;
 }
 
+/****
+ * Changed:  Called after the subcheck's orders or payments change.  Once
+ *  its check is counted in System::live_totals, its share is refigured
+ *  here rather than waiting for Check::Update().
+ ****/
+void SubCheck::Changed()
+{
+    if (parent && parent->live && parent->archive == nullptr && MasterSystem)
+        MasterSystem->UpdateLiveTotals(parent);
+}
+
 int SubCheck::Add(Order *order, Settings *settings)
 {
     FnTrace("SubCheck::Add(Order, Settings)");
@@ -3580,6 +3795,8 @@ int SubCheck::Add(Order *order, Settings *settings)
 
     if (settings)
         FigureTotals(settings);
+    else
+        Changed();
 
     return 0;
 }
@@ -3645,6 +3862,8 @@ int SubCheck::Add(Payment *pmnt, Settings *settings)
 
     if (settings)
         ConsolidatePayments(settings);
+    else
+        Changed();
 
     return 0;
 }
@@ -3660,6 +3879,8 @@ int SubCheck::Remove(Order *order, Settings *settings)
         order->parent->Remove(order);
         if (settings)
             FigureTotals(settings);
+        else
+            Changed();
         return 0;
     }
 
@@ -3667,6 +3888,8 @@ int SubCheck::Remove(Order *order, Settings *settings)
 
     if (settings)
         FigureTotals(settings);
+    else
+        Changed();
     return 0;
 }
 
@@ -3676,6 +3899,8 @@ int SubCheck::Remove(Payment *pmnt, Settings *settings)
     payment_list.Remove(pmnt);
     if (settings)
         FigureTotals(settings);
+    else
+        Changed();
     return 0;
 }
 
@@ -3704,6 +3929,7 @@ int SubCheck::Purge(int restore)
 
     order_list.Purge();
     payment_list.Purge();
+    Changed();
     return 0;
 }
 
@@ -3728,6 +3954,7 @@ Order *SubCheck::RemoveCount(Order *order, int count)
 		order->FigureCost();
         ptr->count = static_cast<short>(count);
 		ptr->FigureCost();
+        Changed();
 		return ptr;
 	}
 	else
@@ -4490,6 +4717,7 @@ int SubCheck::FigureTotals(Settings *settings)
             balance = 0;
         }
     }
+    Changed();
     return 0;
 }
 
@@ -4616,6 +4844,7 @@ int SubCheck::Void()
     status = CHECK_VOIDED;
     for (Order *order = OrderList(); order != nullptr; order = order->next)
         order->status |= ORDER_COMP;
+    Changed();
     return 0;
 }
 
@@ -5239,6 +5468,7 @@ void SubCheck::ClearTips()
         if (tt == TENDER_CAPTURED_TIP || tt == TENDER_CHARGED_TIP)
             payptr->value = 0;
     }
+    Changed();
 }
 
 int SubCheck::GrossSales(Check *check, Settings *settings, int sales_group)
@@ -5289,6 +5519,7 @@ int SubCheck::Settle(Terminal *term)
     if (! settle_time.IsSet())
         settle_time = SystemTime;
 
+    Changed();
     return 0;
 }
 
@@ -5302,6 +5533,7 @@ int SubCheck::Close(Terminal *term)
         return 1;
 
     status = CHECK_CLOSED;
+    Changed();
     return 0;
 }
 
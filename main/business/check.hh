@@ -156,6 +156,8 @@ class InputDataFile;
 class OutputDataFile;
 class CustomerInfo;
 class ReportZone;
+struct JournalImage;
+struct JournalSub;
 
 class Order
 {
@@ -270,6 +272,7 @@ class SubCheck
 public:
     // General
     SubCheck *next, *fore; // linked list pointers
+    Check    *parent;      // check it is on (set by Check::Add())
     int       number;      // check number
     Archive  *archive;     // mostly for FigureTotals
 
@@ -347,6 +350,11 @@ public:
     int       Copy(SubCheck *sc, Settings *settings = nullptr, int restore = 0);  // Copies the contents of a subcheck
     int       Read(Settings *settings, InputDataFile &df, int version);  // Reads subcheck from file
     int       Write(OutputDataFile &df, int version);  // Writes subcheck to file
+    int       ReadHead(InputDataFile &df, int version);  // fields written before the orders
+    int       WriteHead(OutputDataFile &df, int version);
+    int       ReadTail(InputDataFile &df, int version);  // fields written after the payments
+    int       WriteTail(OutputDataFile &df, int version);
+    int       ReadImage(const JournalSub &sub);  // rebuilds the subcheck from its journal image
     int       Add(Order *o, Settings *settings = nullptr);  // Adds an order - recalculates if settings are given
     int       Add(Payment *p, Settings *settings = nullptr);  // Adds a payment - recalculates if settings are given
     int       Remove(Order *o, Settings *settings = nullptr);  // Removes an order - recalculates if settings are given
@@ -392,6 +400,7 @@ public:
     int       HasOpenTab();
     int       OnlyCredit();
     int       SetBatch(const char* termid, const char* batch);
+    void      Changed();  // refigures the check's share of live totals
 };
 
 class Check
@@ -405,6 +414,8 @@ public:
     Archive      *archive;       // where does this check belong?
     SubCheck     *current_sub;   // current subcheck being edited
     int           user_current;  // employee currently using check
+    short         dirty;         // changed since its file was last written
+    short         live;          // has a share in System::live_totals
 
     // Saved
     int           serial_number;  // unique number for saving
@@ -452,9 +463,14 @@ public:
     Check    *Copy(Settings *settings);
     int       Load(Settings *settings, const genericChar* filename); // Loads check from file
     int       Save();  // Saves check to disk
+    void      Changed();  // marks it for the next auto-save (not in archives or copies)
     int       Read(Settings *settings, InputDataFile &df, int version);  // Reads check data from file
     int       ReadFix(InputDataFile &datFile, int version);
     int       Write(OutputDataFile &df, int version);  // Writes check data to file
+    int       ReadHeader(InputDataFile &df, int version);  // check fields without subchecks
+    int       WriteHeader(OutputDataFile &df, int version);
+    int       ReadImage(Settings *settings, const JournalImage &image);  // rebuilds the check from a journal image
+    int       WriteImage(JournalImage &image);  // the check's parts, for the check journal
     int       Add(SubCheck *sc);  // Adds check to check
     int       Remove(SubCheck *sc);  // Removes check from check
     int       Purge();  // Removes & deletes all subchecks from check
@@ -0,0 +1,125 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * check_index.cc
+ * Hash lookups of the current checks by serial number, table and owner
+ */
+
+#include "check_index.hh"
+#include "fntrace.hh"
+
+#include <algorithm>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+template <typename Map, typename Key>
+void CheckIndex::Insert(Map &map, const Key &key, Entry entry)
+{
+    Entries &entries = map[key];
+    const auto pos = std::upper_bound(entries.begin(), entries.end(), entry.serial,
+                                      [](int serial, const Entry &e) { return serial < e.serial; });
+    entries.insert(pos, entry);
+}
+
+template <typename Map, typename Key>
+void CheckIndex::Erase(Map &map, const Key &key, const Check *check)
+{
+    auto found = map.find(key);
+    if (found == map.end())
+        return;
+    Entries &entries = found->second;
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [check](const Entry &e) { return e.check == check; }),
+                  entries.end());
+    if (entries.empty())
+        map.erase(found);
+}
+
+void CheckIndex::Unfile(const Check *check, const Keys &filed)
+{
+    auto serial = by_serial.find(filed.serial);
+    if (serial != by_serial.end() && serial->second == check)
+        by_serial.erase(serial);
+    Erase(by_table[filed.training ? 1 : 0], filed.table, check);
+    Erase(by_owner, filed.owner, check);
+}
+
+void CheckIndex::Update(Check *check, int serial, std::string_view table, int training, int owner)
+{
+    FnTrace("CheckIndex::Update()");
+    if (check == nullptr)
+        return;
+    training = training ? 1 : 0;
+
+    auto found = keys.find(check);
+    if (found != keys.end())
+    {
+        Keys &filed = found->second;
+        if (filed.serial == serial && filed.table == table &&
+            filed.training == training && filed.owner == owner)
+        {
+            return;  // nothing to refile
+        }
+        Unfile(check, filed);
+        filed = Keys{serial, std::string(table), training, owner};
+    }
+    else
+        keys.emplace(check, Keys{serial, std::string(table), training, owner});
+
+    by_serial[serial] = check;
+    Insert(by_table[training], std::string(table), Entry{serial, check});
+    Insert(by_owner, owner, Entry{serial, check});
+}
+
+void CheckIndex::Remove(Check *check)
+{
+    FnTrace("CheckIndex::Remove()");
+    auto found = keys.find(check);
+    if (found == keys.end())
+        return;
+    Unfile(check, found->second);
+    keys.erase(found);
+}
+
+void CheckIndex::Clear()
+{
+    keys.clear();
+    by_serial.clear();
+    by_table[0].clear();
+    by_table[1].clear();
+    by_owner.clear();
+}
+
+Check *CheckIndex::FindSerial(int serial) const
+{
+    const auto found = by_serial.find(serial);
+    return (found == by_serial.end()) ? nullptr : found->second;
+}
+
+const CheckIndex::Entries *CheckIndex::AtTable(std::string_view table, int training) const
+{
+    const auto &tables = by_table[training ? 1 : 0];
+    const auto found = tables.find(std::string(table));
+    return (found == tables.end()) ? nullptr : &found->second;
+}
+
+const CheckIndex::Entries *CheckIndex::OwnedBy(int owner) const
+{
+    const auto found = by_owner.find(owner);
+    return (found == by_owner.end()) ? nullptr : &found->second;
+}
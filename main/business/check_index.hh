@@ -0,0 +1,84 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * check_index.hh
+ * Hash lookups of the current checks by serial number, table and owner
+ */
+
+#ifndef CHECK_INDEX_HH
+#define CHECK_INDEX_HH
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class Check;
+
+/*********************************************************************
+ * CheckIndex
+ *
+ * Finds current checks without walking System's check list.  Checks
+ * are filed under the keys given to Update() -- serial number, table
+ * and training flag, owner -- and refiled when those change.  Status
+ * is not a key:  the few checks at one table or of one owner are
+ * tested for it by the caller, so a check closing needs no update.
+ * Each bucket is kept in serial number order, the check list's order.
+ ********************************************************************/
+class CheckIndex
+{
+public:
+    struct Entry
+    {
+        int    serial;
+        Check *check;
+    };
+    using Entries = std::vector<Entry>;
+
+    // Files check under its current keys
+    void Update(Check *check, int serial, std::string_view table, int training, int owner);
+    void Remove(Check *check);
+    void Clear();
+
+    // Lookups give nullptr when there are none
+    [[nodiscard]] Check *FindSerial(int serial) const;
+    [[nodiscard]] const Entries *AtTable(std::string_view table, int training) const;
+    [[nodiscard]] const Entries *OwnedBy(int owner) const;
+    [[nodiscard]] std::size_t Size() const noexcept { return keys.size(); }
+
+private:
+    struct Keys
+    {
+        int         serial;
+        std::string table;
+        int         training;
+        int         owner;
+    };
+
+    std::unordered_map<const Check*, Keys>   keys;        // what each check is filed under
+    std::unordered_map<int, Check*>          by_serial;
+    std::unordered_map<std::string, Entries> by_table[2];  // [training]
+    std::unordered_map<int, Entries>         by_owner;
+
+    template <typename Map, typename Key>
+    static void Insert(Map &map, const Key &key, Entry entry);
+    template <typename Map, typename Key>
+    static void Erase(Map &map, const Key &key, const Check *check);
+    void Unfile(const Check *check, const Keys &filed);
+};
+
+#endif
@@ -0,0 +1,637 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * check_journal.cc
+ * Append-only journal of open check changes
+ */
+
+#include "check_journal.hh"
+#include "data_file.hh"
+#include "utility.hh"
+
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+bool CheckJournal::enabled = false;
+
+namespace
+{
+/*********************************************************************
+ * Journal layout
+ *
+ *   frame:   "vtj <check version> <payload length> <payload fnv64>\n"
+ *            followed by the payload
+ *   save:    "1 serial base_digest result_digest has_header\n" [part]
+ *            "subcount\n" { "sub_index\n" head order_ops payment_ops tail }*
+ *            "-1\n"
+ *   part:    "<records> <length>\n" followed by length bytes of check text
+ *   ops:     "count\n" { "0 first count\n" (keep old entries)
+ *                      | "1\n" part       (new entry) }*
+ *   drop:    "2 serial\n"
+ *
+ * A frame whose length or checksum does not match ends the journal; it
+ * was torn by a crash while being appended.
+ ********************************************************************/
+constexpr const char* kJournalName   = "checks.journal";
+constexpr const char* kOldSuffix     = ".old";
+constexpr int         kRecordSave    = 1;
+constexpr int         kRecordDrop    = 2;
+constexpr int         kOpKeep        = 0;
+constexpr int         kOpNew         = 1;
+constexpr std::size_t kCheckpointBytes = 1024 * 1024;
+constexpr auto        kCheckpointAge   = std::chrono::minutes(5);
+
+constexpr uint64_t kFnvOffset = 0xcbf29ce484222325ULL;
+constexpr uint64_t kFnvPrime  = 0x100000001b3ULL;
+
+[[nodiscard]] uint64_t fnv1a(std::string_view data) noexcept
+{
+    uint64_t hash = kFnvOffset;
+    for (char ch : data)
+        hash = (hash ^ static_cast<unsigned char>(ch)) * kFnvPrime;
+    return hash;
+}
+
+inline void mix(uint64_t &hash, uint64_t value) noexcept
+{
+    for (int i = 0; i < 8; ++i)
+        hash = (hash ^ ((value >> (8 * i)) & 0xFF)) * kFnvPrime;
+}
+
+void put_part(std::string &rec, const JournalPart &part)
+{
+    rec += std::to_string(part.parts) + " " + std::to_string(part.text.size()) + "\n";
+    rec += part.text;
+}
+
+// Reads the numbers and parts of one record payload; any error sticks.
+struct Reader
+{
+    std::string_view data;
+    std::size_t pos{0};
+    bool failed{false};
+
+    template <typename T>
+    T Number()
+    {
+        T value{};
+        while (pos < data.size() && (data[pos] == ' ' || data[pos] == '\n'))
+            ++pos;
+        const char* begin = data.data() + pos;
+        const auto [end, ec] = std::from_chars(begin, data.data() + data.size(), value);
+        if (ec != std::errc())
+            failed = true;
+        pos += static_cast<std::size_t>(end - begin);
+        return value;
+    }
+
+    JournalPart Part(int version)
+    {
+        JournalPart part;
+        part.version = version;
+        part.parts = Number<int>();
+        const std::size_t length = Number<std::size_t>();
+        if (failed || pos >= data.size() || data[pos] != '\n' || length > data.size() - pos - 1)
+        {
+            failed = true;
+            return part;
+        }
+        part.text.assign(data.substr(pos + 1, length));
+        pos += 1 + length;
+        return part;
+    }
+};
+
+/****
+ * WriteOps:  Describes the new list of entries against the old one: runs
+ *   of entries whose text is unchanged are kept by index, everything
+ *   else is written out.
+ ****/
+void WriteOps(std::string &rec, const std::vector<uint64_t> &before, const std::vector<uint64_t> &after,
+              const std::vector<JournalPart> &entries)
+{
+    // old indices by hash, smallest last so runs stay in order
+    std::unordered_map<uint64_t, std::vector<int>> unused;
+    for (int idx = static_cast<int>(before.size()) - 1; idx >= 0; --idx)
+        unused[before[static_cast<std::size_t>(idx)]].push_back(idx);
+
+    struct Op { int first; int count; std::size_t entry; };
+    std::vector<Op> ops;
+    for (std::size_t idx = 0; idx < after.size(); ++idx)
+    {
+        auto found = unused.find(after[idx]);
+        if (found == unused.end() || found->second.empty())
+        {
+            ops.push_back({-1, 0, idx});
+            continue;
+        }
+        const int old_idx = found->second.back();
+        found->second.pop_back();
+        if (!ops.empty() && ops.back().first >= 0 && ops.back().first + ops.back().count == old_idx)
+            ++ops.back().count;
+        else
+            ops.push_back({old_idx, 1, 0});
+    }
+
+    rec += std::to_string(ops.size()) + "\n";
+    for (const Op &op : ops)
+    {
+        if (op.first >= 0)
+        {
+            rec += std::to_string(kOpKeep) + " " + std::to_string(op.first) + " " +
+                std::to_string(op.count) + "\n";
+        }
+        else
+        {
+            rec += std::to_string(kOpNew) + "\n";
+            put_part(rec, entries[op.entry]);
+        }
+    }
+}
+
+// Reads one op list, taking kept entries from 'old' and new ones from
+// the record.  Each old entry may be kept once.
+int ReadOps(Reader &in, int version, const std::vector<JournalPart> &old, std::vector<JournalPart> &result)
+{
+    std::vector<bool> kept(old.size(), false);
+    result.clear();
+    const int count = in.Number<int>();
+    for (int op_idx = 0; op_idx < count && !in.failed; ++op_idx)
+    {
+        const int op = in.Number<int>();
+        if (op == kOpKeep)
+        {
+            const int first = in.Number<int>();
+            const int run = in.Number<int>();
+            for (int idx = first; idx < first + run && !in.failed; ++idx)
+            {
+                if (idx < 0 || idx >= static_cast<int>(old.size()) || kept[static_cast<std::size_t>(idx)])
+                    in.failed = true;
+                else
+                {
+                    kept[static_cast<std::size_t>(idx)] = true;
+                    result.push_back(old[static_cast<std::size_t>(idx)]);
+                }
+            }
+        }
+        else if (op == kOpNew)
+            result.push_back(in.Part(version));
+        else
+            in.failed = true;
+    }
+    return in.failed ? 1 : 0;
+}
+
+[[nodiscard]] bool file_exists(const std::string &file)
+{
+    struct stat info{};
+    return stat(file.c_str(), &info) == 0;
+}
+
+} // namespace
+
+
+/*********************************************************************
+ * CheckJournal
+ ********************************************************************/
+
+CheckJournal::~CheckJournal()
+{
+    if (writer.joinable())
+        writer.join();
+    Close();
+}
+
+/****
+ * Print:  Hashes each part of image and the image as a whole.  Only the
+ *   text counts, so a check reads back to the same digest whatever
+ *   version its parts were written in.
+ ****/
+CheckJournal::CheckPrint CheckJournal::Print(const JournalImage &image)
+{
+    CheckPrint print;
+    print.header = fnv1a(image.header.text);
+    uint64_t digest = kFnvOffset;
+    mix(digest, print.header);
+    mix(digest, image.subs.size());
+    for (const JournalSub &sub : image.subs)
+    {
+        SubPrint sp;
+        sp.head = fnv1a(sub.head.text);
+        sp.tail = fnv1a(sub.tail.text);
+        for (const JournalPart &part : sub.orders)
+            sp.orders.push_back(fnv1a(part.text));
+        for (const JournalPart &part : sub.payments)
+            sp.payments.push_back(fnv1a(part.text));
+
+        mix(digest, sp.head);
+        mix(digest, sp.orders.size());
+        for (uint64_t hash : sp.orders)
+            mix(digest, hash);
+        mix(digest, sp.payments.size());
+        for (uint64_t hash : sp.payments)
+            mix(digest, hash);
+        mix(digest, sp.tail);
+        print.subs.push_back(std::move(sp));
+    }
+    // 0 marks a record that creates the check, so never use it as a digest
+    print.digest = (digest == 0) ? 1 : digest;
+    return print;
+}
+
+int CheckJournal::Open(const std::string &directory)
+{
+    FnTrace("CheckJournal::Open()");
+    Close();
+    path = directory + "/" + kJournalName;
+    fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0666);
+    if (fd < 0)
+    {
+        ReportError("CheckJournal: can't open '" + path + "' errno: " + std::to_string(errno));
+        return 1;
+    }
+    const off_t end = lseek(fd, 0, SEEK_END);
+    bytes = (end > 0) ? static_cast<std::size_t>(end) : 0;
+    return 0;
+}
+
+int CheckJournal::Close()
+{
+    FnTrace("CheckJournal::Close()");
+    if (fd >= 0)
+    {
+        Sync();
+        ::close(fd);
+        fd = -1;
+    }
+    return 0;
+}
+
+int CheckJournal::Append(std::string_view payload, int version)
+{
+    FnTrace("CheckJournal::Append()");
+    std::string frame = "vtj " + std::to_string(version) + " " +
+        std::to_string(payload.size()) + " " + std::to_string(fnv1a(payload)) + "\n";
+    frame.append(payload);
+
+    // one write() per frame, so a crash can only tear the last one
+    std::size_t done = 0;
+    while (done < frame.size())
+    {
+        const ssize_t len = ::write(fd, frame.data() + done, frame.size() - done);
+        if (len < 0 && errno == EINTR)
+            continue;
+        if (len <= 0)
+        {
+            ReportError("CheckJournal: write error '" + std::to_string(errno) + "' for '" + path + "'");
+            return 1;
+        }
+        done += static_cast<std::size_t>(len);
+    }
+    bytes += frame.size();
+
+    const DataFileSync sync = GetDataFileSync();
+    if (sync == DataFileSync::File)
+        fdatasync(fd);
+    else if (sync == DataFileSync::Group)
+        unsynced = true;
+    return 0;
+}
+
+int CheckJournal::Sync()
+{
+    if (fd < 0 || !unsynced)
+        return 0;
+    unsynced = false;
+    return fdatasync(fd);
+}
+
+/****
+ * Record:  Appends the difference between image and the check's last
+ *   recorded state.  The first record of a check (since startup or a
+ *   failure) holds all of it.
+ ****/
+int CheckJournal::Record(int serial, const JournalImage &image)
+{
+    FnTrace("CheckJournal::Record()");
+    if (fd < 0)
+        return 1;
+
+    CheckPrint next = Print(image);
+    auto found = prints.find(serial);
+    const CheckPrint empty;
+    const CheckPrint &last = (found != prints.end()) ? found->second : empty;
+    if (found != prints.end() && last.digest == next.digest)
+        return 0;  // nothing changed
+
+    const bool header_changed = (found == prints.end() || last.header != next.header);
+    std::string rec = std::to_string(kRecordSave) + " " + std::to_string(serial) + " " +
+        std::to_string(last.digest) + " " + std::to_string(next.digest) + " " +
+        (header_changed ? "1" : "0") + "\n";
+    if (header_changed)
+        put_part(rec, image.header);
+
+    rec += std::to_string(next.subs.size()) + "\n";
+    for (std::size_t idx = 0; idx < next.subs.size(); ++idx)
+    {
+        const SubPrint &now = next.subs[idx];
+        const SubPrint none;
+        const SubPrint &was = (idx < last.subs.size()) ? last.subs[idx] : none;
+        if (idx < last.subs.size() && was.head == now.head && was.tail == now.tail &&
+            was.orders == now.orders && was.payments == now.payments)
+        {
+            continue;
+        }
+        const JournalSub &sub = image.subs[idx];
+        rec += std::to_string(idx) + "\n";
+        put_part(rec, sub.head);
+        WriteOps(rec, was.orders, now.orders, sub.orders);
+        WriteOps(rec, was.payments, now.payments, sub.payments);
+        put_part(rec, sub.tail);
+    }
+    rec += "-1\n";
+
+    if (Append(rec, image.header.version))
+    {
+        prints.erase(serial);  // the next record starts over with the whole check
+        return 1;
+    }
+    prints[serial] = std::move(next);
+    journaled[serial] = image;
+    return 0;
+}
+
+int CheckJournal::Drop(int serial)
+{
+    FnTrace("CheckJournal::Drop()");
+    // a running checkpoint must not write the file back after it is deleted
+    if (writer.joinable())
+        writer.join();
+    prints.erase(serial);
+    journaled.erase(serial);
+    if (fd < 0)
+        return 0;
+    return Append(std::to_string(kRecordDrop) + " " + std::to_string(serial) + "\n", 0);
+}
+
+/****
+ * Journaled:  A dirty check as its last record left it, which is what a
+ *   checkpoint must write:  the check itself may hold edits not saved
+ *   yet, and the next record is a delta on the journaled state.
+ ****/
+const JournalImage *CheckJournal::Journaled(int serial) const
+{
+    auto found = journaled.find(serial);
+    return (found != journaled.end()) ? &found->second : nullptr;
+}
+
+bool CheckJournal::CheckpointDue() const
+{
+    if (journaled.empty())
+        return false;
+    return bytes >= kCheckpointBytes ||
+        std::chrono::steady_clock::now() - last_checkpoint >= kCheckpointAge;
+}
+
+bool CheckJournal::Checkpointing()
+{
+    if (writer.joinable() && !writing)
+        writer.join();
+    return writer.joinable();
+}
+
+/****
+ * Rotate:  Moves the records so far into checks.journal.old (appending if
+ *   an earlier checkpoint never finished) and starts an empty journal.
+ ****/
+int CheckJournal::Rotate()
+{
+    FnTrace("CheckJournal::Rotate()");
+    const std::string old_path = path + kOldSuffix;
+    Close();
+    if (!file_exists(old_path))
+    {
+        if (std::rename(path.c_str(), old_path.c_str()) != 0 && errno != ENOENT)
+            return 1;
+    }
+    else
+    {
+        std::ifstream src(path, std::ios::binary);
+        std::ofstream dst(old_path, std::ios::binary | std::ios::app);
+        dst << src.rdbuf();
+        dst.flush();
+        if (!dst)
+            return 1;
+        src.close();
+        ::unlink(path.c_str());
+    }
+    const std::string directory = path.substr(0, path.rfind('/'));
+    return Open(directory);
+}
+
+/****
+ * Checkpoint:  Writes files (the checks with journal records) on a
+ *   background thread, then removes the rotated journal.  Records made
+ *   meanwhile go to the new journal and apply on top of the checkpointed
+ *   state.
+ ****/
+int CheckJournal::Checkpoint(std::vector<JournalFile> files, bool wait)
+{
+    FnTrace("CheckJournal::Checkpoint()");
+    if (Checkpointing())
+    {
+        if (!wait)
+            return 0;  // previous checkpoint still writing
+        writer.join();
+    }
+    last_checkpoint = std::chrono::steady_clock::now();
+    if (fd < 0 || journaled.empty())
+        return 0;
+    if (Rotate())
+    {
+        ReportError("CheckJournal: can't rotate '" + path + "'");
+        return 1;
+    }
+    journaled.clear();
+
+    const std::string old_path = path + kOldSuffix;
+    writing = true;
+    writer = std::thread([this, files = std::move(files), old_path]() {
+        int failed = 0;
+        for (const JournalFile &file : files)
+        {
+            OutputDataFile df;
+            if (df.Open(file.filename, file.version, 0, DataFileKind::Check) ||
+                df.WriteRaw(file.body) || df.Close())
+            {
+                ++failed;
+            }
+        }
+        failed += DataFileGroupCommit();
+        if (failed == 0)
+            ::unlink(old_path.c_str());
+        else
+            ReportError("CheckJournal: checkpoint failed, keeping '" + old_path + "'");
+        writing = false;
+    });
+    if (wait)
+        writer.join();
+    return 0;
+}
+
+/****
+ * Replay:  Applies checks.journal.old and checks.journal, in that order,
+ *   and truncates a torn tail so new records append cleanly.  Changed
+ *   checks are left dirty for the next checkpoint.
+ ****/
+int CheckJournal::Replay(const std::string &directory, const ImageSource &source, JournalReplay &replay)
+{
+    FnTrace("CheckJournal::Replay()");
+    const std::string journal = directory + "/" + kJournalName;
+    int applied = 0;
+    applied += ReplayFile(journal + kOldSuffix, false, source, replay);
+    applied += ReplayFile(journal, true, source, replay);
+    return applied;
+}
+
+int CheckJournal::ReplayFile(const std::string &file, bool truncate, const ImageSource &source,
+                             JournalReplay &replay)
+{
+    FnTrace("CheckJournal::ReplayFile()");
+    std::ifstream in(file, std::ios::binary);
+    if (!in)
+        return 0;
+    const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    int applied = 0;
+    std::size_t pos = 0;
+    while (pos < data.size())
+    {
+        const std::size_t line_end = data.find('\n', pos);
+        if (line_end == std::string::npos || data.compare(pos, 4, "vtj ") != 0)
+            break;
+        Reader header{std::string_view(data).substr(pos + 4, line_end - pos - 4)};
+        const int version = header.Number<int>();
+        const std::size_t length = header.Number<std::size_t>();
+        const uint64_t hash = header.Number<uint64_t>();
+        if (header.failed || length > data.size() - line_end - 1)
+            break;
+        const std::string_view payload(data.data() + line_end + 1, length);
+        if (fnv1a(payload) != hash)
+            break;
+        if (Apply(payload, version, source, replay) > 0)
+            ++applied;
+        pos = line_end + 1 + length;
+    }
+
+    if (pos < data.size())
+    {
+        ReportError("CheckJournal: ignoring torn tail of '" + file + "'");
+        if (truncate && ::truncate(file.c_str(), static_cast<off_t>(pos)) != 0)
+            ReportError("CheckJournal: can't truncate '" + file + "'");
+    }
+    return applied;
+}
+
+/****
+ * Apply:  Returns 1 if the record changed a check, 0 if it did not apply
+ *   (its base state is gone) and -1 if it could not be read.
+ ****/
+int CheckJournal::Apply(std::string_view payload, int version, const ImageSource &source,
+                        JournalReplay &replay)
+{
+    FnTrace("CheckJournal::Apply()");
+    Reader in{payload};
+    const int kind = in.Number<int>();
+    const int serial = in.Number<int>();
+    if (in.failed)
+        return -1;
+
+    auto found = replay.images.find(serial);
+    if (found == replay.images.end() && replay.dropped.count(serial) == 0)
+    {
+        JournalImage image;
+        if (source && source(serial, image) == 0)
+            found = replay.images.emplace(serial, std::move(image)).first;
+    }
+
+    if (kind == kRecordDrop)
+    {
+        if (found == replay.images.end())
+            return 0;
+        replay.images.erase(found);
+        replay.changed.erase(serial);
+        replay.dropped.insert(serial);
+        journaled.erase(serial);
+        return 1;
+    }
+    if (kind != kRecordSave)
+        return -1;
+
+    const uint64_t base = in.Number<uint64_t>();
+    const uint64_t result = in.Number<uint64_t>();
+    JournalImage next;
+    if (base != 0)
+    {
+        if (found == replay.images.end() || Print(found->second).digest != base)
+            return 0;  // already folded into check_N, or superseded
+        next = found->second;
+    }
+
+    if (in.Number<int>())
+        next.header = in.Part(version);
+    const int subcount = in.Number<int>();
+    int idx = in.Number<int>();
+    while (idx >= 0 && !in.failed)
+    {
+        if (static_cast<std::size_t>(idx) >= next.subs.size())
+            next.subs.resize(static_cast<std::size_t>(idx) + 1);
+        JournalSub &sub = next.subs[static_cast<std::size_t>(idx)];
+        sub.head = in.Part(version);
+        const std::vector<JournalPart> old_orders = std::move(sub.orders);
+        ReadOps(in, version, old_orders, sub.orders);
+        const std::vector<JournalPart> old_payments = std::move(sub.payments);
+        ReadOps(in, version, old_payments, sub.payments);
+        sub.tail = in.Part(version);
+        idx = in.Number<int>();
+    }
+    if (subcount < 0 || static_cast<std::size_t>(subcount) > next.subs.size())
+        in.failed = true;
+    else
+        next.subs.resize(static_cast<std::size_t>(subcount));
+
+    if (in.failed || Print(next).digest != result)
+    {
+        ReportError("CheckJournal: unreadable record for check " + std::to_string(serial));
+        return -1;
+    }
+
+    journaled[serial] = next;
+    replay.images[serial] = std::move(next);
+    replay.changed.insert(serial);
+    replay.dropped.erase(serial);
+    return 1;
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * check_journal.hh
+ * Append-only journal of open check changes
+ */
+
+#ifndef CHECK_JOURNAL_HH
+#define CHECK_JOURNAL_HH
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/*********************************************************************
+ * Journal images
+ *
+ * A check as the journal sees it:  the text of each part in the order
+ * Check::Write() lays them out (less the counts), and the check version
+ * each part was written in.  Check::WriteImage() and Check::ReadImage()
+ * turn checks into images and back, so the journal never needs a Check.
+ ********************************************************************/
+struct JournalPart
+{
+    std::string text;
+    int version{0};
+    int parts{1};     // Order records (the order and its modifiers)
+
+    bool operator==(const JournalPart &other) const = default;
+};
+
+struct JournalSub
+{
+    JournalPart head;
+    std::vector<JournalPart> orders;
+    std::vector<JournalPart> payments;
+    JournalPart tail;
+
+    bool operator==(const JournalSub &other) const = default;
+};
+
+struct JournalImage
+{
+    JournalPart header;
+    std::vector<JournalSub> subs;
+
+    bool operator==(const JournalImage &other) const = default;
+};
+
+// What CheckJournal::Replay() did to the checks
+struct JournalReplay
+{
+    std::unordered_map<int, JournalImage> images;  // by serial, every check a record was read against
+    std::unordered_set<int> changed;               // images a record changed
+    std::unordered_set<int> dropped;               // checks a record removed
+};
+
+// A check file for CheckJournal::Checkpoint() to write
+struct JournalFile
+{
+    std::string filename;
+    int version{0};
+    std::string body;   // the encoded check, see OutputDataFile::OpenMemory()
+};
+
+/*********************************************************************
+ * CheckJournal
+ *
+ * With the journal on (checkjournal in .viewtouch_config), a check save
+ * appends only what changed since the check's last save -- the header,
+ * a subcheck's fields, new or edited orders and payments -- to
+ * <current>/checks.journal instead of rewriting check_N.  Each record
+ * names the digest of the check state it applies to, so replaying is
+ * safe whether or not a checkpoint already folded it into check_N.
+ * Checkpoints rotate the journal to checks.journal.old and write the
+ * check files from a background thread.
+ ********************************************************************/
+class CheckJournal
+{
+public:
+    // hashes of one check's parts as of its last journal record
+    struct SubPrint
+    {
+        uint64_t head{0};
+        uint64_t tail{0};
+        std::vector<uint64_t> orders;    // one per order, with its modifiers
+        std::vector<uint64_t> payments;
+    };
+    struct CheckPrint
+    {
+        uint64_t header{0};
+        uint64_t digest{0};              // of the whole check
+        std::vector<SubPrint> subs;
+    };
+
+    // Fills image for the current check serial; returns 1 if there is none
+    using ImageSource = std::function<int(int serial, JournalImage &image)>;
+
+    static bool enabled;                 // set from .viewtouch_config
+
+    CheckJournal() = default;
+    ~CheckJournal();
+    CheckJournal(const CheckJournal&) = delete;
+    CheckJournal& operator=(const CheckJournal&) = delete;
+
+    int  Open(const std::string &directory);
+    int  Close();
+    [[nodiscard]] bool IsOpen() const noexcept { return fd >= 0; }
+
+    int  Record(int serial, const JournalImage &image);  // nonzero: the caller must write the check whole
+    int  Drop(int serial);               // check left the current day
+    // Applies checks.journal.old and checks.journal, in that order, to the
+    // images source gives; returns the records applied
+    int  Replay(const std::string &directory, const ImageSource &source, JournalReplay &replay);
+    // Rotates the journal and writes files (the dirty checks, as
+    // Journaled() gives them) behind it
+    int  Checkpoint(std::vector<JournalFile> files, bool wait = false);
+    int  Sync();                         // syncs records held for the group commit
+    [[nodiscard]] bool CheckpointDue() const;
+    [[nodiscard]] bool Checkpointing();  // a checkpoint is still writing
+    [[nodiscard]] bool IsDirty(int serial) const { return journaled.count(serial) > 0; }
+    // A dirty check as its last record left it; nullptr if it's not dirty
+    [[nodiscard]] const JournalImage *Journaled(int serial) const;
+    [[nodiscard]] std::size_t Size() const noexcept { return bytes; }
+
+    [[nodiscard]] static CheckPrint Print(const JournalImage &image);
+
+private:
+    std::string path;
+    int fd{-1};
+    std::size_t bytes{0};
+    bool unsynced{false};
+    std::unordered_map<int, CheckPrint> prints;  // by serial number
+    std::unordered_map<int, JournalImage> journaled;  // checks whose files are behind the journal, as journaled
+    std::thread writer;                          // running checkpoint
+    std::atomic<bool> writing{false};            // until writer is done
+    std::chrono::steady_clock::time_point last_checkpoint{std::chrono::steady_clock::now()};
+
+    int Append(std::string_view payload, int version);
+    int Rotate();
+    int ReplayFile(const std::string &file, bool truncate, const ImageSource &source, JournalReplay &replay);
+    int Apply(std::string_view payload, int version, const ImageSource &source, JournalReplay &replay);
+};
+
+#endif
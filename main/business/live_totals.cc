@@ -0,0 +1,216 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * live_totals.cc
+ * Running totals of the current day's checks
+ */
+
+#include "live_totals.hh"
+#include "fntrace.hh"
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+namespace {
+
+void AddTally(LiveTotals::Tally &to, const LiveTotals::Tally &from, int sign)
+{
+    to.amount += sign * from.amount;
+    to.count  += sign * from.count;
+}
+
+bool IsEmpty(const LiveTotals::Tally &tally)
+{
+    return tally.amount == 0 && tally.count == 0;
+}
+
+void AddServer(LiveTotals::ServerTally &to, const LiveTotals::ServerTally &from, int sign)
+{
+    to.opened         += sign * from.opened;
+    to.closed         += sign * from.closed;
+    to.guests         += sign * from.guests;
+    to.takeouts       += sign * from.takeouts;
+    to.fastfood       += sign * from.fastfood;
+    to.sitdown_sales  += sign * from.sitdown_sales;
+    to.takeout_sales  += sign * from.takeout_sales;
+    to.fastfood_sales += sign * from.fastfood_sales;
+    to.captured_tip   += sign * from.captured_tip;
+}
+
+bool IsEmpty(const LiveTotals::ServerTally &tally)
+{
+    return tally.opened == 0 && tally.closed == 0 && tally.guests == 0 &&
+        tally.takeouts == 0 && tally.fastfood == 0 && tally.sitdown_sales == 0 &&
+        tally.takeout_sales == 0 && tally.fastfood_sales == 0 && tally.captured_tip == 0;
+}
+
+// adds (sign 1) or takes back (sign -1) the tallies of from, dropping
+// keys that come to nothing so the maps only hold what's live
+template <typename Map>
+void MergeTallies(Map &to, const Map &from, int sign)
+{
+    for (const auto &[key, tally] : from)
+    {
+        auto &total = to[key];
+        AddTally(total, tally, sign);
+        if (IsEmpty(total))
+            to.erase(key);
+    }
+}
+
+void AddSales(LiveTotals::SalesTally &to, const LiveTotals::SalesTally &from, int sign)
+{
+    to.guests         += sign * from.guests;
+    to.takeouts       += sign * from.takeouts;
+    to.fastfood       += sign * from.fastfood;
+    to.takeout_sales  += sign * from.takeout_sales;
+    to.fastfood_sales += sign * from.fastfood_sales;
+    to.item_comps     += sign * from.item_comps;
+    MergeTallies(to.families, from.families, sign);
+    MergeTallies(to.tenders, from.tenders, sign);
+    MergeTallies(to.meals, from.meals, sign);
+    for (std::size_t idx = 0; idx < to.tax.size(); ++idx)
+        to.tax[idx] += sign * from.tax[idx];
+}
+
+void AddItems(LiveTotals::ItemTallies &to, const LiveTotals::ItemTallies &from, int sign)
+{
+    for (const auto &[key, item] : from)
+    {
+        LiveTotals::ItemTally &total = to[key];
+        AddTally(total.counted, item.counted, sign);
+        if (sign > 0)
+            total.type = item.type;
+        for (const auto &[mod_key, mod] : item.modifiers)
+        {
+            LiveTotals::ModifierTally &modifier = total.modifiers[mod_key];
+            AddTally(modifier.priced, mod.priced, sign);
+            AddTally(modifier.figured, mod.figured, sign);
+            if (IsEmpty(modifier.priced) && IsEmpty(modifier.figured))
+                total.modifiers.erase(mod_key);
+        }
+        if (IsEmpty(total.counted) && total.modifiers.empty())
+            to.erase(key);
+    }
+}
+
+} // namespace
+
+void LiveTotals::Merge(const Totals &share, int sign)
+{
+    for (const auto &[drawer_id, tally] : share.drawers)
+    {
+        DrawerTally &drawer = totals.drawers[drawer_id];
+        drawer.checks += sign * tally.checks;
+        MergeTallies(drawer.tenders, tally.tenders, sign);
+        if (drawer.checks == 0 && drawer.tenders.empty())
+            totals.drawers.erase(drawer_id);
+    }
+
+    for (const auto &[user_id, tally] : share.servers)
+    {
+        ServerTally &server = totals.servers[user_id];
+        AddServer(server, tally, sign);
+        if (IsEmpty(server))
+            totals.servers.erase(user_id);
+    }
+    AddServer(totals.everyone, share.everyone, sign);
+    AddSales(totals.sales, share.sales, sign);
+
+    for (const auto &[user_id, items] : share.items)
+    {
+        ItemTallies &to = totals.items[user_id];
+        AddItems(to, items, sign);
+        if (to.empty())
+            totals.items.erase(user_id);
+    }
+
+    if (sign > 0)
+    {
+        if (share.first_open != 0 && (totals.first_open == 0 || share.first_open < totals.first_open))
+            totals.first_open = share.first_open;
+        if (share.last_open > totals.last_open)
+            totals.last_open = share.last_open;
+        if (share.last_close > totals.last_close)
+            totals.last_close = share.last_close;
+        if (share.last_settle > totals.last_settle)
+            totals.last_settle = share.last_settle;
+    }
+}
+
+void LiveTotals::Update(int serial, Totals share)
+{
+    FnTrace("LiveTotals::Update()");
+    auto found = shares.find(serial);
+    if (found != shares.end())
+    {
+        Merge(found->second, -1);
+        Merge(share, 1);
+        found->second = std::move(share);
+    }
+    else
+    {
+        Merge(share, 1);
+        shares.emplace(serial, std::move(share));
+    }
+}
+
+void LiveTotals::Drop(int serial)
+{
+    FnTrace("LiveTotals::Drop()");
+    auto found = shares.find(serial);
+    if (found == shares.end())
+        return;
+    Merge(found->second, -1);
+    shares.erase(found);
+}
+
+void LiveTotals::Clear()
+{
+    FnTrace("LiveTotals::Clear()");
+    totals = Totals{};
+    shares.clear();
+    sale_credit = -1;
+}
+
+const LiveTotals::DrawerTally *LiveTotals::FindDrawer(int drawer_id) const
+{
+    const auto found = totals.drawers.find(drawer_id);
+    return (found == totals.drawers.end()) ? nullptr : &found->second;
+}
+
+const LiveTotals::ServerTally *LiveTotals::FindServer(int user_id) const
+{
+    const auto found = totals.servers.find(user_id);
+    return (found == totals.servers.end()) ? nullptr : &found->second;
+}
+
+const LiveTotals::ItemTallies *LiveTotals::FindItems(int user_id) const
+{
+    const auto found = totals.items.find(user_id);
+    return (found == totals.items.end()) ? nullptr : &found->second;
+}
+
+bool LiveTotals::Covers(int64_t start, int64_t end) const
+{
+    if (shares.empty())
+        return true;
+    if (start == 0 || totals.first_open == 0)
+        return false;
+    return totals.first_open >= start && totals.last_open < end &&
+        totals.last_close < end && totals.last_settle < end;
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * live_totals.hh
+ * Running totals of the current day's checks
+ */
+
+#ifndef LIVE_TOTALS_HH
+#define LIVE_TOTALS_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+// LiveTotals::SalesTally::tax, in SubCheck's order
+#define LIVE_TAX_FOOD         0
+#define LIVE_TAX_ALCOHOL      1
+#define LIVE_TAX_ROOM         2
+#define LIVE_TAX_MERCHANDISE  3
+#define LIVE_TAX_GST          4
+#define LIVE_TAX_PST          5
+#define LIVE_TAX_HST          6
+#define LIVE_TAX_QST          7
+#define LIVE_TAX_VAT          8
+#define LIVE_TAX_CLASSES      9
+
+/*********************************************************************
+ * LiveTotals
+ *
+ * Sums over the current day's checks, kept up to date one check at a
+ * time:  System::UpdateLiveTotals() figures a check's share whenever
+ * the check or one of its orders or payments changes, and Update()
+ * takes back the share it last recorded for that check before adding
+ * the new one.  Readers (Drawer::Total(), the server, balance and sales
+ * mix reports) look up the sums instead of walking every check.
+ ********************************************************************/
+class LiveTotals
+{
+public:
+    struct Tally
+    {
+        int amount{0};
+        int count{0};
+    };
+    using TenderKey = std::pair<int, int>;  // tender type, tender id
+
+    // what Drawer::Total() gathers from the checks
+    struct DrawerTally
+    {
+        int checks{0};                          // subchecks settled to the drawer
+        std::map<TenderKey, Tally> tenders;     // tender id 0 for plain tender types
+    };
+    // what the server report gathers from the checks
+    struct ServerTally
+    {
+        int opened{0};
+        int closed{0};
+        int guests{0};
+        int takeouts{0};
+        int fastfood{0};
+        int sitdown_sales{0};
+        int takeout_sales{0};
+        int fastfood_sales{0};
+        int captured_tip{0};
+    };
+    // what the balance report gathers from the checks closed (and hotel
+    // checks opened), training checks left out
+    struct SalesTally
+    {
+        int guests{0};
+        int takeouts{0};
+        int fastfood{0};
+        int takeout_sales{0};                   // as SubCheck::GrossSales()
+        int fastfood_sales{0};
+        int item_comps{0};
+        std::map<int, Tally> families;          // GrossSales() by item family
+        std::map<TenderKey, Tally> tenders;     // payments by tender type and id
+        std::map<int, Tally> meals;             // total_sales by meal period settled in
+        std::array<int, LIVE_TAX_CLASSES> tax{};  // tax exempt subchecks left out
+    };
+    // what the sales mix gathers from settled orders:  units are
+    // Order::cost / Order::item_cost, as ItemCountList counts them
+    struct ModifierTally
+    {
+        Tally priced;   // modifiers with Order::cost > 0 (items without families)
+        Tally figured;  // modifiers with Order::total_cost > 0 (items by family)
+    };
+    using ItemKey     = std::tuple<std::string, int, int>;  // name, item cost, family
+    using ModifierKey = std::pair<std::string, int>;        // name, item cost
+    struct ItemTally
+    {
+        Tally counted;  // Order::count (weight for ITEM_POUND) over the orders
+        int   type{0};
+        std::map<ModifierKey, ModifierTally> modifiers;
+    };
+    using ItemTallies = std::map<ItemKey, ItemTally>;
+
+    // the totals, and also one check's share of them
+    struct Totals
+    {
+        std::unordered_map<int, DrawerTally> drawers;  // by drawer serial number
+        std::unordered_map<int, ServerTally> servers;  // by employee id, training included
+        ServerTally           everyone;                // training checks left out
+        SalesTally            sales;
+        std::unordered_map<int, ItemTallies> items;    // by who gets the sale, training left out
+        // time span of the checks (seconds, as SalesFactTime()); only
+        // ever widened, so it covers at least the checks counted
+        int64_t first_open{0};
+        int64_t last_open{0};
+        int64_t last_close{0};
+        int64_t last_settle{0};
+    };
+
+    int sale_credit{-1};  // Settings::sale_credit the server tallies follow
+
+    // Replaces the share recorded for check serial
+    void Update(int serial, Totals share);
+    // Takes check serial's share back out
+    void Drop(int serial);
+    void Clear();
+
+    [[nodiscard]] const Totals &Current() const noexcept { return totals; }
+    [[nodiscard]] std::size_t CheckCount() const noexcept { return shares.size(); }
+    // nullptr when nothing is recorded
+    [[nodiscard]] const DrawerTally *FindDrawer(int drawer_id) const;
+    [[nodiscard]] const ServerTally *FindServer(int user_id) const;
+    [[nodiscard]] const ItemTallies *FindItems(int user_id) const;
+    // boolean - every check was opened, settled and closed from start up to end
+    [[nodiscard]] bool Covers(int64_t start, int64_t end) const;
+
+private:
+    Totals totals;
+    std::unordered_map<int, Totals> shares;  // by check serial number
+
+    void Merge(const Totals &share, int sign);
+};
+
+#endif
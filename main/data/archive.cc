@@ -28,12 +28,87 @@
 
 #include "src/utils/cpp23_utils.hh"
 
+#include <sys/stat.h>
+#include <algorithm>
+
 #ifdef DMALLOC
 #include <dmalloc.h>
 #endif
 
 
+namespace {
+
+// identifies the archive file an index was built from
+struct ArchiveStamp
+{
+    int64_t size{-1};
+    int64_t mtime{-1};  // nanoseconds
+};
+
+ArchiveStamp StampOf(const std::string &file)
+{
+    ArchiveStamp stamp;
+    struct stat sb{};
+    if (stat(file.c_str(), &sb) == 0)
+    {
+        stamp.size  = static_cast<int64_t>(sb.st_size);
+        stamp.mtime = static_cast<int64_t>(sb.st_mtim.tv_sec) * 1000000000 + sb.st_mtim.tv_nsec;
+    }
+    return stamp;
+}
+
+std::string IndexPath(const Str &filename)
+{
+    return std::string(filename.Value()) + ".idx";
+}
+
+std::string FactsPath(const Str &filename)
+{
+    return std::string(filename.Value()) + ".facts";
+}
+
+// adds order and, after it, its modifiers (FigureCost() already run)
+void AddOrderFacts(SalesFacts &facts, int32_t sub, int32_t parent, Order *order)
+{
+    SalesFacts::OrderColumns &o = facts.orders;
+    const int32_t row = static_cast<int32_t>(facts.OrderCount());
+    o.sub.push_back(sub);
+    o.parent.push_back(parent);
+    o.name.push_back(facts.Intern(order->item_name.str()));
+    o.family.push_back(order->item_family);
+    o.item_type.push_back(order->item_type);
+    o.sales_type.push_back(order->sales_type);
+    o.qualifier.push_back(order->qualifier);
+    o.status.push_back(order->status);
+    o.item_cost.push_back(order->item_cost);
+    o.cost.push_back(order->cost);
+    o.total_cost.push_back(order->total_cost);
+    o.total_comp.push_back(order->total_comp);
+    o.count.push_back(order->count);
+    o.seat.push_back(order->seat);
+    o.user_id.push_back(order->user_id);
+    o.employee_meal.push_back(order->employee_meal);
+    o.is_reduced.push_back(order->is_reduced);
+
+    for (Order *mod = order->modifier_list; mod != nullptr; mod = mod->next)
+        AddOrderFacts(facts, sub, row, mod);
+}
+
+void Widen(TimeInfo &first, TimeInfo &last, const TimeInfo &time)
+{
+    if (!time.IsSet())
+        return;
+    if (!first.IsSet() || time < first)
+        first = time;
+    if (!last.IsSet() || time > last)
+        last = time;
+}
+
+} // namespace
+
 /**** Archive Class ****/
+std::size_t Archive::memory_budget = 0;  // sites opt in with archivememory
+
 // Constructors
 Archive::Archive(TimeInfo &end)
 {
@@ -49,6 +124,8 @@ Archive::Archive(TimeInfo &end)
     file_version       = 0;
     altmedia.Set("");
     from_disk          = 0;
+    indexed            = 0;
+    memory_size        = 0;
 
     drawer_version = DRAWER_VERSION;
     check_version  = CHECK_VERSION;
@@ -102,6 +179,8 @@ Archive::Archive(Settings *settings, const char* file)
     last_serial_number = 0;
     altmedia.Set("");
     from_disk          = 0;
+    indexed            = 0;
+    memory_size        = 0;
 
     drawer_version = DRAWER_VERSION;
     check_version  = CHECK_VERSION;
@@ -178,6 +257,7 @@ int Archive::LoadPacked(Settings *settings, const char* file)
     InputDataFile df;
     int error = 0;
     int i = 0;
+    std::vector<ArchiveCheckEntry> entries;
 
     Unload();
     if (file)
@@ -271,6 +351,7 @@ int Archive::LoadPacked(Settings *settings, const char* file)
                 ReportError("Unexpected end of Check data");
                 goto archive_read_error;
             }
+            const uint64_t offset = df.Tell();
             auto *check = new Check;
             error = check->Read(settings, df, check_version);
             if (error)
@@ -281,7 +362,16 @@ int Archive::LoadPacked(Settings *settings, const char* file)
                 goto archive_read_error;
             }
 
-            Add(check);
+            if (Add(check) == 0)
+            {
+                ArchiveCheckEntry entry;
+                entry.serial_number = check->serial_number;
+                entry.user_owner    = check->user_owner;
+                entry.time_open     = check->time_open;
+                entry.table         = check->Table();
+                entry.offset        = offset;
+                entries.push_back(std::move(entry));
+            }
         }
     }
     else
@@ -492,6 +582,8 @@ int Archive::LoadPacked(Settings *settings, const char* file)
         }
     }
 
+    BuildIndex(entries);
+    Touch();
     return 0;
 
 archive_read_error:
@@ -620,11 +712,38 @@ int Archive::SavePacked()
         return 1;  // cannot rewrite archive
     }
 
-    file_version = ARCHIVE_VERSION;
     OutputDataFile df;
-    if (df.Open(filename.Value(), ARCHIVE_VERSION, 1))
+    if (df.Open(filename.Value(), ARCHIVE_VERSION, 1, DataFileKind::Archive))
         return 1;
+    return WritePacked(df);
+}
 
+/****
+ * QueuePacked:  Like SavePacked(), but only encodes the archive here;
+ *  the write-behind thread compresses and writes it.
+ ****/
+int Archive::QueuePacked()
+{
+    FnTrace("Archive::QueuePacked()");
+    if (loaded == 0 || corrupt || from_disk)
+        return 1;
+
+    OutputDataFile df;
+    if (df.OpenMemory(DataFileFormatFor(DataFileKind::Archive)) || WritePacked(df))
+        return 1;
+    if (QueueDataFile(filename.Value(), ARCHIVE_VERSION, 1, df))
+    {
+        changed = 1;
+        from_disk = 0;
+        return 1;
+    }
+    return 0;
+}
+
+int Archive::WritePacked(OutputDataFile &df)
+{
+    FnTrace("Archive::WritePacked()");
+    file_version = ARCHIVE_VERSION;
     int count;
     df.Write(id);
     df.Write(start_time);
@@ -777,6 +896,10 @@ int Archive::SavePacked()
 
     changed = 0;  // can't have changed:  we just saved it
     from_disk = 1;  // it is now on disc, no need for system restart
+    Summarize();
+    // the checks moved in the new file; LoadPacked() indexes it again
+    check_index.clear();
+    indexed = 0;
 
     return 0;
 }
@@ -821,6 +944,486 @@ int Archive::Unload()
     cc_settle_results = nullptr;
 
     loaded = 0;
+    memory_size = 0;
+    return 0;
+}
+
+/****
+ * BuildIndex:  Summarizes the archive just loaded, takes its check
+ *  positions as the index and writes the sidecar index if the one on
+ *  disk is missing or out of date.
+ ****/
+void Archive::BuildIndex(std::vector<ArchiveCheckEntry> &entries)
+{
+    FnTrace("Archive::BuildIndex()");
+    Summarize();
+    std::sort(entries.begin(), entries.end(),
+              [](const ArchiveCheckEntry &a, const ArchiveCheckEntry &b) {
+                  return a.serial_number < b.serial_number;
+              });
+    check_index = std::move(entries);
+    indexed = 1;
+    WriteIndex();
+}
+
+/****
+ * Summarize:  Figures the summary and memory estimate from the loaded
+ *  lists.
+ ****/
+void Archive::Summarize()
+{
+    FnTrace("Archive::Summarize()");
+    summary = ArchiveSummary{};
+    memory_size = sizeof(Archive);
+
+    for (Drawer *drawer = DrawerList(); drawer != nullptr; drawer = drawer->next)
+    {
+        ++summary.drawers;
+        memory_size += sizeof(Drawer);
+    }
+
+    for (Check *check = CheckList(); check != nullptr; check = check->next)
+    {
+        memory_size += sizeof(Check);
+        for (SubCheck *sc = check->SubList(); sc != nullptr; sc = sc->next)
+        {
+            memory_size += sizeof(SubCheck);
+            for (Order *order = sc->OrderList(); order != nullptr; order = order->next)
+            {
+                memory_size += sizeof(Order);
+                for (Order *mod = order->modifier_list; mod != nullptr; mod = mod->next)
+                    memory_size += sizeof(Order);
+            }
+            for (Payment *payment = sc->PaymentList(); payment != nullptr; payment = payment->next)
+                memory_size += sizeof(Payment);
+        }
+
+        if (summary.first_serial == 0 || check->serial_number < summary.first_serial)
+            summary.first_serial = check->serial_number;
+        if (check->serial_number > summary.last_serial)
+            summary.last_serial = check->serial_number;
+        if (check->IsTraining())
+            continue;
+
+        ++summary.checks;
+        summary.guests += check->Guests();
+        Widen(summary.first_open, summary.last_open, check->time_open);
+        for (SubCheck *sc = check->SubList(); sc != nullptr; sc = sc->next)
+        {
+            ++summary.subchecks;
+            summary.sales    += sc->total_sales;
+            summary.tax      += sc->TotalTax();
+            summary.payments += sc->payment;
+            Widen(summary.first_settle, summary.last_settle, sc->settle_time);
+            for (Payment *payment = sc->PaymentList(); payment != nullptr; payment = payment->next)
+            {
+                if (payment->credit != nullptr ||
+                    payment->tender_type == TENDER_CREDIT_CARD ||
+                    payment->tender_type == TENDER_DEBIT_CARD ||
+                    payment->tender_type == TENDER_CHARGED_TIP)
+                {
+                    ++summary.card_payments;
+                }
+            }
+        }
+    }
+
+    for (Expense *expense = expense_db.ExpenseList(); expense != nullptr; expense = expense->next)
+    {
+        ++summary.expenses;
+        Widen(summary.first_expense, summary.last_expense, expense->exp_date);
+    }
+
+    if (cc_init_results != nullptr)
+        summary.card_results += cc_init_results->Count();
+    if (cc_saf_details_results != nullptr)
+        summary.card_results += cc_saf_details_results->Count();
+    if (cc_settle_results != nullptr)
+        summary.card_results += cc_settle_results->Count();
+}
+
+int Archive::WriteIndex()
+{
+    FnTrace("Archive::WriteIndex()");
+    const ArchiveStamp stamp = StampOf(filename.Value());
+    if (stamp.size < 0)
+        return 1;
+
+    // leave an up to date index alone
+    const std::string path = IndexPath(filename);
+    if (DoesFileExist(path.c_str()))
+    {
+        InputDataFile in;
+        int version = 0;
+        int64_t size = -1;
+        int64_t mtime = -1;
+        if (in.Open(path, version) == 0 && version == ARCHIVE_INDEX_VERSION)
+        {
+            in.Read(size);
+            in.Read(mtime);
+            if (size == stamp.size && mtime == stamp.mtime)
+                return 0;
+        }
+    }
+
+    OutputDataFile df;
+    if (df.Open(path, ARCHIVE_INDEX_VERSION, 1, DataFileKind::Archive))
+        return 1;
+    df.Write(stamp.size);
+    df.Write(stamp.mtime);
+    df.Write(check_version, 1);
+
+    df.Write(summary.checks);
+    df.Write(summary.subchecks);
+    df.Write(summary.guests);
+    df.Write(summary.drawers);
+    df.Write(summary.card_payments);
+    df.Write(summary.card_results);
+    df.Write(summary.expenses, 1);
+    df.Write(summary.sales);
+    df.Write(summary.tax);
+    df.Write(summary.payments, 1);
+    df.Write(summary.first_serial);
+    df.Write(summary.last_serial, 1);
+    df.Write(summary.first_open);
+    df.Write(summary.last_open, 1);
+    df.Write(summary.first_settle);
+    df.Write(summary.last_settle, 1);
+    df.Write(summary.first_expense);
+    df.Write(summary.last_expense, 1);
+
+    df.Write(static_cast<int>(check_index.size()), 1);
+    for (ArchiveCheckEntry &entry : check_index)
+    {
+        df.Write(entry.serial_number);
+        df.Write(entry.user_owner);
+        df.Write(entry.time_open);
+        df.Write(entry.table.c_str());
+        df.Write(entry.offset, 1);
+    }
+    return df.Close();
+}
+
+int Archive::ReadIndex()
+{
+    FnTrace("Archive::ReadIndex()");
+    const std::string path = IndexPath(filename);
+    if (!DoesFileExist(path.c_str()))
+        return 1;
+
+    InputDataFile df;
+    int version = 0;
+    if (df.Open(path, version) || version != ARCHIVE_INDEX_VERSION)
+        return 1;
+
+    // an archive rewritten since (or converted by vt_dataconv) has moved
+    const ArchiveStamp stamp = StampOf(filename.Value());
+    int64_t size = -1;
+    int64_t mtime = -1;
+    df.Read(size);
+    df.Read(mtime);
+    if (size != stamp.size || mtime != stamp.mtime)
+        return 1;
+
+    ArchiveSummary sum;
+    short version_of_checks = 0;
+    df.Read(version_of_checks);
+    df.Read(sum.checks);
+    df.Read(sum.subchecks);
+    df.Read(sum.guests);
+    df.Read(sum.drawers);
+    df.Read(sum.card_payments);
+    df.Read(sum.card_results);
+    df.Read(sum.expenses);
+    df.Read(sum.sales);
+    df.Read(sum.tax);
+    df.Read(sum.payments);
+    df.Read(sum.first_serial);
+    df.Read(sum.last_serial);
+    df.Read(sum.first_open);
+    df.Read(sum.last_open);
+    df.Read(sum.first_settle);
+    df.Read(sum.last_settle);
+    df.Read(sum.first_expense);
+    df.Read(sum.last_expense);
+
+    int count = 0;
+    df.Read(count);
+    if (count < 0 || df.end_of_file)
+        return 1;
+    std::vector<ArchiveCheckEntry> entries(static_cast<std::size_t>(count));
+    for (ArchiveCheckEntry &entry : entries)
+    {
+        Str table;
+        df.Read(entry.serial_number);
+        df.Read(entry.user_owner);
+        df.Read(entry.time_open);
+        df.Read(table);
+        df.Read(entry.offset);
+        entry.table = table.Value();
+        if (df.end_of_file)
+            return 1;
+    }
+
+    check_version = version_of_checks;
+    summary       = sum;
+    check_index   = std::move(entries);
+    indexed       = 1;
+    return 0;
+}
+
+int Archive::LoadIndex(Settings *settings)
+{
+    FnTrace("Archive::LoadIndex()");
+    if (indexed || ReadIndex() == 0)
+        return 0;
+    if (loaded)
+        return 1;  // the file isn't indexed until it is loaded again; use the lists
+    if (LoadPacked(settings))
+        return 1;
+    return indexed ? 0 : 1;
+}
+
+/****
+ * Summary:  The lists are newer than the index once anything changed
+ *  them (or a save rewrote the file), so a loaded archive is summarized
+ *  from them then; otherwise the index is read, or built by loading.
+ ****/
+const ArchiveSummary *Archive::Summary(Settings *settings)
+{
+    FnTrace("Archive::Summary()");
+    if (loaded && (changed || !indexed))
+        Summarize();
+    else if (!indexed && LoadIndex(settings))
+        return nullptr;
+    return &summary;
+}
+
+int Archive::MaySettleBetween(Settings *settings, TimeInfo &start, TimeInfo &end)
+{
+    FnTrace("Archive::MaySettleBetween()");
+    const ArchiveSummary *sum = Summary(settings);
+    if (sum == nullptr)
+        return 1;
+    if (!sum->first_settle.IsSet())
+        return 0;
+    return (sum->last_settle > start && sum->first_settle < end) ? 1 : 0;
+}
+
+int Archive::MayHoldExpensesBetween(Settings *settings, TimeInfo &start, TimeInfo &end)
+{
+    FnTrace("Archive::MayHoldExpensesBetween()");
+    const ArchiveSummary *sum = Summary(settings);
+    if (sum == nullptr)
+        return 1;
+    if (!sum->first_expense.IsSet())
+        return 0;
+    return (sum->last_expense >= start && sum->first_expense < end) ? 1 : 0;
+}
+
+int Archive::MayHoldCardResults(Settings *settings)
+{
+    FnTrace("Archive::MayHoldCardResults()");
+    const ArchiveSummary *sum = Summary(settings);
+    return (sum == nullptr || sum->card_results > 0) ? 1 : 0;
+}
+
+const ArchiveCheckEntry *Archive::FindCheckEntry(Settings *settings, int serial)
+{
+    FnTrace("Archive::FindCheckEntry()");
+    if (LoadIndex(settings))
+        return nullptr;
+
+    const auto found = std::lower_bound(check_index.begin(), check_index.end(), serial,
+                                        [](const ArchiveCheckEntry &entry, int value) {
+                                            return entry.serial_number < value;
+                                        });
+    if (found == check_index.end() || found->serial_number != serial)
+        return nullptr;
+    return &*found;
+}
+
+std::vector<const ArchiveCheckEntry *> Archive::FindCheckEntries(Settings *settings, TimeInfo &start,
+                                                                 TimeInfo &end)
+{
+    FnTrace("Archive::FindCheckEntries()");
+    std::vector<const ArchiveCheckEntry *> found;
+    if (LoadIndex(settings))
+        return found;
+
+    for (const ArchiveCheckEntry &entry : check_index)
+    {
+        if (entry.time_open.IsSet() && entry.time_open >= start && entry.time_open < end)
+            found.push_back(&entry);
+    }
+    return found;
+}
+
+/****
+ * ReadCheck:  Reads the check as it was last saved to the archive file,
+ *  seeking through the index to the block that holds it, so the rest of
+ *  the archive stays on disk.  While the loaded lists are newer than the
+ *  index the check is copied from them through a memory stream instead.
+ *  Totals are not figured:  the archive's tax settings are only read
+ *  with the rest of it.  The caller owns the check.
+ ****/
+std::unique_ptr<Check> Archive::ReadCheck(Settings *settings, int serial)
+{
+    FnTrace("Archive::ReadCheck()");
+    auto check = std::make_unique<Check>();
+    check->archive = this;
+
+    if (loaded && (changed || !indexed))
+    {
+        Check *found = check_list.Head();
+        while (found != nullptr && found->serial_number != serial)
+            found = found->next;
+        if (found == nullptr)
+            return nullptr;
+
+        OutputDataFile out;
+        InputDataFile in;
+        if (out.OpenMemory() || found->Write(out, CHECK_VERSION) ||
+            in.OpenMemory(out.Contents()) || check->Read(settings, in, CHECK_VERSION))
+        {
+            return nullptr;
+        }
+    }
+    else
+    {
+        const ArchiveCheckEntry *entry = FindCheckEntry(settings, serial);
+        if (entry == nullptr)
+            return nullptr;
+
+        InputDataFile df;
+        int version = 0;
+        if (df.Open(filename.Value(), version) || df.Seek(entry->offset))
+            return nullptr;
+        if (check->Read(settings, df, check_version) || check->serial_number != serial)
+        {
+            ReportError("Archive index does not match " + std::string(filename.Value()));
+            check_index.clear();
+            indexed = 0;
+            return nullptr;
+        }
+    }
+
+    for (SubCheck *subcheck = check->SubList(); subcheck != nullptr; subcheck = subcheck->next)
+        subcheck->archive = this;
+    return check;
+}
+
+/****
+ * Facts:  The sales fact store.  Returns nullptr while the archive has
+ *  unsaved changes (the lists are newer than any file) or if it can't
+ *  be loaded; callers then walk the checks instead.
+ ****/
+const SalesFacts *Archive::Facts(Settings *settings)
+{
+    FnTrace("Archive::Facts()");
+    if (loaded && (changed || corrupt))
+        return nullptr;
+
+    // QueuePacked() clears changed before the writer lands the file;
+    // stamping the old file would serve facts from before the save
+    DataFileSettle(filename.Value());
+    const ArchiveStamp stamp = StampOf(filename.Value());
+    const auto current = [&stamp](const SalesFacts &f) {
+        return stamp.size >= 0 && f.source_size == stamp.size && f.source_mtime == stamp.mtime;
+    };
+    if (facts && current(*facts))
+        return facts.get();
+
+    const std::string path = FactsPath(filename);
+    auto built = std::make_unique<SalesFacts>();
+    if (built->Read(path) == 0 && current(*built))
+    {
+        facts = std::move(built);
+        return facts.get();
+    }
+
+    if (loaded == 0 && LoadPacked(settings))
+        return nullptr;
+    if (corrupt || BuildFacts(settings, *built))
+        return nullptr;
+    built->source_size  = stamp.size;
+    built->source_mtime = stamp.mtime;
+    if (stamp.size >= 0 && built->Write(path))
+        ReportError(std::string("Can't write sales facts '") + path + "'");
+    Touch();
+    facts = std::move(built);
+    return facts.get();
+}
+
+/****
+ * BuildFacts:  Flattens the loaded checks into out, one row per check,
+ *  subcheck, order, modifier and payment.
+ ****/
+int Archive::BuildFacts(Settings *settings, SalesFacts &out)
+{
+    FnTrace("Archive::BuildFacts()");
+    if (loaded == 0)
+        return 1;
+
+    out.Clear();
+    SalesFacts::CheckColumns    &c = out.checks;
+    SalesFacts::SubCheckColumns &s = out.subchecks;
+    SalesFacts::PaymentColumns  &p = out.payments;
+    for (Check *check = CheckList(); check != nullptr; check = check->next)
+    {
+        const int32_t check_row = static_cast<int32_t>(out.CheckCount());
+        int flags = 0;
+        if (check->IsTraining())
+            flags |= FACT_TRAINING;
+        if (check->IsTakeOut())
+            flags |= FACT_TAKEOUT;
+        if (check->IsFastFood())
+            flags |= FACT_FASTFOOD;
+        TimeInfo *closed = check->TimeClosed();
+
+        c.serial.push_back(check->serial_number);
+        c.type.push_back(check->CustomerType());
+        c.flags.push_back(flags);
+        c.user_open.push_back(check->user_open);
+        c.user_owner.push_back(check->user_owner);
+        c.guests.push_back(check->Guests());
+        c.time_open.push_back(SalesFactTime(check->time_open));
+        c.time_closed.push_back(closed ? SalesFactTime(*closed) : 0);
+
+        for (SubCheck *sc = check->SubList(); sc != nullptr; sc = sc->next)
+        {
+            const int32_t sub_row = static_cast<int32_t>(out.SubCheckCount());
+            s.check.push_back(check_row);
+            s.number.push_back(sc->number);
+            s.status.push_back(sc->status);
+            s.drawer_id.push_back(sc->drawer_id);
+            s.meal.push_back(sc->settle_time.IsSet() ? settings->MealPeriod(sc->settle_time) : -1);
+            s.total_sales.push_back(sc->total_sales);
+            s.total_tax.push_back(sc->TotalTax());
+            s.tip.push_back(sc->TotalTip());
+            s.payment.push_back(sc->payment);
+            s.settle_time.push_back(SalesFactTime(sc->settle_time));
+
+            for (Order *order = sc->OrderList(); order != nullptr; order = order->next)
+            {
+                order->FigureCost();
+                AddOrderFacts(out, sub_row, -1, order);
+            }
+
+            for (Payment *payment = sc->PaymentList(); payment != nullptr; payment = payment->next)
+            {
+                p.sub.push_back(sub_row);
+                p.tender_type.push_back(payment->tender_type);
+                p.tender_id.push_back(payment->tender_id);
+                p.value.push_back(payment->value);
+                p.amount.push_back(payment->amount);
+                p.flags.push_back(payment->flags);
+                p.user_id.push_back(payment->user_id);
+                p.drawer_id.push_back(payment->drawer_id);
+                p.credit.push_back(payment->credit != nullptr ? 1 : 0);
+            }
+        }
+    }
     return 0;
 }
 
@@ -1057,3 +1660,11 @@ MealInfo *Archive::FindMealByID(int meal_id)
     }
     return nullptr;
 }
+
+/**** Functions ****/
+int64_t SalesFactTime(const TimeInfo &timevar)
+{
+    if (!timevar.IsSet())
+        return 0;
+    return static_cast<int64_t>(timevar.get_local_time().time_since_epoch().count());
+}
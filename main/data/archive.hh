@@ -29,10 +29,19 @@
 #include "list_utility.hh"
 #include "expense.hh"
 #include "settings.hh"
+#include "sales_facts.hh"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
 
 
 /**** Definitions ****/
 #define ARCHIVE_VERSION 14
+#define ARCHIVE_INDEX_VERSION 4
+#define ARCHIVE_IDLE_SECONDS  300  // System::TrimArchives() keeps archives used this recently
 
 
 /**** Types ****/
@@ -44,6 +53,37 @@ class InputDataFile;
 class OutputDataFile;
 class CreditDB;
 
+// Totals of an archive's non-training checks, kept in its index so
+// reports can tell what an archive holds without loading it
+struct ArchiveSummary
+{
+    int      checks{0};
+    int      subchecks{0};
+    int      guests{0};
+    int      drawers{0};
+    int      card_payments{0};    // card tenders and payments with card data
+    int      card_results{0};     // card processor init, SAF and settle records
+    int      expenses{0};
+    int64_t  sales{0};            // SubCheck::total_sales
+    int64_t  tax{0};
+    int64_t  payments{0};
+    int      first_serial{0};     // all checks, training included
+    int      last_serial{0};
+    TimeInfo first_open, last_open;
+    TimeInfo first_settle, last_settle;
+    TimeInfo first_expense, last_expense;
+};
+
+// Where one check is stored in an archive file
+struct ArchiveCheckEntry
+{
+    int         serial_number{0};
+    int         user_owner{0};
+    TimeInfo    time_open;
+    std::string table;
+    uint64_t    offset{0};  // InputDataFile::Tell() at the check record
+};
+
 class Archive
 {
     DList<Check>          check_list;
@@ -55,6 +95,14 @@ class Archive
     DList<MealInfo>       meal_list;
     short                 from_disk;  // if this is positive, we'll avoid writing
 
+    int  ReadIndex();
+    int  WriteIndex();
+    void BuildIndex(std::vector<ArchiveCheckEntry> &entries);
+    void Summarize();
+    int  BuildFacts(Settings *s, SalesFacts &out);
+
+    std::unique_ptr<SalesFacts> facts;  // see Facts()
+
 public:
     Archive *next, *fore;
     Str      filename;
@@ -77,6 +125,21 @@ public:
     short    changed;  // has archive been changed since last load or save?
     short    corrupt;   // error in loading archive - no changes will save
 
+    // Sidecar index (<archive>.idx):  where each check sits in the file,
+    // plus a summary.  Written whenever LoadPacked() finds it missing or
+    // older than the archive file.  Archives are saved in the binary
+    // format by default, so a position names one block to read.
+    short                          indexed;      // check_index and summary match the file
+    ArchiveSummary                 summary;
+    std::vector<ArchiveCheckEntry> check_index;  // by serial number
+
+    // System::TrimArchives() unloads the least recently used archives
+    // once the loaded ones pass memory_budget; last_used is set by any
+    // CheckList() or DrawerList() walk
+    static std::size_t             memory_budget;  // bytes, 0 for no limit
+    std::size_t                    memory_size;    // estimate for the loaded contents
+    std::chrono::steady_clock::time_point last_used;
+
     // Settings that shouldn't change (from settings.hh)
     Flt tax_food;
     Flt tax_alcohol;
@@ -114,10 +177,11 @@ public:
     ~Archive() { Unload(); }
 
     // Member Functions
-    Check          *CheckList()      { return check_list.Head(); }
-    Check          *CheckListEnd()   { return check_list.Tail(); }
-    Drawer         *DrawerList()     { return drawer_list.Head(); }
-    Drawer         *DrawerListEnd()  { return drawer_list.Tail(); }
+    // walking the checks or drawers counts as use (see Touch())
+    Check          *CheckList()      { Touch(); return check_list.Head(); }
+    Check          *CheckListEnd()   { Touch(); return check_list.Tail(); }
+    Drawer         *DrawerList()     { Touch(); return drawer_list.Head(); }
+    Drawer         *DrawerListEnd()  { Touch(); return drawer_list.Tail(); }
     DiscountInfo   *DiscountList()   { return discount_list.Head(); }
     CouponInfo     *CouponList()     { return coupon_list.Head(); }
     CreditCardInfo *CreditCardList() { return creditcard_list.Head(); }
@@ -132,8 +196,37 @@ public:
     int LoadAlternateSettings();
     int SavePacked();
     // Saves archive contents
+    int QueuePacked();
+    // Saves archive contents from the write-behind thread
+    int WritePacked(OutputDataFile &df);
+    // Writes archive contents to an open file
     int Unload();
     // Purges archive contents - makes archive as unloaded
+    void Touch() { last_used = std::chrono::steady_clock::now(); }
+    // Marks the archive as recently used
+
+    int LoadIndex(Settings *s);
+    // Reads the sidecar index, loading the archive to build it if needed
+    const ArchiveSummary *Summary(Settings *s);
+    // The index summary, or one figured from the lists while they are
+    // newer than the file; nullptr if the archive can't be read
+    int MaySettleBetween(Settings *s, TimeInfo &start, TimeInfo &end);
+    // boolean - can any non-training subcheck have settled strictly
+    // between start and end?
+    int MayHoldExpensesBetween(Settings *s, TimeInfo &start, TimeInfo &end);
+    // boolean - can any expense be dated from start up to end?
+    int MayHoldCardResults(Settings *s);
+    // boolean - can the archive hold card processor results?
+    const ArchiveCheckEntry *FindCheckEntry(Settings *s, int serial);
+    std::vector<const ArchiveCheckEntry *> FindCheckEntries(Settings *s, TimeInfo &start,
+                                                            TimeInfo &end);
+    // checks opened from start up to end
+    std::unique_ptr<Check> ReadCheck(Settings *s, int serial);
+    // Reads one check through the index; the archive need not be loaded
+    const SalesFacts *Facts(Settings *s);
+    // The archive's sales as columns, from <archive>.facts; built (and
+    // written) from the archive when missing or older than the archive
+    // file.  nullptr if the archive can't be loaded.
 
     int Add(Drawer *d);
     int Remove(Drawer *d);
@@ -163,4 +256,8 @@ public:
     MealInfo       *FindMealByID(int meal_id);
 };
 
+/**** Functions ****/
+int64_t SalesFactTime(const TimeInfo &timevar);
+// time as stored in SalesFacts:  seconds since the epoch, 0 if unset
+
 #endif
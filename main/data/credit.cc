@@ -37,6 +37,7 @@
 #include <cctype>
 #include <ctime>
 #include <cstring>
+#include <memory>
 
 #ifdef DMALLOC
 #include <dmalloc.h>
@@ -100,6 +101,8 @@ int   CreditCardStateValue[] = {
  * Credit Class
  ********************************************************************/
 
+thread_local std::vector<long long> *Credit::batch_sink = nullptr;
+
 Credit::Credit()
 {
     FnTrace("Credit::Credit()");
@@ -338,7 +341,12 @@ int Credit::Read(InputDataFile &df, int version)
     }
 
     if (IsSettled() == 0)
-        MasterSystem->AddBatch(batch);
+    {
+        if (batch_sink)
+            batch_sink->push_back(batch);
+        else
+            MasterSystem->AddBatch(batch);
+    }
 
     return error;
 }
@@ -2103,6 +2111,13 @@ int Credit::ReceiptPrint(Terminal *term, int receipt_type, Printer *pprinter, in
     int idx;
     static int count = 0;  // for saving receipts for Moneris testing
     Check *parent = term->system_data->FindCheckByID(check_id);
+    std::unique_ptr<Check> archived;  // parent read back from its archive
+
+    if (parent == nullptr && check_id > 0 && settings->cc_print_custinfo)
+    {
+        archived = term->system_data->ReadArchivedCheck(check_id);
+        parent = archived.get();
+    }
 
     if (printer == nullptr)
         printer = term->FindPrinter(PRINTER_RECEIPT);
@@ -2904,7 +2919,7 @@ int CCSettle::Next(Terminal *term)
                 if (archive == nullptr)
                 {
                     archive = MasterSystem->ArchiveList();
-                    if (archive && archive->loaded == 0)
+                    if (archive && archive->loaded == 0 && archive->MayHoldCardResults(settings))
                         archive->LoadPacked(settings);
                 }
                 else
@@ -2912,7 +2927,7 @@ int CCSettle::Next(Terminal *term)
                     do
                     {
                         archive = archive->next;
-                        if (archive && archive->loaded == 0)
+                        if (archive && archive->loaded == 0 && archive->MayHoldCardResults(settings))
                             archive->LoadPacked(settings);
                     } while (archive != nullptr && archive->cc_settle_results == nullptr);
                 }
@@ -2954,7 +2969,7 @@ int CCSettle::Fore(Terminal *term)
                 if (archive == nullptr)
                 {
                     archive = MasterSystem->ArchiveListEnd();
-                    if (archive && archive->loaded == 0)
+                    if (archive && archive->loaded == 0 && archive->MayHoldCardResults(settings))
                         archive->LoadPacked(settings);
                 }
                 else
@@ -2962,7 +2977,7 @@ int CCSettle::Fore(Terminal *term)
                     do
                     {
                         archive = archive->fore;
-                        if (archive && archive->loaded == 0)
+                        if (archive && archive->loaded == 0 && archive->MayHoldCardResults(settings))
                             archive->LoadPacked(settings);
                     } while (archive != nullptr && archive->cc_settle_results == nullptr);
                 }
@@ -3366,6 +3381,25 @@ int CCSettle::IsSettled()
     return retval;
 }
 
+int CCSettle::Count()
+{
+    FnTrace("CCSettle::Count()");
+    int retval = 0;
+    CCSettle *node = next;
+
+    if (result.size() > 0)
+    {
+        retval = 1;
+        while (node != nullptr)
+        {
+            retval += 1;
+            node = node->next;
+        }
+    }
+
+    return retval;
+}
+
 int CCSettle::GenerateReport(Terminal *term, Report *report, ReportZone *rzone, Archive *reparc)
 {
     FnTrace("CCSettle::GenerateReport()");
@@ -3580,7 +3614,7 @@ int CCInit::Next(Terminal *term)
                 if (archive == nullptr)
                 {
                     archive = MasterSystem->ArchiveList();
-                    if (archive && archive->loaded == 0)
+                    if (archive && archive->loaded == 0 && archive->MayHoldCardResults(settings))
                         archive->LoadPacked(settings);
                 }
                 else
@@ -3588,7 +3622,7 @@ int CCInit::Next(Terminal *term)
                     do
                     {
                         archive = archive->next;
-                        if (archive && archive->loaded == 0)
+                        if (archive && archive->loaded == 0 && archive->MayHoldCardResults(settings))
                             archive->LoadPacked(settings);
                     } while (archive != nullptr && archive->cc_init_results == nullptr);
                 }
@@ -3630,7 +3664,7 @@ int CCInit::Fore(Terminal *term)
                 if (archive == nullptr)
                 {
                     archive = MasterSystem->ArchiveListEnd();
-                    if (archive && archive->loaded == 0)
+                    if (archive && archive->loaded == 0 && archive->MayHoldCardResults(settings))
                         archive->LoadPacked(settings);
                 }
                 else
@@ -3638,7 +3672,7 @@ int CCInit::Fore(Terminal *term)
                     do
                     {
                         archive = archive->fore;
-                        if (archive && archive->loaded == 0)
+                        if (archive && archive->loaded == 0 && archive->MayHoldCardResults(settings))
                             archive->LoadPacked(settings);
                     } while (archive != nullptr && archive->cc_init_results == nullptr);
                 }
@@ -3970,7 +4004,7 @@ int CCSAFDetails::Next(Terminal *term)
                 if (archive == nullptr)
                 {
                     archive = MasterSystem->ArchiveList();
-                    if (archive && archive->loaded == 0)
+                    if (archive && archive->loaded == 0 && archive->MayHoldCardResults(settings))
                         archive->LoadPacked(settings);
                 }
                 else
@@ -3978,7 +4012,7 @@ int CCSAFDetails::Next(Terminal *term)
                     do
                     {
                         archive = archive->next;
-                        if (archive && archive->loaded == 0)
+                        if (archive && archive->loaded == 0 && archive->MayHoldCardResults(settings))
                             archive->LoadPacked(settings);
                     } while (archive != nullptr && archive->cc_saf_details_results == nullptr);
                 }
@@ -4020,7 +4054,7 @@ int CCSAFDetails::Fore(Terminal *term)
                 if (archive == nullptr)
                 {
                     archive = MasterSystem->ArchiveListEnd();
-                    if (archive && archive->loaded == 0)
+                    if (archive && archive->loaded == 0 && archive->MayHoldCardResults(settings))
                         archive->LoadPacked(settings);
                 }
                 else
@@ -4028,7 +4062,7 @@ int CCSAFDetails::Fore(Terminal *term)
                     do
                     {
                         archive = archive->fore;
-                        if (archive && archive->loaded == 0)
+                        if (archive && archive->loaded == 0 && archive->MayHoldCardResults(settings))
                             archive->LoadPacked(settings);
                     } while (archive != nullptr && archive->cc_saf_details_results == nullptr);
                 }
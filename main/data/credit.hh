@@ -25,6 +25,8 @@
 #include "printer.hh"
 #include "utility.hh"
 
+#include <vector>
+
 class Archive;
 class ReportZone;
 class LayoutZone;
@@ -310,6 +312,10 @@ public:
     TimeInfo settle_time;
     int check_id;   // set when the Credit is first attached to a check
 
+    // While set, Read() collects the batches of unsettled credits here
+    // instead of adding them to MasterSystem (threads loading checks)
+    static thread_local std::vector<long long> *batch_sink;
+
     // Constructors
     Credit();
     Credit(const char* swipe_value);
@@ -526,6 +532,7 @@ public:
     int       Save();
     int       ReadResults(Terminal *term);
     int       IsSettled();
+    int       Count();
     int       MakeReport(Terminal *term, Report *report, ReportZone *rzone);
     void      DebugPrint();
     const char* Batch()  { return batch.Value(); }
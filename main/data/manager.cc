@@ -28,6 +28,7 @@
 #include "printer.hh"
 #include "drawer.hh"
 #include "data_file.hh"
+#include "archive.hh"
 #include "term/term_view.hh"
 #include "data_persistence_manager.hh"
 #include "inventory.hh"
@@ -39,6 +40,8 @@
 #include "credit.hh"
 #include "debug.hh"
 #include "socket.hh"
+#include "remote_link.hh"
+#include "remote_order.hh"
 #include "version/vt_version_info.hh"
 #include "zone/dialog_zone.hh"
 
@@ -78,6 +81,9 @@
 #include <filesystem>       // generic filesystem functions available since C++17
 #include <cstdio>           // for std::remove
 #include <array>            // std::array for fixed-size buffers
+#include <utility>          // std::pair
+#include <vector>           // std::vector for the startup phase times
+#include <unordered_map>    // remote order connections by socket
 
 #ifdef DMALLOC
 #include <dmalloc.h>
@@ -164,6 +170,7 @@ int                 LoaderSocket = 0;
 int                 OpenTermPort = 10001;
 int                 OpenTermSocket = -1;
 int                 autoupdate = 0;
+int                 LoadThreads = 0;  // startup parse workers, 0 = one per core
 
 // run the user command on startup if it is available; after that,
 // we'll only run it when we get SIGUSR2.  The 2 here indicates
@@ -226,10 +233,8 @@ unsigned long restart_timeout_id = 0; // Timeout for auto restart
 
 #ifdef DEBUG
 #define OPENTERM_SLEEP 0
-#define MAX_CONN_TRIES 1000
 #else
 #define OPENTERM_SLEEP 5
-#define MAX_CONN_TRIES 10
 #endif
 
 
@@ -270,6 +275,7 @@ int      RunMacros();
 int      RunReport(const genericChar* report_string, Printer *printer);
 Printer *SetPrinter(const genericChar* printer_description);
 int      ReadViewTouchConfig();
+int      StartRemoteOrders(int listen_sock);
 int      ReloadFonts();  // Function to reload fonts when global defaults change
 
 genericChar* GetMachineName(genericChar* str = nullptr, int len = STRLENGTH)
@@ -458,6 +464,51 @@ int ReadViewTouchConfig()
         (void)conf.GetValue(autoupdate, "autoupdate");  // Suppress nodiscard warnings
         (void)conf.GetValue(select_timeout, "selecttimeout");
         (void)conf.GetValue(debug_mode, "debugmode");
+
+        // on-disk format per data file family ("text" or "binary")
+        const std::array<std::pair<const char*, DataFileKind>, 4> format_keys = {{
+            {"checkfileformat",    DataFileKind::Check},
+            {"drawerfileformat",   DataFileKind::Drawer},
+            {"archivefileformat",  DataFileKind::Archive},
+            {"settingsfileformat", DataFileKind::Settings},
+        }};
+        for (const auto &[key, kind] : format_keys)
+        {
+            std::string name;
+            DataFileFormat format;
+            if (conf.GetValue(name, key) && ParseDataFileFormat(name, format))
+                SetDataFileFormat(kind, format);
+        }
+
+        // how data file saves reach the disk ("direct", "none", "file" or "group")
+        std::string sync_name;
+        DataFileSync sync;
+        if (conf.GetValue(sync_name, "datafilesync") && ParseDataFileSync(sync_name, sync))
+            SetDataFileSync(sync);
+
+        // journal open check saves instead of rewriting check files
+        int check_journal = 0;
+        if (conf.GetValue(check_journal, "checkjournal"))
+            CheckJournal::enabled = (check_journal != 0);
+
+        // workers parsing archives, checks and drawers at startup
+        (void)conf.GetValue(LoadThreads, "loadthreads");
+
+        // megabytes of loaded archives kept before the least recently
+        // used are unloaded (0 keeps everything)
+        int archive_memory = 0;
+        if (conf.GetValue(archive_memory, "archivememory") && archive_memory >= 0)
+            Archive::memory_budget = static_cast<std::size_t>(archive_memory) * 1024 * 1024;
+
+        // terminal link encoding:  1 keeps every link on the tagged v1
+        // encoding; linkchecked keeps the type bytes in the compact one
+        (void)conf.GetValue(LinkEncodingLimit, "linkencoding");
+        int link_checked = 0;
+        if (conf.GetValue(link_checked, "linkchecked"))
+            LinkFlags = link_checked ? LINK_CHECKED : 0;
+
+        // megabytes of page copies each vt_term is asked to keep (0 for none)
+        (void)conf.GetValue(LinkPageMemory, "pagememory");
     } catch (const std::runtime_error &e) {
         ReportError(
                     std::string("ReadViewTouchConfig: ")
@@ -592,6 +643,10 @@ int main(int argc, genericChar* argv[])
                 {
                     notrace = 1;
                 }
+                else if (strncmp(buffer.data(), "loadthreads ", 12) == 0)
+                {
+                    LoadThreads = atoi(&buffer[12]);
+                }
             }
             else
                 ++c;
@@ -655,6 +710,7 @@ int main(int argc, genericChar* argv[])
         EndSystem();
     }
     vt::Logger::debug("System object created successfully");
+    MasterSystem->load_threads = LoadThreads;
     
     // Initialize data persistence manager
     vt::Logger::info("Initializing data persistence manager...");
@@ -835,6 +891,47 @@ int ReportLoader(const char* message)
     return 0;
 }
 
+// boot-time breakdown:  each startup phase runs until the next one starts
+static std::vector<std::pair<std::string, double>> StartupTimes;
+static std::chrono::steady_clock::time_point       StartupMark;
+
+static void EndStartupPhase()
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (!StartupTimes.empty())
+        StartupTimes.back().second = std::chrono::duration<double, std::milli>(now - StartupMark).count();
+    StartupMark = now;
+}
+
+/****
+ * StartupPhase:  Tells the loader which startup phase is running and
+ *  starts timing it.
+ ****/
+static int StartupPhase(const char* message)
+{
+    FnTrace("StartupPhase()");
+    EndStartupPhase();
+    StartupTimes.emplace_back(message, 0.0);
+    return ReportLoader(message);
+}
+
+/****
+ * LogStartupTimes:  Ends the last startup phase and logs how long each
+ *  one took.
+ ****/
+static void LogStartupTimes()
+{
+    FnTrace("LogStartupTimes()");
+    EndStartupPhase();
+    double total = 0.0;
+    for (const auto &[name, ms] : StartupTimes)
+        total += ms;
+    vt::Logger::info("Startup took {:.1f} ms", total);
+    for (const auto &[name, ms] : StartupTimes)
+        vt::Logger::info("  {:<36} {:9.1f} ms", name, ms);
+    StartupTimes.clear();
+}
+
 void Terminate(int my_signal)
 {
     FnTrace("Terminate()");
@@ -1116,7 +1213,7 @@ int StartSystem(int my_use_net)
     ReportLoader(str.data());
 
     // Load Phrase Translation
-    ReportLoader("Loading Locale Settings");
+    StartupPhase("Loading Locale Settings");
     sys->FullPath(MASTER_LOCALE, str.data());
     MasterLocale = std::make_unique<Locale>();
     if (MasterLocale->Load(str.data()))
@@ -1127,7 +1224,7 @@ int StartSystem(int my_use_net)
     }
 
     // Load Settings
-    ReportLoader("Loading General Settings");
+    StartupPhase("Loading General Settings");
     Settings *settings = &sys->settings;
     sys->FullPath(MASTER_SETTINGS, str.data());
     bool settings_just_created = false;
@@ -1250,7 +1347,7 @@ int StartSystem(int my_use_net)
     KillTask("vt_print");
 
     // Load System Data
-    ReportLoader("Loading Application Data");
+    StartupPhase("Loading Application Data");
     LoadSystemData();
 
 
@@ -1301,7 +1398,7 @@ int StartSystem(int my_use_net)
     std::array<genericChar, 256> msg{}; //char string used for file load messages
 
     // Load Archive & Create System Object
-    ReportLoader("Scanning Archives");
+    StartupPhase("Scanning Archives");
     sys->FullPath(ARCHIVE_DATA_DIR, str.data());
     sys->FullPath(MASTER_DISCOUNT_SAVE, altmedia.data());
     if (sys->ScanArchives(str.data(), altmedia.data()))
@@ -1310,7 +1407,7 @@ int StartSystem(int my_use_net)
     // Load Employees
     vt_safe_string::safe_format(msg.data(), msg.size(), "Attempting to load file %s...", MASTER_USER_DB);
     ReportError(msg.data()); //stamp file attempt in log
-    ReportLoader("Loading Employees");
+    StartupPhase("Loading Employees");
     sys->FullPath(MASTER_USER_DB, str.data());
     if (sys->user_db.Load(str.data()))
     {
@@ -1349,7 +1446,7 @@ int StartSystem(int my_use_net)
     // Load Menu
     vt_safe_string::safe_format(msg.data(), msg.size(), "Attempting to load file %s...", MASTER_MENU_DB);
     ReportError(msg.data()); //stamp file attempt in log
-    ReportLoader("Loading Menu");
+    StartupPhase("Loading Menu");
     sys->FullPath(MASTER_MENU_DB, str.data());
     if (!fs::exists(str.data()))
     {
@@ -1368,7 +1465,7 @@ int StartSystem(int my_use_net)
     // Load Exceptions
     vt_safe_string::safe_format(msg.data(), msg.size(), "Attempting to load file %s...", MASTER_EXCEPTION);
     ReportError(msg.data()); //stamp file attempt in log
-    ReportLoader("Loading Exception Records");
+    StartupPhase("Loading Exception Records");
     sys->FullPath(MASTER_EXCEPTION, str.data());
     if (sys->exception_db.Load(str.data()))
     {
@@ -1382,7 +1479,7 @@ int StartSystem(int my_use_net)
     // Load Inventory
     vt_safe_string::safe_format(msg.data(), msg.size(), "Attempting to load file %s...", MASTER_INVENTORY);
     ReportError(msg.data()); //stamp file attempt in log
-    ReportLoader("Loading Inventory");
+    StartupPhase("Loading Inventory");
     sys->FullPath(MASTER_INVENTORY, str.data());
     if (sys->inventory.Load(str.data()))
     {
@@ -1398,22 +1495,22 @@ int StartSystem(int my_use_net)
 
     // Load Customers
     sys->FullPath(CUSTOMER_DATA_DIR, str.data());
-    ReportLoader("Loading Customers");
+    StartupPhase("Loading Customers");
     sys->customer_db.Load(str.data());
 
     // Load Checks & Drawers
     sys->FullPath(CURRENT_DATA_DIR, str.data());
-    ReportLoader("Loading Current Checks & Drawers");
+    StartupPhase("Loading Current Checks & Drawers");
     sys->LoadCurrentData(str.data());
 
     // Load Accounts
     sys->FullPath(ACCOUNTS_DATA_DIR, str.data());
-    ReportLoader("Loading Accounts");
+    StartupPhase("Loading Accounts");
     sys->account_db.Load(str.data());
 
     // Load Expenses
     sys->FullPath(EXPENSE_DATA_DIR, str.data());
-    ReportLoader("Loading Expenses");
+    StartupPhase("Loading Expenses");
     sys->expense_db.Load(str.data());
     sys->expense_db.AddDrawerPayments(sys->DrawerList());
 
@@ -1422,7 +1519,7 @@ int StartSystem(int my_use_net)
     sys->cdustrings.Load(str.data());
 
     // Load Credit Card Exceptions, Refunds, and Voids
-    ReportLoader("Loading Credit Card Information");
+    StartupPhase("Loading Credit Card Information");
     sys->cc_exception_db->Load(MASTER_CC_EXCEPT);
     sys->cc_refund_db->Load(MASTER_CC_REFUND);
     sys->cc_void_db->Load(MASTER_CC_VOID);
@@ -1469,7 +1566,7 @@ int StartSystem(int my_use_net)
     }
 
     // Add local terminal
-    ReportLoader("Opening Local Terminal");
+    StartupPhase("Opening Local Terminal");
     int term_count_before = settings->TermCount();
     TermInfo *ti = settings->FindServer(displaystr.data());
     if (ti == nullptr)
@@ -1524,7 +1621,9 @@ int StartSystem(int my_use_net)
     }
 
     // Cleanup/Init & start
+    StartupPhase("Starting Current Day");
     sys->InitCurrentDay();
+    LogStartupTimes();
 
     // Start update system timer
     UpdateID = XtAppAddTimeOut(App, UPDATE_TIME,
@@ -1542,7 +1641,11 @@ int StartSystem(int my_use_net)
         RunUserCommand();
 
     if (my_use_net)
-        OpenTermSocket = Listen(OpenTermPort);
+    {
+        OpenTermSocket = Listen(OpenTermPort, 1);
+        if (OpenTermSocket > -1)
+            StartRemoteOrders(OpenTermSocket);
+    }
 
     // Event Loop
     XEvent event;
@@ -1680,6 +1783,10 @@ int EndSystem()
             MasterSystem->cc_init_results->Save();
         if (MasterSystem->cc_saf_details_results)
             MasterSystem->cc_saf_details_results->Save();
+        MasterSystem->CheckpointJournal(1);
+        MasterSystem->check_journal.Close();
+        DataFileStopWriter();  // finish queued saves before the last sync
+        DataFileGroupCommit();
         ReportError("EndSystem: Database saves completed, continuing with shutdown...");
     }
 
@@ -2922,7 +3029,6 @@ int CompleteRemoteOrder(Check *check)
         check->date.Set();
         check->FinalizeOrders(term);
         check->Save();
-        MasterControl->UpdateAll(UPDATE_CHECKS, nullptr);
         check->current_sub = check->FirstOpenSubCheck();
 
         // need to print the check
@@ -2944,10 +3050,9 @@ int CompleteRemoteOrder(Check *check)
     return status;
 }
 
-int SendRemoteOrderResult(int socket, Check *check, int result_code, int status)
+std::string RemoteOrderResult(Check *check, int result_code, int status)
 {
-    FnTrace("SendRemoteOrderResult()");
-    int retval = 0;
+    FnTrace("RemoteOrderResult()");
     std::array<char, STRLONG> result_str{};
 
     result_str[0] = '\0';
@@ -2980,9 +3085,7 @@ int SendRemoteOrderResult(int socket, Check *check, int result_code, int status)
     else
         vt_safe_string::safe_concat(result_str.data(), STRLONG, "NOTPRINTED");
 
-    write(socket, result_str.data(), strlen(result_str.data()));
-
-    return retval;
+    return std::string(result_str.data());
 }
 
 int DeliveryToInt(const char* cost)
@@ -2996,102 +3099,91 @@ int DeliveryToInt(const char* cost)
     return retval;
 }
 
-int ProcessRemoteOrder(int sock_fd)
+/****
+ * ApplyRemoteOrder:  makes a check of a remote order and returns the
+ *  answer for the client; status is set as CompleteRemoteOrder() sets it.
+ *  Terminals aren't updated here; the caller does that once per batch.
+ ****/
+std::string ApplyRemoteOrder(const RemoteOrder &remote, int &status)
 {
-    FnTrace("ProcessRemoteOrder()");
-    int        retval = 0;
-    KeyValueInputFile kvif;
-    std::array<char, STRLONG> key{};
-    std::array<char, STRLONG> value{};
+    FnTrace("ApplyRemoteOrder()");
+    int        retval = CALLCTR_ERROR_NONE;
     Settings  *settings = &MasterSystem->settings;
-    Check     *check = nullptr;
-    SubCheck  *subcheck = nullptr;
     Order     *order = nullptr;
     std::array<char, STRSHORT> StoreNum{};
-    int        status = CALLCTR_STATUS_INCOMPLETE;
 
-    kvif.Set(sock_fd);
-
-    write(sock_fd, "SENDORDER\n", 10);
-
-    check = new Check(settings, CHECK_DELIVERY);
-    if (check == nullptr)
-        return retval;
-    subcheck = check->NewSubCheck();
+    status = CALLCTR_STATUS_INCOMPLETE;
+    auto check = std::make_unique<Check>(settings, CHECK_DELIVERY);
+    SubCheck *subcheck = check->NewSubCheck();
     if (subcheck == nullptr)
-        return retval;
+        return RemoteOrderResult(check.get(), retval, CALLCTR_STATUS_FAILED);
 
-    while ((status == CALLCTR_STATUS_INCOMPLETE) &&
-           (retval == CALLCTR_ERROR_NONE) &&
-           (kvif.Read(key.data(), value.data(), STRLONG - 2) > 0))
+    for (const RemoteOrderField &field : remote.fields)
     {
+        if (retval != CALLCTR_ERROR_NONE)
+            break;
+        const char* key = field.key.c_str();
+        const char* value = field.value.c_str();
         if (debug_mode)
-            printf("Key:  %s, Value:  %s\n", key.data(), value.data());
-        if (strncmp(key.data(), "OrderID", 7) == 0)
-            check->CallCenterID(atoi(value.data()));
-        else if (strncmp(key.data(), "OrderType", 9) == 0)
+            printf("Key:  %s, Value:  %s\n", key, value);
+        if (strncmp(key, "OrderID", 7) == 0)
+            check->CallCenterID(atoi(value));
+        else if (strncmp(key, "OrderType", 9) == 0)
             check->CustomerType((value[0] == 'D') ? CHECK_DELIVERY : CHECK_TAKEOUT);
-        else if ( strncmp(key.data(), "OrderStatus", 11) == 0)
+        else if ( strncmp(key, "OrderStatus", 11) == 0)
             ; // ignore this
-        else if (strncmp(key.data(), "FirstName", 9) == 0)
-            check->FirstName(value.data());
-        else if (strncmp(key.data(), "LastName", 8) == 0)
-            check->LastName(value.data());
-        else if (strncmp(key.data(), "CustomerName", 12) == 0)
-            check->FirstName(value.data());
-        else if (strncmp(key.data(), "PhoneNo", 7) == 0)
-            check->PhoneNumber(value.data());
-        else if (strncmp(key.data(), "PhoneExt", 8) == 0)
-            check->Extension(value.data());
-        else if (strncmp(key.data(), "Street", 6) == 0)
-            check->Address(value.data());
-        else if (strncmp(key.data(), "Address", 7) == 0)
-            check->Address(value.data());
-        else if (strncmp(key.data(), "Suite", 5) == 0)
-            check->Address2(value.data());
-        else if (strncmp(key.data(), "CrossStreet", 11) == 0)
-            check->CrossStreet(value.data());
-        else if (strncmp(key.data(), "City", 4) == 0)
-            check->City(value.data());
-        else if (strncmp(key.data(), "State", 5) == 0)
-            check->State(value.data());
-        else if (strncmp(key.data(), "Zip", 3) == 0)
-            check->Postal(value.data());
-        else if (strncmp(key.data(), "DeliveryCharge", 14) == 0)
-            subcheck->delivery_charge = DeliveryToInt(value.data());
-        else if (strncmp(key.data(), "RestaurantID", 12) == 0)
-            vt_safe_string::safe_copy(StoreNum.data(), StoreNum.size(), value.data());
+        else if (strncmp(key, "FirstName", 9) == 0)
+            check->FirstName(value);
+        else if (strncmp(key, "LastName", 8) == 0)
+            check->LastName(value);
+        else if (strncmp(key, "CustomerName", 12) == 0)
+            check->FirstName(value);
+        else if (strncmp(key, "PhoneNo", 7) == 0)
+            check->PhoneNumber(value);
+        else if (strncmp(key, "PhoneExt", 8) == 0)
+            check->Extension(value);
+        else if (strncmp(key, "Street", 6) == 0)
+            check->Address(value);
+        else if (strncmp(key, "Address", 7) == 0)
+            check->Address(value);
+        else if (strncmp(key, "Suite", 5) == 0)
+            check->Address2(value);
+        else if (strncmp(key, "CrossStreet", 11) == 0)
+            check->CrossStreet(value);
+        else if (strncmp(key, "City", 4) == 0)
+            check->City(value);
+        else if (strncmp(key, "State", 5) == 0)
+            check->State(value);
+        else if (strncmp(key, "Zip", 3) == 0)
+            check->Postal(value);
+        else if (strncmp(key, "DeliveryCharge", 14) == 0)
+            subcheck->delivery_charge = DeliveryToInt(value);
+        else if (strncmp(key, "RestaurantID", 12) == 0)
+            vt_safe_string::safe_copy(StoreNum.data(), StoreNum.size(), value);
         else if (
-            (strncmp(key.data(), "Item", 4) == 0) ||
-            (strncmp(key.data(), "Detail", 6) == 0) ||
-            (strncmp(key.data(), "Product", 7) == 0) ||
-            (strncmp(key.data(), "Addon", 5) == 0) ||
-            (strncmp(key.data(), "SideNumber", 10) == 0) ||
-            (strncmp(key.data(), "EndItem", 7) == 0) ||
-            (strncmp(key.data(), "EndDetail", 9) == 0) ||
-            (strncmp(key.data(), "EndProduct", 10) == 0) ||
-            (strncmp(key.data(), "EndAddon", 8) == 0))
+            (strncmp(key, "Item", 4) == 0) ||
+            (strncmp(key, "Detail", 6) == 0) ||
+            (strncmp(key, "Product", 7) == 0) ||
+            (strncmp(key, "Addon", 5) == 0) ||
+            (strncmp(key, "SideNumber", 10) == 0) ||
+            (strncmp(key, "EndItem", 7) == 0) ||
+            (strncmp(key, "EndDetail", 9) == 0) ||
+            (strncmp(key, "EndProduct", 10) == 0) ||
+            (strncmp(key, "EndAddon", 8) == 0))
         {
-            retval = ProcessRemoteOrderEntry(subcheck, &order, key.data(), value.data());
+            retval = ProcessRemoteOrderEntry(subcheck, &order, key, value);
         }
-        else if (strncmp(key.data(), "EndOrder", 8) == 0)
-            status = CompleteRemoteOrder(check);
         else if (debug_mode)
-            printf("Unknown Key:  %s, Value:  %s\n", key.data(), value.data());
+            printf("Unknown Key:  %s, Value:  %s\n", key, value);
     }
-    if (strncmp(key.data(), "EndOrder", 8) != 0)
-    {
-        // There are still key/value pairs waiting, so we need to read them
-        // all to clear out the queue.
-        while (kvif.Read(key.data(), value.data(), STRLONG - 2) > 0)
-        {
-            if (strncmp(key.data(), "EndOrder", 8) == 0)
-                break;
-        }
-    }
-    SendRemoteOrderResult(sock_fd, check, retval, status);
+    if (retval == CALLCTR_ERROR_NONE)
+        status = CompleteRemoteOrder(check.get());
+    delete order;  // an item that was never ended
 
-    return retval;
+    std::string answer = RemoteOrderResult(check.get(), retval, status);
+    if (status == CALLCTR_STATUS_COMPLETE)
+        check.release();  // MasterSystem has it now
+    return answer;
 }
 
 int CompareCardNumbers(const char* card1, const char* card2)
@@ -3163,7 +3255,9 @@ Check* FindCCData(const char* cardnum, int value)
                 archive = MasterSystem->ArchiveListEnd();
             else
                 archive = archive->fore;
-            if (archive->loaded == 0)
+            // an archive whose index shows no card payments stays unloaded
+            const ArchiveSummary *sum = archive->Summary(&MasterSystem->settings);
+            if (archive->loaded == 0 && (sum == nullptr || sum->card_payments > 0))
                 archive->LoadPacked(&MasterSystem->settings);
             curr_check = archive->CheckList();
         }
@@ -3265,63 +3359,243 @@ int ProcessSocketRequest(char* request)
     return retval;
 }
 
-int ReadSocketRequest(int listen_sock)
+/*************************************************************
+ * Remote order/request port
+ *
+ * Every connection is watched on its own and read as its bytes come
+ * in.  Whole orders are queued and applied together REMOTE_ORDER_BATCH_MS
+ * after the first of them arrives, with one terminal update for the lot.
+ * Answers a connection can't take yet wait in its LinkOutput, and a
+ * pipelining connection that has too many unanswered isn't read until
+ * they go out.
+ *************************************************************/
+struct RemoteLinkInfo
 {
-    FnTrace("ReadSocketRequest()");
-    int  retval = 1;
-    static int open_sock = -1;
-    static int count = 0;
-    std::array<char, STRLONG> request{};
-    int  bytes_read = 0;
-    int  sel_result;
+    std::shared_ptr<RemoteOrderLink> link;
+    unsigned long input_id{0};    // 0 once nothing more is read, or while Full()
+    bool output_watched{false};   // in RemoteOutputPoll
+};
+
+struct RemoteOrderEntry
+{
+    std::shared_ptr<RemoteOrderLink> link;  // kept open for the answer
+    RemoteOrder order;
+};
+
+static std::unordered_map<int, RemoteLinkInfo> RemoteLinks;  // by socket
+static std::vector<RemoteOrderEntry> RemoteOrderQueue;
+static RemoteOrderLedger RemoteOrderAnswers;
+static LinkOutputPoll RemoteOutputPoll;  // links with answers waiting for room
+static unsigned long RemoteAcceptId = 0;
+static unsigned long RemoteBatchId = 0;
+static unsigned long RemoteOutputId = 0;
 
-    if (open_sock < 0)
+static void RemoteLinkCB(XtPointer client_data, int *fid, XtInputId *id);
+
+static RemoteLinkInfo *FindRemoteLink(const RemoteOrderLink *link)
+{
+    auto found = RemoteLinks.find(link->Fd());
+    if (found == RemoteLinks.end() || found->second.link.get() != link)
+        return nullptr;  // closed already
+    return &found->second;
+}
+
+static void CloseRemoteLink(int fd)
+{
+    FnTrace("CloseRemoteLink()");
+    auto found = RemoteLinks.find(fd);
+    if (found == RemoteLinks.end())
+        return;
+    if (found->second.input_id)
+        RemoveInputFn(found->second.input_id);
+    if (found->second.output_watched)
+        RemoteOutputPoll.Unwatch(fd);
+    found->second.link->Finish(1000);
+    RemoteLinks.erase(found);  // the socket closes with the last reference
+}
+
+static void RemoteOutputCB(XtPointer /*client_data*/, int * /*fid*/, XtInputId * /*id*/)
+{
+    FnTrace("RemoteOutputCB()");
+    std::vector<void *> ready;
+    RemoteOutputPoll.Ready(ready);
+    for (void *owner : ready)
+    {
+        RemoteLinkInfo *info = FindRemoteLink(static_cast<RemoteOrderLink *>(owner));
+        if (info == nullptr)
+            continue;
+        const int result = info->link->Flush();
+        if (result == 1)
+            continue;
+        RemoteOutputPoll.Unwatch(info->link->Fd());
+        info->output_watched = false;
+        if (result < 0 || (info->link->Ended() && info->link->Awaiting() == 0))
+            CloseRemoteLink(info->link->Fd());
+    }
+}
+
+/****
+ * WatchRemoteOutput:  puts link's socket in the output poll while it
+ *  has answers pending.  Returns 1 if the link failed and was closed.
+ ****/
+static int WatchRemoteOutput(RemoteLinkInfo &info, int result)
+{
+    FnTrace("WatchRemoteOutput()");
+    const int fd = info.link->Fd();
+    if (result < 0)
     {
-        if (SelectIn(listen_sock, select_timeout) > 0)
-            open_sock = Accept(listen_sock);
+        CloseRemoteLink(fd);
+        return 1;
     }
-    else if (open_sock >= 0)
+    if (result == 1 && !info.output_watched)
     {
-        sel_result = SelectIn(open_sock, select_timeout);
-        if (sel_result > 0)
+        if (RemoteOutputId == 0 && RemoteOutputPoll.Fd() >= 0)
+            RemoteOutputId = AddInputFn((InputFn) RemoteOutputCB, RemoteOutputPoll.Fd(), nullptr);
+        if (RemoteOutputId != 0 && RemoteOutputPoll.Watch(fd, info.link.get()) == 0)
+            info.output_watched = true;
+        else
+            info.link->Finish(1000);  // no poll; wait as before
+    }
+    return 0;
+}
+
+static void RemoteOrderBatchCB(XtPointer /*client_data*/, XtIntervalId * /*time_id*/)
+{
+    FnTrace("RemoteOrderBatchCB()");
+    RemoteBatchId = 0;
+    std::vector<RemoteOrderEntry> batch;
+    batch.swap(RemoteOrderQueue);
+
+    int added = 0;
+    std::vector<int> resume;  // links Full() before this batch
+    for (RemoteOrderEntry &entry : batch)
+    {
+        std::string answer;
+        if (const std::string *given = RemoteOrderAnswers.Find(entry.order.id))
         {
-            ssize_t read_result = read(open_sock, request.data(), request.size() - 1);
-            bytes_read = static_cast<int>(std::min(read_result, static_cast<ssize_t>(INT_MAX)));
-            if (bytes_read > 0)
+            // sent again, likely for want of the answer; it stands
+            answer = *given;
+        }
+        else
+        {
+            int status = CALLCTR_STATUS_INCOMPLETE;
+            answer = ApplyRemoteOrder(entry.order, status);
+            if (status == CALLCTR_STATUS_COMPLETE)
             {
-                // In most cases we're only going to read once and then close the socket.
-                // This really isn't intended to be a conversation at this point.
-                if (strncmp(request.data(), "remoteorder", 11) == 0)
-                    retval = ProcessRemoteOrder(open_sock);
-                else
-                {
-                    request[bytes_read] = '\0';
-                    write(open_sock, "ACK", 3);
-                    retval = ProcessSocketRequest(request.data());
-                }
-                close(open_sock);
-                open_sock = -1;
+                RemoteOrderAnswers.Record(entry.order.id, answer);
+                ++added;
             }
         }
-        else if (sel_result < 0)
+
+        const bool was_full = entry.link->Full();
+        const int result = entry.link->Answer(entry.order, answer);
+        RemoteLinkInfo *info = FindRemoteLink(entry.link.get());
+        if (info == nullptr || WatchRemoteOutput(*info, result))
+            continue;
+        if (entry.link->Ended() && entry.link->Awaiting() == 0)
         {
-            perror("ReadSocketRequest select");
-            close(open_sock);
-            open_sock = -1;
+            if (!info->output_watched)
+                CloseRemoteLink(entry.link->Fd());
         }
-        else
+        else if (was_full && !entry.link->Ended())
+            resume.push_back(entry.link->Fd());
+    }
+    if (added > 0)
+        MasterControl->UpdateAll(UPDATE_CHECKS, nullptr);
+
+    for (int fd : resume)
+    {
+        auto found = RemoteLinks.find(fd);
+        if (found == RemoteLinks.end() || found->second.input_id != 0)
+            continue;
+        found->second.input_id = AddInputFn((InputFn) RemoteLinkCB, fd, nullptr);
+        RemoteLinkCB(nullptr, &fd, nullptr);  // lines already read in
+    }
+}
+
+static void RemoteLinkCB(XtPointer /*client_data*/, int *fid, XtInputId * /*id*/)
+{
+    FnTrace("RemoteLinkCB()");
+    auto found = RemoteLinks.find(*fid);
+    if (found == RemoteLinks.end())
+        return;
+    std::shared_ptr<RemoteOrderLink> link = found->second.link;
+
+    std::vector<RemoteOrder> orders;
+    const int result = link->Read(orders);
+    for (RemoteOrder &order : orders)
+        RemoteOrderQueue.push_back(RemoteOrderEntry{link, std::move(order)});
+    if (!RemoteOrderQueue.empty() && RemoteBatchId == 0)
+    {
+        RemoteBatchId = AddTimeOutFn((TimeOutFn) RemoteOrderBatchCB, REMOTE_ORDER_BATCH_MS, nullptr);
+    }
+
+    if (link->Kind() == REMOTE_LINK_REQUEST)
+    {
+        std::string request = link->Request();
+        link->Reply("ACK");
+        CloseRemoteLink(*fid);
+        ProcessSocketRequest(request.data());
+    }
+    else if (result < 0 || link->Full())
+    {
+        // nothing more to read, or not until answers catch up
+        if (found->second.input_id)
+            RemoveInputFn(found->second.input_id);
+        found->second.input_id = 0;
+        if (result < 0 && link->Awaiting() == 0 && !found->second.output_watched)
+            CloseRemoteLink(*fid);
+    }
+}
+
+static void RemoteAcceptCB(XtPointer /*client_data*/, int *fid, XtInputId * /*id*/)
+{
+    FnTrace("RemoteAcceptCB()");
+    int fd;
+    while ((fd = Accept(*fid)) >= 0)
+    {
+        RemoteLinkInfo &info = RemoteLinks[fd];
+        info.link = std::make_shared<RemoteOrderLink>(fd);
+        info.input_id = AddInputFn((InputFn) RemoteLinkCB, fd, nullptr);
+    }
+}
+
+/****
+ * StartRemoteOrders:  watches listen_sock (non-blocking) for
+ *  connections.  Orders already in today's checks are answered as
+ *  taken if they're sent again.
+ ****/
+int StartRemoteOrders(int listen_sock)
+{
+    FnTrace("StartRemoteOrders()");
+    for (Check *check = MasterSystem->CheckList(); check != nullptr; check = check->next)
+    {
+        if (check->CallCenterID() > 0)
         {
-            count += 1;
-            if (count > MAX_CONN_TRIES)
-            {
-                close(open_sock);
-                open_sock = -1;
-                count = 0;
-            }
+            RemoteOrderAnswers.Record(check->CallCenterID(),
+                RemoteOrderResult(check, CALLCTR_ERROR_NONE, CALLCTR_STATUS_COMPLETE));
         }
     }
+    RemoteAcceptId = AddInputFn((InputFn) RemoteAcceptCB, listen_sock, nullptr);
+    return (RemoteAcceptId == 0) ? 1 : 0;
+}
 
-    return retval;
+/****
+ * ExpireRemoteLinks:  closes connections that have gone quiet for
+ *  REMOTE_ORDER_IDLE seconds with nothing owed to them
+ ****/
+static void ExpireRemoteLinks()
+{
+    FnTrace("ExpireRemoteLinks()");
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<int> idle;
+    for (const auto &[fd, info] : RemoteLinks)
+    {
+        if (info.link->Idle(now))
+            idle.push_back(fd);
+    }
+    for (int fd : idle)
+        CloseRemoteLink(fd);
 }
 
 void UpdateSystemCB(XtPointer client_data, XtIntervalId *time_id)
@@ -3358,9 +3632,9 @@ void UpdateSystemCB(XtPointer client_data, XtIntervalId *time_id)
         }
     }
 
-    // Respond to remote OpenTerm requests
-    if (OpenTermSocket > -1)
-        ReadSocketRequest(OpenTermSocket);
+    // Drop remote order/request connections that went quiet
+    if (!RemoteLinks.empty())
+        ExpireRemoteLinks();
 
     // Get current time & other info
     SystemTime.Set();
@@ -3456,6 +3730,14 @@ void UpdateSystemCB(XtPointer client_data, XtIntervalId *time_id)
         
         // Check for scheduled restart every minute
         CheckScheduledRestart();
+
+        // archives on screen count as in use
+        for (Terminal *t = MasterControl->TermList(); t != nullptr; t = t->next)
+        {
+            if (t->archive)
+                t->archive->Touch();
+        }
+        MasterSystem->TrimArchives();
     }
 
     // Update Terminals
@@ -3539,6 +3821,15 @@ void UpdateSystemCB(XtPointer client_data, XtIntervalId *time_id)
     // Update data persistence manager
     GetDataPersistenceManager().Update();
 
+    // one sync for every data file saved since the last tick
+    DataFileGroupCommit();
+    if (MasterSystem != nullptr)
+    {
+        MasterSystem->check_journal.Sync();
+        if (MasterSystem->check_journal.CheckpointDue())
+            MasterSystem->CheckpointJournal();
+    }
+
     // restart system timer
     UpdateID = XtAppAddTimeOut(App, UPDATE_TIME,
                                (XtTimerCallbackProc) UpdateSystemCB, client_data);
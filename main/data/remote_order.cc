@@ -0,0 +1,215 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * remote_order.cc
+ * Connections on the remote order/request port
+ */
+
+#include "remote_order.hh"
+#include "fntrace.hh"
+
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+static constexpr std::string_view OrderRequest = "remoteorder";
+static constexpr std::string_view BatchRequest = "remotebatch";
+
+/***********************************************************************
+ * RemoteOrderLink Class
+ ***********************************************************************/
+RemoteOrderLink::RemoteOrderLink(int fd)
+    : socket_no(fd)
+    , input(fd)
+    , last_heard(std::chrono::steady_clock::now())
+{
+    FnTrace("RemoteOrderLink::RemoteOrderLink()");
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    output.SetSocket(fd);
+}
+
+int RemoteOrderLink::Read(std::vector<RemoteOrder> &orders)
+{
+    FnTrace("RemoteOrderLink::Read()");
+    if (ended)
+        return -1;
+    if (kind == REMOTE_LINK_WAITING && ReadFirst() < 0)
+        ended = true;
+    if (!ended && (kind == REMOTE_LINK_ORDER || kind == REMOTE_LINK_PIPELINE) &&
+        ReadOrder(orders) < 0)
+    {
+        ended = true;
+    }
+    return ended ? -1 : 0;
+}
+
+/****
+ * ReadFirst:  looks at what has come without taking it, since an order
+ *  request's lines are left for KeyValueInputFile
+ ****/
+int RemoteOrderLink::ReadFirst()
+{
+    FnTrace("RemoteOrderLink::ReadFirst()");
+    std::array<char, STRLONG> buffer{};
+    ssize_t got = 0;
+    do
+    {
+        got = recv(socket_no, buffer.data(), buffer.size() - 1, MSG_PEEK);
+    }
+    while (got < 0 && errno == EINTR);
+    if (got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+        return -1;
+    if (got < 0)
+        return 0;
+    last_heard = std::chrono::steady_clock::now();
+
+    const std::string_view seen(buffer.data(), static_cast<size_t>(got));
+    for (std::string_view word : {OrderRequest, BatchRequest})
+    {
+        if (seen.size() < word.size() && word.starts_with(seen))
+            return 0;  // could still be an order request
+    }
+
+    for (std::string_view word : {OrderRequest, BatchRequest})
+    {
+        if (!seen.starts_with(word))
+            continue;
+        // take the request line, or just the word if its line isn't all here
+        const size_t end = seen.find('\n');
+        const size_t take = (end == std::string_view::npos) ? word.size() : end + 1;
+        if (read(socket_no, buffer.data(), take) != static_cast<ssize_t>(take))
+            return -1;
+        if (word == BatchRequest)
+        {
+            kind = REMOTE_LINK_PIPELINE;
+            Reply("SENDORDERS\n");
+        }
+        else
+        {
+            kind = REMOTE_LINK_ORDER;
+            Reply("SENDORDER\n");
+        }
+        return 0;
+    }
+
+    // a one-line request:  read once, as the port always has
+    got = read(socket_no, buffer.data(), buffer.size() - 1);
+    if (got <= 0)
+        return -1;
+    request.assign(buffer.data(), static_cast<size_t>(got));
+    kind = REMOTE_LINK_REQUEST;
+    return -1;
+}
+
+int RemoteOrderLink::ReadOrder(std::vector<RemoteOrder> &orders)
+{
+    FnTrace("RemoteOrderLink::ReadOrder()");
+    while (!Full() && input.Read(key.data(), value.data(), STRLONG - 2) > 0)
+    {
+        last_heard = std::chrono::steady_clock::now();
+        if (key[0] == '\0')
+            continue;
+        if (strncmp(key.data(), "EndOrder", 8) == 0)
+        {
+            ++numbered;
+            if (order.correlation.empty())
+                order.correlation = std::to_string(numbered);
+            orders.push_back(std::move(order));
+            order = RemoteOrder{};
+            ++awaiting;
+            if (kind == REMOTE_LINK_ORDER)
+                return -1;  // one order per connection
+            continue;
+        }
+        if (order.fields.size() >= REMOTE_ORDER_FIELDS)
+            return -1;
+        if (strncmp(key.data(), "CorrelationID", 13) == 0)
+        {
+            // one word, since it starts the answer line
+            std::string_view word(value.data());
+            word = word.substr(0, word.find_first_of(" \t"));
+            order.correlation.assign(word.substr(0, STRSHORT));
+            continue;
+        }
+        if (strncmp(key.data(), "OrderID", 7) == 0)
+            order.id = atoi(value.data());
+        order.fields.push_back(RemoteOrderField{key.data(), value.data()});
+    }
+    return input.Closed() ? -1 : 0;
+}
+
+int RemoteOrderLink::Reply(std::string_view text)
+{
+    FnTrace("RemoteOrderLink::Reply()");
+    return output.Add(std::vector<Uchar>(text.begin(), text.end()));
+}
+
+int RemoteOrderLink::Answer(const RemoteOrder &answered, std::string_view answer)
+{
+    FnTrace("RemoteOrderLink::Answer()");
+    int result = 0;
+    if (kind == REMOTE_LINK_PIPELINE)
+    {
+        std::string line;
+        line.reserve(answered.correlation.size() + answer.size() + 9);
+        line.append("RESULT ").append(answered.correlation).append(" ").append(answer).append("\n");
+        result = Reply(line);
+    }
+    else
+        result = Reply(answer);
+    Answered();
+    return result;
+}
+
+bool RemoteOrderLink::Idle(std::chrono::steady_clock::time_point now) const noexcept
+{
+    return awaiting == 0 && now - last_heard > std::chrono::seconds(REMOTE_ORDER_IDLE);
+}
+
+/***********************************************************************
+ * RemoteOrderLedger Class
+ ***********************************************************************/
+const std::string *RemoteOrderLedger::Find(int id) const
+{
+    if (id == 0)
+        return nullptr;
+    auto found = answers.find(id);
+    return (found == answers.end()) ? nullptr : &found->second;
+}
+
+void RemoteOrderLedger::Record(int id, std::string answer)
+{
+    FnTrace("RemoteOrderLedger::Record()");
+    if (id == 0)
+        return;
+    const bool added = answers.insert_or_assign(id, std::move(answer)).second;
+    if (!added)
+        return;
+    ids.push_back(id);
+    if (ids.size() > REMOTE_ORDER_LEDGER)
+    {
+        answers.erase(ids.front());
+        ids.pop_front();
+    }
+}
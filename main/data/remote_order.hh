@@ -0,0 +1,161 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * remote_order.hh
+ * Connections on the remote order/request port
+ */
+
+#ifndef REMOTE_ORDER_HH
+#define REMOTE_ORDER_HH
+
+#include "basic.hh"
+#include "data_file.hh"
+#include "link_output.hh"
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#define REMOTE_ORDER_IDLE      30    // seconds a connection may sit silent
+#define REMOTE_ORDER_BATCH_MS  50    // orders gathered before they're applied
+#define REMOTE_ORDER_LEDGER    4096  // order ids remembered for resends
+#define REMOTE_ORDER_FIELDS    4096  // most lines one order may have
+#define REMOTE_ORDER_PIPELINE  256   // orders one link may have unanswered
+
+// What a connection turned out to be
+#define REMOTE_LINK_WAITING    0  // nothing whole yet
+#define REMOTE_LINK_REQUEST    1  // a one-line request (openterm, cloneterm, ...)
+#define REMOTE_LINK_ORDER      2  // a remote order
+#define REMOTE_LINK_PIPELINE   3  // remote orders one after another
+
+/**** Types ****/
+struct RemoteOrderField
+{
+    std::string key;
+    std::string value;
+};
+
+struct RemoteOrder
+{
+    int id{0};                             // OrderID, 0 if none was sent
+    std::string correlation;               // CorrelationID, or its number on the link
+    std::vector<RemoteOrderField> fields;  // as sent, up to EndOrder
+};
+
+/*********************************************************************
+ * RemoteOrderLink
+ *
+ * One connection to the remote order port, read without blocking as
+ * its bytes arrive.  The first line says what it is:  "remoteorder"
+ * is answered SENDORDER, after which the order comes as key:value
+ * lines ending with EndOrder; anything else is a one-line request read
+ * the way it always was, in a single read.
+ *
+ * The answer to an order, id:serial:status:printed, is its
+ * acknowledgement and only goes out once the check is saved.  A client
+ * that loses the connection before the answer sends the order again
+ * and gets the same answer back (see RemoteOrderLedger), without the
+ * order being added twice.
+ *
+ * "remotebatch" is answered SENDORDERS and the connection then stays
+ * open for any number of orders, each ending with EndOrder, sent
+ * without waiting for answers.  An order may carry a CorrelationID
+ * line (one word); otherwise it is known by its number on the
+ * connection, from 1.  Each answer comes back on a line of its own
+ * once the order is taken, as "RESULT correlation answer", in the order
+ * the orders are taken.  Past REMOTE_ORDER_PIPELINE unanswered orders
+ * the link stops reading until answers catch up.  The client closes
+ * its side when done and gets the rest of its answers before the
+ * connection closes.
+ ********************************************************************/
+class RemoteOrderLink
+{
+public:
+    // Takes over fd (closed with the link) and makes it non-blocking
+    explicit RemoteOrderLink(int fd);
+    RemoteOrderLink(const RemoteOrderLink&) = delete;
+    RemoteOrderLink& operator=(const RemoteOrderLink&) = delete;
+
+    // Takes in what has arrived, adding whole orders to orders; -1 once
+    // nothing more will be read (the client closed, the link failed or
+    // everything expected has come), else 0
+    int Read(std::vector<RemoteOrder> &orders);
+    // Queues text to go out as it is; returns as LinkOutput::Add()
+    int Reply(std::string_view text);
+    // An order read has had its answer queued
+    int Answered() noexcept { return (awaiting > 0) ? --awaiting : 0; }
+    // Queues the answer to an order read, the way this link is answered,
+    // and counts it Answered(); returns as Reply()
+    int Answer(const RemoteOrder &answered, std::string_view answer);
+    int Flush() { return output.Flush(); }
+    int Finish(int timeout_ms) { return output.Finish(timeout_ms); }
+
+    [[nodiscard]] int Fd() const noexcept { return socket_no; }
+    [[nodiscard]] int Kind() const noexcept { return kind; }
+    [[nodiscard]] const std::string &Request() const noexcept { return request; }
+    // Orders read whose answers haven't been queued yet
+    [[nodiscard]] int Awaiting() const noexcept { return awaiting; }
+    // Read() takes no more orders until some are answered; call it again
+    // after, as lines may be waiting that the socket won't signal
+    [[nodiscard]] bool Full() const noexcept { return awaiting >= REMOTE_ORDER_PIPELINE; }
+    // Read() has returned -1
+    [[nodiscard]] bool Ended() const noexcept { return ended; }
+    // Silent for REMOTE_ORDER_IDLE seconds with no answer owed
+    [[nodiscard]] bool Idle(std::chrono::steady_clock::time_point now) const noexcept;
+
+private:
+    int socket_no{-1};
+    int kind{REMOTE_LINK_WAITING};
+    int awaiting{0};
+    int numbered{0};    // orders read, for those without a CorrelationID
+    bool ended{false};  // nothing more to read
+    KeyValueInputFile input;
+    LinkOutput output;
+    std::string request;
+    std::array<char, STRLONG> key{};
+    std::array<char, STRLONG> value{};
+    RemoteOrder order;  // the one being read
+    std::chrono::steady_clock::time_point last_heard;
+
+    int ReadFirst();
+    int ReadOrder(std::vector<RemoteOrder> &orders);
+};
+
+/*********************************************************************
+ * RemoteOrderLedger
+ *
+ * The answers given to the last REMOTE_ORDER_LEDGER orders, by
+ * OrderID, so an order sent again gets the first answer instead of
+ * becoming a second check.
+ ********************************************************************/
+class RemoteOrderLedger
+{
+public:
+    // The answer given to order id, nullptr if none (or id is 0)
+    [[nodiscard]] const std::string *Find(int id) const;
+    void Record(int id, std::string answer);
+    [[nodiscard]] std::size_t Size() const noexcept { return answers.size(); }
+
+private:
+    std::unordered_map<int, std::string> answers;
+    std::deque<int> ids;  // oldest first
+};
+
+#endif
@@ -891,6 +891,7 @@ TermInfo::TermInfo()
     isserver      = 0;
     print_workorder = 1;
     workorder_heading = 0;
+    link_deflate  = 0;
 
     for (int & i : tax_inclusive)
     	i = -1;
@@ -942,6 +943,8 @@ int TermInfo::Read(InputDataFile &df, int version)
 	for (int & i : tax_inclusive)
     	error += df.Read(i);
     }
+    if (version >= 108)
+        error += df.Read(link_deflate);
 
     // dpulse is used when there are two drawers attached to one
     // printer, and two terminals printing to that printer.  AKA,
@@ -982,6 +985,7 @@ int TermInfo::Write(OutputDataFile &df, int version)
     error += df.Write(workorder_heading);
     for (int i : tax_inclusive)
     	error += df.Write(i);
+    error += df.Write(link_deflate);
 
     return error;
 }
@@ -1029,6 +1033,7 @@ int TermInfo::OpenTerm(Control *control_db, int update)
     term->workorder_heading = workorder_heading;
     for (int i=0; i<4; i++)
     	term->tax_inclusive[i] = tax_inclusive[i];
+    term->link_deflate = link_deflate;
 
     if (printer_model != MODEL_NONE)
     {
@@ -1550,7 +1555,8 @@ int Settings::Load(const char* file)
     // 95 (07/12/18) removed license_key
     // 99            added enable_f3_f4_recording
     // 102           added button text position and per-terminal image toggle (placeholder field retained)
-    // 103 (current) added global button image toggle
+    // 103           added global button image toggle
+    // 108 (current) added per-terminal link_deflate
 
     genericChar str[256];
     if (version < 25 || version > SETTINGS_VERSION)
@@ -2282,7 +2288,7 @@ int Settings::Save()
 
     // Write out SETTINGS_VERSION
     OutputDataFile df;
-    if (df.Open(filename.Value(), SETTINGS_VERSION))
+    if (df.Open(filename.Value(), SETTINGS_VERSION, 0, DataFileKind::Settings))
         return 1;
 
     df.Write(store_name);
@@ -2962,7 +2968,7 @@ int Settings::SaveMedia()
 
     // Write out SETTINGS_VERSION
     OutputDataFile df;
-    if (df.Open(discount_filename.Value(), SETTINGS_VERSION))
+    if (df.Open(discount_filename.Value(), SETTINGS_VERSION, 0, DataFileKind::Settings))
         return 1;
 
     // Write out Discounts
@@ -30,7 +30,7 @@
 // NOTE:  WHEN UPDATING SETTINGS DO NOT FORGET that you may also
 // need to update archive.hh and archive.cc for settings which
 // should be maintained historically.
-constexpr int SETTINGS_VERSION = 107;  // READ ABOVE
+constexpr int SETTINGS_VERSION = 108;  // READ ABOVE
 
 
 /**** Definitions & Data ****/
@@ -484,6 +484,7 @@ public:
     int isserver;
     int print_workorder;
     int workorder_heading;	// 0=standard, 1=simple
+    int link_deflate;		// large frames to the display may go deflated
     Str cc_credit_termid;
     Str cc_debit_termid;
 
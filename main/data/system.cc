@@ -35,12 +35,20 @@
 #include "utility.hh"
 #include "safe_string_utils.hh"
 #include "src/utils/cpp23_utils.hh"
+#include "src/utils/vt_logger.hh"
 
 #include <dirent.h>
 #include <sys/types.h>
 #include <sys/file.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
 
 #ifdef DMALLOC
 #include <dmalloc.h>
@@ -50,6 +58,278 @@
 /**** Globals ****/
 std::unique_ptr<System> MasterSystem = nullptr;
 
+namespace {
+
+using StartupClock = std::chrono::steady_clock;
+
+double MillisecondsSince(StartupClock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(StartupClock::now() - start).count();
+}
+
+// threads parsing data files at startup; 0 asks for one per core
+int StartupThreads(int requested)
+{
+    if (requested > 0)
+        return std::min(requested, 64);
+    return std::clamp(static_cast<int>(std::thread::hardware_concurrency()), 1, 8);
+}
+
+// Runs fn(0) .. fn(count - 1) on up to 'threads' threads, the caller's
+// included.  Items are handed out one at a time, so a few large files
+// don't leave the other threads idle.
+template <typename Fn>
+void ParallelFor(std::size_t count, int threads, Fn fn)
+{
+    std::atomic<std::size_t> next{0};
+    const auto work = [&next, count, &fn]() {
+        for (std::size_t idx = next++; idx < count; idx = next++)
+            fn(idx);
+    };
+
+    std::vector<std::thread> pool;
+    const std::size_t helpers = std::min(count, static_cast<std::size_t>(threads)) - (count > 0);
+    for (std::size_t i = 0; i < helpers; ++i)
+        pool.emplace_back(work);
+    work();
+    for (std::thread &thread : pool)
+        thread.join();
+}
+
+// Parses a check file without touching System.  Checks older than
+// version 13 keep their customer inside the check and build it through
+// the customer database, which only the main thread may change, so
+// those are left for the caller.  The batches of unsettled credits are
+// collected in 'batches' for the caller to add.
+enum class ParseResult { Parsed, Failed, MainThread };
+
+ParseResult ParseCheck(Settings *settings, const std::string &file, std::unique_ptr<Check> &check,
+                       std::vector<long long> &batches)
+{
+    int version = 0;
+    InputDataFile df;
+    if (df.Open(file, version))
+        return ParseResult::Failed;
+    if (version <= 12)
+        return ParseResult::MainThread;
+
+    check = std::make_unique<Check>();
+    check->filename.Set(file);
+    Credit::batch_sink = &batches;
+    const int error = check->Read(settings, df, version);
+    Credit::batch_sink = nullptr;
+    if (error)
+    {
+        check.reset();
+        return ParseResult::Failed;
+    }
+    return ParseResult::Parsed;
+}
+
+// A current check's share of System::live_totals:  its drawer tallies
+// as Drawer::Total() figures them, its server report counts, the sales
+// the balance report takes from it and the orders the sales mix counts.
+LiveTotals::Totals LiveShare(Settings *settings, Check *check)
+{
+    LiveTotals::Totals share;
+    const bool training = check->IsTraining() != 0;
+    const bool takeout  = check->IsTakeOut() != 0;
+    const bool fastfood = check->IsFastFood() != 0;
+
+    LiveTotals::ServerTally opener;
+    LiveTotals::ServerTally seller;
+    if (check->time_open.IsSet())
+    {
+        share.first_open = share.last_open = SalesFactTime(check->time_open);
+        if (!takeout)
+            opener.opened = 1;
+    }
+
+    TimeInfo *closed = check->TimeClosed();
+    if (closed)
+    {
+        share.last_close = SalesFactTime(*closed);
+        if (takeout)
+            seller.takeouts = 1;
+        else if (fastfood)
+            seller.fastfood = 1;
+        else
+        {
+            seller.guests = check->Guests();
+            seller.closed = 1;
+        }
+    }
+
+    // the balance report takes closed checks and hotel checks
+    const bool hotel = check->CustomerType() == CHECK_HOTEL;
+    const bool balanced = (closed && closed->IsSet()) || (hotel && check->time_open.IsSet());
+    LiveTotals::SalesTally &sales = share.sales;
+    if (balanced && !training)
+    {
+        if (takeout)
+            ++sales.takeouts;
+        else if (fastfood)
+            ++sales.fastfood;
+        else
+            sales.guests += check->Guests();
+    }
+    LiveTotals::ItemTallies &items = share.items[check->WhoGetsSale(settings)];
+
+    for (SubCheck *sc = check->SubList(); sc != nullptr; sc = sc->next)
+    {
+        if (sc->settle_time.IsSet())
+            share.last_settle = std::max(share.last_settle, SalesFactTime(sc->settle_time));
+        if (closed)
+        {
+            if (takeout)
+                seller.takeout_sales += sc->total_sales;
+            else if (fastfood)
+                seller.fastfood_sales += sc->total_sales;
+            else
+                seller.sitdown_sales += sc->total_sales;
+            seller.captured_tip += sc->TotalTip();
+        }
+        if (training)
+            continue;
+
+        if (balanced)
+        {
+            // SubCheck::GrossSales(), by family
+            int gross = 0;
+            if (sc->status == CHECK_CLOSED || hotel)
+            {
+                for (Order *order = sc->OrderList(); order != nullptr; order = order->next)
+                {
+                    order->FigureCost();
+                    LiveTotals::Tally &family = sales.families[order->item_family];
+                    family.amount += order->total_cost;
+                    ++family.count;
+                    gross += order->total_cost;
+                }
+            }
+            if (takeout)
+                sales.takeout_sales += gross;
+            if (fastfood)
+                sales.fastfood_sales += gross;
+            sales.item_comps += sc->item_comps;
+
+            for (Payment *payment = sc->PaymentList(); payment != nullptr; payment = payment->next)
+            {
+                LiveTotals::Tally &tender = sales.tenders[{payment->tender_type, payment->tender_id}];
+                tender.amount += payment->value;
+                ++tender.count;
+            }
+            if (sc->settle_time.IsSet())
+            {
+                LiveTotals::Tally &meal = sales.meals[settings->MealPeriod(sc->settle_time)];
+                meal.amount += sc->total_sales;
+                ++meal.count;
+            }
+            if (sc->IsTaxExempt() == 0)
+            {
+                sales.tax[LIVE_TAX_FOOD]        += sc->total_tax_food;
+                sales.tax[LIVE_TAX_ALCOHOL]     += sc->total_tax_alcohol;
+                sales.tax[LIVE_TAX_ROOM]        += sc->total_tax_room;
+                sales.tax[LIVE_TAX_MERCHANDISE] += sc->total_tax_merchandise;
+                sales.tax[LIVE_TAX_GST]         += sc->total_tax_GST;
+                sales.tax[LIVE_TAX_PST]         += sc->total_tax_PST;
+                sales.tax[LIVE_TAX_HST]         += sc->total_tax_HST;
+                sales.tax[LIVE_TAX_QST]         += sc->total_tax_QST;
+                sales.tax[LIVE_TAX_VAT]         += sc->total_tax_VAT;
+            }
+        }
+
+        // the sales mix counts the orders of settled subchecks, as
+        // ItemCountTree::CountOrder() does
+        if (sc->settle_time.IsSet())
+        {
+            for (Order *order = sc->OrderList(); order != nullptr; order = order->next)
+            {
+                if ((order->qualifier & QUALIFIER_NO) || order->count == 0)
+                    continue;
+                order->FigureCost();
+                LiveTotals::ItemTally &item = items[{order->item_name.str(), order->item_cost, order->item_family}];
+                item.counted.amount += order->count;
+                ++item.counted.count;
+                item.type = order->item_type;
+                for (Order *mod = order->modifier_list; mod != nullptr; mod = mod->next)
+                {
+                    const int units = (mod->item_cost > 0) ? mod->cost / mod->item_cost : mod->count;
+                    LiveTotals::ModifierTally &modifier = item.modifiers[{mod->item_name.str(), mod->item_cost}];
+                    if (mod->cost > 0)
+                    {
+                        modifier.priced.amount += units;
+                        ++modifier.priced.count;
+                    }
+                    if (mod->total_cost > 0)
+                    {
+                        modifier.figured.amount += units;
+                        ++modifier.figured.count;
+                    }
+                    if (modifier.priced.count == 0 && modifier.figured.count == 0)
+                        item.modifiers.erase({mod->item_name.str(), mod->item_cost});
+                }
+            }
+        }
+
+        LiveTotals::DrawerTally &drawer = share.drawers[sc->drawer_id];
+        ++drawer.checks;
+        if (sc->item_comps > 0)
+        {
+            LiveTotals::Tally &comps = drawer.tenders[{TENDER_ITEM_COMP, 0}];
+            comps.amount += sc->item_comps;
+            ++comps.count;
+        }
+        for (Payment *payment = sc->PaymentList(); payment != nullptr; payment = payment->next)
+        {
+            const int idx = payment->tender_type;
+            const int pid = (payment->tender_id > 0 || idx >= NUMBER_OF_TENDERS) ? payment->tender_id : 0;
+            LiveTotals::Tally &tender = drawer.tenders[{idx, pid}];
+            tender.amount += payment->value;
+            ++tender.count;
+            if (idx == TENDER_CHANGE || idx == TENDER_PAID_TIP)
+                drawer.tenders[{TENDER_CASH, 0}].amount -= payment->value;
+        }
+    }
+
+    // empty tallies would only clutter the maps
+    for (auto it = share.drawers.begin(); it != share.drawers.end(); ++it)
+    {
+        auto &tenders = it->second.tenders;
+        for (auto tender = tenders.begin(); tender != tenders.end();)
+        {
+            if (tender->second.amount == 0 && tender->second.count == 0)
+                tender = tenders.erase(tender);
+            else
+                ++tender;
+        }
+    }
+
+    if (items.empty())
+        share.items.clear();
+
+    const int sale_user = check->WhoGetsSale(settings);
+    LiveTotals::ServerTally &open_user = share.servers[check->user_open];
+    open_user.opened += opener.opened;
+    LiveTotals::ServerTally &sale_tally = share.servers[sale_user];
+    sale_tally.closed         += seller.closed;
+    sale_tally.guests         += seller.guests;
+    sale_tally.takeouts       += seller.takeouts;
+    sale_tally.fastfood       += seller.fastfood;
+    sale_tally.sitdown_sales  += seller.sitdown_sales;
+    sale_tally.takeout_sales  += seller.takeout_sales;
+    sale_tally.fastfood_sales += seller.fastfood_sales;
+    sale_tally.captured_tip   += seller.captured_tip;
+    if (!training)
+    {
+        share.everyone = seller;
+        share.everyone.opened = opener.opened;
+    }
+    return share;
+}
+
+} // namespace
+
 
 /**** System Class ****/
 // Constructor
@@ -58,6 +338,7 @@ System::System()
     last_archive_id        = 0;
     last_serial_number     = 0;
     report_sort_method     = 0;
+    load_threads           = 0;
     phrases_changed        = 0;
     data_path.Set(VIEWTOUCH_PATH "/dat");
     temp_path.Set("/tmp");
@@ -101,6 +382,7 @@ int System::LoadCurrentData(const char* path)
 	if (path == nullptr)
 		return 1;
 
+	const auto start_time = StartupClock::now();
 	DIR *dp = opendir(path);
 	if (dp == nullptr)
 	{
@@ -111,6 +393,8 @@ int System::LoadCurrentData(const char* path)
 	current_path.Set(path);
 	char str[256];
     const char* name;
+    std::vector<std::string> check_files;
+    std::vector<std::string> drawer_files;
 	struct dirent *record = nullptr;
 	do
 	{
@@ -122,39 +406,9 @@ int System::LoadCurrentData(const char* path)
             if (strcmp(&name[len-4], ".fmt") == 0)
                 continue;
 			if (strncmp(name, "check_", 6) == 0)
-			{
-				vt_safe_string::safe_format(str, 256, "%s/%s", path, name);
-				auto *check = new Check;
-				if (check == nullptr)
-					ReportError("Couldn't create check");
-				else
-				{
-					if (check->Load(&settings, str))
-					{
-						ReportError("Error in loading check");
-						delete check;
-					}
-					else
-						Add(check);
-				}
-			}
+				check_files.push_back(std::string(path) + "/" + name);
 			else if (strncmp(name, "drawer_", 7) == 0)
-			{
-				vt_safe_string::safe_format(str, 256, "%s/%s", path, name);
-				auto *drawer = new Drawer;
-				if (drawer == nullptr)
-					ReportError("Couldn't Create Drawer");
-				else
-				{
-					if (drawer->Load(str))
-					{
-						ReportError("Error in loading drawer");
-						delete drawer;
-					}
-					else
-						Add(drawer);
-				}
-			}
+				drawer_files.push_back(std::string(path) + "/" + name);
             else if (strcmp(name, "ccvoiddb") == 0)
             {
                 vt_safe_string::safe_format(str, 256, "%s/%s", path, name);
@@ -174,9 +428,178 @@ int System::LoadCurrentData(const char* path)
 	}
 	while (record);
 	closedir(dp);
+	const double scan_ms = MillisecondsSince(start_time);
+
+	// parse every file into its own detached check or drawer
+	const auto parse_time = StartupClock::now();
+	const int threads = StartupThreads(load_threads);
+	std::vector<std::unique_ptr<Check>> checks(check_files.size());
+	std::vector<ParseResult> check_results(check_files.size(), ParseResult::Failed);
+	std::vector<std::vector<long long>> check_batches(check_files.size());
+	std::vector<std::unique_ptr<Drawer>> drawers(drawer_files.size());
+	ParallelFor(check_files.size() + drawer_files.size(), threads,
+	            [&](std::size_t idx) {
+		if (idx < check_files.size())
+		{
+			check_results[idx] = ParseCheck(&settings, check_files[idx], checks[idx], check_batches[idx]);
+			return;
+		}
+		idx -= check_files.size();
+		drawers[idx] = std::make_unique<Drawer>();
+		if (drawers[idx]->Load(drawer_files[idx].c_str()))
+			drawers[idx].reset();
+	});
+	const double parse_ms = MillisecondsSince(parse_time);
+
+	// link them in serial number order so the lists come out the same
+	// however the threads were scheduled
+	const auto link_time = StartupClock::now();
+	for (std::size_t idx = 0; idx < checks.size(); ++idx)
+	{
+		if (check_results[idx] == ParseResult::MainThread)
+		{
+			checks[idx] = std::make_unique<Check>();
+			if (checks[idx]->Load(&settings, check_files[idx].c_str()))
+				check_results[idx] = ParseResult::Failed;
+		}
+		if (check_results[idx] == ParseResult::Failed)
+		{
+			ReportError("Error in loading check");
+			checks[idx].reset();
+		}
+		else
+		{
+			for (long long batch : check_batches[idx])
+				AddBatch(batch);
+		}
+	}
+	for (const std::unique_ptr<Drawer> &drawer : drawers)
+	{
+		if (drawer == nullptr)
+			ReportError("Error in loading drawer");
+	}
+	std::erase(checks, nullptr);
+	std::erase(drawers, nullptr);
+	const auto by_serial = [](const auto &a, const auto &b) {
+		return a->serial_number < b->serial_number;
+	};
+	std::stable_sort(checks.begin(), checks.end(), by_serial);
+	std::stable_sort(drawers.begin(), drawers.end(), by_serial);
+	for (std::unique_ptr<Check> &check : checks)
+		Add(check.release());
+	for (std::unique_ptr<Drawer> &drawer : drawers)
+		Add(drawer.release());
+	const double link_ms = MillisecondsSince(link_time);
+
+	const auto journal_time = StartupClock::now();
+	if (CheckJournal::enabled)
+	{
+		// fold saves made since the last checkpoint back into check_N
+		ReplayCheckJournal(path);
+		if (check_journal.Open(path) == 0)
+			CheckpointJournal(1);
+	}
+
+	vt::Logger::info("Loaded {} checks and {} drawers in {:.1f} ms "
+	                 "(scan {:.1f}, parse {:.1f} on {} threads, link {:.1f}, journal {:.1f})",
+	                 checks.size(), drawers.size(), MillisecondsSince(start_time),
+	                 scan_ms, parse_ms, threads, link_ms, MillisecondsSince(journal_time));
 	return 0;
 }
 
+/****
+ * ReplayCheckJournal:  Applies the check journal to the checks just
+ *  loaded, replacing each check a record changed and removing each
+ *  one a record dropped.  Returns the records applied.
+ ****/
+int System::ReplayCheckJournal(const char* path)
+{
+	FnTrace("System::ReplayCheckJournal()");
+	JournalReplay replay;
+	const int applied = check_journal.Replay(path, [this](int serial, JournalImage &image) {
+		Check *check = check_index.FindSerial(serial);
+		return (check == nullptr) ? 1 : check->WriteImage(image);
+	}, replay);
+
+	for (int serial : replay.dropped)
+	{
+		Check *check = check_index.FindSerial(serial);
+		if (check == nullptr)
+			continue;
+		Remove(check);
+		// the journal isn't open yet, so this is the whole of DestroyFile()
+		DataFileForget(check->filename.Value());
+		unlink(check->filename.Value());
+		delete check;
+	}
+
+	for (int serial : replay.changed)
+	{
+		const JournalImage &image = replay.images[serial];
+		auto check = std::make_unique<Check>();
+		if (check->ReadImage(&settings, image))
+		{
+			ReportError("CheckJournal: can't rebuild check " + std::to_string(serial));
+			continue;
+		}
+		check->serial_number = serial;
+		Check *old = check_index.FindSerial(serial);
+		if (old != nullptr)
+		{
+			check->filename.Set(old->filename);
+			Remove(old);
+			delete old;
+		}
+		else
+			check->filename.Set(std::string(path) + "/check_" + std::to_string(serial));
+
+		JournalImage rebuilt;
+		if (check->WriteImage(rebuilt) == 0 &&
+		    CheckJournal::Print(rebuilt).digest != CheckJournal::Print(image).digest)
+		{
+			ReportError("CheckJournal: check " + std::to_string(serial) + " differs from its journal record");
+		}
+		Add(check.release());
+	}
+
+	if (applied > 0)
+		vt::Logger::info("Replayed {} check journal records", applied);
+	return applied;
+}
+
+/****
+ * CheckpointJournal:  Hands the checks with journal records to the
+ *  journal's checkpoint, which writes them behind the caller unless
+ *  wait is set.  Each is written as it was last journaled, not as it
+ *  is now, so edits not saved yet stay out of check_N and the records
+ *  that follow still apply on top of it.
+ ****/
+int System::CheckpointJournal(int wait)
+{
+	FnTrace("System::CheckpointJournal()");
+	if (!check_journal.IsOpen() || (!wait && check_journal.Checkpointing()))
+		return 0;
+
+	std::vector<JournalFile> files;
+	const DataFileFormat format = DataFileFormatFor(DataFileKind::Check);
+	for (Check *check = CheckList(); check != nullptr; check = check->next)
+	{
+		const JournalImage *image = check_journal.Journaled(check->serial_number);
+		if (image == nullptr || check->filename.empty())
+			continue;
+		Check saved;
+		OutputDataFile body;
+		if (saved.ReadImage(&settings, *image) || body.OpenMemory(format) ||
+		    saved.Write(body, CHECK_VERSION))
+		{
+			ReportError("CheckJournal: can't checkpoint check " + std::to_string(check->serial_number));
+			return 1;
+		}
+		files.push_back({check->filename.Value(), CHECK_VERSION, std::string(body.Contents())});
+	}
+	return check_journal.Checkpoint(std::move(files), wait != 0);
+}
+
 /****
  * BackupCurrentData:  This method should really only be called
  *  from System::EndDay().  It will copy all data in current
@@ -195,6 +618,8 @@ int System::BackupCurrentData()
         retval = 1;
     else
     {
+        DataFileFlushQueue();   // tar must see the latest saves
+        DataFileGroupCommit();
         vt::cpp23::format_to_buffer(bakname, STRLONG, "{}/current_{:04d}{:02d}{:02d}{:02d}{:02d}.tar.gz",
                  backup_path.Value(), SystemTime.Year(),
                  SystemTime.Month(), SystemTime.Day(),
@@ -213,6 +638,7 @@ int System::ScanArchives(const char* path, const char* altmedia)
     if (path)
         archive_path.Set(path);
 
+    const auto start_time = StartupClock::now();
     DIR *dp = opendir(archive_path.Value());
     if (dp == nullptr)
     {
@@ -220,6 +646,7 @@ int System::ScanArchives(const char* path, const char* altmedia)
         return 1;
     }
 
+    std::vector<std::string> files;
     struct dirent *record = nullptr;
     do
     {
@@ -234,23 +661,40 @@ int System::ScanArchives(const char* path, const char* altmedia)
                     continue;
                 if (strcmp(&name[len-4], ".fmt") == 0)
                     continue;
+                if (strcmp(&name[len-4], ".idx") == 0)
+                    continue;
+                if (len > 6 && strcmp(&name[len-6], ".facts") == 0)
+                    continue;
 
-                genericChar str[256];
-                vt_safe_string::safe_format(str, 256, "%s/%s", archive_path.Value(), name);
-                auto *archive = new Archive(&settings, str);
-                archive->altmedia.Set(altmedia);
-                if (archive == nullptr)
-                    ReportError("Couldn't create archive");
-                else
-                {
-                    if (archive->id > last_archive_id)
-                        last_archive_id = archive->id;
-                    Add(archive);
-                }
+                files.push_back(std::string(archive_path.Value()) + "/" + name);
             }
         }
     }
     while (record);
+    closedir(dp);
+
+    // each Archive reads its header in the constructor
+    const auto header_time = StartupClock::now();
+    const int threads = StartupThreads(load_threads);
+    std::sort(files.begin(), files.end());
+    std::vector<std::unique_ptr<Archive>> archives(files.size());
+    ParallelFor(files.size(), threads, [&](std::size_t idx) {
+        archives[idx] = std::make_unique<Archive>(&settings, files[idx].c_str());
+    });
+    const double header_ms = MillisecondsSince(header_time);
+
+    // added oldest first, each one goes straight to the end of the list
+    std::stable_sort(archives.begin(), archives.end(),
+                     [](const std::unique_ptr<Archive> &a, const std::unique_ptr<Archive> &b) {
+                         return a->end_time < b->end_time;
+                     });
+    for (std::unique_ptr<Archive> &archive : archives)
+    {
+        archive->altmedia.Set(altmedia);
+        if (archive->id > last_archive_id)
+            last_archive_id = archive->id;
+        Add(archive.release());
+    }
 
     Archive *archive;
 
@@ -264,6 +708,7 @@ int System::ScanArchives(const char* path, const char* altmedia)
     }
 
     // load last archive with checks
+    const auto load_time = StartupClock::now();
     archive = ArchiveListEnd();
     while (archive)
     {
@@ -276,7 +721,9 @@ int System::ScanArchives(const char* path, const char* altmedia)
         archive = archive->fore;
     }
 
-    closedir(dp);
+    vt::Logger::info("Scanned {} archives in {:.1f} ms (headers {:.1f} on {} threads, last archive {:.1f})",
+                     files.size(), MillisecondsSince(start_time), header_ms, threads,
+                     MillisecondsSince(load_time));
     return 0;
 }
 
@@ -293,6 +740,71 @@ int System::UnloadArchives()
     return 0;
 }
 
+/****
+ * TrimArchives:  Unloads the least recently used archives until the
+ *  loaded ones fit Archive::memory_budget.  Archives with unsaved changes
+ *  and ones used in the last ARCHIVE_IDLE_SECONDS stay, since reports and
+ *  zones may still hold pointers into them.  Returns how many were
+ *  unloaded.
+ ****/
+int System::TrimArchives()
+{
+    FnTrace("System::TrimArchives()");
+    if (Archive::memory_budget == 0)
+        return 0;
+
+    const auto idle_since = std::chrono::steady_clock::now() - std::chrono::seconds(ARCHIVE_IDLE_SECONDS);
+    std::size_t total = 0;
+    std::vector<Archive *> idle;
+    for (Archive *archive = ArchiveList(); archive != nullptr; archive = archive->next)
+    {
+        if (archive->loaded == 0)
+            continue;
+        total += archive->memory_size;
+        if (archive->changed == 0 && archive->last_used < idle_since)
+            idle.push_back(archive);
+    }
+    if (total <= Archive::memory_budget)
+        return 0;
+
+    std::sort(idle.begin(), idle.end(), [](const Archive *a, const Archive *b) {
+        return a->last_used < b->last_used;
+    });
+    int unloaded = 0;
+    for (Archive *archive : idle)
+    {
+        if (total <= Archive::memory_budget)
+            break;
+        total -= std::min(total, archive->memory_size);
+        archive->Unload();
+        ++unloaded;
+    }
+    if (unloaded > 0)
+        vt::Logger::debug("Unloaded {} archives, {} KB still loaded", unloaded, total / 1024);
+    return unloaded;
+}
+
+/****
+ * ReadArchivedCheck:  Finds a check in the archives by serial number
+ *  through their summaries and indexes and reads just that check.  The
+ *  caller owns it.
+ ****/
+std::unique_ptr<Check> System::ReadArchivedCheck(int serial)
+{
+    FnTrace("System::ReadArchivedCheck()");
+    for (Archive *archive = ArchiveListEnd(); archive != nullptr; archive = archive->fore)
+    {
+        const ArchiveSummary *sum = archive->Summary(&settings);
+        if (sum == nullptr || sum->last_serial == 0)
+            continue;
+        if (serial > sum->last_serial)
+            break;  // serial numbers only grow
+        if (serial >= sum->first_serial)
+            return archive->ReadCheck(&settings, serial);
+    }
+    return nullptr;
+}
+
 int System::Add(Archive *archive)
 {
     FnTrace("System::Add(Archive)");
@@ -380,6 +892,24 @@ int System::SaveChanged()
     return 0;
 }
 
+/****
+ * QueueChanged:  Like SaveChanged(), but the archives are written by the
+ *  write-behind thread.  Returns the number that could not be queued.
+ ****/
+int System::QueueChanged()
+{
+    FnTrace("System::QueueChanged()");
+    int failed = 0;
+
+    for (Archive *archive = ArchiveList(); archive != nullptr; archive = archive->next)
+    {
+        if (archive->changed && archive->QueuePacked())
+            ++failed;
+    }
+
+    return failed;
+}
+
 int System::Add(Check *check)
 {
     FnTrace("System::Add(Check)");
@@ -413,6 +943,8 @@ int System::Add(Check *check)
             check_list.AddToHead(check);
     }
 
+    IndexCheck(check);
+    UpdateLiveTotals(check);
     return retval;
 }
 
@@ -421,6 +953,9 @@ int System::Remove(Check *check)
     if (check == nullptr || check->archive)
         return 1;
 
+    live_totals.Drop(check->serial_number);
+    check->live = 0;
+    check_index.Remove(check);
     return check_list.Remove(check);
 }
 
@@ -470,6 +1005,7 @@ int System::EndDay()
     menu.ResetAdmissionItems();
         
     UnloadArchives();
+    CheckpointJournal(1);
     BackupCurrentData();
 
     // delete training checks and empty Customer user checks
@@ -646,14 +1182,18 @@ int System::EndDay()
     archive->discount_alcohol      = settings.discount_alcohol;
     archive->price_rounding        = settings.price_rounding;
 
-    // Save Archive
+    // Save Archive, then its sales facts for the reports
     archive->SavePacked();
+    archive->Facts(&settings);
 
     // Prepare for new day
     CreateFixedDrawers();
     tip_db.Update(this);
     settings.RemoveInactiveMedia();
 
+    // start the new day with an empty journal
+    CheckpointJournal(1);
+    RebuildLiveTotals();
     return 0;
 }
 
@@ -946,6 +1486,7 @@ ItemException *System::FirstItemException(Archive *archive)
     {
         if (archive->loaded == 0)
             archive->LoadPacked(&settings);
+        archive->Touch();
         return archive->exception_db.ItemList();
     }
     else
@@ -959,6 +1500,7 @@ TableException *System::FirstTableException(Archive *archive)
     {
         if (archive->loaded == 0)
             archive->LoadPacked(&settings);
+        archive->Touch();
         return archive->exception_db.TableList();
     }
     else
@@ -972,6 +1514,7 @@ RebuildException *System::FirstRebuildException(Archive *archive)
     {
         if (archive->loaded == 0)
             archive->LoadPacked(&settings);
+        archive->Touch();
         return archive->exception_db.RebuildList();
     }
     else
@@ -985,25 +1528,22 @@ int System::CountOpenChecks(Employee *e)
     if (e)
         id = e->id;
     
-    int count = 0;
-    int ctype;
     TimeInfo now;
     now.Set();
     now += std::chrono::minutes(60);
 
-    for (Check *check = CheckList(); check != nullptr; check = check->next)
-    {
+    const auto is_open = [id, &now](Check *check) {
         if (check->IsTraining())
-            continue;
+            return false;
         if (id > 0 && check->user_owner != id)
-            continue;
+            return false;
         if (check->GetStatus() != CHECK_OPEN)
-            continue;
-        
-        ctype = check->CustomerType();
+            return false;
+
+        int ctype = check->CustomerType();
         if (ctype == CHECK_HOTEL)
-            continue;
-        
+            return false;
+
         // Take Out, Delivery, and Catering orders are only counted as open
         // if they are past due.  Otherwise, they may need to be open because
         // they have a delivery/pickup date sometime in the future.  This is
@@ -1012,11 +1552,25 @@ int System::CountOpenChecks(Employee *e)
         if ((ctype == CHECK_TAKEOUT || ctype == CHECK_DELIVERY || ctype == CHECK_CATERING) &&
             check->date > now)
         {
-            continue;
+            return false;
+        }
+        return true;
+    };
+
+    int count = 0;
+    if (id > 0)
+    {
+        // one owner's checks come straight from the index
+        if (const CheckIndex::Entries *entries = check_index.OwnedBy(id))
+        {
+            for (const CheckIndex::Entry &entry : *entries)
+                count += is_open(entry.check) ? 1 : 0;
         }
-        ++count;
+        return count;
     }
-    
+
+    for (Check *check = CheckList(); check != nullptr; check = check->next)
+        count += is_open(check) ? 1 : 0;
     return count;
 }
 
@@ -1026,11 +1580,18 @@ int System::NumberStacked(const char* table, Employee *e)
     if (e == nullptr)
         return 0;
 
+    const CheckIndex::Entries *entries = check_index.AtTable(table, e->training);
+    if (entries == nullptr)
+        return 0;
+
     int count = 0;
-    for (Check *check = CheckList(); check != nullptr; check = check->next)
+    for (const CheckIndex::Entry &entry : *entries)
+    {
+        Check *check = entry.check;
         if (check->IsTraining() == e->training && check->GetStatus() == CHECK_OPEN &&
             strcmp(check->Table(), table) == 0)
             ++count;
+    }
     return count;
 }
 
@@ -1040,8 +1601,14 @@ Check *System::FindOpenCheck(const char* table, Employee *e)
     if (e == nullptr)
         return nullptr;
 
-    for (Check *check = CheckListEnd(); check != nullptr; check = check->fore)
+    const CheckIndex::Entries *entries = check_index.AtTable(table, e->training);
+    if (entries == nullptr)
+        return nullptr;
+
+    // newest first, as the check list ends with the highest serial number
+    for (auto entry = entries->rbegin(); entry != entries->rend(); ++entry)
     {
+        Check *check = entry->check;
         if (check->IsTraining() == e->training && strcmp(check->Table(), table) == 0 &&
             check->GetStatus() == CHECK_OPEN)
         {
@@ -1054,21 +1621,7 @@ Check *System::FindOpenCheck(const char* table, Employee *e)
 Check *System::FindCheckByID(int check_id)
 {
     FnTrace("System::FindCheckByID()");
-    Check *retval = nullptr;
-    Check *currcheck = CheckList();
-
-    while (currcheck != nullptr)
-    {
-        if (currcheck->serial_number == check_id)
-        {
-            retval = currcheck;
-            currcheck = nullptr;
-        }
-        else
-            currcheck = currcheck->next;
-    }
-
-    return retval;
+    return check_index.FindSerial(check_id);
 }
 
 Check *System::ExtractOpenCheck(Check *check)
@@ -1123,9 +1676,11 @@ Check *System::ExtractOpenCheck(Check *check)
     return oc;
 }
 
-int System::SaveCheck(Check *check)
+int System::SaveCheck(Check *check, int queue)
 {
     FnTrace("System::SaveCheck()");
+    IndexCheck(check);
+    UpdateLiveTotals(check);
     if (check == nullptr || check->IsTraining() || check->archive)
         return 1;
 
@@ -1150,8 +1705,23 @@ int System::SaveCheck(Check *check)
         return 1;
     }
 
+    // with the journal on, only the changes since the last save are written
+    if (check_journal.IsOpen())
+    {
+        JournalImage image;
+        if (check->WriteImage(image) == 0 && check_journal.Record(check->serial_number, image) == 0)
+            return 0;
+    }
+
     OutputDataFile df;
-    if (df.Open(check->filename.Value(), CHECK_VERSION))
+    if (queue)
+    {
+        // encode here, write from the write-behind thread
+        if (df.OpenMemory(DataFileFormatFor(DataFileKind::Check)) || check->Write(df, CHECK_VERSION))
+            return 1;
+        return QueueDataFile(check->filename.Value(), CHECK_VERSION, 0, df);
+    }
+    if (df.Open(check->filename.Value(), CHECK_VERSION, 0, DataFileKind::Check))
     {
         ReportError("Failed to open check file for writing: " + std::string(check->filename.Value()));
         return 1;
@@ -1185,6 +1755,56 @@ int System::DestroyCheck(Check *check)
     return 0;
 }
 
+int System::IndexCheck(Check *check)
+{
+    FnTrace("System::IndexCheck()");
+    if (check == nullptr || check->archive || check->copy)
+        return 1;
+    if (check->next == nullptr && check->fore == nullptr && CheckList() != check)
+        return 1;  // not one of the current checks (yet)
+
+    check_index.Update(check, check->serial_number, check->Table(), check->IsTraining(),
+                       check->user_owner);
+    return 0;
+}
+
+/****
+ * UpdateLiveTotals:  Called wherever a current check may have changed
+ *  (Check::Update(), SaveCheck(), Add(), and the SubCheck order and
+ *  payment changes once the check is counted); costs one pass over this
+ *  check rather than over the day.
+ ****/
+int System::UpdateLiveTotals(Check *check)
+{
+    FnTrace("System::UpdateLiveTotals()");
+    if (check == nullptr || check->archive || check->copy || check->serial_number <= 0)
+        return 1;
+    if (check->next == nullptr && check->fore == nullptr && CheckList() != check)
+        return 1;  // not one of the current checks (yet)
+    if (live_totals.sale_credit != settings.sale_credit)
+        return RebuildLiveTotals();
+
+    live_totals.Update(check->serial_number, LiveShare(&settings, check));
+    check->live = 1;
+    return 0;
+}
+
+int System::RebuildLiveTotals()
+{
+    FnTrace("System::RebuildLiveTotals()");
+    live_totals.Clear();
+    live_totals.sale_credit = settings.sale_credit;
+    for (Check *check = CheckList(); check != nullptr; check = check->next)
+    {
+        if (check->serial_number > 0)
+        {
+            live_totals.Update(check->serial_number, LiveShare(&settings, check));
+            check->live = 1;
+        }
+    }
+    return 0;
+}
+
 Drawer *System::GetServerBank(Employee *e)
 {
     FnTrace("System::GetServerBank()");
@@ -1234,7 +1854,7 @@ int System::CreateFixedDrawers()
     return 0;
 }
 
-int System::SaveDrawer(Drawer *drawer)
+int System::SaveDrawer(Drawer *drawer, int queue)
 {
     FnTrace("System::SaveDrawer()");
     if (drawer->serial_number <= 0 || drawer->archive)
@@ -1248,7 +1868,13 @@ int System::SaveDrawer(Drawer *drawer)
     }
 
     OutputDataFile df;
-    if (df.Open(drawer->filename.Value(), DRAWER_VERSION))
+    if (queue)
+    {
+        if (df.OpenMemory(DataFileFormatFor(DataFileKind::Drawer)) || drawer->Write(df, DRAWER_VERSION))
+            return 1;
+        return QueueDataFile(drawer->filename.Value(), DRAWER_VERSION, 0, df);
+    }
+    if (df.Open(drawer->filename.Value(), DRAWER_VERSION, 0, DataFileKind::Drawer))
         return 1;
     else
         return drawer->Write(df, DRAWER_VERSION);
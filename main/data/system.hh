@@ -32,6 +32,9 @@
 #include "list_utility.hh"
 #include "archive.hh"
 #include "expense.hh"
+#include "check_journal.hh"
+#include "live_totals.hh"
+#include "check_index.hh"
 #include <string>
 #include <array>
 #include <memory>
@@ -103,6 +106,7 @@ public:
     int report_sort_method;
     int report_detail;         // how much detail to show on the reports
     int column_spacing;        // for reports;
+    int load_threads;          // startup parse workers; 0 = one per core
 
     // phrases_changed keeps track of the last time a user edited the phrase
     // translations so that zones can track whether they need to refresh any
@@ -128,6 +132,9 @@ public:
     AccountDB        account_db;
     ExpenseDB        expense_db;
     CustomerInfoDB   customer_db;
+    CheckJournal     check_journal;  // open check saves, when enabled
+    LiveTotals       live_totals;    // sums over the current checks
+    CheckIndex       check_index;    // current checks by serial, table and owner
     CDUStrings       cdustrings;
 
     // Credit Card Stuff
@@ -163,11 +170,19 @@ public:
     // returns string containing full filename for system datafile
     int LoadCurrentData(const char* path);
     // loads current day's data ('current' directory)
+    int ReplayCheckJournal(const char* path);
+    // applies the check journal in path to the loaded checks
+    int CheckpointJournal(int wait = 0);
+    // writes the checks the journal has records for back to their files
     int BackupCurrentData();
     int ScanArchives(const char* path, const char* altmedia);
     // Loads all archive headers
     int UnloadArchives();
     // purges all archive info from memory
+    int TrimArchives();
+    // unloads least recently used archives over Archive::memory_budget
+    std::unique_ptr<Check> ReadArchivedCheck(int serial);
+    // reads one archived check through the archive indexes
     int InitCurrentDay();
     // call after current data is loaded
     int Add(Archive *archive);
@@ -180,6 +195,8 @@ public:
     // finds 1st archive starting at or after time
     int SaveChanged();
     // save all archive with change flag set
+    int QueueChanged();
+    // queues all archives with change flag set for the write-behind thread
     int EndDay();
     // archives current day
     int LastEndDay();
@@ -210,10 +227,16 @@ public:
     Check *FindCheckByID(int check_id);
     Check *ExtractOpenCheck(Check *check);
     // Pulls out open subs as new check
-    int SaveCheck(Check *check);
-    // saves check to file
+    int SaveCheck(Check *check, int queue = 0);
+    // saves check to file (queued for the write-behind thread if 'queue')
     int DestroyCheck(Check *check);
     // Deletes a check from memory (& disk for current checks)
+    int IndexCheck(Check *check);
+    // refiles a current check in check_index after its table or owner changed
+    int UpdateLiveTotals(Check *check);
+    // refigures a current check's share of live_totals
+    int RebuildLiveTotals();
+    // refigures live_totals from every current check
 
     // Drawer functions
     int Add(Drawer *drawer);
@@ -226,8 +249,8 @@ public:
     // returns server bank for user (creates new one if needed)
     int CreateFixedDrawers();
     // scans hardware and creates drawer objects for all defined drawers
-    int SaveDrawer(Drawer *drawer);
-    // writes drawer object to disk
+    int SaveDrawer(Drawer *drawer, int queue = 0);
+    // writes drawer object to disk (or queues it, like SaveCheck())
     int CountDrawersOwned(int user_id);
     // returns number of drawers curently owned by user
     int AllDrawersPulled();
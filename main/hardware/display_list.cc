@@ -0,0 +1,327 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * display_list.cc
+ * What a terminal was last sent for each zone of its page
+ */
+
+#include "display_list.hh"
+#include "fntrace.hh"
+
+#include <algorithm>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+#define DISPLAY_DAMAGE_MAX 16  // damaged areas kept apart before merging
+
+// FNV-1a
+static uint64_t HashBytes(std::span<const Uchar> bytes)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (Uchar c : bytes)
+    {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint64_t HashValue(uint64_t hash, uint64_t value)
+{
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        hash ^= (value >> shift) & 0xff;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool SameArea(const RegionInfo &a, const RegionInfo &b)
+{
+    return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+}
+
+/***********************************************************************
+ * DisplayList Class
+ ***********************************************************************/
+void DisplayList::Start(const void *page_key, const RegionInfo &area)
+{
+    FnTrace("DisplayList::Start()");
+    recording   = true;
+    open        = false;
+    page        = page_key;
+    page_area   = area;
+    items.clear();
+    header_len  = -1;
+    title_start = -1;
+    last_end    = 0;
+}
+
+void DisplayList::Title(int offset)
+{
+    if (recording && header_len < 0)
+        title_start = offset;
+}
+
+void DisplayList::Begin(int kind, const void *key, const RegionInfo &area, int offset)
+{
+    if (!recording || open)
+        return;
+    if (header_len < 0)
+        header_len = offset;
+    else
+        Gap(offset);
+
+    Item item;
+    item.kind  = kind;
+    item.key   = key;
+    item.area  = area;
+    item.start = offset;
+    items.push_back(item);
+    open = true;
+}
+
+void DisplayList::End(int offset)
+{
+    if (!recording || !open)
+        return;
+    items.back().len = offset - items.back().start;
+    last_end = offset;
+    open = false;
+}
+
+/****
+ * Gap:  commands put out between items (by nothing in particular) are
+ *  kept as an item of their own that covers the page
+ ****/
+void DisplayList::Gap(int offset)
+{
+    if (offset <= last_end)
+        return;
+    Item item;
+    item.kind  = DISPLAY_GAP;
+    item.area  = page_area;
+    item.start = last_end;
+    item.len   = offset - last_end;
+    items.push_back(item);
+    last_end = offset;
+}
+
+void DisplayList::Finish(std::span<const Uchar> rendered)
+{
+    FnTrace("DisplayList::Finish()");
+    if (!recording)
+        return;
+    const int total = static_cast<int>(rendered.size());
+    if (open)
+        End(total);
+    if (header_len < 0)
+        header_len = last_end = total;
+    Gap(total);
+    recording = false;
+
+    for (Item &item : items)
+        item.hash = HashBytes(rendered.subspan(static_cast<size_t>(item.start), static_cast<size_t>(item.len)));
+    const int title_at = (title_start >= 0 && title_start <= header_len) ? title_start : header_len;
+    header_hash = HashBytes(rendered.first(static_cast<size_t>(title_at)));
+    title_hash  = HashBytes(rendered.subspan(static_cast<size_t>(title_at), static_cast<size_t>(header_len - title_at)));
+    title_start = title_at;
+}
+
+int DisplayList::Compare(RegionInfo &changed, int &title_changed) const
+{
+    FnTrace("DisplayList::Compare()");
+    changed = RegionInfo(0, 0, 0, 0);
+    title_changed = 0;
+    if (!shown_valid || page != shown_page || header_hash != shown_header ||
+        items.size() != shown.size())
+    {
+        return 1;
+    }
+
+    for (size_t idx = 0; idx < items.size(); ++idx)
+    {
+        const Item &now = items[idx];
+        const Item &was = shown[idx];
+        if (now.kind != was.kind || now.key != was.key)
+            return 1;
+        if (now.hash != was.hash || !SameArea(now.area, was.area) ||
+            Damaged(now.area) || Damaged(was.area))
+        {
+            changed.Fit(was.area);
+            changed.Fit(now.area);
+        }
+    }
+    title_changed = (title_hash != shown_title) ? 1 : 0;
+    return 0;
+}
+
+void DisplayList::Commit()
+{
+    FnTrace("DisplayList::Commit()");
+    shown        = items;
+    shown_page   = page;
+    shown_header = header_hash;
+    shown_title  = title_hash;
+    shown_valid  = true;
+    damage.clear();
+    clipped = false;
+}
+
+/****
+ * Keep:  the hash covers every item's commands and area, so a copy is
+ *  only taken for one that would look the same
+ ****/
+int DisplayList::Keep(int slots, int &hash)
+{
+    FnTrace("DisplayList::Keep()");
+    auto entry = std::find_if(kept.begin(), kept.end(), [&](const Kept &k) { return k.page == shown_page; });
+    if (entry == kept.end())
+    {
+        if (static_cast<int>(kept.size()) < slots)
+        {
+            Kept fresh;
+            fresh.slot = static_cast<int>(kept.size());
+            kept.push_back(fresh);
+            entry = kept.end() - 1;
+        }
+        else
+        {
+            entry = std::min_element(kept.begin(), kept.end(), [](const Kept &a, const Kept &b) {
+                return a.used < b.used;
+            });
+        }
+    }
+
+    uint64_t sum = HashValue(HashValue(14695981039346656037ULL, shown_header), shown_title);
+    for (const Item &item : shown)
+    {
+        sum = HashValue(sum, item.hash);
+        sum = HashValue(sum, (static_cast<uint64_t>(item.area.x) << 48) ^ (static_cast<uint64_t>(item.area.y) << 32) ^
+                             (static_cast<uint64_t>(item.area.w) << 16) ^ static_cast<uint64_t>(item.area.h));
+    }
+    entry->hash   = static_cast<int>((sum ^ (sum >> 32)) & 0x7fffffff);
+    entry->page   = shown_page;
+    entry->items  = shown;
+    entry->header = shown_header;
+    entry->title  = shown_title;
+    entry->used   = ++use_count;
+    hash = entry->hash;
+    return entry->slot;
+}
+
+int DisplayList::Recall(int &hash)
+{
+    FnTrace("DisplayList::Recall()");
+    for (Kept &entry : kept)
+    {
+        if (entry.page != page || entry.header != header_hash || entry.items.size() != items.size())
+            continue;
+        const bool same = std::equal(items.begin(), items.end(), entry.items.begin(),
+                                     [](const Item &a, const Item &b) { return a.kind == b.kind && a.key == b.key; });
+        if (!same)
+            return -1;
+
+        shown        = entry.items;
+        shown_page   = entry.page;
+        shown_header = entry.header;
+        shown_title  = entry.title;
+        shown_valid  = true;
+        damage.clear();
+        clipped = false;
+        entry.used = ++use_count;
+        hash = entry.hash;
+        return entry.slot;
+    }
+    return -1;
+}
+
+void DisplayList::Clip(int x, int y, int w, int h)
+{
+    clip = RegionInfo(x, y, w, h);
+    clipped = true;
+}
+
+void DisplayList::Updated()
+{
+    if (clipped)
+        Damage(clip);
+    else
+        Invalidate();
+    clipped = false;
+}
+
+void DisplayList::Updated(int x, int y, int w, int h)
+{
+    Damage(RegionInfo(x, y, w, h));
+    clipped = false;
+}
+
+void DisplayList::Damage(const RegionInfo &area)
+{
+    if (!shown_valid || !area.IsSet())
+        return;
+    if (damage.size() >= DISPLAY_DAMAGE_MAX)
+    {
+        // too many to keep apart; one area around them all will do
+        RegionInfo all(damage.front());
+        for (const RegionInfo &region : damage)
+            all.Fit(region);
+        damage.clear();
+        damage.push_back(all);
+        damage.front().Fit(area);
+        return;
+    }
+    damage.push_back(area);
+}
+
+bool DisplayList::Damaged(const RegionInfo &area) const
+{
+    return std::any_of(damage.begin(), damage.end(), [&](const RegionInfo &region) {
+        return region.Overlap(area.x, area.y, area.w, area.h);
+    });
+}
+
+std::span<const Uchar> DisplayList::TitleBytes(std::span<const Uchar> rendered) const
+{
+    if (title_start < 0 || header_len < title_start)
+        return {};
+    return rendered.subspan(static_cast<size_t>(title_start), static_cast<size_t>(header_len - title_start));
+}
+
+int DisplayList::Largest() const noexcept
+{
+    int largest = header_len;
+    for (const Item &item : items)
+        largest = std::max(largest, item.len);
+    return largest;
+}
+
+void DisplayList::Count(int update_type, uint64_t whole, uint64_t sent, int result)
+{
+    Stats &count = stats[update_type];
+    ++count.redraws;
+    if (result == 0)
+        ++count.changes;
+    else if (result == 2)
+        ++count.unchanged;
+    else if (result == 3)
+        ++count.recalled;
+    count.whole += whole;
+    count.sent  += sent;
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * display_list.hh
+ * What a terminal was last sent for each zone of its page
+ */
+
+#ifndef DISPLAY_LIST_HH
+#define DISPLAY_LIST_HH
+
+#include "basic.hh"
+#include "utility.hh"
+
+#include <cstdint>
+#include <map>
+#include <span>
+#include <vector>
+
+// Display list item kinds
+#define DISPLAY_GAP     0  // commands between items; taken to cover the page
+#define DISPLAY_SHADOW  1  // a zone's shadow
+#define DISPLAY_ZONE    2  // a zone
+#define DISPLAY_CURSOR  3  // a zone's edit cursor
+
+/*********************************************************************
+ * DisplayList
+ *
+ * Terminal::Draw() renders a page into a scratch queue and records
+ * where each zone's commands fall in it:  the page header first (with
+ * the title bar time string marked), then one item per shadow, zone
+ * and edit cursor in painting order.  Compare() holds the recording up
+ * against the list last shown and finds the area whose commands
+ * changed, so only the items over that area need resending.  Only
+ * hashes of the commands are kept between redraws.
+ *
+ * Drawing that reaches the terminal some other way (a zone drawing
+ * itself, a clipped redraw) is reported with Clip() and Updated(), so
+ * items under it count as changed next time.
+ *
+ * vt_term can keep copies of pages it was shown (TERM_PAGESTORE).
+ * Keep() notes what such a copy holds, one per page in a few slots
+ * reused least recently used first; Recall() finds the copy a new
+ * recording lines up with, so going back to a page resends only what
+ * changed on it since.
+ ********************************************************************/
+class DisplayList
+{
+public:
+    struct Item
+    {
+        int kind{DISPLAY_GAP};
+        const void *key{nullptr};  // the zone
+        RegionInfo area;
+        int start{0};              // offset of its commands in the recording
+        int len{0};
+        uint64_t hash{0};
+    };
+
+    struct Stats
+    {
+        int redraws{0};         // full-page redraws asked for
+        int changes{0};         // sent as changed areas
+        int unchanged{0};       // nothing to send
+        int recalled{0};        // started from a copy vt_term kept
+        uint64_t whole{0};      // bytes whole redraws would have been
+        uint64_t sent{0};       // bytes actually sent
+    };
+
+    // Starts recording a page; offsets count from the start of the
+    // queue it renders into, which must begin empty
+    void Start(const void *page_key, const RegionInfo &page_area);
+    // The header's title bar time string starts at offset
+    void Title(int offset);
+    // Brackets one item's commands
+    void Begin(int kind, const void *key, const RegionInfo &area, int offset);
+    void End(int offset);
+    // Ends the recording:  rendered is everything the page put out
+    void Finish(std::span<const Uchar> rendered);
+    [[nodiscard]] bool Recording() const noexcept { return recording; }
+
+    // 1 if the page has to be sent whole (nothing shown yet, another
+    // page or header, items that don't line up), else 0 with changed
+    // set to the area to resend (unset if none) and title_changed set
+    // if only the title bar time differs in the header
+    int Compare(RegionInfo &changed, int &title_changed) const;
+    // The recording is now what the terminal shows
+    void Commit();
+    // The next redraw is sent whole
+    void Invalidate() noexcept { shown_valid = false; }
+
+    // Notes that vt_term keeps a copy of what's shown (as of Commit())
+    // in the slot returned:  the one this page had, an empty one or the
+    // least recently used of slots; hash is set to identify the copy
+    int Keep(int slots, int &hash);
+    // If a kept copy is of the recorded page with the same header and
+    // items, it becomes what's shown and its slot is returned with hash
+    // set; else -1
+    int Recall(int &hash);
+    // vt_term holds no copies
+    void Forget() noexcept { kept.clear(); }
+
+    // The terminal shows what was drawn in the clip area (or the whole
+    // page if unclipped), or in x, y, w, h; the clip is cleared
+    void Clip(int x, int y, int w, int h);
+    void Updated();
+    void Updated(int x, int y, int w, int h);
+
+    [[nodiscard]] const std::vector<Item> &Items() const noexcept { return items; }
+    [[nodiscard]] int HeaderSize() const noexcept { return header_len; }
+    [[nodiscard]] std::span<const Uchar> TitleBytes(std::span<const Uchar> rendered) const;
+    // The longest run of commands that has to go out in one frame
+    [[nodiscard]] int Largest() const noexcept;
+
+    // Adds one redraw for update_type (result:  0 changes, 1 whole,
+    // 2 unchanged, 3 changes to a kept copy)
+    void Count(int update_type, uint64_t whole, uint64_t sent, int result);
+    [[nodiscard]] const std::map<int, Stats> &GetStats() const noexcept { return stats; }
+
+private:
+    // recording
+    bool recording{false};
+    bool open{false};
+    const void *page{nullptr};
+    RegionInfo page_area;
+    std::vector<Item> items;
+    int header_len{-1};
+    int title_start{-1};
+    uint64_t header_hash{0};
+    uint64_t title_hash{0};
+    int last_end{0};
+
+    // last shown
+    bool shown_valid{false};
+    const void *shown_page{nullptr};
+    std::vector<Item> shown;
+    uint64_t shown_header{0};
+    uint64_t shown_title{0};
+
+    // copies vt_term keeps
+    struct Kept
+    {
+        int slot{0};
+        int hash{0};
+        const void *page{nullptr};
+        std::vector<Item> items;
+        uint64_t header{0};
+        uint64_t title{0};
+        uint64_t used{0};
+    };
+    std::vector<Kept> kept;
+    uint64_t use_count{0};
+
+    // drawn since
+    std::vector<RegionInfo> damage;
+    RegionInfo clip;
+    bool clipped{false};
+
+    std::map<int, Stats> stats;
+
+    void Gap(int offset);
+    void Damage(const RegionInfo &area);
+    [[nodiscard]] bool Damaged(const RegionInfo &area) const;
+};
+
+#endif
@@ -27,6 +27,7 @@
 #include "settings.hh"
 #include "manager.hh"
 #include "archive.hh"
+#include "data_persistence_manager.hh"
 #include "safe_string_utils.hh"
 #include "src/utils/cpp23_utils.hh"
 #include <sys/types.h>
@@ -158,6 +159,7 @@ Drawer::Drawer()
     total_payments   = 0;
     position         = 0;
     media_balanced   = 0;
+    dirty            = 0;
     archive = nullptr;
 }
 
@@ -176,6 +178,7 @@ Drawer::Drawer(TimeInfo &timevar)
     total_payments   = 0;
     position         = 0;
     media_balanced   = 0;
+    dirty            = 0;
     archive = nullptr;
 }
 
@@ -259,6 +262,7 @@ int Drawer::Read(InputDataFile &df, int version)
         else
             Add(dp);
     }
+    dirty = 0;  // just as it was written
     return error;
 }
 
@@ -353,18 +357,34 @@ int Drawer::Save()
     if (archive)
         archive->changed = 1;
     else
+    {
         retval = MasterSystem->SaveDrawer(this);
+        dirty = (retval != 0);  // retried by the next auto-save
+        if (dirty)
+            GetDataPersistenceManager().MarkDataDirty("drawers");
+    }
 
     return retval;
 }
 
+// Only the drawer's own flag is set; the auto-save looks for it.
+void Drawer::Changed()
+{
+    if (archive == nullptr)
+        dirty = 1;
+}
+
 int Drawer::DestroyFile()
 {
     FnTrace("Drawer::DestroyFile()");
     if (filename.empty())
         return 0;
 
+    // a save still waiting to be renamed into place would bring it back
+    const int pending = DataFileForget(filename.Value());
     int result = DeleteFile(filename.Value());
+    if (result && pending)
+        result = 0;  // only the pending save existed
     if (result)
         ReportError("Error In Deleting Drawer");
     filename.Clear();
@@ -374,24 +394,28 @@ int Drawer::DestroyFile()
 int Drawer::Add(DrawerPayment *dp)
 {
     FnTrace("Drawer::Add()");
+    Changed();
     return payment_list.AddToTail(dp);
 }
 
 int Drawer::Add(DrawerBalance *db)
 {
     FnTrace("Drawer::Add()");
+    Changed();
     return balance_list.AddToTail(db);
 }
 
 int Drawer::Remove(DrawerPayment *dp)
 {
     FnTrace("Drawer::Remove()");
+    Changed();
     return payment_list.Remove(dp);
 }
 
 int Drawer::Remove(DrawerBalance *db)
 {
     FnTrace("Drawer::Remove()");
+    Changed();
     return balance_list.Remove(db);
 }
 
@@ -403,6 +427,7 @@ int Drawer::Purge()
 
     total_difference = 0;
     total_checks     = 0;
+    Changed();
     return 0;
 }
 
@@ -978,6 +1003,39 @@ int Drawer::Total(Check *check_list, int force)
         count[i]  = 0;
     }
 
+    // The current day's checks are already tallied by drawer
+    const LiveTotals::DrawerTally *live = nullptr;
+    const bool use_live = (check_list != nullptr && MasterSystem &&
+                           check_list == MasterSystem->CheckList());
+    if (use_live)
+    {
+        live = MasterSystem->live_totals.FindDrawer(serial_number);
+        check_list = nullptr;
+    }
+    if (live)
+    {
+        total_checks = live->checks;
+        for (const auto &[key, tally] : live->tenders)
+        {
+            const int idx = key.first;
+            const int pid = key.second;
+            if (pid > 0 || idx >= NUMBER_OF_TENDERS)
+            {
+                DrawerBalance *bal = FindBalance(idx, pid, 1);
+                if (bal)
+                {
+                    bal->amount += tally.amount;
+                    bal->count  += tally.count;
+                }
+            }
+            else
+            {
+                amount[idx] += tally.amount;
+                count[idx]  += tally.count;
+            }
+        }
+    }
+
     // Go through checks
     for (check = check_list; check != nullptr; check = check->next)
     {
@@ -1133,6 +1191,7 @@ int Drawer::RecordSale(SubCheck *sc)
 
     ++total_checks;
     sc->drawer_id = serial_number;
+    Changed();
     return 0;
 }
 
@@ -113,6 +113,7 @@ public:
     int        total_checks;     // total checks in drawer
     int        total_payments;   // total payments in drawer
     Str        filename;         // file drawer is saved as (if not archived)
+    short      dirty;            // changed since its file was last written (not saved)
 
     // Constructors
     Drawer();
@@ -144,6 +145,8 @@ public:
     // Returns number of drawrers in list starting with current drawer
     int Save();
     // Saves drawer to file (or makes parent archive changed)
+    void Changed();
+    // Marks drawer for the next auto-save (not in archives)
     int DestroyFile();
     // Kills drawer file on disk only
     int MakeReport(Terminal *t, Check *check_list, Report *r);
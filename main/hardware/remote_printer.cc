@@ -210,6 +210,8 @@ RemotePrinter::RemotePrinter(const char* host, int port, int mod, int no)
         vt::cpp23::format_to_buffer(tmp.data(), tmp.size(), "Failed to get connection with printer {}", no);
         ReportError(tmp.data());
     }
+    else
+        fcntl(socket_no, F_SETFL, fcntl(socket_no, F_GETFL, 0) | O_NONBLOCK);
     close(dev);
 }
 
@@ -360,7 +362,9 @@ int RemotePrinter::Reconnect()
     }
     
     // Successfully reconnected
+    fcntl(new_socket, F_SETFL, fcntl(new_socket, F_GETFL, 0) | O_NONBLOCK);
     socket_no = new_socket;
+    buffer_in->Reset();
     failure = 0;
     close(dev);
     
@@ -550,9 +554,11 @@ void PrinterCB(XtPointer client_data, int *fid, XtInputId *id)
 {
     RemotePrinter *p = (RemotePrinter *) client_data;
     int val = p->buffer_in->Read(p->socket_no);
+    if (val == 0)
+        return;  // no whole message yet
 
     Control *db = p->parent;
-    if (val <= 0)
+    if (val < 0)
     {
         ++p->failure;
         
@@ -613,7 +619,7 @@ void PrinterCB(XtPointer client_data, int *fid, XtInputId *id)
     }
 
     std::array<char, 256> str{};
-    while (p->buffer_in->size > 0)
+    while (p->buffer_in->size > 0 || p->buffer_in->Take() > 0)
     {
         int code = p->RInt8();
         switch (code)
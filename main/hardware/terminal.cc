@@ -38,7 +38,9 @@
 #include "manager.hh"
 #include "printer.hh"
 #include "remote_link.hh"
+#include "link_output.hh"
 #include "src/utils/vt_enum_utils.hh"
+#include "src/utils/vt_logger.hh"
 #include "report.hh"
 #include "sales.hh"
 #include "settings.hh"
@@ -56,6 +58,7 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/file.h>
 #include <sys/socket.h>
 #include <sys/time.h>
@@ -184,33 +187,116 @@ enum window_buttons {
 #define SOCKET_FILE "/tmp/vt_term"
 
 /**** Calback Functions ****/
+// sockets with output waiting for room
+static LinkOutputPoll OutputPoll;
+static unsigned long  OutputPollId = 0;
+
+void OutputCB(XtPointer /*client_data*/, int * /*fid*/, XtInputId * /*id*/)
+{
+    FnTrace("OutputCB()");
+    std::vector<void *> ready;
+    OutputPoll.Ready(ready);
+    for (void *owner : ready)
+        static_cast<Terminal *>(owner)->FlushOutput();
+}
+
+/****
+ * WatchOutput:  puts term's socket in the output poll while it has
+ *  output pending, and reports stalls and failed links.
+ ****/
+static void WatchOutput(Terminal *term, int result, bool was_behind, bool was_failed)
+{
+    FnTrace("WatchOutput()");
+    if (result == 1 && term->output_watched == 0)
+    {
+        if (OutputPollId == 0 && OutputPoll.Fd() >= 0)
+            OutputPollId = AddInputFn((InputFn) OutputCB, OutputPoll.Fd(), nullptr);
+        if (OutputPollId != 0 && OutputPoll.Watch(term->socket_no, term) == 0)
+            term->output_watched = 1;
+        else
+            term->output.Finish(5000);  // no poll; wait as before
+    }
+    else if (result != 1 && term->output_watched)
+    {
+        OutputPoll.Unwatch(term->socket_no);
+        term->output_watched = 0;
+    }
+
+    const LinkOutput::Stats &stats = term->output.GetStats();
+    if (was_behind && !term->output.Behind())
+    {
+        vt::Logger::info("Terminal '{}' caught up: {} ms behind in {} stalls, peak {} KB queued, "
+                         "{} redraw frames dropped", term->host.Value(), stats.stall_ms,
+                         stats.stalls, stats.peak / 1024, stats.coalesced);
+    }
+    if (result < 0 && !was_failed && term->socket_no > 0)
+    {
+        // let TermCB() find the dead link and clean up as for a read failure
+        ReportError(std::string("Terminal '") + term->host.Value() + "' output failed; closing link");
+        shutdown(term->socket_no, SHUT_RDWR);
+    }
+}
+
+/****
+ * ReportDisplay:  logs how much the display list saved term, by the
+ *  update that asked for the redraws (0 for none), and what deflating
+ *  its frames did
+ ****/
+static void ReportDisplay(Terminal *term)
+{
+    FnTrace("ReportDisplay()");
+    for (const auto &[cause, count] : term->display.GetStats())
+    {
+        if (count.changes == 0 && count.unchanged == 0 && count.recalled == 0)
+            continue;
+        vt::Logger::debug("Terminal '{}' redraws for update {:#x}: {} ({} as changes, {} from kept pages, "
+                          "{} unchanged), sent {} KB of {} KB", term->host.Value(), cause, count.redraws,
+                          count.changes, count.recalled, count.unchanged, count.sent / 1024,
+                          count.whole / 1024);
+    }
+
+    const LinkDeflate *zip = term->buffer_out ? term->buffer_out->Zip() : nullptr;
+    if (zip != nullptr && zip->GetStats().frames > 0)
+    {
+        const LinkDeflate::Stats &count = zip->GetStats();
+        vt::Logger::debug("Terminal '{}' frames: {} ({} deflated), sent {} KB of {} KB, {} ms deflating",
+                          term->host.Value(), count.frames, count.deflated, count.sent / 1024,
+                          count.raw / 1024, count.pack_us / 1000);
+    }
+}
+
 void TermCB(XtPointer client_data, int *fid, XtInputId * /*id*/)
 {
 
     FnTrace("TermCB()");
     Terminal *term = (Terminal *) client_data;
     Terminal *errterm = nullptr;
-    int val = term->buffer_in->Read(*fid);
     static int last_code = 0;
 
-    if (val <= 0)
+    // clones share the primary's input queue, but each has its own
+    // inbox and writes in the encoding it switched to
+    Terminal *sender = term;
+    if (*fid != term->socket_no)
     {
-        // If *fid doesn't equal term->socket_no, then we have a clone.
-        // In that case, we need to find the clone so that we can process
-        // it properly rather than the primary.
-        if (*fid != term->socket_no)
+        for (Terminal *clone = term->CloneList(); clone != nullptr; clone = clone->next)
         {
-            Terminal *currterm = term->CloneList();
-            while (currterm != nullptr && errterm == nullptr)
+            if (clone->socket_no == *fid)
             {
-                if (*fid == currterm->socket_no)
-                    errterm = currterm;
-                else
-                    currterm = currterm->next;
+                sender = clone;
+                break;
             }
         }
-        else
-            errterm = term;
+    }
+
+    int val = term->buffer_in->Read(*fid, sender->link_inbox);
+    if (val == 0)
+        return;  // no whole message yet
+    if (val < 0)
+    {
+        // sender is the primary or the clone whose link failed (if it's
+        // neither, there's nobody to hold responsible)
+        if (sender->socket_no == *fid)
+            errterm = sender;
 
         // Upgrade the failure count and return unless we've hit the threshold.
         if (errterm == nullptr)
@@ -253,7 +339,11 @@ void TermCB(XtPointer client_data, int *fid, XtInputId * /*id*/)
     term->failure = 0;
     genericChar str[STRLENGTH];
 
-    while (term->buffer_in->size > 0)
+    term->buffer_in->SetEncoding(sender->link_encoding, sender->link_flags);
+
+    // every message read this time, including any that didn't fit in
+    // the queue at first
+    while (term->buffer_in->size > 0 || term->buffer_in->Take(sender->link_inbox) > 0)
 	{
 		int code = term->RInt8();
         term->buffer_in->SetCode("vt_main", code);
@@ -507,6 +597,50 @@ void TermCB(XtPointer client_data, int *fid, XtInputId * /*id*/)
                     term->Signal(str, 0);
             }
             break;
+        case ServerProtocol::SrvLinkOffer:
+        {
+            int offer       = term->RInt8();
+            int offer_flags = term->RInt8();
+            sender->keeps_pages = (offer_flags & LINK_PAGECACHE) ? 1 : 0;
+            // clones were switched to the primary's encoding on connect
+            if (sender != term)
+                break;
+            int encoding = std::min(offer, LinkEncodingLimit);
+            int flags    = (offer_flags | LinkFlags) & LINK_CHECKED;
+            if (term->link_deflate && (offer_flags & LINK_DEFLATE))
+                flags |= LINK_DEFLATE;
+            if (encoding > LINK_ENCODING_TAGGED || (flags & LINK_DEFLATE))
+            {
+                term->WInt8(TERM_LINKSWITCH);
+                term->WInt8(encoding);
+                term->WInt8(flags);
+                term->buffer_out->SetEncoding(encoding, flags);
+            }
+            break;
+        }
+        case ServerProtocol::SrvLinkSwitch:
+            sender->link_encoding = term->RInt8();
+            sender->link_flags    = term->RInt8();
+            term->buffer_in->SetEncoding(sender->link_encoding, sender->link_flags);
+            break;
+        case ServerProtocol::SrvPageMiss:
+            // the copy was lost on its way (or the link started over);
+            // start again from a whole page
+            term->RInt8();
+            term->display.Forget();
+            term->display.Invalidate();
+            term->Draw(RENDER_REDRAW);
+            break;
+        case ServerProtocol::SrvImageReady:
+        {
+            // the terminal drew placeholders here while it decoded images
+            int x = term->RInt16();
+            int y = term->RInt16();
+            int w = term->RInt16();
+            int h = term->RInt16();
+            term->Draw(0, x, y, w, h);
+            break;
+        }
         case ServerProtocol::SrvShutdown:  // only allow easy exits on debug platforms
             if (term->user != nullptr && (term->user->id == 1 || term->user->id == 2))
                 EndSystem();  // superuser and developer can end system
@@ -628,6 +762,15 @@ Terminal::Terminal()
 
     buffer_in       = nullptr;
     buffer_out      = nullptr;
+    link_encoding   = LINK_ENCODING_TAGGED;
+    link_flags      = 0;
+    keeps_pages     = 0;
+    link_deflate    = 0;
+    output_watched  = 0;
+    redraw_serial   = 0;
+    redrawing       = 0;
+    update_cause    = 0;
+    framed_bytes    = 0;
 
     // General Inits
     size      = 0;
@@ -742,10 +885,18 @@ Terminal::~Terminal()
 	if (redraw_id)
 		RemoveTimeOutFn(redraw_id);
 
+	ReportDisplay(this);
+
 	if (socket_no > 0)
 	{
-		WInt8(TERM_DIE);
-		SendNow();
+		if (buffer_out)
+		{
+			WInt8(TERM_DIE);
+			SendNow();
+		}
+		output.Finish(1000);
+		if (output_watched)
+			OutputPoll.Unwatch(socket_no);
 		close(socket_no);
 	}
 
@@ -814,6 +965,7 @@ int Terminal::Initialize()
     SetDropShadow(settings->use_drop_shadows);
     SetShadowOffset(settings->shadow_offset_x, settings->shadow_offset_y);
     SetShadowBlur(settings->shadow_blur_radius);
+    display.Forget();  // kept pages were drawn under the old settings
     show_button_images = settings->show_button_images_default;
     show_button_images_custom = 0;  // Reset custom flag when initializing from global default
 
@@ -874,13 +1026,212 @@ int Terminal::Draw(int update_flag)
     FnTrace("Terminal::Draw()");
     if (page)
     {
+        // RENDER_NEW follows changes (fonts, settings, edits) that can
+        // make the same commands look different, so copies vt_term kept
+        // go too
+        if (update_flag == RENDER_NEW)
+            display.Forget();
+        ShowPage(update_flag, 0, update_flag == RENDER_NEW);
+    }
+    return 0;
+}
+
+/****
+ * ShowPage:  Renders the page and sends it (see SendPage())
+ ****/
+int Terminal::ShowPage(int update_flag, int no_parent, int force_whole)
+{
+    FnTrace("Terminal::ShowPage()");
+    if (buffer_out != nullptr && buffer_out == render_queue.get())
+        return 0;  // a zone asked for a redraw while one is rendering
+
+    // a full redraw goes out in frames of its own, so a terminal that's
+    // behind can drop it unsent once a newer one is queued
+    SendNow();
+    redrawing = ++redraw_serial;
+    const int saved_type = last_page_type;
+    const int saved_size = last_page_size;
+    if (RenderPage(update_flag, no_parent) == 0)
+        SendPage(force_whole);
+    else
+    {
+        // too much to hold; straight out as it renders, as before
+        last_page_type = saved_type;
+        last_page_size = saved_size;
+        display.Invalidate();
         RenderBlankPage();
-        page->Render(this, update_flag);
+        page->Render(this, RENDER_REDRAW, no_parent);
         UpdateAll();
     }
+    redrawing = 0;
     return 0;
 }
 
+/****
+ * RenderPage:  Renders the page into render_queue, recording each
+ *  zone's commands in the display list.  Returns 1 if the page didn't
+ *  fit there, or has a run of commands too long for one frame.
+ ****/
+int Terminal::RenderPage(int update_flag, int no_parent)
+{
+    FnTrace("Terminal::RenderPage()");
+    if (buffer_out == nullptr)
+        return 1;
+    if (render_queue == nullptr)
+        render_queue = std::make_unique<CharQueue>(static_cast<int>(QUEUE_SIZE * 4));
+
+    CharQueue *out = buffer_out;
+    render_queue->Clear();
+    render_queue->SetEncoding(out->Encoding(), out->Flags());
+    buffer_out = render_queue.get();
+    display.Start(page, RegionInfo(0, 0, page->width, page->height));
+    RenderBlankPage();
+    page->Render(this, update_flag, no_parent);
+    display.Finish(render_queue->ReadSpan());
+    buffer_out = out;
+
+    if (render_queue->overflow || display.Largest() > out->buffer_size)
+        return 1;
+    return 0;
+}
+
+/****
+ * SendPage:  Sends what RenderPage() rendered, whole (always if
+ *  force_whole) or just the area whose commands changed since the last
+ *  redraw:  that area is cleared to the background and the items over
+ *  it sent again in order, so zones overlapping a changed one are
+ *  painted over it as before.  Going back to a page vt_term kept a copy
+ *  of, the copy is put back and changes are sent against it.  Returns
+ *  1 sent whole, 0 changes sent, 2 nothing changed, 3 copy put back.
+ ****/
+int Terminal::SendPage(int force_whole)
+{
+    FnTrace("Terminal::SendPage()");
+    const std::span<const Uchar> rendered = render_queue->ReadSpan();
+    const auto item_bytes = [&](const DisplayList::Item &item) {
+        return rendered.subspan(static_cast<size_t>(item.start), static_cast<size_t>(item.len));
+    };
+    const uint64_t before = framed_bytes;
+    const int page_slots = PageSlots();
+
+    RegionInfo changed;
+    int title_changed = 0;
+    int result = 1;
+    int whole = force_whole || display.Compare(changed, title_changed);
+    int slot = -1;
+    int hash = 0;
+    if (whole && !force_whole && page_slots > 0 && (slot = display.Recall(hash)) >= 0)
+    {
+        WInt8(TERM_PAGERECALL);
+        WInt8(slot);
+        WInt32(hash);
+        whole = display.Compare(changed, title_changed);
+    }
+
+    if (whole)
+    {
+        Emit(rendered.first(static_cast<size_t>(display.HeaderSize())));
+        for (const DisplayList::Item &item : display.Items())
+            Emit(item_bytes(item));
+        UpdateAll();
+    }
+    else if (changed.IsSet() || title_changed || slot >= 0)
+    {
+        // changes are sent relative to what's shown, so they can't be
+        // dropped for a later redraw like a whole page can (a copy put
+        // back goes with its changes)
+        if (slot < 0)
+        {
+            SendNow();
+            redrawing = 0;
+        }
+        if (title_changed)
+        {
+            WInt8(TERM_TITLEBAR);
+            Emit(display.TitleBytes(rendered));
+            changed.Fit(0, 0, page->width, TITLE_HEIGHT);
+        }
+        if (changed.IsSet())
+        {
+            SetClip(changed.x, changed.y, changed.w, changed.h);
+            RenderBackground();
+            for (const DisplayList::Item &item : display.Items())
+            {
+                if (item.area.Overlap(changed.x, changed.y, changed.w, changed.h))
+                    Emit(item_bytes(item));
+            }
+        }
+        if (slot >= 0)
+        {
+            UpdateArea(0, 0, page->width, page->height);
+            result = 3;
+        }
+        else
+        {
+            UpdateArea(changed.x, changed.y, changed.w, changed.h);
+            result = 0;
+        }
+    }
+    else
+        result = 2;
+
+    display.Commit();
+    if (page_slots > 0 && result != 2)
+    {
+        // in the same frame as the page, so both or neither are dropped
+        const int keep_slot = display.Keep(page_slots, hash);
+        WInt8(TERM_PAGESTORE);
+        WInt8(keep_slot);
+        WInt32(hash);
+    }
+    display.Count(update_cause, rendered.size(), framed_bytes - before, result);
+    return result;
+}
+
+/****
+ * PageSlots:  vt_term can be asked to keep copies of pages only if it
+ *  offered to on every link, clones included, and then only as many
+ *  full screen pixmaps (at 4 bytes a pixel) as fit in LinkPageMemory
+ ****/
+int Terminal::PageSlots()
+{
+    FnTrace("Terminal::PageSlots()");
+    if (keeps_pages == 0 || LinkPageMemory <= 0)
+        return 0;
+    for (Terminal *clone = clone_list.Head(); clone != nullptr; clone = clone->next)
+    {
+        if (clone->keeps_pages == 0)
+            return 0;
+    }
+    const long long screen = static_cast<long long>(std::max(width, 1)) * std::max(height, 1) * 4;
+    const long long fit = static_cast<long long>(LinkPageMemory) * 1024 * 1024 / screen;
+    return static_cast<int>(std::min<long long>(fit, LINK_PAGE_SLOTS));
+}
+
+/****
+ * Emit:  Adds a run of already encoded commands to the output, sending
+ *  what's buffered first if they would take it past the send size.
+ ****/
+int Terminal::Emit(std::span<const Uchar> bytes)
+{
+    FnTrace("Terminal::Emit()");
+    if (buffer_out->size > 0 && buffer_out->size + static_cast<int>(bytes.size()) > buffer_out->send_size)
+        Broadcast();
+    return buffer_out->PutBytes(bytes);
+}
+
+void Terminal::BeginItem(int kind, const void *key, const RegionInfo &area)
+{
+    if (display.Recording() && buffer_out == render_queue.get())
+        display.Begin(kind, key, area, buffer_out->size);
+}
+
+void Terminal::EndItem()
+{
+    if (display.Recording() && buffer_out == render_queue.get())
+        display.End(buffer_out->size);
+}
+
 int Terminal::Draw(int update_flag, int x, int y, int w, int h)
 {
     FnTrace("Terminal::Draw(x,y,w,h)");
@@ -1100,11 +1451,7 @@ int Terminal::ChangePage(Page *targetPage)
     if (page)
         AllowBlanking(page->IsKitchen() == 0);
 
-    RenderBlankPage();
-
-    page->Render(this, RENDER_NEW, no_parent_flag);
-
-    UpdateAll();
+    ShowPage(RENDER_NEW, no_parent_flag, 0);
 
     return 0;
 }
@@ -2549,6 +2896,10 @@ int Terminal::Update(int update_message, const genericChar* value)
     if (page == nullptr)
         return 1;
 
+    // redraws from here on are counted against update_message
+    const int prior_cause = update_cause;
+    update_cause = update_message;
+
     if (update_message & UPDATE_MINUTE)
         DrawTitleBar();
     
@@ -2578,7 +2929,9 @@ int Terminal::Update(int update_message, const genericChar* value)
         Draw(1);
     }
     
-    return page->Update(this, update_message, value);
+    const int result = page->Update(this, update_message, value);
+    update_cause = prior_cause;
+    return result;
 }
 
 Drawer *Terminal::FindDrawer()
@@ -3981,6 +4334,7 @@ int Terminal::RenderBlankPage()
     else
     {
         WStr(pn);
+        display.Title(buffer_out->size);
         WStr(TimeDate(SystemTime, TD0));
     }
 
@@ -4437,6 +4791,7 @@ int Terminal::RenderShadow(int x, int y, int w, int h, int shade, int shape)
 int Terminal::UpdateAll()
 {
     FnTrace("Terminal::UpdateAll()");
+    display.Updated();
     WInt8(TERM_UPDATEALL);
     return SendNow();
 }
@@ -4447,6 +4802,7 @@ int Terminal::UpdateArea(int x, int y, int w, int h)
     if (w <= 0 || h <= 0)
         return 0;
 
+    display.Updated(x, y, w, h);
     WInt8(TERM_UPDATEAREA);
     WInt16(x);
     WInt16(y);
@@ -4458,6 +4814,7 @@ int Terminal::UpdateArea(int x, int y, int w, int h)
 int Terminal::SetClip(int x, int y, int w, int h)
 {
     FnTrace("Terminal::SetClip()");
+    display.Clip(x, y, w, h);
     WInt8(TERM_SETCLIP);
     WInt16(x);
     WInt16(y);
@@ -4826,25 +5183,71 @@ int Terminal::Send()
     if (buffer_out->size <= buffer_out->send_size)
         return 0;
 
-    return buffer_out->Write(socket_no);
+    return Broadcast();
 }
 
 /****
- * SendNow:  Returns the result of a final write(), so -1 on error,
- *  number of bytes written otherwise.
+ * SendNow:  Queues what's buffered for this terminal and its clones.
+ *  Returns -1 if the link has failed, the number of bytes queued
+ *  otherwise (1 with nothing to send).
  ****/
 int Terminal::SendNow()
 {
     FnTrace("Terminal::SendNow()");
-    Terminal *currterm = clone_list.Head();
+    if (buffer_out == nullptr || buffer_out->size <= 0)
+        return 1;
 
-    while (currterm != nullptr)
-    {
-        buffer_out->Write(currterm->socket_no, 0);
-        currterm = currterm->next;
-    }
+    return Broadcast();
+}
+
+/****
+ * Broadcast:  Frames what's buffered once and queues that one frame
+ *  for each clone and this terminal.  Each queue holds a reference, not
+ *  a copy, and a slow clone holds up nobody but itself.  Returns as
+ *  Output() does for this terminal.
+ ****/
+int Terminal::Broadcast()
+{
+    FnTrace("Terminal::Broadcast()");
+    if (buffer_out == render_queue.get())
+        return 0;  // rendering a page for the display list; SendPage() sends it
+
+    auto bytes = std::make_shared<std::vector<Uchar>>();
+    buffer_out->Frame(*bytes);
+    buffer_out->Clear();
+    framed_bytes += bytes->size();
+    const LinkFrame frame = std::move(bytes);
+
+    for (Terminal *currterm = clone_list.Head(); currterm != nullptr; currterm = currterm->next)
+        currterm->Output(frame, redrawing);
 
-    return buffer_out->Write(socket_no);
+    return Output(frame, redrawing);
+}
+
+/****
+ * Output:  Queues a frame for this terminal's vt_term and writes what
+ *  the socket takes now; the output poll writes the rest as the socket
+ *  drains.  Returns the payload size, or -1 if the link has failed.
+ ****/
+int Terminal::Output(LinkFrame frame, int redraw)
+{
+    FnTrace("Terminal::Output()");
+    const int bytes = static_cast<int>(frame->size()) - 4;
+    const bool was_behind = output.Behind();
+    const bool was_failed = output.Failed();
+    const int result = output.Add(std::move(frame), redraw);
+    WatchOutput(this, result, was_behind, was_failed);
+    return (result < 0) ? -1 : bytes;
+}
+
+int Terminal::FlushOutput()
+{
+    FnTrace("Terminal::FlushOutput()");
+    const bool was_behind = output.Behind();
+    const bool was_failed = output.Failed();
+    const int result = output.Flush();
+    WatchOutput(this, result, was_behind, was_failed);
+    return result;
 }
 
 #define MOVE_RIGHT  5
@@ -7430,6 +7833,8 @@ Terminal* NewTerminal(const genericChar* hostname, int hardware_type, int isserv
     {
         term = new Terminal;
         term->socket_no = socket_no;
+        fcntl(socket_no, F_SETFL, fcntl(socket_no, F_GETFL, 0) | O_NONBLOCK);
+        term->output.SetSocket(socket_no);
         term->buffer_in  = new CharQueue(QUEUE_SIZE);
         term->buffer_out = new CharQueue(QUEUE_SIZE);
         term->host.Set(hostname);
@@ -7454,12 +7859,30 @@ int CloneTerminal(Terminal *term, const char* dest, const char* name)
         new_term->buffer_in = nullptr;
         new_term->buffer_out = nullptr;
         new_term->host.Set(name);
+
+        // the clone is fed the primary's output, so it has to switch to
+        // the primary's encoding before the first shared frame arrives
+        if (term->buffer_out &&
+            (term->buffer_out->Encoding() != LINK_ENCODING_TAGGED || term->buffer_out->Flags() != 0))
+        {
+            CharQueue link(16);
+            link.Put8(TERM_LINKSWITCH);
+            link.Put8(term->buffer_out->Encoding());
+            link.Put8(term->buffer_out->Flags());
+            link.Write(socket_no);
+        }
+        fcntl(socket_no, F_SETFL, fcntl(socket_no, F_GETFL, 0) | O_NONBLOCK);
+        new_term->output.SetSocket(socket_no);
         // Register the clone's socket with the original terminal's
         // input handler. Clones share the primary terminal's input
         // buffer, so TermCB expects the primary `term` as client_data
         // and will map the file descriptor to the correct clone.
         new_term->input_id = AddInputFn((InputFn) TermCB, new_term->socket_no, term);
         term->AddClone(new_term);
+        // the clone has seen nothing yet, so the next redraw goes whole
+        // and it holds no copies of pages
+        term->display.Invalidate();
+        term->display.Forget();
     }
 
     return retval;
@@ -26,6 +26,9 @@
 #include "customer.hh"
 #include "locale.hh"
 #include "utility.hh"
+#include "display_list.hh"
+#include "link_output.hh"
+#include "remote_link.hh"
 
 #include <string>
 #include <memory>
@@ -284,7 +287,6 @@ class Control;
 class Printer;
 class Locale;
 class System;
-class CharQueue;
 class Settings;
 struct BatchItem;
 
@@ -404,6 +406,19 @@ public:
     CharQueue *buffer_in;
     CharQueue *buffer_out;
     int socket_no;
+    int link_encoding;   // LINK_ENCODING_ value vt_term writes in
+    int link_flags;
+    int keeps_pages;     // boolean - vt_term offered LINK_PAGECACHE
+    int link_deflate;    // boolean - TermInfo lets large frames go deflated
+    LinkInbox link_inbox;  // what vt_term sent that isn't a whole frame yet
+    LinkOutput output;   // frames on their way to vt_term
+    int output_watched;  // boolean - socket is in the output poll
+    int redraw_serial;   // full-page redraws sent
+    int redrawing;       // redraw_serial while Draw() sends a redraw, else 0
+    DisplayList display; // what each zone of the page last sent
+    std::unique_ptr<CharQueue> render_queue;  // Draw() renders a page here first
+    int update_cause;    // UPDATE_ message being handled, 0 for none
+    uint64_t framed_bytes;  // bytes Broadcast() has framed for vt_term
     unsigned long input_id = 0;
     unsigned long redraw_id = 0;
     std::mutex redraw_id_mutex;
@@ -477,6 +492,12 @@ public:
     int ClearPageStack();                     // clears stack
     int Draw(int update_flag);
     int Draw(int update_flag, int x, int y, int w, int h);
+    int ShowPage(int update_flag, int no_parent, int force_whole);  // Renders and sends the page
+    int RenderPage(int update_flag, int no_parent = 0);  // Renders the page into render_queue
+    int SendPage(int force_whole);            // Sends render_queue whole or its changes
+    int PageSlots();                          // Page copies vt_term on every link can keep
+    void BeginItem(int kind, const void *key, const RegionInfo &area);
+    void EndItem();                           // Bracket a zone's commands in the display list
     int Jump(int jump_type, int jump_id = 0); // Standard jump function
     int JumpToIndex(int period);              // Jumps to index for current page
     int NextTablePage();
@@ -660,6 +681,10 @@ public:
     genericChar* RStr(Str *s);
     int   Send();
     int   SendNow();
+    int   Broadcast();
+    int   Emit(std::span<const Uchar> bytes);
+    int   Output(LinkFrame frame, int redraw);
+    int   FlushOutput();
 
     Settings *GetSettings();
 
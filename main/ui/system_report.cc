@@ -40,6 +40,7 @@
 #include <cstring>
 #include <iostream>
 #include <algorithm>
+#include <vector>
 
 #ifdef DMALLOC
 #include <dmalloc.h>
@@ -187,7 +188,85 @@ int System::ServerReport(Terminal *term, TimeInfo &time_start,
         if (thisArchive == nullptr)
             ptrReport->update_flag |= UPDATE_MINUTE;
 
-        Check *thisCheck = FirstCheck(thisArchive);
+        // saved archives are scanned by column
+        const SalesFacts *facts = thisArchive ? thisArchive->Facts(s) : nullptr;
+        if (facts)
+        {
+            const SalesFacts::CheckColumns    &fc = facts->checks;
+            const SalesFacts::SubCheckColumns &fs = facts->subchecks;
+            const int64_t start_key = SalesFactTime(time_start);
+            const int64_t end_key   = SalesFactTime(end);
+            std::vector<char> closed_in_range(facts->CheckCount(), 0);
+            for (std::size_t row = 0; row < facts->CheckCount(); ++row)
+            {
+                const int flags = fc.flags[row];
+                const bool everyone = (user_id == 0 && (flags & FACT_TRAINING) == 0);
+                if ((everyone || fc.user_open[row] == user_id) &&
+                    start_key != 0 && fc.time_open[row] != 0 &&
+                    fc.time_open[row] >= start_key && fc.time_open[row] < end_key &&
+                    (flags & FACT_TAKEOUT) == 0)
+                {
+                    ++opened;
+                }
+
+                const int sale_user = (s->sale_credit == 0) ? fc.user_owner[row] : fc.user_open[row];
+                if (start_key != 0 && fc.time_closed[row] != 0 &&
+                    fc.time_closed[row] >= start_key && fc.time_closed[row] < end_key &&
+                    (everyone || sale_user == user_id))
+                {
+                    closed_in_range[row] = 1;
+                    if (flags & FACT_TAKEOUT)
+                        ++takeouts;
+                    else if (flags & FACT_FASTFOOD)
+                        ++fastfood;
+                    else
+                    {
+                        guests += fc.guests[row];
+                        ++closed;
+                    }
+                }
+            }
+
+            for (std::size_t row = 0; row < facts->SubCheckCount(); ++row)
+            {
+                const int32_t check_row = fs.check[row];
+                if (!closed_in_range[check_row])
+                    continue;
+                const int flags = fc.flags[check_row];
+                if (flags & FACT_TAKEOUT)
+                    takeout_sales += fs.total_sales[row];
+                else if (flags & FACT_FASTFOOD)
+                    fastfood_sales += fs.total_sales[row];
+                else
+                    sitdown_sales += fs.total_sales[row];
+                captured_tip += fs.tip[row];
+            }
+        }
+
+        // so is the current day, when the range holds all of it
+        const LiveTotals::ServerTally *live = nullptr;
+        bool use_live = false;
+        if (thisArchive == nullptr &&
+            live_totals.sale_credit == s->sale_credit &&
+            live_totals.Covers(SalesFactTime(time_start), SalesFactTime(end)))
+        {
+            use_live = true;
+            live = (user_id == 0) ? &live_totals.Current().everyone : live_totals.FindServer(user_id);
+        }
+        if (live)
+        {
+            opened         += live->opened;
+            closed         += live->closed;
+            guests         += live->guests;
+            takeouts       += live->takeouts;
+            fastfood       += live->fastfood;
+            sitdown_sales  += live->sitdown_sales;
+            takeout_sales  += live->takeout_sales;
+            fastfood_sales += live->fastfood_sales;
+            captured_tip   += live->captured_tip;
+        }
+
+        Check *thisCheck = (facts || use_live) ? nullptr : FirstCheck(thisArchive);
         while (thisCheck)
         {
             if (((user_id == 0 && thisCheck->IsTraining() == 0) ||
@@ -1363,6 +1442,77 @@ public:
     }
 };
 
+// adds a goodwill payment to the balance report's media lists
+void AddBalanceMedia(BRData *brdata, Settings *settings, int tender_type, int tender_id, int value)
+{
+    CompInfo *compinfo;
+    DiscountInfo *discinfo;
+    CouponInfo *coupinfo;
+    MealInfo *mealinfo;
+
+    switch (tender_type)
+    {
+    case TENDER_COMP:
+        compinfo = nullptr;
+        if (brdata->archive)
+            compinfo = brdata->archive->FindCompByID(tender_id);
+        else
+            compinfo = settings->FindCompByID(tender_id);
+        if (compinfo)
+            brdata->complist.Add(compinfo->name.Value(), value);
+        break;
+    case TENDER_EMPLOYEE_MEAL:
+        mealinfo = nullptr;
+        if (brdata->archive)
+            mealinfo = brdata->archive->FindMealByID(tender_id);
+        else
+            mealinfo = settings->FindMealByID(tender_id);
+        if (mealinfo)
+            brdata->meallist.Add(mealinfo->name.Value(), value);
+        break;
+    case TENDER_DISCOUNT:
+        discinfo = nullptr;
+        if (brdata->archive)
+            discinfo = brdata->archive->FindDiscountByID(tender_id);
+        else
+            discinfo = settings->FindDiscountByID(tender_id);
+        if (discinfo)
+            brdata->discountlist.Add(discinfo->name.Value(), value);
+        break;
+    case TENDER_COUPON:
+        coupinfo = nullptr;
+        if (brdata->archive)
+            coupinfo = brdata->archive->FindCouponByID(tender_id);
+        else
+            coupinfo = settings->FindCouponByID(tender_id);
+        if (coupinfo)
+            brdata->couponlist.Add(coupinfo->name.Value(), value);
+        break;
+    }
+}
+
+// adds the current day's running totals, in place of walking its checks
+void AddBalanceLive(BRData *brdata, Settings *settings, const LiveTotals::SalesTally &live)
+{
+    brdata->guests         += live.guests;
+    brdata->takeout        += live.takeouts;
+    brdata->fastfood       += live.fastfood;
+    brdata->takeout_sales  += live.takeout_sales;
+    brdata->fastfood_sales += live.fastfood_sales;
+    brdata->item_comp      += live.item_comps;
+    for (const auto &[family, tally] : live.families)
+    {
+        brdata->sales += tally.amount;
+        if (family == FAMILY_UNKNOWN)
+            continue;
+        const int sg = settings->family_group[family];
+        if (sg >= SALESGROUP_FOOD && sg <= SALESGROUP_ROOM)
+            brdata->group_sales[sg] += tally.amount;
+    }
+    for (const auto &[tender, tally] : live.tenders)
+        AddBalanceMedia(brdata, settings, tender.first, tender.second, tally.amount);
+}
+
 int BalanceReportWorkFn(BRData *brdata)
 {
     FnTrace("BalanceReportWorkFn()");
@@ -1421,6 +1571,14 @@ int BalanceReportWorkFn(BRData *brdata)
         brdata->lastArchive = brdata->archive;
     }
 
+    // the current day is already tallied, when the range holds all of it
+    if (brdata->archive == nullptr &&
+        sys->live_totals.Covers(SalesFactTime(brdata->start), SalesFactTime(brdata->end)))
+    {
+        AddBalanceLive(brdata, currSettings, sys->live_totals.Current().sales);
+        c = nullptr;
+    }
+
     while (c)
     {
         if (c->IsTraining() == 0)
@@ -1452,54 +1610,9 @@ int BalanceReportWorkFn(BRData *brdata)
                     if (c->IsFastFood())
                         brdata->fastfood_sales += x;
 
-                    CompInfo *compinfo;
-                    DiscountInfo *discinfo;
-                    CouponInfo *coupinfo;
-                    MealInfo *mealinfo;
-
                     brdata->item_comp += sc->item_comps;
                     for (Payment *p = sc->PaymentList(); p != nullptr; p = p->next)
-                    {
-                        switch (p->tender_type)
-                        {
-                        case TENDER_COMP:
-                            compinfo = nullptr;
-                            if (brdata->archive)
-                                compinfo = brdata->archive->FindCompByID(p->tender_id);
-                            else
-                                compinfo = currSettings->FindCompByID(p->tender_id);
-                            if (compinfo)
-                                brdata->complist.Add(compinfo->name.Value(), p->value);
-                            break;
-                        case TENDER_EMPLOYEE_MEAL:
-                            mealinfo = nullptr;
-                            if (brdata->archive)
-                                mealinfo = brdata->archive->FindMealByID(p->tender_id);
-                            else
-                                mealinfo = currSettings->FindMealByID(p->tender_id);
-                            if (mealinfo)
-                                brdata->meallist.Add(mealinfo->name.Value(), p->value);
-                            break;
-                        case TENDER_DISCOUNT:
-                            discinfo = nullptr;
-                            if (brdata->archive)
-                                discinfo = brdata->archive->FindDiscountByID(p->tender_id);
-                            else
-                                discinfo = currSettings->FindDiscountByID(p->tender_id);
-                            if (discinfo)
-                                brdata->discountlist.Add(discinfo->name.Value(), p->value);
-                            break;
-                        case TENDER_COUPON:
-                            coupinfo = nullptr;
-                            if (brdata->archive)
-                                coupinfo = brdata->archive->FindCouponByID(p->tender_id);
-                            else
-                                coupinfo = currSettings->FindCouponByID(p->tender_id);
-                            if (coupinfo)
-                                brdata->couponlist.Add(coupinfo->name.Value(), p->value);
-                            break;
-                        }
-                    }
+                        AddBalanceMedia(brdata, currSettings, p->tender_type, p->tender_id, p->value);
                 }
             }
         }
@@ -3780,8 +3893,12 @@ int System::ExpenseReport(Terminal *term, TimeInfo &start_time, TimeInfo &end_ti
 
         while ((currArchive != nullptr) && (currArchive->end_time <= end_time))
         {
-            if (currArchive->loaded == 0)
+            // an archive left unloaded has no expenses to walk
+            if (currArchive->loaded == 0 &&
+                currArchive->MayHoldExpensesBetween(term->GetSettings(), start_time, end_time))
+            {
                 currArchive->LoadPacked(term->GetSettings());
+            }
             expense = currArchive->expense_db.ExpenseList();
             while (expense != nullptr)
             {
@@ -3993,12 +4110,17 @@ int RoyaltyReportWorkFn(RoyaltyData *rdata)
     {
         if (archive)
         {
-            // add this archive to the report
-            if (archive->loaded == 0)
-                archive->LoadPacked(rdata->settings);
-
-            currCheck = archive->CheckList();
-            currCoupon = archive->CouponList();
+            // add this archive to the report unless its index shows
+            // nothing settled in the range or no check opened in it
+            if (archive->MaySettleBetween(rdata->settings, rdata->start_time, rdata->end_time) &&
+                (archive->loaded ||
+                 !archive->FindCheckEntries(rdata->settings, rdata->start_time, rdata->end_time).empty()))
+            {
+                if (archive->loaded == 0)
+                    archive->LoadPacked(rdata->settings);
+                currCheck = archive->CheckList();
+                currCoupon = archive->CouponList();
+            }
         }
         else if (SystemTime < rdata->end_time)
         {
@@ -4017,71 +4139,64 @@ int RoyaltyReportWorkFn(RoyaltyData *rdata)
             currCoupon = currCoupon->next;
         }
 
-        // Check if there are no checks to process
-        if (currCheck == nullptr)
+        // an archive skipped above (or one without checks) adds nothing,
+        // but the archives after it still count
+        while (currCheck != nullptr)
         {
-            // No checks to process, mark as done and continue to archive processing
-            rdata->done = 1;
-        }
-        else
-        {
-            while (currCheck != nullptr)
+            if ((currCheck->IsTraining() == 0) &&
+                (currCheck->time_open >= rdata->start_time) &&
+                (currCheck->time_open < rdata->end_time))
             {
-                if ((currCheck->IsTraining() == 0) &&
-                    (currCheck->time_open >= rdata->start_time) &&
-                    (currCheck->time_open < rdata->end_time))
+                guests_counted = 0;
+                currSubcheck = currCheck->SubList();
+                while (currSubcheck != nullptr)
                 {
-                    guests_counted = 0;
-                    currSubcheck = currCheck->SubList();
-                    while (currSubcheck != nullptr)
+                    if (currSubcheck->settle_time.IsSet() &&
+                        currSubcheck->settle_time > rdata->start_time &&
+                        currSubcheck->settle_time < rdata->end_time &&
+                        (archive == nullptr ||
+                         (currSubcheck->settle_time >= archive->start_time &&
+                          currSubcheck->settle_time <= archive->end_time)))
                     {
-                        if (currSubcheck->settle_time.IsSet() &&
-                            currSubcheck->settle_time > rdata->start_time &&
-                            currSubcheck->settle_time < rdata->end_time &&
-                            (archive == nullptr ||
-                             (currSubcheck->settle_time >= archive->start_time &&
-                              currSubcheck->settle_time <= archive->end_time)))
+                        // Calculate day index from settlement time, not opening time
+                        day = currSubcheck->settle_time.Day() - 1;  // day is an index, start at 0
+                        if (day < rdata->maxdays)
                         {
-                            // Calculate day index from settlement time, not opening time
-                            day = currSubcheck->settle_time.Day() - 1;  // day is an index, start at 0
-                            if (day < rdata->maxdays)
+                            currSubcheck->FigureTotals(rdata->settings);
+                            if (guests_counted == 0)
                             {
-                                currSubcheck->FigureTotals(rdata->settings);
-                                if (guests_counted == 0)
+                                if (currCheck->IsTakeOut() || currCheck->IsFastFood())
                                 {
-                                    if (currCheck->IsTakeOut() || currCheck->IsFastFood())
-                                    {
-                                        rdata->customers[day] += 1;
-                                        rdata->total_guests += 1;
-                                    }
-                                    else
-                                    {
-                                        rdata->customers[day] += currCheck->Guests();
-                                        rdata->total_guests += currCheck->Guests();
-                                    }
-                                    guests_counted = 1;
+                                    rdata->customers[day] += 1;
+                                    rdata->total_guests += 1;
                                 }
-                                rdata->sales[day] += currSubcheck->total_sales;
-                                rdata->total_sales += currSubcheck->total_sales;
-                                // now check vouchers
-                                currVoucher = voucher_list.Head();
-                                while (currVoucher != nullptr)
+                                else
                                 {
-                                    vouchers = currSubcheck->TotalPayment(currVoucher->type, currVoucher->id);
-                                    if (vouchers)
-                                    {
-                                        rdata->total_vouchers += 1;
-                                        rdata->total_voucher_amt += vouchers;
-                                    }
-                                    currVoucher = currVoucher->next;
+                                    rdata->customers[day] += currCheck->Guests();
+                                    rdata->total_guests += currCheck->Guests();
+                                }
+                                guests_counted = 1;
+                            }
+                            rdata->sales[day] += currSubcheck->total_sales;
+                            rdata->total_sales += currSubcheck->total_sales;
+                            // now check vouchers
+                            currVoucher = voucher_list.Head();
+                            while (currVoucher != nullptr)
+                            {
+                                vouchers = currSubcheck->TotalPayment(currVoucher->type, currVoucher->id);
+                                if (vouchers)
+                                {
+                                    rdata->total_vouchers += 1;
+                                    rdata->total_voucher_amt += vouchers;
                                 }
+                                currVoucher = currVoucher->next;
                             }
                         }
-                        currSubcheck = currSubcheck->next;
                     }
+                    currSubcheck = currSubcheck->next;
                 }
-                currCheck = currCheck->next;
             }
+            currCheck = currCheck->next;
         }
         voucher_list.Purge();  // always clean the voucher list
 
@@ -4486,10 +4601,14 @@ int GatherAuditChecks(AuditingData *adata)
 
     if (archive)
     {
-        // add this archive to the report
-        if (archive->loaded == 0)
-            archive->LoadPacked(settings);
-        check     = archive->CheckList();
+        // add this archive to the report unless its index shows nothing
+        // settled in the range
+        if (archive->MaySettleBetween(settings, adata->start_time, adata->end_time))
+        {
+            if (archive->loaded == 0)
+                archive->LoadPacked(settings);
+            check = archive->CheckList();
+        }
     }
     else
     {
@@ -5093,10 +5212,16 @@ int CreditCardReportWorkFn(CCData *ccdata)
     {
         if (archive)
         {
-            // add this archive to the report
-            if (archive->loaded == 0)
-                archive->LoadPacked(settings);
-            check     = archive->CheckList();
+            // add this archive to the report unless its index shows
+            // no card payments or nothing settled in the range
+            const ArchiveSummary *sum = archive->Summary(settings);
+            if ((sum == nullptr || sum->card_payments > 0) &&
+                archive->MaySettleBetween(settings, ccdata->start_time, ccdata->end_time))
+            {
+                if (archive->loaded == 0)
+                    archive->LoadPacked(settings);
+                check = archive->CheckList();
+            }
         }
         else
         {
@@ -48,6 +48,7 @@ public:
     // ordered list by item name
     std::map<std::string, ItemCount> itemlist;
     int AddCount(Order *item);
+    int AddCount(const ItemCount &newitem, int cost, int item_cost);
     bool empty() { return itemlist.empty(); }
 };
 class ItemCount
@@ -64,9 +65,15 @@ public:
     int type = 0;
 
     ItemCount(Order *o);
+    ItemCount(const std::string &item_name, int item_family, int item_cost,
+              int item_count, int item_type);
     ItemCount();
 
     int AddCount(Order *o);
+
+private:
+    void Set(const std::string &item_name, int item_family, int item_cost,
+             int item_count, int item_type);
 };
 
 
@@ -86,6 +93,8 @@ public:
     ItemCount *SearchBranch(ItemCount *ic, const std::string &name, int cost, int family);
     int CountOrder(Order *o);
     int CountOrderNoFamily(Order *o);
+    int CountFact(const SalesFacts &facts, std::size_t row, int show_family);
+    int CountLive(const LiveTotals::ItemKey &key, const LiveTotals::ItemTally &item, int show_family);
     
     int Add(ItemCount *ic)
         {
@@ -115,13 +124,19 @@ public:
 int ItemCountList::AddCount(Order *item)
 {
     FnTrace("ItemCountList::AddCount()");
+    return AddCount(ItemCount(item), item->cost, item->item_cost);
+}
 
-    ItemCount newitem(item);
+int ItemCountList::AddCount(const ItemCount &newitem, int cost, int item_cost)
+{
+    FnTrace("ItemCountList::AddCount(ItemCount)");
 
     if (itemlist.find(newitem.name) == itemlist.end())
     {
-        // new item, just insert it
-        itemlist.insert(std::make_pair(newitem.name, newitem));
+        // new item, counted the same way (see below)
+        ItemCount &added = itemlist.insert(std::make_pair(newitem.name, newitem)).first->second;
+        if (item_cost > 0)
+            added.count = cost / item_cost;
     } else
     {
         // update existing item
@@ -130,7 +145,7 @@ int ItemCountList::AddCount(Order *item)
         // always be 1.  But item->cost is item->item_cost
         // multiplied by the original count.  So we divide
         // item->cost by item->item_cost to get the correct count.
-        int item_count = item->cost / item->item_cost;
+        int item_count = (item_cost > 0) ? cost / item_cost : newitem.count;
         old_item.count += item_count;
     }
 
@@ -145,18 +160,7 @@ ItemCount::ItemCount(Order *o)
 {
     FnTrace("ItemCount::ItemCount(Order)");
     if (o)
-    {
-        // trim leading '.' characters
-        std::string oname = o->item_name.str();
-        oname.erase(oname.begin(), std::find_if(oname.begin(), oname.end(),
-                     [](const char c) {return c != '.';}));
-
-        name      = oname;
-        family    = o->item_family;
-        cost      = o->item_cost;
-        count     = o->count;
-        type      = o->item_type;
-    }
+        Set(o->item_name.str(), o->item_family, o->item_cost, o->count, o->item_type);
     else
     {
         name = UnknownStr;
@@ -164,6 +168,28 @@ ItemCount::ItemCount(Order *o)
     }
 }
 
+ItemCount::ItemCount(const std::string &item_name, int item_family, int item_cost,
+                     int item_count, int item_type)
+{
+    FnTrace("ItemCount::ItemCount(values)");
+    Set(item_name, item_family, item_cost, item_count, item_type);
+}
+
+void ItemCount::Set(const std::string &item_name, int item_family, int item_cost,
+                    int item_count, int item_type)
+{
+    // trim leading '.' characters
+    std::string oname = item_name;
+    oname.erase(oname.begin(), std::find_if(oname.begin(), oname.end(),
+                 [](const char c) {return c != '.';}));
+
+    name      = oname;
+    family    = static_cast<uint8_t>(item_family);
+    cost      = item_cost;
+    count     = item_count;
+    type      = item_type;
+}
+
 ItemCount::ItemCount()
 {
     FnTrace("ItemCount::ItemCount()");
@@ -338,6 +364,81 @@ int ItemCountTree::CountOrderNoFamily(Order *o)
     return 0;
 }
 
+/****
+ * CountFact:  CountOrder() (or CountOrderNoFamily()) for the order in
+ *  row of an archive's sales facts.  The costs there were figured when
+ *  the facts were built.
+ ****/
+int ItemCountTree::CountFact(const SalesFacts &facts, std::size_t row, int show_family)
+{
+    FnTrace("ItemCountTree::CountFact()");
+    const SalesFacts::OrderColumns &o = facts.orders;
+    if ((o.qualifier[row] & QUALIFIER_NO) || o.count[row] == 0)
+        return 0;
+
+    const std::string &item_name = facts.String(o.name[row]);
+    ItemCount *ic = show_family ? Find(item_name, o.item_cost[row], o.family[row])
+                                : Find(item_name, o.item_cost[row]);
+    if (ic)
+        ic->count += o.count[row];
+    else
+    {
+        ic = new ItemCount(item_name, o.family[row], o.item_cost[row], o.count[row],
+                           o.item_type[row]);
+        Add(ic);
+    }
+
+    // the order's modifiers follow it, ahead of the next order
+    const std::size_t rows = facts.OrderCount();
+    for (std::size_t mod = row + 1; mod < rows && o.parent[mod] >= 0; ++mod)
+    {
+        if (o.parent[mod] != static_cast<int32_t>(row))
+            continue;
+        const int figured = show_family ? o.total_cost[mod] : o.cost[mod];
+        if (figured > 0)
+        {
+            ic->mods.AddCount(ItemCount(facts.String(o.name[mod]), o.family[mod],
+                                        o.item_cost[mod], o.count[mod], o.item_type[mod]),
+                              o.cost[mod], o.item_cost[mod]);
+        }
+    }
+
+    return 0;
+}
+
+/****
+ * CountLive:  CountOrder() (or CountOrderNoFamily()) for the orders of
+ *  the current day gathered under one item in System::live_totals
+ ****/
+int ItemCountTree::CountLive(const LiveTotals::ItemKey &key, const LiveTotals::ItemTally &item, int show_family)
+{
+    FnTrace("ItemCountTree::CountLive()");
+    const auto &[item_name, item_cost, family] = key;
+    if (item.counted.count == 0)
+        return 0;
+
+    ItemCount *ic = show_family ? Find(item_name, item_cost, family) : Find(item_name, item_cost);
+    if (ic)
+        ic->count += item.counted.amount;
+    else
+    {
+        ic = new ItemCount(item_name, family, item_cost, item.counted.amount, item.type);
+        Add(ic);
+    }
+
+    for (const auto &[mod_key, modifier] : item.modifiers)
+    {
+        const LiveTotals::Tally &units = show_family ? modifier.figured : modifier.priced;
+        if (units.count == 0)
+            continue;
+        const auto &[mod_name, mod_cost] = mod_key;
+        ic->mods.AddCount(ItemCount(mod_name, family, mod_cost, units.amount, item.type),
+                          units.amount * mod_cost, mod_cost);
+    }
+
+    return 0;
+}
+
 
 #define COUNT_POS  (-11)
 #define WEIGHT_POS (-17)
@@ -489,9 +590,52 @@ int System::SalesMixReport(Terminal *t, const TimeInfo &start_time, const TimeIn
     Settings *s = &settings;
     ItemCountTree tree;
     Archive *a = FindByTime(start_time);
+    const int64_t start_key = SalesFactTime(start_time);
+    const int64_t end_key   = SalesFactTime(end);
     for (;;)
     {
-        for (Check *c = FirstCheck(a); c != nullptr; c = c->next)
+        // saved archives are scanned by column
+        const SalesFacts *facts = a ? a->Facts(s) : nullptr;
+        if (facts)
+        {
+            const SalesFacts::CheckColumns    &fc = facts->checks;
+            const SalesFacts::SubCheckColumns &fs = facts->subchecks;
+            const SalesFacts::OrderColumns    &fo = facts->orders;
+            for (std::size_t row = 0; row < facts->OrderCount(); ++row)
+            {
+                if (fo.parent[row] >= 0)
+                    continue;
+                const int32_t sub = fo.sub[row];
+                const int32_t check = fs.check[sub];
+                const int64_t settle = fs.settle_time[sub];
+                const int sale_user = (s->sale_credit == 0) ? fc.user_owner[check]
+                                                            : fc.user_open[check];
+                if ((fc.flags[check] & FACT_TRAINING) == 0 &&
+                    (user_id == 0 || user_id == sale_user) &&
+                    settle != 0 && start_key != 0 &&
+                    settle < end_key && settle > start_key)
+                {
+                    tree.CountFact(*facts, row, show_family);
+                }
+            }
+        }
+
+        // and the current day is tallied, when the range holds all of it
+        const bool use_live = (a == nullptr && start_key != 0 &&
+                               live_totals.sale_credit == s->sale_credit &&
+                               live_totals.Covers(start_key + 1, end_key));
+        if (use_live)
+        {
+            for (const auto &[sale_user, items] : live_totals.Current().items)
+            {
+                if (user_id != 0 && user_id != sale_user)
+                    continue;
+                for (const auto &[key, item] : items)
+                    tree.CountLive(key, item, show_family);
+            }
+        }
+
+        for (Check *c = (facts || use_live) ? nullptr : FirstCheck(a); c != nullptr; c = c->next)
         {
             if ((c->IsTraining() == 0) && (user_id == 0 || user_id == c->WhoGetsSale(s)))
             {
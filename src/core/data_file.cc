@@ -24,24 +24,37 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
 #include <cctype>
 #include <cerrno>
 #include <charconv>
+#include <chrono>
 #include <climits>
+#include <condition_variable>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <fcntl.h>
 #include <fstream>
 #include <iostream>
 #include <limits>
+#include <mutex>
 #include <optional>
 #include <string_view>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/uio.h>
+#include <thread>
 #include <unistd.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #ifdef DMALLOC
 #include <dmalloc.h>
 #endif
@@ -123,14 +136,674 @@ inline void put_character(gzFile gz_fp, std::FILE* file_fp, bool compress, char
     }
 }
 
-inline bool is_space(int ch) noexcept
+// The "C" locale whitespace set; data files are locale independent.
+constexpr bool is_space(int ch) noexcept
+{
+    return ch == ' ' || (ch >= '\t' && ch <= '\r');
+}
+
+// Returns the first whitespace character in [pos, end), or end.  Every
+// whitespace byte is <= 0x20, so the vector loops flag candidates with
+// one unsigned compare per 16 bytes and leave the exact test to is_space().
+[[nodiscard]] inline const char* find_space(const char* pos, const char* end) noexcept
+{
+#if defined(__SSE2__)
+    const __m128i limit = _mm_set1_epi8(0x20);
+    while (end - pos >= 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+        auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(chunk, limit), chunk)));
+        while (mask != 0)
+        {
+            const int idx = std::countr_zero(mask);
+            if (is_space(pos[idx]))
+                return pos + idx;
+            mask &= mask - 1;
+        }
+        pos += 16;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t limit = vdupq_n_u8(0x20);
+    while (end - pos >= 16)
+    {
+        const uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t*>(pos));
+        if (vmaxvq_u8(vcleq_u8(chunk, limit)) != 0)
+            break;  // candidate in this chunk; the scalar loop finds it
+        pos += 16;
+    }
+#endif
+    while (pos < end && !is_space(*pos))
+        ++pos;
+    return pos;
+}
+
+// strtod() wants a terminated string; tokens are views into the buffer.
+[[nodiscard]] bool parse_real(std::string_view token, double &value)
+{
+    std::array<char, 64> small{};
+    std::string large;
+    const char* text = small.data();
+    if (token.size() < small.size())
+        std::memcpy(small.data(), token.data(), token.size());
+    else
+        text = (large = token).c_str();
+
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtod(text, &end);
+    return text != end && errno != ERANGE;
+}
+
+/*********************************************************************
+ * Binary format
+ *
+ *   file header:  7f 'V' 'T' 'B' | revision u8 | flags u8 | 2 reserved
+ *                 | version u32le
+ *   block:        raw length u32le | stored length u32le | codec u8
+ *                 | stored bytes (codec 0 = raw, 1 = zlib)
+ *   field:        tag u8 (type in bits 0-2, line break in bit 3)
+ *                 Integer: zig-zag varint
+ *                 Real:    IEEE double, u64le
+ *                 String/Token: varint length | bytes
+ *
+ * Fields never straddle blocks, so a reader only ever parses from the
+ * block it has in memory.
+ ********************************************************************/
+constexpr std::array<unsigned char, 4> kBinaryMagic = {0x7F, 'V', 'T', 'B'};
+constexpr unsigned char kBinaryRevision   = 1;
+constexpr std::size_t   kBinaryHeaderSize = 12;
+constexpr std::size_t   kBlockHeaderSize  = 9;
+constexpr uint32_t      kMaxBlockSize     = 64U * 1024U * 1024U;  // sanity limit
+constexpr unsigned char kCodecRaw         = 0;
+constexpr unsigned char kCodecZlib        = 1;
+constexpr unsigned char kFieldTypeMask    = 0x07;
+constexpr unsigned char kFieldBreak       = 0x08;
+constexpr std::size_t   kMaxVarintSize    = 10;
+
+// archives default to binary, where a position found through their
+// index reads back one block (see InputDataFile::Seek())
+std::array<DataFileFormat, static_cast<std::size_t>(DataFileKind::Count)> data_file_formats{
+    DataFileFormat::Text,    // Generic
+    DataFileFormat::Text,    // Check
+    DataFileFormat::Text,    // Drawer
+    DataFileFormat::Binary,  // Archive
+    DataFileFormat::Text     // Settings
+};
+
+/*********************************************************************
+ * Group commit
+ *
+ * In DataFileSync::Group mode a closed file waits here, still under its
+ * temp name, until DataFileGroupCommit() syncs the whole batch (one
+ * syncfs() per filesystem on Linux), renames each file in save order
+ * and syncs each directory once.
+ ********************************************************************/
+constexpr std::size_t kMaxGroupFiles = 64;  // commit early past this many
+
+struct GroupEntry
+{
+    int         fd;         // open descriptor of the temp file
+    std::string temp_path;
+    std::string path;
+};
+
+// set on the main thread, read by every thread that opens a file
+std::atomic<DataFileSync> data_file_sync{DataFileSync::Direct};
+std::mutex group_mutex;
+std::vector<GroupEntry> group_pending;
+
+[[nodiscard]] std::string parent_dir(const std::string &path)
+{
+    const auto slash = path.rfind('/');
+    if (slash == std::string::npos)
+        return ".";
+    return (slash == 0) ? "/" : path.substr(0, slash);
+}
+
+int sync_directory(const std::string &dir) noexcept
+{
+    const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    const int result = fsync(fd);
+    ::close(fd);
+    return result;
+}
+
+inline void put_u32(unsigned char* out, uint32_t val) noexcept
+{
+    for (int i = 0; i < 4; ++i)
+        out[i] = static_cast<unsigned char>(val >> (8 * i));
+}
+
+[[nodiscard]] inline uint32_t get_u32(const unsigned char* in) noexcept
+{
+    uint32_t val = 0;
+    for (int i = 0; i < 4; ++i)
+        val |= static_cast<uint32_t>(in[i]) << (8 * i);
+    return val;
+}
+
+inline void put_varint(std::vector<unsigned char> &out, uint64_t val)
+{
+    while (val >= 0x80)
+    {
+        out.push_back(static_cast<unsigned char>(val | 0x80));
+        val >>= 7U;
+    }
+    out.push_back(static_cast<unsigned char>(val));
+}
+
+[[nodiscard]] inline bool get_varint(const unsigned char* &pos, const unsigned char* end, uint64_t &val) noexcept
+{
+    val = 0;
+    for (unsigned shift = 0; pos < end && shift < 64; shift += 7)
+    {
+        const unsigned char byte = *pos++;
+        val |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Values arrive as uint64_t casts of signed and unsigned types alike;
+// zig-zag over the signed view keeps small negatives short and is a
+// bijection, so every value round-trips.
+[[nodiscard]] constexpr uint64_t zigzag_encode(uint64_t val) noexcept
+{
+    return (val << 1U) ^ static_cast<uint64_t>(static_cast<int64_t>(val) >> 63);
+}
+
+[[nodiscard]] constexpr uint64_t zigzag_decode(uint64_t val) noexcept
+{
+    return (val >> 1U) ^ (0 - (val & 1U));
+}
+
+[[nodiscard]] uint64_t decode_token(std::string_view token, bool old_format) noexcept
+{
+    uint64_t value = 0;
+    if (old_format)
+    {
+        const auto& decode = old_decode_table();
+        for (char ch : token)
+            value = (value * kOldBase) + decode[static_cast<unsigned char>(ch)];
+    }
+    else
+    {
+        const auto& decode = new_decode_table();
+        for (char ch : token)
+            value = (value << 6) + decode[static_cast<unsigned char>(ch)];
+    }
+    return value;
+}
+
+// Produces the token the text format would have stored for 'field'.
+void render_token(const DataFileField &field, std::string &out)
+{
+    out.clear();
+    switch (field.type)
+    {
+    case DataFieldType::Integer:
+    {
+        uint64_t val = field.integer;
+        do
+        {
+            out.insert(out.begin(), kNewEncodeDigits[static_cast<std::size_t>(val & 0x3F)]);
+            val >>= 6U;
+        }
+        while (val > 0);
+        break;
+    }
+    case DataFieldType::Real:
+    {
+        std::array<char, 64> buffer{};
+        const auto written = vt::cpp23::format_to_buffer(buffer.data(), buffer.size(), "{}", field.real);
+        out.assign(buffer.data(), std::min(written, buffer.size() - 1));
+        break;
+    }
+    case DataFieldType::String:
+        if (field.text.empty())
+        {
+            out = "~";
+            break;
+        }
+        out.assign(field.text);
+        std::replace(out.begin(), out.end(), '~', '_');
+        std::replace(out.begin(), out.end(), ' ', '_');
+        break;
+    case DataFieldType::Token:
+        out.assign(field.text);
+        break;
+    case DataFieldType::None:
+        break;
+    }
+}
+
+/*********************************************************************
+ * Write-behind queue
+ *
+ * One writer thread takes saves in queue order.  'busy' names the file
+ * it is writing, so a direct save of that file waits for it instead of
+ * having its rename overtaken by the older copy.
+ ********************************************************************/
+struct WriteJob
+{
+    std::string    filename;
+    int            version{0};
+    int            compress{0};
+    DataFileFormat format{DataFileFormat::Text};
+    std::string    body;
+    std::chrono::steady_clock::time_point queued;
+};
+
+struct WriteQueue
+{
+    std::mutex              mutex;
+    std::condition_variable wake;   // jobs queued or stopping
+    std::condition_variable room;   // a job was taken
+    std::condition_variable idle;   // a job was finished
+    std::deque<WriteJob>    jobs;
+    std::string             busy;
+    bool                    stopped{false};
+    bool                    held{false};  // DataFileHoldQueue(), tests only
+    int                     failures{0};  // since the last DataFileFlushQueue()
+    DataFileWriterStats     stats;
+    std::thread             thread;
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+        }
+        wake.notify_all();
+        if (thread.joinable() && thread.get_id() != std::this_thread::get_id())
+            thread.join();
+    }
+    ~WriteQueue() { Stop(); }
+};
+
+WriteQueue &write_queue()
+{
+    static WriteQueue queue;
+    return queue;
+}
+
+thread_local bool in_writer = false;
+
+int write_job(const WriteJob &job)
+{
+    OutputDataFile df;
+    int error = df.Open(job.filename, job.version, job.compress, job.format);
+    if (error == 0)
+        error = df.WriteRaw(job.body);
+    if (df.Close())
+        error = 1;
+    return error;
+}
+
+void writer_main()
+{
+    in_writer = true;
+    WriteQueue &queue = write_queue();
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    for (;;)
+    {
+        queue.wake.wait(lock, [&queue] { return queue.stopped || (!queue.held && !queue.jobs.empty()); });
+        if (queue.jobs.empty())
+            break;  // stopped and drained
+
+        WriteJob job = std::move(queue.jobs.front());
+        queue.jobs.pop_front();
+        queue.busy = job.filename;
+        queue.stats.depth = queue.jobs.size();
+        queue.room.notify_all();
+        lock.unlock();
+
+        const int error = write_job(job);
+        const std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - job.queued;
+
+        lock.lock();
+        queue.busy.clear();
+        if (error)
+        {
+            ReportError("Write-behind save failed for '" + job.filename + "'");
+            ++queue.stats.failed;
+            ++queue.failures;
+        }
+        else
+            ++queue.stats.written;
+        queue.stats.last_ms = latency.count();
+        queue.stats.max_ms = std::max(queue.stats.max_ms, latency.count());
+        queue.idle.notify_all();
+    }
+}
+
+// Takes the queued job for 'filename' out of the queue, once the writer
+// is not writing it.  Returns false if none was queued.
+bool take_queued(const std::string &filename, WriteJob &job)
+{
+    if (in_writer)
+        return false;
+    WriteQueue &queue = write_queue();
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty() && queue.busy.empty())
+        return false;
+    queue.idle.wait(lock, [&queue, &filename] { return queue.busy != filename; });
+    const auto found = std::find_if(queue.jobs.begin(), queue.jobs.end(),
+                                    [&filename](const WriteJob &queued) { return queued.filename == filename; });
+    if (found == queue.jobs.end())
+        return false;
+    job = std::move(*found);
+    queue.jobs.erase(found);
+    queue.stats.depth = queue.jobs.size();
+    queue.room.notify_all();
+    return true;
+}
+
+// A direct save or a delete of 'filename' supersedes a queued one.
+// Returns 1 if one was dropped.
+int drop_queued(const std::string &filename)
+{
+    WriteJob job;
+    return take_queued(filename, job) ? 1 : 0;
+}
+
+// Writes the queued save of 'filename' here rather than waiting for the
+// writer to reach it.
+int write_queued(const std::string &filename)
 {
-    return std::isspace(static_cast<unsigned char>(ch)) != 0;
+    WriteJob job;
+    if (!take_queued(filename, job))
+        return 0;
+    const int error = write_job(job);
+    const std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - job.queued;
+
+    WriteQueue &queue = write_queue();
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (error)
+    {
+        ReportError("Write-behind save failed for '" + job.filename + "'");
+        ++queue.stats.failed;
+        ++queue.failures;
+    }
+    else
+        ++queue.stats.written;
+    queue.stats.last_ms = latency.count();
+    queue.stats.max_ms = std::max(queue.stats.max_ms, latency.count());
+    return error ? 1 : 0;
 }
 
 } // namespace
 
+/*********************************************************************
+ * Data file format selection
+ ********************************************************************/
+
+DataFileFormat DataFileFormatFor(DataFileKind kind) noexcept
+{
+    const auto idx = static_cast<std::size_t>(kind);
+    if (idx >= data_file_formats.size())
+        return DataFileFormat::Text;
+    return data_file_formats[idx];
+}
+
+void SetDataFileFormat(DataFileKind kind, DataFileFormat format) noexcept
+{
+    const auto idx = static_cast<std::size_t>(kind);
+    if (idx < data_file_formats.size())
+        data_file_formats[idx] = format;
+}
+
+DataFileSync GetDataFileSync() noexcept
+{
+    return data_file_sync.load();
+}
+
+void SetDataFileSync(DataFileSync sync)
+{
+    if (data_file_sync.exchange(sync) == DataFileSync::Group && sync != DataFileSync::Group)
+        DataFileGroupCommit();
+}
+
+bool ParseDataFileSync(std::string_view name, DataFileSync &sync) noexcept
+{
+    static constexpr std::array<std::pair<std::string_view, DataFileSync>, 4> names = {{
+        {"direct", DataFileSync::Direct},
+        {"none",   DataFileSync::None},
+        {"file",   DataFileSync::File},
+        {"group",  DataFileSync::Group},
+    }};
+    for (const auto &[key, value] : names)
+    {
+        if (name == key)
+        {
+            sync = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::size_t DataFileGroupPending()
+{
+    std::lock_guard<std::mutex> lock(group_mutex);
+    return group_pending.size();
+}
+
+/****
+ * commit_group:  Syncs and renames entries into place; the caller holds
+ *   group_mutex.  Returns the number of files left at their old state.
+ ****/
+static int commit_group(std::vector<GroupEntry> &entries)
+{
+    std::vector<bool> synced(entries.size(), false);
+#ifdef __linux__
+    std::vector<dev_t> synced_devices;
+#endif
+    for (std::size_t idx = 0; idx < entries.size(); ++idx)
+    {
+        const int fd = entries[idx].fd;
+#ifdef __linux__
+        // one syncfs() per filesystem beats an fsync() per file, but not
+        // for a single file
+        struct stat info{};
+        if (entries.size() > 1 && fstat(fd, &info) == 0)
+        {
+            if (std::find(synced_devices.begin(), synced_devices.end(), info.st_dev) != synced_devices.end())
+            {
+                synced[idx] = true;
+                continue;
+            }
+            if (syncfs(fd) == 0)
+            {
+                synced_devices.push_back(info.st_dev);
+                synced[idx] = true;
+                continue;
+            }
+        }
+#endif
+        synced[idx] = (fsync(fd) == 0);
+    }
+
+    int failed = 0;
+    std::vector<std::string> dirs;
+    for (std::size_t idx = 0; idx < entries.size(); ++idx)
+    {
+        const GroupEntry &entry = entries[idx];
+        ::close(entry.fd);
+        if (!synced[idx] || std::rename(entry.temp_path.c_str(), entry.path.c_str()) != 0)
+        {
+            ReportError("DataFileGroupCommit: keeping old '" + entry.path + "' errno: " + std::to_string(errno));
+            ::unlink(entry.temp_path.c_str());
+            ++failed;
+            continue;
+        }
+        std::string dir = parent_dir(entry.path);
+        if (std::find(dirs.begin(), dirs.end(), dir) == dirs.end())
+            dirs.push_back(std::move(dir));
+    }
+    for (const std::string &dir : dirs)
+        sync_directory(dir);
+    entries.clear();
+    return failed;
+}
+
+int DataFileGroupCommit()
+{
+    FnTrace("DataFileGroupCommit()");
+    std::lock_guard<std::mutex> lock(group_mutex);
+    if (group_pending.empty())
+        return 0;
+    return commit_group(group_pending);
+}
+
+/****
+ * commit_pending:  Commits only the group entries for filename, so a
+ *   reader sees the latest save without syncing the whole batch.
+ ****/
+static int commit_pending(const std::string &filename)
+{
+    std::lock_guard<std::mutex> lock(group_mutex);
+    std::vector<GroupEntry> mine;
+    for (auto entry = group_pending.begin(); entry != group_pending.end();)
+    {
+        if (entry->path == filename)
+        {
+            mine.push_back(std::move(*entry));
+            entry = group_pending.erase(entry);
+        }
+        else
+            ++entry;
+    }
+    return mine.empty() ? 0 : commit_group(mine);
+}
+
+int DataFileSettle(const std::string &filename)
+{
+    FnTrace("DataFileSettle()");
+    int failed = write_queued(filename);
+    failed += commit_pending(filename);
+    return failed;
+}
+
+int DataFileForget(const std::string &filename)
+{
+    FnTrace("DataFileForget()");
+    int dropped = drop_queued(filename);
+    std::lock_guard<std::mutex> lock(group_mutex);
+    for (auto entry = group_pending.begin(); entry != group_pending.end();)
+    {
+        if (entry->path != filename)
+        {
+            ++entry;
+            continue;
+        }
+        ::close(entry->fd);
+        ::unlink(entry->temp_path.c_str());
+        entry = group_pending.erase(entry);
+        dropped = 1;
+    }
+    return dropped;
+}
+
+bool ParseDataFileFormat(std::string_view name, DataFileFormat &format) noexcept
+{
+    if (name == "text")
+    {
+        format = DataFileFormat::Text;
+        return true;
+    }
+    if (name == "binary")
+    {
+        format = DataFileFormat::Binary;
+        return true;
+    }
+    return false;
+}
+
+int QueueDataFile(const std::string &filename, int version, int use_compression,
+                  OutputDataFile &body)
+{
+    FnTrace("QueueDataFile()");
+    WriteJob job;
+    job.filename = filename;
+    job.version  = version;
+    job.compress = use_compression;
+    job.format   = body.Format();
+    job.body.assign(body.Contents());
+    job.queued   = std::chrono::steady_clock::now();
+
+    WriteQueue &queue = write_queue();
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    if (queue.stopped || in_writer)
+    {
+        lock.unlock();
+        return write_job(job);
+    }
+
+    const auto found = std::find_if(queue.jobs.begin(), queue.jobs.end(),
+                                    [&filename](const WriteJob &queued) { return queued.filename == filename; });
+    if (found != queue.jobs.end())
+    {
+        // keep the older queue time: latency is measured from the first save
+        job.queued = found->queued;
+        *found = std::move(job);
+        return 0;
+    }
+
+    if (queue.jobs.size() >= DataFileQueueLimit)
+    {
+        ++queue.stats.stalls;
+        queue.room.wait(lock, [&queue] { return queue.jobs.size() < DataFileQueueLimit; });
+    }
+    queue.jobs.push_back(std::move(job));
+    queue.stats.depth = queue.jobs.size();
+    queue.stats.max_depth = std::max(queue.stats.max_depth, queue.stats.depth);
+    if (!queue.thread.joinable())
+        queue.thread = std::thread(writer_main);
+    queue.wake.notify_one();
+    return 0;
+}
+
+int DataFileFlushQueue()
+{
+    FnTrace("DataFileFlushQueue()");
+    if (in_writer)
+        return 0;
+    WriteQueue &queue = write_queue();
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    queue.held = false;
+    queue.wake.notify_all();
+    queue.idle.wait(lock, [&queue] { return queue.jobs.empty() && queue.busy.empty(); });
+    const int failed = queue.failures;
+    queue.failures = 0;
+    return failed;
+}
+
+void DataFileStopWriter()
+{
+    FnTrace("DataFileStopWriter()");
+    write_queue().Stop();
+}
+
+DataFileWriterStats GetDataFileWriterStats()
+{
+    WriteQueue &queue = write_queue();
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    return queue.stats;
+}
+
 #ifdef VT_TESTING
+void DataFileHoldQueue()
+{
+    WriteQueue &queue = write_queue();
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    queue.held = true;
+    queue.idle.wait(lock, [&queue] { return queue.busy.empty(); });
+}
+
 int ReportError(const std::string &message)
 {
     FnTrace("ReportError()");
@@ -157,6 +830,10 @@ int InputDataFile::Open(const std::string &name, int &version)
         return 1;
     }
 
+    // a newer copy of this file may still be queued or waiting under its
+    // temp name; settle just this one, the rest can keep waiting
+    DataFileSettle(name);
+
     if (!std::ifstream(name).good())
     {
         ReportError("Unable to read non existing file: '" + name + "'");
@@ -174,6 +851,25 @@ int InputDataFile::Open(const std::string &name, int &version)
         ReportError("Unable to read file: '" + name + "' errno: " + std::to_string(errno));
         return 1;
     }
+    gzbuffer(fp, static_cast<unsigned int>(DataFileBlockSize));
+
+    std::array<unsigned char, kBinaryHeaderSize> header{};
+    const int header_len = gzread(fp, header.data(), static_cast<unsigned int>(header.size()));
+    if (header_len == static_cast<int>(header.size()) &&
+        std::equal(kBinaryMagic.begin(), kBinaryMagic.end(), header.begin()))
+    {
+        if (header[4] != kBinaryRevision)
+        {
+            Close();
+            ReportError("Unsupported binary revision " + std::to_string(header[4]) + " in file: '" + name + "'");
+            return 1;
+        }
+        version = static_cast<int>(get_u32(header.data() + 8));
+        binary = true;
+        filename = name;
+        return 0;
+    }
+    gzrewind(fp);
 
     std::array<char, 256> token{};
     if (GetToken(token.data(), static_cast<int>(token.size())) != 0)
@@ -230,6 +926,19 @@ int InputDataFile::Open(const std::string &name, int &version)
     return 0;
 }
 
+int InputDataFile::OpenMemory(std::string_view data)
+{
+    FnTrace("InputDataFile::OpenMemory()");
+    Close();
+    text.assign(data.begin(), data.end());
+    text_pos = 0;
+    text_end = text.size();
+    text_eof = true;  // nothing to refill from
+    memory   = true;
+    filename = "<memory>";
+    return 0;
+}
+
 int InputDataFile::Close() noexcept
 {
     FnTrace("InputDataFile::Close()");
@@ -239,44 +948,392 @@ int InputDataFile::Close() noexcept
         fp = nullptr;
     }
     old_format = false;
+    binary = false;
+    corrupt = false;
+    block.clear();
+    block_pos = 0;
+    block_start = 0;
+    text_pos = 0;
+    text_end = 0;
+    text_eof = false;
+    memory = false;
+    end_of_file = false;
+    return 0;
+}
+
+bool InputDataFile::NextBlock()
+{
+    FnTrace("InputDataFile::NextBlock()");
+    block.clear();
+    block_pos = 0;
+    block_start = gztell(fp);
+
+    std::array<unsigned char, kBlockHeaderSize> header{};
+    const int header_len = gzread(fp, header.data(), static_cast<unsigned int>(header.size()));
+    if (header_len == 0)
+        return false;  // clean end of file
+
+    const uint32_t raw_len    = (header_len == static_cast<int>(header.size())) ? get_u32(header.data()) : 0;
+    const uint32_t stored_len = (header_len == static_cast<int>(header.size())) ? get_u32(header.data() + 4) : 0;
+    const unsigned char codec = header[8];
+    bool valid = (header_len == static_cast<int>(header.size()) &&
+                  raw_len <= kMaxBlockSize && stored_len <= kMaxBlockSize);
+
+    if (valid && codec == kCodecRaw && raw_len == stored_len)
+    {
+        block.resize(raw_len);
+        valid = (gzread(fp, block.data(), raw_len) == static_cast<int>(raw_len));
+    }
+    else if (valid && codec == kCodecZlib)
+    {
+        std::vector<unsigned char> packed(stored_len);
+        valid = (gzread(fp, packed.data(), stored_len) == static_cast<int>(stored_len));
+        if (valid)
+        {
+            block.resize(raw_len);
+            uLongf dest_len = raw_len;
+            valid = (uncompress(block.data(), &dest_len, packed.data(), stored_len) == Z_OK &&
+                     dest_len == raw_len);
+        }
+    }
+    else
+    {
+        valid = false;
+    }
+
+    if (!valid)
+    {
+        ReportError("Corrupt data block in file: '" + filename + "'");
+        corrupt = true;
+        block.clear();
+    }
+    return valid;
+}
+
+bool InputDataFile::NextField(DataFileField &field)
+{
+    if (corrupt)
+        return false;
+    while (block_pos >= block.size())
+    {
+        if (!NextBlock())
+            return false;
+    }
+
+    const unsigned char* pos = block.data() + block_pos;
+    const unsigned char* end = block.data() + block.size();
+    const unsigned char tag  = *pos++;
+
+    field = DataFileField{};
+    field.type       = static_cast<DataFieldType>(tag & kFieldTypeMask);
+    field.line_break = (tag & kFieldBreak) != 0;
+
+    bool valid = true;
+    switch (field.type)
+    {
+    case DataFieldType::Integer:
+    {
+        uint64_t raw = 0;
+        valid = get_varint(pos, end, raw);
+        field.integer = zigzag_decode(raw);
+        break;
+    }
+    case DataFieldType::Real:
+    {
+        uint64_t bits = 0;
+        valid = (end - pos >= 8);
+        if (valid)
+        {
+            bits = static_cast<uint64_t>(get_u32(pos)) | (static_cast<uint64_t>(get_u32(pos + 4)) << 32);
+            pos += 8;
+        }
+        field.real = std::bit_cast<double>(bits);
+        break;
+    }
+    case DataFieldType::String:
+    case DataFieldType::Token:
+    {
+        uint64_t len = 0;
+        valid = get_varint(pos, end, len) && len <= static_cast<uint64_t>(end - pos);
+        if (valid)
+        {
+            field.text = std::string_view(reinterpret_cast<const char*>(pos), static_cast<std::size_t>(len));
+            pos += len;
+        }
+        break;
+    }
+    case DataFieldType::None:
+    default:
+        valid = false;
+        break;
+    }
+
+    if (!valid)
+    {
+        ReportError("Corrupt field in file: '" + filename + "'");
+        corrupt = true;
+        block.clear();
+        block_pos = 0;
+        return false;
+    }
+    block_pos = static_cast<std::size_t>(pos - block.data());
+    return true;
+}
+
+uint64_t InputDataFile::FieldValue(const DataFileField &field)
+{
+    if (field.type == DataFieldType::Integer)
+        return field.integer;
+    if (field.type == DataFieldType::Token)
+        return decode_token(field.text, old_format);
+
+    // type mismatch; decode whatever the text format would have held
+    render_token(field, token_text);
+    return decode_token(token_text, false);
+}
+
+// Makes at least one unread text byte available; false at end of file.
+bool InputDataFile::FillText()
+{
+    if (text_pos < text_end)
+        return true;
+    if (text_eof)
+        return false;
+
+    text.resize(DataFileBlockSize);
+    const int len = gzread(fp, text.data(), static_cast<unsigned int>(text.size()));
+    text_pos = 0;
+    text_end = (len > 0) ? static_cast<std::size_t>(len) : 0;
+    text_eof = (len <= 0);
+    if (len < 0)
+    {
+        ReportError("Read error in file: '" + filename + "'");
+        corrupt = true;
+    }
+    return !text_eof;
+}
+
+/****
+ * NextToken:  Finds the next whitespace-delimited text token and consumes
+ *   the single delimiter after it ('delim' is 0 when the token ends at end
+ *   of file).  Leading whitespace is skipped unless 'skip_space' is false,
+ *   as the pre-1998 encoding requires.  The view points into the buffer,
+ *   or into token_text when the token spans a refill, and is only valid
+ *   until the next read.  Returns false if no token is left.
+ ****/
+bool InputDataFile::NextToken(std::string_view &token, char &delim, bool skip_space)
+{
+    delim = '\0';
+    if (skip_space)
+    {
+        while (FillText())
+        {
+            while (text_pos < text_end && is_space(text[text_pos]))
+                ++text_pos;
+            if (text_pos < text_end)
+                break;
+        }
+    }
+    if (!FillText())
+        return false;
+
+    const char* start = text.data() + text_pos;
+    const char* end   = text.data() + text_end;
+    const char* stop  = find_space(start, end);
+    if (stop < end)
+    {
+        token    = std::string_view(start, static_cast<std::size_t>(stop - start));
+        delim    = *stop;
+        text_pos = static_cast<std::size_t>(stop - text.data()) + 1;
+        return true;
+    }
+
+    // the token runs past the buffer; gather it across refills
+    token_text.assign(start, end);
+    text_pos = text_end;
+    while (FillText())
+    {
+        start = text.data() + text_pos;
+        end   = text.data() + text_end;
+        stop  = find_space(start, end);
+        token_text.append(start, stop);
+        if (stop < end)
+        {
+            delim    = *stop;
+            text_pos = static_cast<std::size_t>(stop - text.data()) + 1;
+            break;
+        }
+        text_pos = text_end;
+    }
+    token = token_text;
+    return true;
+}
+
+// Drops the text buffer and seeks the stream back to the first unread
+// byte, for the scans that read ahead with RawChar().  Returns the offset.
+z_off_t InputDataFile::TextRewind()
+{
+    if (memory)
+        return static_cast<z_off_t>(text_pos);
+
+    const z_off_t pos = gztell(fp) - static_cast<z_off_t>(text_end - text_pos);
+    text_pos = 0;
+    text_end = 0;
+    text_eof = false;
+    if (pos < 0 || gzseek(fp, pos, SEEK_SET) < 0)
+        return -1;
+    return pos;
+}
+
+int InputDataFile::RawChar()
+{
+    if (memory)
+        return (text_pos < text_end) ? static_cast<unsigned char>(text[text_pos++]) : -1;
+    return gzgetc(fp);
+}
+
+void InputDataFile::TextSeek(z_off_t pos)
+{
+    if (memory)
+        text_pos = static_cast<std::size_t>(pos);
+    else
+        gzseek(fp, pos, SEEK_SET);
+}
+
+// Binary positions hold the block's stream offset in the high 32 bits
+// and the offset inside the decoded block in the low 32 bits; text
+// positions are offsets in the (inflated) stream.
+uint64_t InputDataFile::Tell()
+{
+    FnTrace("InputDataFile::Tell()");
+    if (memory)
+        return text_pos;
+    if (fp == nullptr)
+        return 0;
+    if (binary)
+    {
+        if (block_pos >= block.size())
+            return static_cast<uint64_t>(gztell(fp)) << 32;
+        return (static_cast<uint64_t>(block_start) << 32) | block_pos;
+    }
+    return static_cast<uint64_t>(gztell(fp) - static_cast<z_off_t>(text_end - text_pos));
+}
+
+int InputDataFile::Seek(uint64_t pos)
+{
+    FnTrace("InputDataFile::Seek()");
     end_of_file = false;
+    if (memory)
+    {
+        if (pos > text_end)
+            return 1;
+        text_pos = static_cast<std::size_t>(pos);
+        return 0;
+    }
+    if (fp == nullptr)
+        return 1;
+
+    if (binary)
+    {
+        const auto start  = static_cast<z_off_t>(pos >> 32);
+        const auto offset = static_cast<std::size_t>(pos & 0xFFFFFFFFU);
+        corrupt = false;
+        block.clear();
+        block_pos = 0;
+        if (gzseek(fp, start, SEEK_SET) < 0)
+            return 1;
+        if (offset == 0)
+            return 0;
+        if (!NextBlock() || offset > block.size())
+            return 1;
+        block_pos = offset;
+        return 0;
+    }
+
+    text_pos = 0;
+    text_end = 0;
+    text_eof = false;
+    return (gzseek(fp, static_cast<z_off_t>(pos), SEEK_SET) < 0) ? 1 : 0;
+}
+
+int InputDataFile::ReadField(DataFileField &field)
+{
+    FnTrace("InputDataFile::ReadField()");
+    if (!is_open())
+        return 1;
+
+    if (binary)
+    {
+        if (!NextField(field))
+        {
+            end_of_file = true;
+            return 1;
+        }
+        return 0;
+    }
+
+    // text: hand out the next token, noting whether a newline follows it
+    std::string_view token;
+    char delim = '\0';
+    if (!NextToken(token, delim, true))
+    {
+        end_of_file = true;
+        return 1;
+    }
+    if (token.data() != token_text.data())
+        token_text.assign(token);  // skipping on below may refill the buffer
+
+    bool line_break = (delim == '\n');
+    while (delim != '\0' && FillText() && is_space(text[text_pos]))
+    {
+        if (text[text_pos] == '\n')
+            line_break = true;
+        ++text_pos;
+    }
+
+    field = DataFileField{};
+    field.type       = DataFieldType::Token;
+    field.line_break = line_break;
+    field.text       = token_text;
     return 0;
 }
 
 int InputDataFile::GetToken(char* buffer, int max_len)
 {
     FnTrace("InputDataFile::GetToken()");
-    if (fp == nullptr || buffer == nullptr || max_len <= 0)
+    if (!is_open() || buffer == nullptr || max_len <= 0)
     {
         return 1;
     }
 
-    const std::size_t capacity = static_cast<std::size_t>(max_len);
-    std::size_t index = 0;
-
-    int ch = gzgetc(fp);
-    while (ch >= 0 && is_space(ch))
+    while (FillText())
     {
-        ch = gzgetc(fp);
+        while (text_pos < text_end && is_space(text[text_pos]))
+            ++text_pos;
+        if (text_pos < text_end)
+            break;
     }
 
-    while (ch >= 0)
+    // a token too long for buffer fills it and the rest is left for the
+    // next read, as it always was
+    const std::size_t capacity = static_cast<std::size_t>(max_len);
+    std::size_t index = 0;
+    while (FillText())
     {
+        const char ch = text[text_pos];
         if (is_space(ch))
         {
+            ++text_pos;
             buffer[index] = '\0';
             return 0;
         }
-
         if (index + 1 >= capacity)
         {
-            buffer[capacity - 1] = '\0';
+            buffer[index] = '\0';
             return 1;
         }
-
-        buffer[index] = static_cast<char>(ch);
-        ++index;
-        ch = gzgetc(fp);
+        buffer[index++] = ch;
+        ++text_pos;
     }
 
     end_of_file = true;
@@ -287,67 +1344,79 @@ int InputDataFile::GetToken(char* buffer, int max_len)
 uint64_t InputDataFile::GetValue()
 {
     FnTrace("InputDataFile::GetValue()");
-    uint64_t value = 0;
-
-    if (fp == nullptr)
+    if (!is_open())
     {
         end_of_file = true;
         return 0;
     }
 
-    if (old_format)
+    if (binary)
     {
-        const auto& decode = old_decode_table();
-        for (;;)
+        DataFileField field;
+        if (!NextField(field))
         {
-            const int ch = gzgetc(fp);
-            if (ch < 0)
-            {
-                end_of_file = true;
-                return 0;
-            }
-            if (is_space(ch))
-            {
-                return value;
-            }
-            value = (value * kOldBase) + decode[static_cast<unsigned char>(ch)];
+            end_of_file = true;
+            return 0;
         }
+        return FieldValue(field);
     }
 
-    int ch = gzgetc(fp);
-    while (ch >= 0 && is_space(ch))
+    // the pre-1998 encoding neither skips leading whitespace nor keeps
+    // a value cut short by end of file
+    std::string_view token;
+    char delim = '\0';
+    if (!NextToken(token, delim, !old_format))
     {
-        ch = gzgetc(fp);
+        end_of_file = true;
+        return 0;
     }
-
-    const auto& decode = new_decode_table();
-    while (ch >= 0)
+    if (delim == '\0')
     {
-        if (is_space(ch))
-        {
-            return value;
-        }
-        value = (value << 6) + decode[static_cast<unsigned char>(ch)];
-        ch = gzgetc(fp);
+        end_of_file = true;
+        if (old_format)
+            return 0;
     }
-
-    end_of_file = true;
-    return value;
+    return decode_token(token, old_format);
 }
 
 int InputDataFile::Read(Flt &val)
 {
     FnTrace("InputDataFile::Read(Flt &)");
-    std::array<char, 256> token{};
-    if (GetToken(token.data(), static_cast<int>(token.size())) != 0)
+    std::string_view token;
+    if (binary)
     {
-        return 1;
+        DataFileField field;
+        if (!NextField(field))
+        {
+            end_of_file = true;
+            return 1;
+        }
+        if (field.type == DataFieldType::Real)
+        {
+            val = static_cast<Flt>(field.real);
+            return 0;
+        }
+        if (field.type != DataFieldType::Token)
+        {
+            render_token(field, token_text);
+            field.text = token_text;
+        }
+        token = field.text;
+    }
+    else
+    {
+        char delim = '\0';
+        if (!is_open() || !NextToken(token, delim, true))
+        {
+            end_of_file = true;
+            return 1;
+        }
+        if (delim == '\0')
+            end_of_file = true;
     }
 
-    char* end = nullptr;
-    errno = 0;
-    const double parsed = std::strtod(token.data(), &end);
-    if (token.data() == end || errno == ERANGE)
+    double parsed = 0.0;
+    if (!parse_real(token, parsed))
     {
         return 1;
     }
@@ -359,19 +1428,76 @@ int InputDataFile::Read(Flt &val)
 int InputDataFile::Read(Str &s)
 {
     FnTrace("InputDataFile::Read(Str &)");
-    std::array<char, STRLONG> token{};
-    if (GetToken(token.data(), static_cast<int>(token.size())) != 0)
+    if (binary)
+    {
+        DataFileField field;
+        if (!NextField(field))
+        {
+            end_of_file = true;
+            return 1;
+        }
+        if (field.type == DataFieldType::String)
+        {
+            if (field.text.empty())
+                s.Clear();
+            else
+                s.Set(field.text);
+            return 0;
+        }
+        // legacy token rules: '~' is empty, '_' stands for a space
+        render_token(field, token_text);
+        if (token_text.empty() || token_text == "~")
+        {
+            s.Clear();
+        }
+        else
+        {
+            std::replace(token_text.begin(), token_text.end(), '_', ' ');
+            s.Set(token_text);
+        }
+        return 0;
+    }
+
+    if (!is_open())
     {
+        end_of_file = true;
         return 1;
     }
+    while (FillText())
+    {
+        while (text_pos < text_end && is_space(text[text_pos]))
+            ++text_pos;
+        if (text_pos < text_end)
+            break;
+    }
+
+    // a token that fits in the buffer and in a Str is taken in place;
+    // anything else goes through GetToken(), which leaves the rest of an
+    // overlong token for the next read
+    std::string_view token;
+    std::array<char, STRLONG> buffer;
+    const char* start = text.data() + text_pos;
+    const char* end   = text.data() + text_end;
+    const char* stop  = (text_pos < text_end) ? find_space(start, end) : end;
+    if (stop < end && stop - start < static_cast<std::ptrdiff_t>(STRLONG))
+    {
+        token    = std::string_view(start, static_cast<std::size_t>(stop - start));
+        text_pos = static_cast<std::size_t>(stop - text.data()) + 1;
+    }
+    else
+    {
+        if (GetToken(buffer.data(), static_cast<int>(buffer.size())) != 0)
+            return 1;
+        token = buffer.data();
+    }
 
-    if (token[0] == '\0' || std::strcmp(token.data(), "~") == 0)
+    if (token.empty() || token == "~")
     {
         s.Clear();
     }
     else
     {
-        s.Set(token.data());
+        s.Set(token);
         s.ChangeAtoB('_', ' ');
     }
     return 0;
@@ -426,12 +1552,38 @@ int InputDataFile::Read(Str *val)
 int InputDataFile::PeekTokens()
 {
     FnTrace("InputDataFile::PeekTokens()");
-    if (fp == nullptr)
+    if (!is_open())
     {
         return 0;
     }
 
-    const auto savepos = gzseek(fp, 0L, SEEK_CUR);
+    if (binary)
+    {
+        // Like the text scan below, the delimiter ahead of the first
+        // token on the line is not counted.
+        const std::vector<unsigned char> saved_block = block;
+        const std::size_t saved_pos = block_pos;
+        const z_off_t saved_start = block_start;
+        const auto savepos = gztell(fp);
+
+        int fields = 0;
+        DataFileField field;
+        while (NextField(field))
+        {
+            ++fields;
+            if (field.line_break)
+                break;
+        }
+
+        block = saved_block;
+        block_pos = saved_pos;
+        block_start = saved_start;
+        corrupt = false;
+        gzseek(fp, savepos, SEEK_SET);
+        return std::max(fields - 1, 0);
+    }
+
+    const auto savepos = TextRewind();
     if (savepos < 0)
     {
         return 0;
@@ -443,7 +1595,7 @@ int InputDataFile::PeekTokens()
 
     while (!newline_found && !end_of_file)
     {
-        const int ch = gzgetc(fp);
+        const int ch = RawChar();
         if (ch < 0)
         {
             end_of_file = true;
@@ -464,14 +1616,14 @@ int InputDataFile::PeekTokens()
         }
     }
 
-    gzseek(fp, savepos, SEEK_SET);
+    TextSeek(savepos);
     return count;
 }
 
 const char* InputDataFile::ShowTokens(char* buffer, int lines)
 {
     FnTrace("InputDataFile::ShowTokens()");
-    if (fp == nullptr || lines <= 0)
+    if (!is_open() || lines <= 0)
     {
         static std::array<char, STRLONG> empty_buffer{};
         empty_buffer[0] = '\0';
@@ -481,7 +1633,40 @@ const char* InputDataFile::ShowTokens(char* buffer, int lines)
     static std::array<char, STRLONG> fallback{};
     char* out = (buffer != nullptr) ? buffer : fallback.data();
 
-    const auto savepos = gzseek(fp, 0L, SEEK_CUR);
+    if (binary)
+    {
+        const std::vector<unsigned char> saved_block = block;
+        const std::size_t saved_pos = block_pos;
+        const z_off_t saved_start = block_start;
+        const auto savepos = gztell(fp);
+
+        std::size_t index = 0;
+        std::string rendered;
+        DataFileField field;
+        while (lines > 0 && NextField(field))
+        {
+            render_token(field, rendered);
+            for (char ch : rendered)
+            {
+                if (index + 1 < STRLONG)
+                    out[index++] = ch;
+            }
+            if (field.line_break)
+                --lines;
+            if (lines > 0 && index + 1 < STRLONG)
+                out[index++] = field.line_break ? '\n' : ' ';
+        }
+        out[index] = '\0';
+
+        block = saved_block;
+        block_pos = saved_pos;
+        block_start = saved_start;
+        corrupt = false;
+        gzseek(fp, savepos, SEEK_SET);
+        return out;
+    }
+
+    const auto savepos = TextRewind();
     if (savepos < 0)
     {
         out[0] = '\0';
@@ -491,14 +1676,14 @@ const char* InputDataFile::ShowTokens(char* buffer, int lines)
     std::size_t index = 0;
     while (lines-- > 0 && !end_of_file)
     {
-        int ch = gzgetc(fp);
+        int ch = RawChar();
         while (ch >= 0 && ch != '\n')
         {
             if (index + 1 < STRLONG)
             {
                 out[index++] = static_cast<char>(ch);
             }
-            ch = gzgetc(fp);
+            ch = RawChar();
         }
         if (ch < 0)
         {
@@ -511,7 +1696,7 @@ const char* InputDataFile::ShowTokens(char* buffer, int lines)
     }
 
     out[index] = '\0';
-    gzseek(fp, savepos, SEEK_SET);
+    TextSeek(savepos);
     return out;
 }
 
@@ -524,7 +1709,12 @@ OutputDataFile::~OutputDataFile()
     Close();
 }
 
-int OutputDataFile::Open(const std::string &filepath, int version, int use_compression)
+int OutputDataFile::Open(const std::string &filepath, int version, int use_compression, DataFileKind kind)
+{
+    return Open(filepath, version, use_compression, DataFileFormatFor(kind));
+}
+
+int OutputDataFile::Open(const std::string &filepath, int version, int use_compression, DataFileFormat format)
 {
     FnTrace("OutputDataFile::Open()");
 
@@ -535,11 +1725,24 @@ int OutputDataFile::Open(const std::string &filepath, int version, int use_compr
     }
 
     Close();
+    drop_queued(filepath);
 
     filename = filepath;
     compress = (use_compression != 0);
+    binary = (format == DataFileFormat::Binary);
 
-    if (compress)
+    // the mode this file was opened under is the one it is committed under
+    sync = data_file_sync.load();
+    if (sync != DataFileSync::Direct)
+    {
+        // binary blocks carry their own compression
+        OpenTemp(compress && !binary);
+    }
+    else if (binary)
+    {
+        file_fp = std::fopen(filepath.c_str(), "wb");
+    }
+    else if (compress)
     {
         gz_fp = gzopen(filepath.c_str(), "w");
     }
@@ -548,7 +1751,7 @@ int OutputDataFile::Open(const std::string &filepath, int version, int use_compr
         file_fp = std::fopen(filepath.c_str(), "w");
     }
 
-    const bool open_failed = (compress && gz_fp == nullptr) || (!compress && file_fp == nullptr);
+    const bool open_failed = (gz_fp == nullptr && file_fp == nullptr);
     if (open_failed)
     {
         ReportError("OutputDataFile::Open error '" + std::to_string(errno) + "' for '" + filepath + "'");
@@ -556,6 +1759,18 @@ int OutputDataFile::Open(const std::string &filepath, int version, int use_compr
         return 1;
     }
 
+    if (binary)
+    {
+        std::array<unsigned char, kBinaryHeaderSize> header{};
+        std::copy(kBinaryMagic.begin(), kBinaryMagic.end(), header.begin());
+        header[4] = kBinaryRevision;
+        put_u32(header.data() + 8, static_cast<uint32_t>(version));
+        std::fwrite(header.data(), 1, header.size(), file_fp);
+        pending.clear();
+        pending.reserve(DataFileBlockSize);
+        return 0;
+    }
+
     const std::string header = "vtpos 0 " + std::to_string(version) + "\n";
     write_raw(gz_fp, file_fp, compress, header.c_str(), header.size());
     return 0;
@@ -564,22 +1779,364 @@ int OutputDataFile::Open(const std::string &filepath, int version, int use_compr
 int OutputDataFile::Close() noexcept
 {
     FnTrace("OutputDataFile::Close()");
+    // a temp file without an open stream was never written
+    const bool was_open = (gz_fp != nullptr || file_fp != nullptr);
+    bool failed = !was_open;
+    if (binary && file_fp != nullptr)
+    {
+        failed = (FlushBlock() != 0);
+    }
+    binary = false;
+    pending.clear();
     if (gz_fp != nullptr)
     {
-        gzclose(gz_fp);
+        failed |= (gzclose(gz_fp) != Z_OK);
         gz_fp = nullptr;
     }
     if (file_fp != nullptr)
     {
-        std::fclose(file_fp);
+        failed |= (std::ferror(file_fp) != 0);
+        failed |= (std::fclose(file_fp) != 0);
         file_fp = nullptr;
     }
+    if (memory != nullptr)
+    {
+        std::free(memory);
+        memory = nullptr;
+        memory_size = 0;
+    }
+    if (!temp_path.empty())
+    {
+        return CommitTemp(failed);
+    }
+    return (was_open && failed) ? 1 : 0;
+}
+
+int OutputDataFile::OpenMemory(DataFileFormat format)
+{
+    FnTrace("OutputDataFile::OpenMemory()");
+    Close();
+    filename = "<memory>";
+    compress = false;
+    binary = (format == DataFileFormat::Binary);
+    file_fp = open_memstream(&memory, &memory_size);
+    if (file_fp == nullptr)
+    {
+        ReportError("OutputDataFile::OpenMemory error '" + std::to_string(errno) + "'");
+        return 1;
+    }
+    if (binary)
+    {
+        pending.clear();
+        pending.reserve(DataFileBlockSize);
+    }
+    return 0;
+}
+
+std::string_view OutputDataFile::Contents()
+{
+    if (file_fp == nullptr)
+        return {};
+    if (binary)
+        FlushBlock();
+    std::fflush(file_fp);
+    return (memory != nullptr) ? std::string_view(memory, memory_size) : std::string_view();
+}
+
+int OutputDataFile::WriteRaw(std::string_view data)
+{
+    FnTrace("OutputDataFile::WriteRaw()");
+    if (gz_fp == nullptr && file_fp == nullptr)
+    {
+        return 1;
+    }
+    if (binary && FlushBlock())
+    {
+        return 1;
+    }
+    if (binary && compress)
+    {
+        return PackBlocks(data);
+    }
+    write_raw(gz_fp, file_fp, compress, data.data(), data.size());
+    return 0;
+}
+
+/****
+ * PackBlocks:  Writes the blocks of a binary OpenMemory() stream, which
+ *   are stored raw, compressing each one as FlushBlock() would have.
+ *   This is how queued saves get compressed on the writer thread.
+ ****/
+int OutputDataFile::PackBlocks(std::string_view data)
+{
+    FnTrace("OutputDataFile::PackBlocks()");
+    const auto* pos = reinterpret_cast<const unsigned char*>(data.data());
+    const auto* end = pos + data.size();
+    while (pos < end)
+    {
+        if (end - pos < static_cast<std::ptrdiff_t>(kBlockHeaderSize))
+            break;
+        const uint32_t raw_len    = get_u32(pos);
+        const uint32_t stored_len = get_u32(pos + 4);
+        const unsigned char codec = pos[8];
+        pos += kBlockHeaderSize;
+        if (stored_len > static_cast<uint64_t>(end - pos))
+            break;
+
+        if (codec == kCodecRaw && raw_len == stored_len)
+        {
+            pending.assign(pos, pos + stored_len);
+            if (FlushBlock())
+                return 1;
+        }
+        else
+        {
+            // already packed; copy the block as it is
+            std::fwrite(pos - kBlockHeaderSize, 1, kBlockHeaderSize + stored_len, file_fp);
+        }
+        pos += stored_len;
+    }
+    if (pos != end)
+    {
+        ReportError("OutputDataFile: truncated binary block for '" + filename + "'");
+        return 1;
+    }
+    return 0;
+}
+
+/****
+ * OpenTemp:  Creates a hidden temp file next to 'filename' (".name.tmpN",
+ *   which the check_/drawer_/archive_ directory scans never match) and
+ *   opens the stream on it.  sync_fd stays open after the stream closes
+ *   so the data can still be synced before the rename.
+ ****/
+int OutputDataFile::OpenTemp(bool gzip)
+{
+    FnTrace("OutputDataFile::OpenTemp()");
+    static std::atomic<unsigned> temp_seq{0};
+    const auto slash = filename.rfind('/');
+    const std::string dir  = (slash == std::string::npos) ? "" : filename.substr(0, slash + 1);
+    const std::string base = (slash == std::string::npos) ? filename : filename.substr(slash + 1);
+
+    int fd = -1;
+    for (int attempt = 0; attempt < 16 && fd < 0; ++attempt)
+    {
+        temp_path = dir + "." + base + ".tmp" + std::to_string(temp_seq++);
+        fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+        if (fd < 0 && errno != EEXIST)
+            break;
+    }
+    if (fd < 0)
+    {
+        temp_path.clear();
+        return 1;
+    }
+
+    // the file renamed over filename keeps its owner (or at least its
+    // group, where we may not give it away) and its permissions
+    struct stat original{};
+    if (::stat(filename.c_str(), &original) == 0 && S_ISREG(original.st_mode))
+    {
+        int chowned = 0;
+        if (original.st_uid != ::geteuid() || original.st_gid != ::getegid())
+            chowned = ::fchown(fd, original.st_uid, original.st_gid);
+        if (chowned != 0)
+            chowned = ::fchown(fd, static_cast<uid_t>(-1), original.st_gid);
+        ::fchmod(fd, original.st_mode & 07777);
+    }
+
+    sync_fd = dup(fd);
+    if (sync_fd >= 0)
+    {
+        if (gzip)
+            gz_fp = gzdopen(fd, "w");
+        else
+            file_fp = fdopen(fd, binary ? "wb" : "w");
+    }
+    if (gz_fp == nullptr && file_fp == nullptr)
+    {
+        // nothing will be written, so nothing may be renamed over filename
+        ::close(fd);
+        if (sync_fd >= 0)
+            ::close(sync_fd);
+        sync_fd = -1;
+        ::unlink(temp_path.c_str());
+        temp_path.clear();
+        return 1;
+    }
+    return 0;
+}
+
+/****
+ * CommitTemp:  Moves the finished temp file over 'filename' according to
+ *   the DataFileSync mode, or throws it away if writing failed so the old
+ *   file survives.
+ ****/
+int OutputDataFile::CommitTemp(bool failed)
+{
+    FnTrace("OutputDataFile::CommitTemp()");
+    if (!failed && sync == DataFileSync::File && fsync(sync_fd) != 0)
+    {
+        failed = true;
+    }
+
+    int retval = 0;
+    if (failed)
+    {
+        ReportError("OutputDataFile: keeping old '" + filename + "' after write error " + std::to_string(errno));
+        ::unlink(temp_path.c_str());
+        retval = 1;
+    }
+    else if (sync == DataFileSync::Group)
+    {
+        std::size_t waiting = 0;
+        {
+            std::lock_guard<std::mutex> lock(group_mutex);
+            group_pending.push_back({sync_fd, temp_path, filename});
+            waiting = group_pending.size();
+        }
+        sync_fd = -1;  // owned by the group now
+        // group mode may have been switched off since this file opened
+        if (waiting >= kMaxGroupFiles || GetDataFileSync() != DataFileSync::Group)
+            DataFileGroupCommit();
+    }
+    else if (std::rename(temp_path.c_str(), filename.c_str()) != 0)
+    {
+        ReportError("OutputDataFile: rename error '" + std::to_string(errno) + "' for '" + filename + "'");
+        ::unlink(temp_path.c_str());
+        retval = 1;
+    }
+    else if (sync == DataFileSync::File)
+    {
+        sync_directory(parent_dir(filename));
+    }
+
+    if (sync_fd >= 0)
+        ::close(sync_fd);
+    sync_fd = -1;
+    temp_path.clear();
+    return retval;
+}
+
+int OutputDataFile::FlushBlock()
+{
+    FnTrace("OutputDataFile::FlushBlock()");
+    if (pending.empty() || file_fp == nullptr)
+    {
+        return 0;
+    }
+
+    const unsigned char* payload = pending.data();
+    std::size_t stored_len = pending.size();
+    unsigned char codec = kCodecRaw;
+
+    std::vector<unsigned char> packed;
+    if (compress)
+    {
+        uLongf packed_len = compressBound(static_cast<uLong>(pending.size()));
+        packed.resize(packed_len);
+        if (compress2(packed.data(), &packed_len, pending.data(),
+                      static_cast<uLong>(pending.size()), Z_DEFAULT_COMPRESSION) == Z_OK &&
+            packed_len < pending.size())
+        {
+            payload    = packed.data();
+            stored_len = packed_len;
+            codec      = kCodecZlib;
+        }
+    }
+
+    std::array<unsigned char, kBlockHeaderSize> header{};
+    put_u32(header.data(), static_cast<uint32_t>(pending.size()));
+    put_u32(header.data() + 4, static_cast<uint32_t>(stored_len));
+    header[8] = codec;
+
+    const bool ok = std::fwrite(header.data(), 1, header.size(), file_fp) == header.size() &&
+                    std::fwrite(payload, 1, stored_len, file_fp) == stored_len;
+    pending.clear();
+    if (!ok)
+    {
+        ReportError("OutputDataFile: write error '" + std::to_string(errno) + "' for '" + filename + "'");
+        return 1;
+    }
+    return 0;
+}
+
+int OutputDataFile::PutField(DataFieldType type, int bk, uint64_t integer, double real, std::string_view text)
+{
+    if (file_fp == nullptr)
+    {
+        return 1;
+    }
+
+    // keep each field inside one block
+    const std::size_t needed = 1 + kMaxVarintSize + text.size();
+    if (!pending.empty() && pending.size() + needed > DataFileBlockSize)
+    {
+        if (FlushBlock())
+            return 1;
+    }
+
+    pending.push_back(static_cast<unsigned char>(static_cast<unsigned char>(type) | (bk ? kFieldBreak : 0)));
+    switch (type)
+    {
+    case DataFieldType::Integer:
+        put_varint(pending, zigzag_encode(integer));
+        break;
+    case DataFieldType::Real:
+    {
+        const auto bits = std::bit_cast<uint64_t>(real);
+        std::array<unsigned char, 8> raw{};
+        put_u32(raw.data(), static_cast<uint32_t>(bits));
+        put_u32(raw.data() + 4, static_cast<uint32_t>(bits >> 32));
+        pending.insert(pending.end(), raw.begin(), raw.end());
+        break;
+    }
+    case DataFieldType::String:
+    case DataFieldType::Token:
+        put_varint(pending, text.size());
+        pending.insert(pending.end(), text.begin(), text.end());
+        break;
+    case DataFieldType::None:
+        pending.pop_back();
+        return 1;
+    }
     return 0;
 }
 
+int OutputDataFile::WriteField(const DataFileField &field)
+{
+    FnTrace("OutputDataFile::WriteField()");
+    const int bk = field.line_break ? 1 : 0;
+    if (binary)
+    {
+        return PutField(field.type, bk, field.integer, field.real, field.text);
+    }
+
+    switch (field.type)
+    {
+    case DataFieldType::Integer:
+        return PutValue(field.integer, bk);
+    case DataFieldType::Real:
+        return Write(static_cast<Flt>(field.real), bk);
+    case DataFieldType::String:
+        return Write(std::string(field.text).c_str(), bk);
+    case DataFieldType::Token:
+        write_raw(gz_fp, file_fp, compress, field.text.data(), field.text.size());
+        put_character(gz_fp, file_fp, compress, static_cast<char>(bk ? '\n' : ' '));
+        return 0;
+    case DataFieldType::None:
+        break;
+    }
+    return 1;
+}
+
 int OutputDataFile::PutValue(uint64_t val, int bk)
 {
     FnTrace("OutputDataFile::PutValue()");
+    if (binary)
+    {
+        return PutField(DataFieldType::Integer, bk, val, 0.0, {});
+    }
     std::array<char, 32> buffer{};
     std::size_t cursor = buffer.size();
 
@@ -600,6 +2157,10 @@ int OutputDataFile::PutValue(uint64_t val, int bk)
 int OutputDataFile::Write(Flt val, int bk)
 {
     FnTrace("OutputDataFile::Write(Flt)");
+    if (binary)
+    {
+        return PutField(DataFieldType::Real, bk, 0, static_cast<double>(val), {});
+    }
     std::array<char, 64> buffer{};
     const int written = bk
         ? vt::cpp23::format_to_buffer(buffer.data(), buffer.size(), "{}\n", static_cast<double>(val))
@@ -620,6 +2181,10 @@ int OutputDataFile::Write(const char* val, int bk)
     }
 
     const std::string_view view(val);
+    if (binary)
+    {
+        return PutField(DataFieldType::String, bk, 0, 0.0, view);
+    }
     if (view.empty())
     {
         const char* token = bk ? "~\n" : "~ ";
@@ -649,17 +2214,17 @@ int OutputDataFile::Write(TimeInfo &timevar, int bk)
         const int seconds = 0;
         const int year = 0;
         error += Write(seconds);
-        error += Write(year);
+        error += Write(year, binary ? bk : 0);
     }
     else
     {
         const int seconds = timevar.SecondsInYear();
         const int year = timevar.Year();
         error += Write(seconds);
-        error += Write(year);
+        error += Write(year, binary ? bk : 0);
     }
 
-    if (bk)
+    if (bk && !binary)
     {
         put_character(gz_fp, file_fp, compress, '\n');
     }
@@ -729,6 +2294,8 @@ bool KeyValueInputFile::Open()
             buffidx = 0;
             comment = false;
             getvalue = false;
+            closed = false;
+            last = '\0';
         }
         else if (filedes < 0)
         {
@@ -804,12 +2371,39 @@ int KeyValueInputFile::Reset()
     buffidx = 0;
     comment = false;
     getvalue = false;
+    closed = false;
+    last = '\0';
     buffer.fill('\0');
     inputfile.clear();
 
     return retval;
 }
 
+/****
+ * Fill:  reads the next block; false if there's nothing to read (for
+ *  now, on a non-blocking descriptor, or for good)
+ ****/
+bool KeyValueInputFile::Fill()
+{
+    ssize_t read_bytes = 0;
+    do
+    {
+        read_bytes = ::read(filedes, buffer.data(), buffer.size());
+    }
+    while (read_bytes < 0 && errno == EINTR);
+
+    bytesread = 0;
+    buffidx = 0;
+    if (read_bytes > 0)
+    {
+        bytesread = static_cast<std::size_t>(read_bytes);
+        return true;
+    }
+    if (read_bytes == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+        closed = true;
+    return false;
+}
+
 int KeyValueInputFile::Read(char* key, char* value, int maxlen)
 {
     FnTrace("KeyValueInputFile::Read()");
@@ -819,23 +2413,17 @@ int KeyValueInputFile::Read(char* key, char* value, int maxlen)
     }
 
     const std::size_t limit = static_cast<std::size_t>(maxlen);
-    key[0] = '\0';
-    value[0] = '\0';
-
-    if (bytesread == 0)
+    if (keyidx == 0 && validx == 0)
     {
-        const auto read_bytes = ::read(filedes, buffer.data(), buffer.size());
-        if (read_bytes <= 0)
-        {
-            bytesread = 0;
-            return 0;
-        }
-        bytesread = static_cast<std::size_t>(read_bytes);
-        buffidx = 0;
+        // not partway through a line
+        key[0] = '\0';
+        value[0] = '\0';
     }
 
+    if (buffidx >= bytesread && !Fill())
+        return 0;
+
     int retval = 0;
-    char last = '\0';
 
     constexpr char backslash = static_cast<char>(0x5C);
     while (bytesread > 0 && retval == 0)
@@ -845,10 +2433,10 @@ int KeyValueInputFile::Read(char* key, char* value, int maxlen)
             const char ch = buffer[buffidx];
             if (ch == '\n')
             {
+                key[keyidx] = '\0';
+                value[validx] = '\0';
                 if (keyidx)
                 {
-                    key[keyidx] = '\0';
-                    value[validx] = '\0';
                     StripWhiteSpace(key);
                     StripWhiteSpace(value);
                 }
@@ -883,25 +2471,8 @@ int KeyValueInputFile::Read(char* key, char* value, int maxlen)
             ++buffidx;
         }
 
-        if (retval == 0)
-        {
-            const auto read_bytes = ::read(filedes, buffer.data(), buffer.size());
-            if (read_bytes <= 0)
-            {
-                bytesread = 0;
-            }
-            else
-            {
-                bytesread = static_cast<std::size_t>(read_bytes);
-                buffidx = 0;
-            }
-        }
-    }
-
-    if (retval == 1)
-    {
-        key[keyidx] = '\0';
-        value[validx] = '\0';
+        if (retval == 0 && !Fill())
+            break;
     }
 
     return retval;
@@ -31,9 +31,100 @@
 #include <cstdint>
 #include <cstdio>
 #include <string>
+#include <string_view>
+#include <vector>
 
 inline constexpr std::size_t DataFileBlockSize = 16384;
 
+/*********************************************************************
+ * Data file formats
+ ********************************************************************/
+// Text is the historical "vtpos 0 <version>" token stream.  Binary is a
+// block-framed stream of tagged fields (varint integers, raw doubles,
+// length-prefixed strings), optionally zlib-compressed per block.
+// InputDataFile detects either format (and the pre-1998 "version_"
+// header) on its own, so readers never need to know which was used.
+enum class DataFileFormat : int
+{
+    Text   = 0,
+    Binary = 1
+};
+
+// File families whose on-disk format can be chosen independently
+// (see the *fileformat keys in .viewtouch_config).  Archives default to
+// binary, everything else to text.
+enum class DataFileKind : int
+{
+    Generic = 0,
+    Check,
+    Drawer,
+    Archive,
+    Settings,
+    Count
+};
+
+[[nodiscard]] DataFileFormat DataFileFormatFor(DataFileKind kind) noexcept;
+void SetDataFileFormat(DataFileKind kind, DataFileFormat format) noexcept;
+[[nodiscard]] bool ParseDataFileFormat(std::string_view name, DataFileFormat &format) noexcept;
+
+/*********************************************************************
+ * Durability
+ ********************************************************************/
+// How OutputDataFile replaces the file it writes (see the datafilesync
+// key in .viewtouch_config).  Every mode but Direct writes a hidden temp
+// file in the same directory and renames it over the original on
+// Close(), so a crash leaves either the old file or the new one.  The
+// temp file takes the original's mode and owner, but a hard link or
+// symlink is replaced rather than written through, so Direct stays the
+// default and sites opt in.
+enum class DataFileSync : int
+{
+    Direct = 0,  // truncate and rewrite in place (no crash safety)
+    None,        // temp file + rename, no fsync
+    File,        // temp file + fsync + rename + directory fsync
+    Group        // renames wait for DataFileGroupCommit() to sync the batch
+};
+
+[[nodiscard]] DataFileSync GetDataFileSync() noexcept;
+void SetDataFileSync(DataFileSync sync);
+[[nodiscard]] bool ParseDataFileSync(std::string_view name, DataFileSync &sync) noexcept;
+// Syncs and renames every file waiting in the group; returns the number
+// of files that could not be committed.  Cheap when nothing is waiting.
+int DataFileGroupCommit();
+[[nodiscard]] std::size_t DataFileGroupPending();
+// Drops any save of filename still queued or not yet renamed into place
+// (waiting out one being written), so a file about to be deleted isn't
+// brought back by the writer or a later commit.  Returns 1 if one was
+// dropped (the file may then not exist on disk yet), else 0.
+int DataFileForget(const std::string &filename);
+// Writes a queued save of filename and commits its pending group save,
+// so the file on disk is its latest save; other files keep waiting.
+// Returns the number of saves that failed.
+int DataFileSettle(const std::string &filename);
+
+// Field types of the binary format.  Token holds a raw text-format token
+// and is only produced by converting text files (vt_dataconv), where the
+// value types are not known; it is decoded with the text rules on read.
+enum class DataFieldType : uint8_t
+{
+    None    = 0,
+    Integer = 1,
+    Real    = 2,
+    String  = 3,
+    Token   = 4
+};
+
+// One schema-free field, as seen by ReadField()/WriteField().  'text'
+// refers to the reader's buffer and is only valid until the next read.
+struct DataFileField
+{
+    DataFieldType    type{DataFieldType::None};
+    bool             line_break{false};
+    uint64_t         integer{0};
+    double           real{0.0};
+    std::string_view text;
+};
+
 /*********************************************************************
  * InputDataFile
  ********************************************************************/
@@ -41,7 +132,27 @@ class InputDataFile
 {
     gzFile fp{nullptr};
     bool old_format{false};
+    bool binary{false};
+    bool corrupt{false};
     std::string filename;
+    std::vector<unsigned char> block;   // current decoded binary block
+    std::size_t block_pos{0};
+    z_off_t block_start{0};             // stream offset of the current block
+    std::string token_text;             // holds tokens that span text buffer refills
+    std::vector<char> text;             // buffered text-format input
+    std::size_t text_pos{0};
+    std::size_t text_end{0};
+    bool text_eof{false};
+    bool memory{false};                 // reading a text record from OpenMemory()
+
+    bool NextBlock();
+    bool NextField(DataFileField &field);
+    uint64_t FieldValue(const DataFileField &field);
+    bool FillText();
+    bool NextToken(std::string_view &token, char &delim, bool skip_space);
+    z_off_t TextRewind();
+    int RawChar();
+    void TextSeek(z_off_t pos);
 
 public:
     bool end_of_file{false};
@@ -49,9 +160,10 @@ public:
     InputDataFile() = default;
     ~InputDataFile();
 
-    [[nodiscard]] bool is_open() const noexcept { return fp != nullptr; }
+    [[nodiscard]] bool is_open() const noexcept { return fp != nullptr || memory; }
 
     int Open(const std::string &filename, int &version);
+    int OpenMemory(std::string_view data);  // headerless text, e.g. a journal record
     int Close() noexcept;
 
     int GetToken(char* buffer, int max_len);
@@ -83,7 +195,22 @@ public:
 
     int PeekTokens();
     const char* ShowTokens(char* buffer = nullptr, int lines = 1);
+
+    // Position of the next unread value, for Seek() to return to later
+    // (e.g. from an archive index).  Only meaningful for the file it came
+    // from.  A binary position names its block, so seeking there reads
+    // just that block; seeking back in a gzipped text file inflates it
+    // again from the start.
+    [[nodiscard]] uint64_t Tell();
+    int Seek(uint64_t pos);
     [[nodiscard]] const std::string &FileName() const noexcept { return filename; }
+
+    // schema-free access for format conversion
+    int ReadField(DataFileField &field);
+    [[nodiscard]] bool IsBinary() const noexcept { return binary; }
+    [[nodiscard]] bool IsLegacyEncoding() const noexcept { return old_format; }
+    // a block, field or read failed; a clean end of file leaves this false
+    [[nodiscard]] bool IsCorrupt() const noexcept { return corrupt; }
 };
 
 /*********************************************************************
@@ -94,15 +221,39 @@ class OutputDataFile
     gzFile gz_fp{nullptr};
     std::FILE* file_fp{nullptr};
     bool compress{false};
+    bool binary{false};
     std::string filename;
+    std::string temp_path;               // written here, renamed to filename on Close()
+    int sync_fd{-1};                     // duplicate of the temp file's descriptor, for fsync
+    DataFileSync sync{DataFileSync::Direct}; // mode at Open(), used by CommitTemp()
+    char* memory{nullptr};               // open_memstream() buffer for OpenMemory()
+    std::size_t memory_size{0};
+    std::vector<unsigned char> pending;  // binary block being assembled
+
+    int OpenTemp(bool gzip);
+    int CommitTemp(bool failed);
+
+    int PutField(DataFieldType type, int bk, uint64_t integer, double real, std::string_view text);
+    int FlushBlock();
+    int PackBlocks(std::string_view data);
 
 public:
     OutputDataFile() = default;
     ~OutputDataFile();
 
-    int Open(const std::string &filename, int version, int use_compression = 0);
+    int Open(const std::string &filename, int version, int use_compression = 0,
+             DataFileKind kind = DataFileKind::Generic);
+    int Open(const std::string &filename, int version, int use_compression, DataFileFormat format);
+    int OpenMemory(DataFileFormat format = DataFileFormat::Text);  // headerless, see Contents()
     int Close() noexcept;
 
+    // everything written so far by an OpenMemory() stream
+    [[nodiscard]] std::string_view Contents();
+    // copies already encoded output (e.g. from Contents()) into the stream
+    int WriteRaw(std::string_view data);
+    [[nodiscard]] DataFileFormat Format() const noexcept
+    { return binary ? DataFileFormat::Binary : DataFileFormat::Text; }
+
     int PutValue(uint64_t val, int bk);
 
     // using the following conversions
@@ -131,10 +282,56 @@ public:
     int Write(Flt  *val, int bk = 0);
     int Write(Str  *val, int bk = 0);
     [[nodiscard]] const std::string &FileName() const noexcept { return filename; }
+
+    // schema-free access for format conversion
+    int WriteField(const DataFileField &field);
+    [[nodiscard]] bool IsBinary() const noexcept { return binary; }
 };
 
+/*********************************************************************
+ * Write-behind queue
+ ********************************************************************/
+// A save encoded in memory (OutputDataFile::OpenMemory()) can be handed
+// to a background thread that compresses and writes it like Open() +
+// WriteRaw() + Close() would.  A newer save of a queued path replaces
+// the queued one, a direct OutputDataFile::Open() or DataFileForget() of
+// the path drops it, and InputDataFile::Open() writes it first, so
+// readers and direct writers never race a stale copy.  QueueDataFile()
+// blocks while DataFileQueueLimit saves are waiting.
+inline constexpr std::size_t DataFileQueueLimit = 256;
+
+struct DataFileWriterStats
+{
+    std::size_t depth{0};      // saves waiting now
+    std::size_t max_depth{0};
+    uint64_t    written{0};
+    uint64_t    failed{0};
+    uint64_t    stalls{0};     // QueueDataFile() calls that waited for room
+    double      last_ms{0.0};  // from queueing to written, last save
+    double      max_ms{0.0};
+};
+
+int QueueDataFile(const std::string &filename, int version, int use_compression,
+                  OutputDataFile &body);
+// Waits until every queued save is written; returns how many of them failed.
+int DataFileFlushQueue();
+// Writes what is queued and stops the thread; later saves are written
+// by the caller.
+void DataFileStopWriter();
+[[nodiscard]] DataFileWriterStats GetDataFileWriterStats();
+#ifdef VT_TESTING
+// Keeps the writer from starting another save until DataFileFlushQueue(),
+// so tests can look at saves while they are still queued.
+void DataFileHoldQueue();
+#endif
+
 /*********************************************************************
  * KeyValueInputFile
+ *
+ * Reads "key: value" lines.  On a non-blocking descriptor Read()
+ * returns 0 when nothing more has arrived and picks up a partial line
+ * where it left off next time, as long as it is handed the same key
+ * and value buffers; Closed() tells that apart from the end of input.
  ********************************************************************/
 class KeyValueInputFile
 {
@@ -146,10 +343,14 @@ private:
     std::size_t buffidx{0};
     bool comment{false};
     bool getvalue{false};
+    bool closed{false};
+    char last{'\0'};
     char delimiter{':'};
     std::array<char, DataFileBlockSize> buffer{};
     std::string inputfile;
 
+    bool Fill();
+
 public:
     KeyValueInputFile() = default;
     explicit KeyValueInputFile(int fd);
@@ -171,6 +372,8 @@ public:
         , buffidx(other.buffidx)
         , comment(other.comment)
         , getvalue(other.getvalue)
+        , closed(other.closed)
+        , last(other.last)
         , delimiter(other.delimiter)
         , buffer(std::move(other.buffer))
         , inputfile(std::move(other.inputfile))
@@ -190,6 +393,8 @@ public:
             buffidx = other.buffidx;
             comment = other.comment;
             getvalue = other.getvalue;
+            closed = other.closed;
+            last = other.last;
             delimiter = other.delimiter;
             buffer = std::move(other.buffer);
             inputfile = std::move(other.inputfile);
@@ -207,6 +412,8 @@ public:
     int Close();
     int Reset();
     int Read(char* key, char* value, int maxlen);
+    // The descriptor reached end of file or failed (not just empty for now)
+    [[nodiscard]] bool Closed() const noexcept { return closed; }
 };
 
 /*********************************************************************
@@ -6,7 +6,10 @@
 #include "main/hardware/terminal.hh"
 #include "main/data/manager.hh"
 #include "main/hardware/remote_printer.hh"
+#include "main/hardware/drawer.hh"
+#include "data_file.hh"
 #include "logger.hh"
+#include "src/utils/vt_logger.hh"
 #include <fstream>
 #include <sstream>
 #include <algorithm>
@@ -131,7 +134,8 @@ void DataPersistenceManager::Initialize(System* system)
     // Register critical data validation and save callbacks
     manager.RegisterCriticalData("checks", 
         [&manager]() { return manager.ValidateChecks(); },
-        [&manager]() { return manager.SaveAllChecks(); });
+        [&manager]() { return manager.SaveAllChecks(); },
+        [&manager]() { return manager.SaveAllChecks(true); });
     
     manager.RegisterCriticalData("settings",
         [&manager]() { return manager.ValidateSettings(); },
@@ -140,6 +144,11 @@ void DataPersistenceManager::Initialize(System* system)
     manager.RegisterCriticalData("archives",
         [&manager]() { return manager.ValidateArchives(); },
         [&manager]() { return manager.SaveAllArchives(); });
+
+    manager.RegisterCriticalData("drawers",
+        []() { return ValidationResult::VALIDATION_SUCCESS; },
+        [&manager]() { return manager.SaveAllDrawers(); },
+        [&manager]() { return manager.SaveAllDrawers(true); });
     
     manager.RegisterCriticalData("terminals",
         [&manager]() { return manager.ValidateTerminals(); },
@@ -326,6 +335,11 @@ DataPersistenceManager::SaveResult DataPersistenceManager::SaveAllData()
             overall_result = result;
         }
     }
+
+    // callers expect the data on disk when this returns
+    if (DataFileFlushQueue() > 0 && overall_result < SAVE_PARTIAL) {
+        overall_result = SAVE_PARTIAL;
+    }
     
     return overall_result;
 }
@@ -348,6 +362,11 @@ DataPersistenceManager::SaveResult DataPersistenceManager::SaveCriticalData()
             overall_result = result;
         }
     }
+
+    // callers expect the data on disk when this returns
+    if (DataFileFlushQueue() > 0 && overall_result < SAVE_PARTIAL) {
+        overall_result = SAVE_PARTIAL;
+    }
     
     return overall_result;
 }
@@ -360,7 +379,8 @@ void DataPersistenceManager::RegisterSaveCallback(const std::string& name, const
 
 void DataPersistenceManager::RegisterCriticalData(const std::string& name,
                                                  ValidationCallback validator,
-                                                 SaveCallback saver)
+                                                 SaveCallback saver,
+                                                 SaveCallback dirty_saver)
 {
     CriticalData data_item;
     data_item.name = name;
@@ -368,6 +388,7 @@ void DataPersistenceManager::RegisterCriticalData(const std::string& name,
     data_item.last_modified = std::chrono::steady_clock::now();
     data_item.validator = std::move(validator);
     data_item.saver = std::move(saver);
+    data_item.dirty_saver = std::move(dirty_saver);
     data_item.consecutive_failures = 0;
     data_item.last_failure = std::chrono::steady_clock::now();
 
@@ -464,14 +485,16 @@ void DataPersistenceManager::ProcessPeriodicTasks()
     if (config.enable_auto_save) {
         auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - last_auto_save);
         if (elapsed >= config.auto_save_interval) {
+            MarkChangedObjects();
             // Check if there's actually dirty data to save
-            if (IsDataDirty("checks") || IsDataDirty("settings") || IsDataDirty("archives")) {
+            if (IsDataDirty("checks") || IsDataDirty("settings") || IsDataDirty("archives") ||
+                IsDataDirty("drawers")) {
                 // Skip auto-save if any terminal is in edit mode to avoid interrupting user workflow
                 if (IsAnyTerminalInEditMode()) {
                     LogInfo("Skipping auto-save - terminal in edit mode (data is dirty)");
                 } else {
                     LogInfo("Performing periodic auto-save (dirty data detected)");
-                    SaveResult result = SaveCriticalData();
+                    SaveResult result = SaveDirtyData();
                     if (result == SAVE_SUCCESS) {
                         last_auto_save = now;
                         LogInfo("Auto-save completed successfully");
@@ -487,10 +510,80 @@ void DataPersistenceManager::ProcessPeriodicTasks()
         }
     }
     
+    PublishWriterMetrics();
+
     // Check CUPS status
     CheckCUPSStatus();
 }
 
+// Checks and drawers only set their own dirty flag when they change (they
+// are also read on loader threads), so their categories are marked here.
+void DataPersistenceManager::MarkChangedObjects()
+{
+    if (!system_ref) {
+        return;
+    }
+    for (Check* check = system_ref->CheckList(); check != nullptr; check = check->next) {
+        if (check->dirty) {
+            MarkDataDirty("checks");
+            break;
+        }
+    }
+    for (Drawer* drawer = system_ref->DrawerList(); drawer != nullptr; drawer = drawer->next) {
+        if (drawer->dirty) {
+            MarkDataDirty("drawers");
+            break;
+        }
+    }
+}
+
+// Runs the savers of dirty categories only, and of checks and drawers
+// writes only the changed ones.  They are queued for the write-behind
+// thread, so this does not wait for the disk.
+DataPersistenceManager::SaveResult DataPersistenceManager::SaveDirtyData()
+{
+    FnTrace("DataPersistenceManager::SaveDirtyData()");
+    SaveResult overall_result = SAVE_SUCCESS;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (auto& data_item : critical_data_items) {
+        if (!data_item.is_dirty) {
+            continue;
+        }
+        SaveResult result = data_item.dirty_saver ? data_item.dirty_saver() : data_item.saver();
+        if (result == SAVE_SUCCESS) {
+            data_item.is_dirty = false;
+            data_item.consecutive_failures = 0;
+        } else {
+            data_item.consecutive_failures++;
+            data_item.last_failure = std::chrono::steady_clock::now();
+        }
+        if (result > overall_result) {
+            overall_result = result;
+        }
+    }
+
+    metrics.total_saves++;
+    if (overall_result != SAVE_SUCCESS) {
+        metrics.failed_saves++;
+    }
+    metrics.total_save_time += std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    return overall_result;
+}
+
+void DataPersistenceManager::PublishWriterMetrics()
+{
+    const DataFileWriterStats stats = GetDataFileWriterStats();
+    vt::PerformanceMonitor::record_metric("persistence.queue_depth", static_cast<double>(stats.depth));
+    vt::PerformanceMonitor::record_metric("persistence.queue_max_depth", static_cast<double>(stats.max_depth));
+    vt::PerformanceMonitor::record_metric("persistence.save_latency_ms", stats.last_ms);
+    vt::PerformanceMonitor::record_metric("persistence.save_latency_max_ms", stats.max_ms);
+    vt::PerformanceMonitor::record_metric("persistence.saves_written", static_cast<double>(stats.written));
+    vt::PerformanceMonitor::record_metric("persistence.saves_failed", static_cast<double>(stats.failed));
+    vt::PerformanceMonitor::record_metric("persistence.queue_stalls", static_cast<double>(stats.stalls));
+}
+
 void DataPersistenceManager::Update()
 {
     ProcessPeriodicTasks();
@@ -802,7 +895,9 @@ void DataPersistenceManager::EmergencySave()
     
     // Save only the most critical data
     SaveAllChecks();
+    SaveAllDrawers();
     SaveAllSettings();
+    DataFileFlushQueue();
     
     LogInfo("Emergency save completed");
 }
@@ -1010,7 +1105,7 @@ DataPersistenceManager::ValidationResult DataPersistenceManager::ValidateCUPSCom
 }
 
 // Internal save methods
-DataPersistenceManager::SaveResult DataPersistenceManager::SaveAllChecks()
+DataPersistenceManager::SaveResult DataPersistenceManager::SaveAllChecks(bool dirty_only)
 {
     FnTrace("DataPersistenceManager::SaveAllChecks()");
 
@@ -1023,19 +1118,19 @@ DataPersistenceManager::SaveResult DataPersistenceManager::SaveAllChecks()
     int total_count = 0;
     int failed_count = 0;
 
-    // Single pass through the linked list for efficiency
+    // With dirty_only, skip checks nothing has changed since their file
+    // was last written; the critical and emergency saves write them all.
     // Add safety limit to prevent infinite loops from corrupted linked lists
     const int MAX_CHECKS = 100000;  // Reasonable upper limit
     Check* check = system_ref->CheckList();
-    while (check != nullptr && total_count < MAX_CHECKS) {
-        total_count++;
-
-        // Skip training checks - we don't want to backup/save training data
-        if (check->IsTraining()) {
-            LogInfo("Skipping training check (serial: " + std::to_string(check->serial_number) + ")");
+    int walked = 0;
+    while (check != nullptr && walked < MAX_CHECKS) {
+        walked++;
+        if ((dirty_only && !check->dirty) || check->IsTraining() || check->copy) {
             check = check->next;
             continue;
         }
+        total_count++;
 
         // Skip invalid checks that can't be saved
         if (check->serial_number <= 0) {
@@ -1047,7 +1142,9 @@ DataPersistenceManager::SaveResult DataPersistenceManager::SaveAllChecks()
             continue;
         }
 
-        if (check->Save() == 0) {
+        // encoded now, written by the write-behind thread
+        if (system_ref->SaveCheck(check, 1) == 0) {
+            check->dirty = 0;
             saved_count++;
         } else {
             failed_count++;
@@ -1061,7 +1158,7 @@ DataPersistenceManager::SaveResult DataPersistenceManager::SaveAllChecks()
     }
 
     // Check if we hit the iteration limit (possible corrupted linked list)
-    if (total_count >= MAX_CHECKS) {
+    if (walked >= MAX_CHECKS) {
         LogError("SaveAllChecks() hit iteration limit (" + std::to_string(MAX_CHECKS) + 
                  "), possible infinite loop prevented. Check list may be corrupted.", "save");
     }
@@ -1077,16 +1174,45 @@ DataPersistenceManager::SaveResult DataPersistenceManager::SaveAllChecks()
                 std::to_string(total_count) + " total", "save");
     }
 
-    double save_ratio = static_cast<double>(saved_count) / total_count;
-    if (save_ratio >= 0.95) {
+    if (failed_count == 0) {
         return SAVE_SUCCESS;
-    } else if (save_ratio >= 0.80) {
+    }
+    double save_ratio = static_cast<double>(saved_count) / total_count;
+    if (save_ratio >= 0.80) {
         return SAVE_PARTIAL;
     } else {
         return SAVE_FAILED;
     }
 }
 
+DataPersistenceManager::SaveResult DataPersistenceManager::SaveAllDrawers(bool dirty_only)
+{
+    FnTrace("DataPersistenceManager::SaveAllDrawers()");
+
+    if (!system_ref) {
+        LogError("Cannot save drawers - system reference is null", "save");
+        return SAVE_FAILED;
+    }
+
+    int failed_count = 0;
+    for (Drawer* drawer = system_ref->DrawerList(); drawer != nullptr; drawer = drawer->next) {
+        if (dirty_only && !drawer->dirty) {
+            continue;
+        }
+        if (system_ref->SaveDrawer(drawer, 1) == 0) {
+            drawer->dirty = 0;
+        } else {
+            failed_count++;
+        }
+    }
+
+    if (failed_count > 0) {
+        LogError("Failed to save " + std::to_string(failed_count) + " drawers", "save");
+        return SAVE_FAILED;
+    }
+    return SAVE_SUCCESS;
+}
+
 DataPersistenceManager::SaveResult DataPersistenceManager::SaveAllSettings()
 {
     FnTrace("DataPersistenceManager::SaveAllSettings()");
@@ -1120,7 +1246,7 @@ DataPersistenceManager::SaveResult DataPersistenceManager::SaveAllArchives()
         return SAVE_FAILED;
     }
     
-    return system_ref->SaveChanged() == 0 ? SAVE_SUCCESS : SAVE_FAILED;
+    return system_ref->QueueChanged() == 0 ? SAVE_SUCCESS : SAVE_FAILED;
 }
 
 DataPersistenceManager::SaveResult DataPersistenceManager::SaveAllTerminals()
@@ -1341,6 +1467,12 @@ std::string DataPersistenceManager::GeneratePerformanceReport() const
     report << "Save success rate: " << GetSaveSuccessRate() * 100 << "%\n";
     report << "Validation success rate: " << GetValidationSuccessRate() * 100 << "%\n";
 
+    const DataFileWriterStats writer = GetDataFileWriterStats();
+    report << "Write-behind queue depth: " << writer.depth << " (max " << writer.max_depth << ")\n";
+    report << "Write-behind saves: " << writer.written << " written, " << writer.failed << " failed, "
+           << writer.stalls << " stalls\n";
+    report << "Write-behind latency: " << writer.last_ms << "ms (max " << writer.max_ms << "ms)\n";
+
     return report.str();
 }
 
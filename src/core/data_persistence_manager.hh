@@ -125,6 +125,7 @@ private:
         std::chrono::steady_clock::time_point last_modified;
         ValidationCallback validator;
         SaveCallback saver;
+        SaveCallback dirty_saver;  // auto-save: only the changed objects
         int consecutive_failures{0};
         std::chrono::steady_clock::time_point last_failure;
 
@@ -176,10 +177,14 @@ private:
     ValidationResult ValidateCUPSCommunication();
     
     // Internal save methods
-    SaveResult SaveAllChecks();
+    SaveResult SaveAllChecks(bool dirty_only = false);
     SaveResult SaveAllSettings();
     SaveResult SaveAllArchives();
+    SaveResult SaveAllDrawers(bool dirty_only = false);
     SaveResult SaveAllTerminals();
+    SaveResult SaveDirtyData();
+    void MarkChangedObjects();
+    void PublishWriterMetrics();
     
     // CUPS monitoring methods
     bool CheckCUPSHealth();
@@ -223,7 +228,8 @@ public:
     // Critical data management
     void RegisterCriticalData(const std::string& name, 
                              ValidationCallback validator, 
-                             SaveCallback saver);
+                             SaveCallback saver,
+                             SaveCallback dirty_saver = nullptr);
     void MarkDataDirty(const std::string& name);
     void MarkDataClean(const std::string& name);
     bool IsDataDirty(const std::string& name) const;
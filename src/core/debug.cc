@@ -137,9 +137,9 @@ constexpr std::array<const char*, 95> term_codes = {
     "",
     "",
     "",
-    "",
-    "",
-    "",
+    "TERM_LINKSWITCH",
+    "TERM_PAGESTORE",
+    "TERM_PAGERECALL",
     "TERM_FLUSH_TS",
     "TERM_CALIBRATE_TS",
     "TERM_USERINPUT",
@@ -216,7 +216,7 @@ void PrintTermCode( int code ) noexcept
     }
 }
 
-constexpr std::array<const char*, 24> server_codes = {
+constexpr std::array<const char*, 26> server_codes = {
     "",
     "SrvError",
     "SrvTermInfo",
@@ -236,10 +236,13 @@ constexpr std::array<const char*, 24> server_codes = {
     "SrvItemSelect",
     "SrvTextEntry",
     "",
-    "",
+    "SrvLinkOffer",
     "SrvPrinterDone",
     "SrvBadFile",
-    "SrvDefPage"
+    "SrvDefPage",
+    "SrvLinkSwitch",
+    "SrvPageMiss",
+    "SrvImageReady"
 };
 constexpr int num_server_codes = static_cast<int>(server_codes.size());
 void PrintServerCode( int code ) noexcept
@@ -22,6 +22,29 @@ namespace
     return reinterpret_cast<const FcChar8*>(text.data());
 }
 
+// Blur steps a drop shadow is drawn with
+[[nodiscard]] constexpr int ShadowBlurSteps(int blur_radius) noexcept
+{
+    // Performance optimization: Limit blur iterations on slower hardware
+    // On Raspberry Pi, reduce blur complexity to improve performance
+    return (blur_radius > 2) ? 2 : blur_radius;  // Cap at 2 for performance
+}
+
+// Draws glyphs when the caller has looked them up already, else the text
+void DrawRun(XftDraw* draw,
+             const XftColor* color,
+             XftFont* font,
+             int x,
+             int y,
+             std::span<const genericChar> text,
+             std::span<const FT_UInt> glyphs)
+{
+    if (!glyphs.empty())
+        XftDrawGlyphs(draw, color, font, x, y, glyphs.data(), static_cast<int>(glyphs.size()));
+    else
+        XftDrawStringUtf8(draw, color, font, x, y, ToFcUtf8(text), ToInt(text));
+}
+
 } // namespace
 
 void GenericDrawString(Display* display,
@@ -54,7 +77,8 @@ void GenericDrawStringXft(Display* display,
                           int x,
                           int y,
                           std::span<const genericChar> text,
-                          int screen_number)
+                          int screen_number,
+                          std::span<const FT_UInt> glyphs)
 {
     if (display == nullptr || draw == nullptr || font == nullptr || color == nullptr || text.empty())
     {
@@ -67,7 +91,7 @@ void GenericDrawStringXft(Display* display,
                        DefaultColormap(display, screen_number),
                        color,
                        &xft_color);
-    XftDrawStringUtf8(draw, &xft_color, font, x, y, ToFcUtf8(text), ToInt(text));
+    DrawRun(draw, &xft_color, font, x, y, text, glyphs);
     XftColorFree(display,
                  DefaultVisual(display, screen_number),
                  DefaultColormap(display, screen_number),
@@ -82,7 +106,8 @@ void GenericDrawStringXftEmbossed(Display* display,
                                   int x,
                                   int y,
                                   std::span<const genericChar> text,
-                                  int screen_number)
+                                  int screen_number,
+                                  std::span<const FT_UInt> glyphs)
 {
     if (display == nullptr || draw == nullptr || font == nullptr || color == nullptr || text.empty())
     {
@@ -102,9 +127,6 @@ void GenericDrawStringXftEmbossed(Display* display,
     XftColorAllocValue(display, DefaultVisual(display, screen_number), DefaultColormap(display, screen_number), &black_color, &xft_black);
     XftColorAllocValue(display, DefaultVisual(display, screen_number), DefaultColormap(display, screen_number), color, &xft_main);
 
-    const FcChar8* fc_text = ToFcUtf8(text);
-    const int text_length = ToInt(text);
-
     // Check if text color is black (or very dark) or dark brown
     // Black is considered when all RGB components are very low (< 1000 out of 65535)
     // Dark brown RGB is {80, 45, 25} in 8-bit, which scales to {20480, 11520, 6400} in 16-bit
@@ -124,21 +146,21 @@ void GenericDrawStringXftEmbossed(Display* display,
     if (is_black || is_dark_brown)
     {
         // For black or dark brown text, draw white at bottom and right (2 pixels right for widescreen)
-        XftDrawStringUtf8(draw, &xft_embossed, font, x + 2, y + 1, fc_text, text_length);  // bottom-right, 2px right
+        DrawRun(draw, &xft_embossed, font, x + 2, y + 1, text, glyphs);  // bottom-right, 2px right
     }
     else if (is_white || is_yellow)
     {
         // For white or yellow text, draw black at bottom and right edges
-        XftDrawStringUtf8(draw, &xft_black, font, x + 1, y + 1, fc_text, text_length);  // bottom-right edge
+        DrawRun(draw, &xft_black, font, x + 1, y + 1, text, glyphs);  // bottom-right edge
     }
     else
     {
         // For other colors, draw white at top (original behavior)
-        XftDrawStringUtf8(draw, &xft_embossed, font, x, y - 1, fc_text, text_length);     // top
+        DrawRun(draw, &xft_embossed, font, x, y - 1, text, glyphs);     // top
     }
 
     // Draw main text on top
-    XftDrawStringUtf8(draw, &xft_main, font, x, y, fc_text, text_length);
+    DrawRun(draw, &xft_main, font, x, y, text, glyphs);
 
     XftColorFree(display, DefaultVisual(display, screen_number), DefaultColormap(display, screen_number), &xft_black);
 
@@ -146,6 +168,84 @@ void GenericDrawStringXftEmbossed(Display* display,
     XftColorFree(display, DefaultVisual(display, screen_number), DefaultColormap(display, screen_number), &xft_main);
 }
 
+int GenericMakeShadowMask(Display* display,
+                          Drawable drawable,
+                          XftFont* font,
+                          std::span<const FT_UInt> glyphs,
+                          int offset_x,
+                          int offset_y,
+                          int blur_radius,
+                          GenericShadowMask& mask)
+{
+    mask = GenericShadowMask{};
+    if (display == nullptr || font == nullptr || glyphs.empty())
+    {
+        return 1;
+    }
+
+    const int count = static_cast<int>(glyphs.size());
+    XGlyphInfo ink{};
+    XftGlyphExtents(display, font, glyphs.data(), count, &ink);
+    const int max_blur = ShadowBlurSteps(blur_radius);
+    const int spread = max_blur * 2;
+    if (ink.width == 0 || ink.height == 0)
+    {
+        return 1;
+    }
+
+    // the ink box of the steps drawn, with the text origin at (ox, oy)
+    mask.width = ink.width + spread * 2;
+    mask.height = ink.height + spread * 2;
+    const int ox = spread + ink.x;
+    const int oy = spread + ink.y;
+    mask.x = offset_x - ox;
+    mask.y = offset_y - oy;
+
+    XRenderPictFormat* format = XRenderFindStandardFormat(display, PictStandardA8);
+    if (format == nullptr)
+    {
+        mask = GenericShadowMask{};
+        return 1;
+    }
+    mask.pixmap = XCreatePixmap(display, drawable, static_cast<unsigned int>(mask.width),
+                                static_cast<unsigned int>(mask.height), 8);
+    XftDraw* alpha = XftDrawCreateAlpha(display, mask.pixmap, 8);
+    if (alpha == nullptr)
+    {
+        XFreePixmap(display, mask.pixmap);
+        mask = GenericShadowMask{};
+        return 1;
+    }
+
+    XftColor clear{};
+    XftColor opaque{};
+    opaque.color.alpha = 0xFFFF;
+    XftDrawRect(alpha, &clear, 0, 0, static_cast<unsigned int>(mask.width), static_cast<unsigned int>(mask.height));
+    for (int blur = 0; blur <= max_blur; ++blur)
+    {
+        const int blur_offset = blur * 2;
+        XftDrawGlyphs(alpha, &opaque, font, ox - blur_offset, oy - blur_offset, glyphs.data(), count);
+        XftDrawGlyphs(alpha, &opaque, font, ox + blur_offset, oy + blur_offset, glyphs.data(), count);
+    }
+    XftDrawDestroy(alpha);
+
+    mask.picture = XRenderCreatePicture(display, mask.pixmap, format, 0, nullptr);
+    return 0;
+}
+
+void GenericFreeShadowMask(Display* display, GenericShadowMask& mask)
+{
+    if (display == nullptr)
+    {
+        return;
+    }
+    if (mask.picture != None)
+        XRenderFreePicture(display, mask.picture);
+    if (mask.pixmap != None)
+        XFreePixmap(display, mask.pixmap);
+    mask = GenericShadowMask{};
+}
+
 void GenericDrawStringXftWithShadow(Display* display,
                                     [[maybe_unused]] Drawable /*drawable*/,
                                     XftDraw* draw,
@@ -157,7 +257,9 @@ void GenericDrawStringXftWithShadow(Display* display,
                                     int screen_number,
                                     int offset_x,
                                     int offset_y,
-                                    int blur_radius)
+                                    int blur_radius,
+                                    std::span<const FT_UInt> glyphs,
+                                    const GenericShadowMask* mask)
 {
     if (display == nullptr || draw == nullptr || font == nullptr || color == nullptr || text.empty())
     {
@@ -179,23 +281,31 @@ void GenericDrawStringXftWithShadow(Display* display,
     XftColorAllocValue(display, DefaultVisual(display, screen_number), DefaultColormap(display, screen_number), &shadow_color, &xft_shadow);
     XftColorAllocValue(display, DefaultVisual(display, screen_number), DefaultColormap(display, screen_number), color, &xft_main);
 
-    const FcChar8* fc_text = ToFcUtf8(text);
-    const int text_length = ToInt(text);
-
-    // Performance optimization: Limit blur iterations on slower hardware
-    // On Raspberry Pi, reduce blur complexity to improve performance
-    const int max_blur = (blur_radius > 2) ? 2 : blur_radius;  // Cap at 2 for performance
-    
-    // Draw shadow with reduced blur iterations for better performance
-    for (int blur = 0; blur <= max_blur; ++blur)
+    // The steps drawn one over another in opaque colour come to the same as
+    // the mask of all of them composited once
+    const Picture target = XftDrawPicture(draw);
+    if (mask != nullptr && mask->picture != None && target != None && shadow_color.alpha == 0xFFFF)
     {
-        const int blur_offset = blur * 2;
-        // Draw only 2 positions instead of 4 for better performance
-        XftDrawStringUtf8(draw, &xft_shadow, font, x + offset_x - blur_offset, y + offset_y - blur_offset, fc_text, text_length);
-        XftDrawStringUtf8(draw, &xft_shadow, font, x + offset_x + blur_offset, y + offset_y + blur_offset, fc_text, text_length);
+        const Picture fill = XRenderCreateSolidFill(display, &shadow_color);
+        XRenderComposite(display, PictOpOver, fill, mask->picture, target, 0, 0, 0, 0,
+                         x + mask->x, y + mask->y,
+                         static_cast<unsigned int>(mask->width), static_cast<unsigned int>(mask->height));
+        XRenderFreePicture(display, fill);
+    }
+    else
+    {
+        // Draw shadow with reduced blur iterations for better performance
+        const int max_blur = ShadowBlurSteps(blur_radius);
+        for (int blur = 0; blur <= max_blur; ++blur)
+        {
+            const int blur_offset = blur * 2;
+            // Draw only 2 positions instead of 4 for better performance
+            DrawRun(draw, &xft_shadow, font, x + offset_x - blur_offset, y + offset_y - blur_offset, text, glyphs);
+            DrawRun(draw, &xft_shadow, font, x + offset_x + blur_offset, y + offset_y + blur_offset, text, glyphs);
+        }
     }
 
-    XftDrawStringUtf8(draw, &xft_main, font, x, y, fc_text, text_length);
+    DrawRun(draw, &xft_main, font, x, y, text, glyphs);
 
     XftColorFree(display, DefaultVisual(display, screen_number), DefaultColormap(display, screen_number), &xft_shadow);
     XftColorFree(display, DefaultVisual(display, screen_number), DefaultColormap(display, screen_number), &xft_main);
@@ -209,7 +319,8 @@ void GenericDrawStringXftAntialiased(Display* display,
                                      int x,
                                      int y,
                                      std::span<const genericChar> text,
-                                     int screen_number)
+                                     int screen_number,
+                                     std::span<const FT_UInt> glyphs)
 {
     if (display == nullptr || draw == nullptr || font == nullptr || color == nullptr || text.empty())
     {
@@ -225,6 +336,6 @@ void GenericDrawStringXftAntialiased(Display* display,
 
     XftColor xft_color{};
     XftColorAllocValue(display, DefaultVisual(display, screen_number), DefaultColormap(display, screen_number), &enhanced_color, &xft_color);
-    XftDrawStringUtf8(draw, &xft_color, font, x, y, ToFcUtf8(text), ToInt(text));
+    DrawRun(draw, &xft_color, font, x, y, text, glyphs);
     XftColorFree(display, DefaultVisual(display, screen_number), DefaultColormap(display, screen_number), &xft_color);
 }
@@ -43,7 +43,8 @@ void GenericDrawStringXft(Display* display,
                           int x,
                           int y,
                           std::span<const genericChar> text,
-                          int screen_number);
+                          int screen_number,
+                          std::span<const FT_UInt> glyphs = {});
 
 inline void GenericDrawStringXft(Display* display,
                                  Drawable drawable,
@@ -54,7 +55,8 @@ inline void GenericDrawStringXft(Display* display,
                                  int y,
                                  const genericChar* text,
                                  int length,
-                                 int screen_number)
+                                 int screen_number,
+                                 std::span<const FT_UInt> glyphs = {})
 {
     GenericDrawStringXft(display,
                          drawable,
@@ -64,7 +66,8 @@ inline void GenericDrawStringXft(Display* display,
                          x,
                          y,
                          MakeGenericCharSpan(text, length),
-                         screen_number);
+                         screen_number,
+                         glyphs);
 }
 
 void GenericDrawStringXftEmbossed(Display* display,
@@ -75,7 +78,8 @@ void GenericDrawStringXftEmbossed(Display* display,
                                   int x,
                                   int y,
                                   std::span<const genericChar> text,
-                                  int screen_number);
+                                  int screen_number,
+                                  std::span<const FT_UInt> glyphs = {});
 
 inline void GenericDrawStringXftEmbossed(Display* display,
                                          Drawable drawable,
@@ -86,7 +90,8 @@ inline void GenericDrawStringXftEmbossed(Display* display,
                                          int y,
                                          const genericChar* text,
                                          int length,
-                                         int screen_number)
+                                         int screen_number,
+                                         std::span<const FT_UInt> glyphs = {})
 {
     GenericDrawStringXftEmbossed(display,
                                  drawable,
@@ -96,9 +101,35 @@ inline void GenericDrawStringXftEmbossed(Display* display,
                                  x,
                                  y,
                                  MakeGenericCharSpan(text, length),
-                                 screen_number);
+                                 screen_number,
+                                 glyphs);
 }
 
+// A drop shadow drawn once into an alpha mask, so later draws of the same
+// text composite it in one pass instead of drawing every blur step again
+struct GenericShadowMask
+{
+    Pixmap pixmap{None};
+    Picture picture{None};
+    int x{0};       // left edge, from the text origin
+    int y{0};       // top edge, from the text origin
+    int width{0};
+    int height{0};
+};
+
+int GenericMakeShadowMask(Display* display,
+                          Drawable drawable,
+                          XftFont* font,
+                          std::span<const FT_UInt> glyphs,
+                          int offset_x,
+                          int offset_y,
+                          int blur_radius,
+                          GenericShadowMask& mask);
+// Draws the shadow GenericDrawStringXftWithShadow() would for glyphs into
+// a new mask.  Returns 1 (mask left empty) if there is nothing to draw.
+
+void GenericFreeShadowMask(Display* display, GenericShadowMask& mask);
+
 void GenericDrawStringXftWithShadow(Display* display,
                                     Drawable drawable,
                                     XftDraw* draw,
@@ -110,7 +141,9 @@ void GenericDrawStringXftWithShadow(Display* display,
                                     int screen_number,
                                     int offset_x,
                                     int offset_y,
-                                    int blur_radius);
+                                    int blur_radius,
+                                    std::span<const FT_UInt> glyphs = {},
+                                    const GenericShadowMask* mask = nullptr);
 
 inline void GenericDrawStringXftWithShadow(Display* display,
                                            Drawable drawable,
@@ -124,7 +157,9 @@ inline void GenericDrawStringXftWithShadow(Display* display,
                                            int screen_number,
                                            int offset_x,
                                            int offset_y,
-                                           int blur_radius)
+                                           int blur_radius,
+                                           std::span<const FT_UInt> glyphs = {},
+                                           const GenericShadowMask* mask = nullptr)
 {
     GenericDrawStringXftWithShadow(display,
                                    drawable,
@@ -137,7 +172,9 @@ inline void GenericDrawStringXftWithShadow(Display* display,
                                    screen_number,
                                    offset_x,
                                    offset_y,
-                                   blur_radius);
+                                   blur_radius,
+                                   glyphs,
+                                   mask);
 }
 
 void GenericDrawStringXftAntialiased(Display* display,
@@ -148,7 +185,8 @@ void GenericDrawStringXftAntialiased(Display* display,
                                      int x,
                                      int y,
                                      std::span<const genericChar> text,
-                                     int screen_number);
+                                     int screen_number,
+                                     std::span<const FT_UInt> glyphs = {});
 
 inline void GenericDrawStringXftAntialiased(Display* display,
                                             Drawable drawable,
@@ -159,7 +197,8 @@ inline void GenericDrawStringXftAntialiased(Display* display,
                                             int y,
                                             const genericChar* text,
                                             int length,
-                                            int screen_number)
+                                            int screen_number,
+                                            std::span<const FT_UInt> glyphs = {})
 {
     GenericDrawStringXftAntialiased(display,
                                     drawable,
@@ -169,5 +208,6 @@ inline void GenericDrawStringXftAntialiased(Display* display,
                                     x,
                                     y,
                                     MakeGenericCharSpan(text, length),
-                                    screen_number);
+                                    screen_number,
+                                    glyphs);
 }
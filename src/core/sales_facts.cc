@@ -0,0 +1,272 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * sales_facts.cc
+ * Columnar store of one archive's checks, orders and payments
+ */
+
+#include "sales_facts.hh"
+#include "fntrace.hh"
+
+#include <zlib.h>
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+/*********************************************************************
+ * File layout (gzip compressed, host byte order -- the file is a cache
+ * rebuilt from the archive, never moved between machines):
+ *   "VTFACTS\0", int32 version, int64 source size, int64 source mtime,
+ *   uint32 string count, then uint32 length + bytes per string,
+ *   then per column:  uint32 row count + the raw values
+ * Keeping each column contiguous lets zlib find the long runs of
+ * repeated families, types and user ids.
+ ********************************************************************/
+
+namespace {
+
+constexpr char FactsMagic[8] = {'V', 'T', 'F', 'A', 'C', 'T', 'S', '\0'};
+constexpr uint32_t MaxRows = 1u << 26;         // sanity limit for corrupt files
+constexpr uint32_t MaxStringLength = 1u << 16;
+
+bool WriteRaw(gzFile fp, const void *data, std::size_t len)
+{
+    if (len == 0)
+        return true;
+    return gzwrite(fp, data, static_cast<unsigned int>(len)) == static_cast<int>(len);
+}
+
+bool ReadRaw(gzFile fp, void *data, std::size_t len)
+{
+    if (len == 0)
+        return true;
+    return gzread(fp, data, static_cast<unsigned int>(len)) == static_cast<int>(len);
+}
+
+template <typename T>
+bool WriteColumn(gzFile fp, const std::vector<T> &column)
+{
+    const uint32_t rows = static_cast<uint32_t>(column.size());
+    return WriteRaw(fp, &rows, sizeof(rows)) &&
+           WriteRaw(fp, column.data(), column.size() * sizeof(T));
+}
+
+template <typename T>
+bool ReadColumn(gzFile fp, std::vector<T> &column)
+{
+    uint32_t rows = 0;
+    if (!ReadRaw(fp, &rows, sizeof(rows)) || rows > MaxRows)
+        return false;
+    column.resize(rows);
+    return ReadRaw(fp, column.data(), column.size() * sizeof(T));
+}
+
+template <typename First, typename... Rest>
+bool SameLength(const First &first, const Rest &... rest)
+{
+    return ((rest.size() == first.size()) && ...);
+}
+
+// every value in column is in [low, high)
+bool InRange(const std::vector<int32_t> &column, int64_t low, int64_t high)
+{
+    for (const int32_t value : column)
+    {
+        if (value < low || value >= high)
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+template <typename Self, typename Fn>
+void SalesFacts::ForEachColumn(Self &self, Fn &&fn)
+{
+    auto &c = self.checks;
+    fn(c.serial); fn(c.type); fn(c.flags); fn(c.user_open); fn(c.user_owner);
+    fn(c.guests); fn(c.time_open); fn(c.time_closed);
+
+    auto &s = self.subchecks;
+    fn(s.check); fn(s.number); fn(s.status); fn(s.drawer_id); fn(s.meal);
+    fn(s.total_sales); fn(s.total_tax); fn(s.tip); fn(s.payment); fn(s.settle_time);
+
+    auto &o = self.orders;
+    fn(o.sub); fn(o.parent); fn(o.name); fn(o.family); fn(o.item_type);
+    fn(o.sales_type); fn(o.qualifier); fn(o.status); fn(o.item_cost); fn(o.cost);
+    fn(o.total_cost); fn(o.total_comp); fn(o.count); fn(o.seat); fn(o.user_id);
+    fn(o.employee_meal); fn(o.is_reduced);
+
+    auto &p = self.payments;
+    fn(p.sub); fn(p.tender_type); fn(p.tender_id); fn(p.value); fn(p.amount);
+    fn(p.flags); fn(p.user_id); fn(p.drawer_id); fn(p.credit);
+}
+
+int32_t SalesFacts::Intern(std::string_view str)
+{
+    FnTrace("SalesFacts::Intern()");
+    std::string key(str);
+    const auto found = lookup.find(key);
+    if (found != lookup.end())
+        return found->second;
+
+    const int32_t id = static_cast<int32_t>(strings.size());
+    strings.push_back(key);
+    lookup.emplace(std::move(key), id);
+    return id;
+}
+
+const std::string &SalesFacts::String(int32_t id) const
+{
+    static const std::string empty;
+    if (id < 0 || static_cast<std::size_t>(id) >= strings.size())
+        return empty;
+    return strings[static_cast<std::size_t>(id)];
+}
+
+bool SalesFacts::Valid() const
+{
+    FnTrace("SalesFacts::Valid()");
+    const auto &c = checks;
+    const auto &s = subchecks;
+    const auto &o = orders;
+    const auto &p = payments;
+
+    if (!SameLength(c.serial, c.type, c.flags, c.user_open, c.user_owner, c.guests,
+                    c.time_open, c.time_closed) ||
+        !SameLength(s.check, s.number, s.status, s.drawer_id, s.meal, s.total_sales,
+                    s.total_tax, s.tip, s.payment, s.settle_time) ||
+        !SameLength(o.sub, o.parent, o.name, o.family, o.item_type, o.sales_type,
+                    o.qualifier, o.status, o.item_cost, o.cost, o.total_cost,
+                    o.total_comp, o.count, o.seat, o.user_id, o.employee_meal,
+                    o.is_reduced) ||
+        !SameLength(p.sub, p.tender_type, p.tender_id, p.value, p.amount, p.flags,
+                    p.user_id, p.drawer_id, p.credit))
+    {
+        return false;
+    }
+
+    if (!InRange(s.check, 0, static_cast<int64_t>(CheckCount())) ||
+        !InRange(o.sub, 0, static_cast<int64_t>(SubCheckCount())) ||
+        !InRange(o.name, 0, static_cast<int64_t>(strings.size())) ||
+        !InRange(p.sub, 0, static_cast<int64_t>(SubCheckCount())))
+    {
+        return false;
+    }
+
+    // a modifier follows the order it modifies
+    for (std::size_t row = 0; row < o.parent.size(); ++row)
+    {
+        if (o.parent[row] < -1 || o.parent[row] >= static_cast<int64_t>(row))
+            return false;
+    }
+    return true;
+}
+
+void SalesFacts::Clear()
+{
+    ForEachColumn(*this, [](auto &column) { column.clear(); });
+    strings.clear();
+    lookup.clear();
+    source_size  = -1;
+    source_mtime = -1;
+}
+
+int SalesFacts::Write(const std::string &path) const
+{
+    FnTrace("SalesFacts::Write()");
+    const std::string temp_path = path + ".tmp";
+    gzFile fp = gzopen(temp_path.c_str(), "wb6");
+    if (fp == nullptr)
+        return 1;
+
+    const int32_t version = SALES_FACTS_VERSION;
+    bool ok = WriteRaw(fp, FactsMagic, sizeof(FactsMagic)) &&
+              WriteRaw(fp, &version, sizeof(version)) &&
+              WriteRaw(fp, &source_size, sizeof(source_size)) &&
+              WriteRaw(fp, &source_mtime, sizeof(source_mtime));
+
+    const uint32_t string_count = static_cast<uint32_t>(strings.size());
+    ok = ok && WriteRaw(fp, &string_count, sizeof(string_count));
+    for (const std::string &str : strings)
+    {
+        const uint32_t len = static_cast<uint32_t>(str.size());
+        ok = ok && WriteRaw(fp, &len, sizeof(len)) && WriteRaw(fp, str.data(), str.size());
+    }
+
+    ForEachColumn(*this, [&](const auto &column) { ok = ok && WriteColumn(fp, column); });
+
+    if (gzclose(fp) != Z_OK)
+        ok = false;
+    if (!ok || std::rename(temp_path.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temp_path.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+int SalesFacts::Read(const std::string &path)
+{
+    FnTrace("SalesFacts::Read()");
+    Clear();
+    gzFile fp = gzopen(path.c_str(), "rb");
+    if (fp == nullptr)
+        return 1;
+    gzbuffer(fp, 65536);
+
+    char magic[sizeof(FactsMagic)] = {};
+    int32_t version = 0;
+    bool ok = ReadRaw(fp, magic, sizeof(magic)) &&
+              std::memcmp(magic, FactsMagic, sizeof(magic)) == 0 &&
+              ReadRaw(fp, &version, sizeof(version)) &&
+              version == SALES_FACTS_VERSION &&
+              ReadRaw(fp, &source_size, sizeof(source_size)) &&
+              ReadRaw(fp, &source_mtime, sizeof(source_mtime));
+
+    uint32_t string_count = 0;
+    ok = ok && ReadRaw(fp, &string_count, sizeof(string_count)) && string_count <= MaxRows;
+    for (uint32_t idx = 0; ok && idx < string_count; ++idx)
+    {
+        uint32_t len = 0;
+        std::string str;
+        ok = ReadRaw(fp, &len, sizeof(len)) && len <= MaxStringLength;
+        if (ok)
+        {
+            str.resize(len);
+            ok = ReadRaw(fp, str.data(), len);
+        }
+        if (ok)
+        {
+            lookup.emplace(str, static_cast<int32_t>(strings.size()));
+            strings.push_back(std::move(str));
+        }
+    }
+
+    ForEachColumn(*this, [&](auto &column) { ok = ok && ReadColumn(fp, column); });
+    gzclose(fp);
+
+    if (!ok || !Valid())
+    {
+        Clear();
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * sales_facts.hh
+ * Columnar store of one archive's checks, orders and payments
+ */
+
+#ifndef SALES_FACTS_HH
+#define SALES_FACTS_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#define SALES_FACTS_VERSION 1
+
+// SalesFacts::CheckColumns::flags
+#define FACT_TRAINING  1
+#define FACT_TAKEOUT   2   // Check::IsTakeOut()
+#define FACT_FASTFOOD  4   // Check::IsFastFood()
+
+/*********************************************************************
+ * SalesFacts
+ *
+ * The sales of one archive as flat tables with one vector per column,
+ * so a report reads only the columns it needs and an archive's worth
+ * of rows is a few contiguous arrays instead of a heap of Check,
+ * SubCheck and Order objects.  Rows refer to their parent by row
+ * number:  a subcheck to its check, an order or payment to its
+ * subcheck, a modifier to its order.  Modifiers follow the order they
+ * modify.  Item names go through a string dictionary.  Times are
+ * seconds since the epoch (local time), 0 when unset.
+ ********************************************************************/
+class SalesFacts
+{
+public:
+    struct CheckColumns
+    {
+        std::vector<int32_t> serial;
+        std::vector<int32_t> type;          // customer type
+        std::vector<int32_t> flags;         // FACT_ values
+        std::vector<int32_t> user_open;
+        std::vector<int32_t> user_owner;
+        std::vector<int32_t> guests;
+        std::vector<int64_t> time_open;
+        std::vector<int64_t> time_closed;   // 0 while any subcheck is open
+    };
+    struct SubCheckColumns
+    {
+        std::vector<int32_t> check;         // row in checks
+        std::vector<int32_t> number;
+        std::vector<int32_t> status;
+        std::vector<int32_t> drawer_id;
+        std::vector<int32_t> meal;          // meal period at settle time
+        std::vector<int32_t> total_sales;
+        std::vector<int32_t> total_tax;
+        std::vector<int32_t> tip;
+        std::vector<int32_t> payment;
+        std::vector<int64_t> settle_time;
+    };
+    struct OrderColumns
+    {
+        std::vector<int32_t> sub;           // row in subchecks
+        std::vector<int32_t> parent;        // row of the order modified, -1 for none
+        std::vector<int32_t> name;          // dictionary id
+        std::vector<int32_t> family;
+        std::vector<int32_t> item_type;
+        std::vector<int32_t> sales_type;
+        std::vector<int32_t> qualifier;
+        std::vector<int32_t> status;        // ORDER_COMP for comps
+        std::vector<int32_t> item_cost;
+        std::vector<int32_t> cost;
+        std::vector<int32_t> total_cost;
+        std::vector<int32_t> total_comp;
+        std::vector<int32_t> count;
+        std::vector<int32_t> seat;
+        std::vector<int32_t> user_id;
+        std::vector<int32_t> employee_meal;
+        std::vector<int32_t> is_reduced;
+    };
+    struct PaymentColumns
+    {
+        std::vector<int32_t> sub;           // row in subchecks
+        std::vector<int32_t> tender_type;
+        std::vector<int32_t> tender_id;
+        std::vector<int32_t> value;
+        std::vector<int32_t> amount;
+        std::vector<int32_t> flags;
+        std::vector<int32_t> user_id;
+        std::vector<int32_t> drawer_id;
+        std::vector<int32_t> credit;        // boolean - has credit card details
+    };
+
+    CheckColumns    checks;
+    SubCheckColumns subchecks;
+    OrderColumns    orders;
+    PaymentColumns  payments;
+
+    // identifies the file the facts were built from; the owner decides
+    // what counts as stale
+    int64_t source_size{-1};
+    int64_t source_mtime{-1};
+
+    [[nodiscard]] std::size_t CheckCount() const noexcept { return checks.serial.size(); }
+    [[nodiscard]] std::size_t SubCheckCount() const noexcept { return subchecks.check.size(); }
+    [[nodiscard]] std::size_t OrderCount() const noexcept { return orders.sub.size(); }
+    [[nodiscard]] std::size_t PaymentCount() const noexcept { return payments.sub.size(); }
+
+    // Returns the dictionary id of str, adding it if new
+    int32_t Intern(std::string_view str);
+    // Returns the dictionary string for id ("" when out of range)
+    [[nodiscard]] const std::string &String(int32_t id) const;
+    [[nodiscard]] std::size_t StringCount() const noexcept { return strings.size(); }
+
+    // boolean - columns agree in length and every row reference is in range
+    [[nodiscard]] bool Valid() const;
+    void Clear();
+
+    // Writes through a temporary file renamed over path; 0 on success
+    int Write(const std::string &path) const;
+    // Replaces the contents with path's; nonzero (contents cleared) on a
+    // missing, foreign, truncated or inconsistent file
+    int Read(const std::string &path);
+
+private:
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, int32_t> lookup;
+
+    template <typename Self, typename Fn> static void ForEachColumn(Self &self, Fn &&fn);
+};
+
+#endif
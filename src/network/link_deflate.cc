@@ -0,0 +1,246 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * link_deflate.cc
+ * Per-frame deflate for terminal links
+ */
+
+#include "link_deflate.hh"
+#include "remote_link.hh"
+#include "fntrace.hh"
+
+#include <zlib.h>
+#include <chrono>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+static void PutLength(Uchar *at, Uint val)
+{
+    at[0] = static_cast<Uchar>(val & 255);
+    at[1] = static_cast<Uchar>((val >> 8) & 255);
+    at[2] = static_cast<Uchar>((val >> 16) & 255);
+    at[3] = static_cast<Uchar>((val >> 24) & 255);
+}
+
+static uint64_t MicrosecondsSince(std::chrono::steady_clock::time_point began)
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - began).count());
+}
+
+/****
+ * SampleCommands:  what a page of buttons and a report put out most,
+ *  in the encoding queue is set to
+ ****/
+static void SampleCommands(CharQueue &queue)
+{
+    // a button:  shadow, zone, label
+    queue.Put8(TERM_SHADOW);
+    queue.Put16(10);  queue.Put16(40);  queue.Put16(120);  queue.Put16(80);
+    queue.Put16(6);   queue.Put8(1);
+    queue.Put8(TERM_ZONE);
+    queue.Put16(10);  queue.Put16(40);  queue.Put16(120);  queue.Put16(80);
+    queue.Put8(3);    queue.Put8(5);    queue.Put8(1);
+    queue.Put8(TERM_ZONETEXTC);
+    queue.PutString("Total", 0);
+    queue.Put16(10);  queue.Put16(40);  queue.Put16(120);  queue.Put16(80);
+    queue.Put8(0);    queue.Put8(4);
+
+    // report lines:  rules, then label, amount
+    queue.Put8(TERM_RECTANGLE);
+    queue.Put16(0);   queue.Put16(0);   queue.Put16(640);  queue.Put16(32);
+    queue.Put8(1);
+    queue.Put8(TERM_HLINE);
+    queue.Put16(20);  queue.Put16(100); queue.Put16(600);
+    queue.Put8(1);    queue.Put8(0);
+    for (const char *amount : {"$0.00", "$10.00", "$125.50"})
+    {
+        queue.Put8(TERM_TEXTL);
+        queue.PutString("Sales", 0);
+        queue.Put16(24);  queue.Put16(120);
+        queue.Put8(0);    queue.Put8(2);    queue.Put16(0);
+        queue.Put8(TERM_TEXTC);
+        queue.PutString("1", 0);
+        queue.Put16(320); queue.Put16(120);
+        queue.Put8(0);    queue.Put8(2);    queue.Put16(0);
+        queue.Put8(TERM_TEXTR);
+        queue.PutString(amount, 0);
+        queue.Put16(616); queue.Put16(120);
+        queue.Put8(0);    queue.Put8(2);    queue.Put16(0);
+    }
+}
+
+/***********************************************************************
+ * LinkDeflate Class
+ ***********************************************************************/
+LinkDeflate::~LinkDeflate()
+{
+    if (packer)
+    {
+        deflateEnd(packer);
+        delete packer;
+    }
+    if (unpacker)
+    {
+        inflateEnd(unpacker);
+        delete unpacker;
+    }
+}
+
+/****
+ * Dictionary:  the same on both ends of a link, since both build it
+ *  from the same commands; the tagged encoding goes last, nearest the
+ *  data, since most links still use it
+ ****/
+const std::vector<Uchar> &LinkDeflate::Dictionary()
+{
+    static const std::vector<Uchar> dictionary = [] {
+        std::vector<Uchar> bytes;
+        for (int encoding : {LINK_ENCODING_COMPACT, LINK_ENCODING_TAGGED})
+        {
+            CharQueue queue(4096);
+            queue.SetEncoding(encoding, 0);
+            SampleCommands(queue);
+            const std::span<const Uchar> sample = queue.ReadSpan();
+            bytes.insert(bytes.end(), sample.begin(), sample.end());
+        }
+        return bytes;
+    }();
+    return dictionary;
+}
+
+int LinkDeflate::Pack(std::span<const Uchar> first, std::span<const Uchar> second, std::vector<Uchar> &frame)
+{
+    FnTrace("LinkDeflate::Pack()");
+    const auto began = std::chrono::steady_clock::now();
+    const size_t raw = first.size() + second.size();
+    ++stats.frames;
+    stats.raw += raw;
+
+    size_t packed = 0;
+    if (raw >= LINK_DEFLATE_MIN)
+    {
+        if (packer == nullptr)
+        {
+            packer = new z_stream_s{};
+            if (deflateInit2(packer, LINK_DEFLATE_LEVEL, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            {
+                delete packer;
+                packer = nullptr;
+            }
+        }
+        else
+            deflateReset(packer);
+    }
+    if (packer != nullptr && raw >= LINK_DEFLATE_MIN)
+    {
+        const std::vector<Uchar> &dictionary = Dictionary();
+        deflateSetDictionary(packer, dictionary.data(), static_cast<uInt>(dictionary.size()));
+        frame.resize(8 + deflateBound(packer, static_cast<uLong>(raw)) + 64);
+        packer->next_out  = frame.data() + 8;
+        packer->avail_out = static_cast<uInt>(frame.size() - 8);
+        packer->next_in   = const_cast<Bytef *>(first.data());
+        packer->avail_in  = static_cast<uInt>(first.size());
+        int result = deflate(packer, second.empty() ? Z_FINISH : Z_NO_FLUSH);
+        if (!second.empty() && result == Z_OK)
+        {
+            packer->next_in  = const_cast<Bytef *>(second.data());
+            packer->avail_in = static_cast<uInt>(second.size());
+            result = deflate(packer, Z_FINISH);
+        }
+        if (result == Z_STREAM_END && packer->total_out + 4 < raw)
+            packed = packer->total_out;
+    }
+
+    if (packed > 0)
+    {
+        frame.resize(8 + packed);
+        PutLength(frame.data(), static_cast<Uint>(4 + packed) | LINK_FRAME_DEFLATED);
+        PutLength(frame.data() + 4, static_cast<Uint>(raw));
+        ++stats.deflated;
+    }
+    else
+    {
+        frame.resize(4);
+        PutLength(frame.data(), static_cast<Uint>(raw));
+        frame.insert(frame.end(), first.begin(), first.end());
+        frame.insert(frame.end(), second.begin(), second.end());
+    }
+    stats.sent    += frame.size();
+    stats.pack_us += MicrosecondsSince(began);
+    return 0;
+}
+
+int LinkDeflate::InflatedSize(std::span<const Uchar> payload)
+{
+    if (payload.size() < 4)
+        return -1;
+    return static_cast<int>(static_cast<Uint>(payload[0]) + (static_cast<Uint>(payload[1]) << 8) +
+                            (static_cast<Uint>(payload[2]) << 16) + (static_cast<Uint>(payload[3]) << 24));
+}
+
+int LinkDeflate::Unpack(std::span<const Uchar> payload, std::span<Uchar> first, std::span<Uchar> second)
+{
+    FnTrace("LinkDeflate::Unpack()");
+    const auto began = std::chrono::steady_clock::now();
+    if (InflatedSize(payload) != static_cast<int>(first.size() + second.size()))
+        return 1;
+
+    if (unpacker == nullptr)
+    {
+        unpacker = new z_stream_s{};
+        if (inflateInit2(unpacker, -MAX_WBITS) != Z_OK)
+        {
+            delete unpacker;
+            unpacker = nullptr;
+            return 1;
+        }
+    }
+    else
+        inflateReset(unpacker);
+    const std::vector<Uchar> &dictionary = Dictionary();
+    inflateSetDictionary(unpacker, dictionary.data(), static_cast<uInt>(dictionary.size()));
+
+    unpacker->next_in  = const_cast<Bytef *>(payload.data() + 4);
+    unpacker->avail_in = static_cast<uInt>(payload.size() - 4);
+    int result = Z_OK;
+    for (std::span<Uchar> out : {first, second})
+    {
+        if (out.empty() || result != Z_OK)
+            continue;
+        unpacker->next_out  = out.data();
+        unpacker->avail_out = static_cast<uInt>(out.size());
+        result = inflate(unpacker, Z_NO_FLUSH);
+        if (result == Z_OK && unpacker->avail_out > 0)
+            result = Z_DATA_ERROR;  // stopped short of the length given
+    }
+    if (result == Z_OK)
+    {
+        // all of it is out; what's left must be the end of the stream
+        Uchar extra = 0;
+        unpacker->next_out  = &extra;
+        unpacker->avail_out = 1;
+        result = inflate(unpacker, Z_NO_FLUSH);
+    }
+
+    ++stats.inflated;
+    stats.unpack_us += MicrosecondsSince(began);
+    if (result != Z_STREAM_END || unpacker->total_out != first.size() + second.size())
+        return 1;
+    return 0;
+}
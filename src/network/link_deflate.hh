@@ -0,0 +1,89 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * link_deflate.hh
+ * Per-frame deflate for terminal links
+ */
+
+#ifndef LINK_DEFLATE_HH
+#define LINK_DEFLATE_HH
+
+#include "basic.hh"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#define LINK_DEFLATE_MIN     512          // smaller frames go as they are
+#define LINK_DEFLATE_LEVEL   1            // zlib level; speed over size for the Pi
+#define LINK_FRAME_DEFLATED  0x80000000U  // frame length flag:  payload is deflated
+
+struct z_stream_s;
+
+/*********************************************************************
+ * LinkDeflate
+ *
+ * Deflates and inflates frame payloads one frame at a time, so frames
+ * dropped unsent (see LinkOutput) never leave the other end missing
+ * history.  Each frame starts from a preset dictionary of common
+ * command sequences in both link encodings, which is what makes short
+ * frames worth deflating at all.
+ *
+ * A deflated frame's length word has LINK_FRAME_DEFLATED set; its
+ * payload is the inflated length (4 bytes, little endian) and the raw
+ * deflate stream.
+ ********************************************************************/
+class LinkDeflate
+{
+public:
+    struct Stats
+    {
+        uint64_t frames{0};     // frames packed
+        uint64_t deflated{0};   // of those, sent deflated
+        uint64_t raw{0};        // bytes in
+        uint64_t sent{0};       // bytes out, lengths included
+        uint64_t pack_us{0};    // time spent deflating
+        uint64_t inflated{0};   // frames unpacked
+        uint64_t unpack_us{0};  // time spent inflating
+    };
+
+    LinkDeflate() = default;
+    LinkDeflate(const LinkDeflate&) = delete;
+    LinkDeflate& operator=(const LinkDeflate&) = delete;
+    ~LinkDeflate();
+
+    // Sets frame to first and second (a wrapped queue's two regions)
+    // framed:  deflated if there are at least LINK_DEFLATE_MIN bytes and
+    // that makes them smaller, else as they are
+    int Pack(std::span<const Uchar> first, std::span<const Uchar> second, std::vector<Uchar> &frame);
+    // Inflates a deflated frame's payload (after its length word) into
+    // first then second, which together must be the inflated length;
+    // 1 if the payload is bad
+    int Unpack(std::span<const Uchar> payload, std::span<Uchar> first, std::span<Uchar> second);
+
+    [[nodiscard]] const Stats &GetStats() const noexcept { return stats; }
+
+    // The inflated length a deflated frame's payload gives, -1 if short
+    static int InflatedSize(std::span<const Uchar> payload);
+    static const std::vector<Uchar> &Dictionary();
+
+private:
+    z_stream_s *packer{nullptr};
+    z_stream_s *unpacker{nullptr};
+    Stats stats;
+};
+
+#endif
@@ -0,0 +1,236 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * link_output.cc
+ * Non-blocking outbound frame queue for a terminal link
+ */
+
+#include "link_output.hh"
+#include "fntrace.hh"
+
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+#define LINK_IOV_MAX 16  // frames handed to one writev()
+
+/***********************************************************************
+ * LinkOutput Class
+ ***********************************************************************/
+int LinkOutput::Add(LinkFrame frame, int redraw)
+{
+    FnTrace("LinkOutput::Add()");
+    if (failed)
+        return -1;
+    if (frame == nullptr || frame->empty())
+        return Flush();
+
+    // a new redraw starting while behind makes the unsent ones moot
+    if (behind && redraw != 0 && (frames.empty() || frames.back().redraw != redraw))
+        Coalesce(redraw);
+
+    stats.queued += frame->size();
+    frames.push_back(Frame{std::move(frame), redraw});
+    if (stats.queued > limit)
+    {
+        Fail();
+        return -1;
+    }
+    return Flush();
+}
+
+int LinkOutput::Flush()
+{
+    FnTrace("LinkOutput::Flush()");
+    if (failed)
+        return -1;
+
+    while (!frames.empty())
+    {
+        struct iovec iov[LINK_IOV_MAX];
+        int count = 0;
+        for (auto frame = frames.begin(); frame != frames.end() && count < LINK_IOV_MAX; ++frame)
+        {
+            const std::size_t skip = (count == 0) ? offset : 0;
+            iov[count].iov_base = const_cast<Uchar *>(frame->bytes->data() + skip);
+            iov[count].iov_len  = frame->bytes->size() - skip;
+            ++count;
+        }
+
+        ssize_t written = writev(socket_no, iov, count);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            Fail();
+            return -1;
+        }
+
+        stats.sent   += static_cast<uint64_t>(written);
+        stats.queued -= static_cast<std::size_t>(written);
+        std::size_t done = static_cast<std::size_t>(written);
+        while (done > 0)
+        {
+            const std::size_t left = frames.front().bytes->size() - offset;
+            if (done < left)
+            {
+                offset += done;
+                break;
+            }
+            done  -= left;
+            offset = 0;
+            frames.pop_front();
+        }
+    }
+
+    Track();
+    return frames.empty() ? 0 : 1;
+}
+
+int LinkOutput::Finish(int timeout_ms)
+{
+    FnTrace("LinkOutput::Finish()");
+    const auto give_up = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    int result = Flush();
+    while (result == 1)
+    {
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            give_up - std::chrono::steady_clock::now()).count();
+        if (left <= 0)
+            break;
+        struct pollfd pfd = {socket_no, POLLOUT, 0};
+        if (poll(&pfd, 1, static_cast<int>(left)) < 0 && errno != EINTR)
+            break;
+        result = Flush();
+    }
+    return result;
+}
+
+/****
+ * Coalesce:  drops the queued frames of redraws other than redraw.  A
+ *  redraw whose first frame is partly written stays whole.
+ ****/
+void LinkOutput::Coalesce(int redraw)
+{
+    FnTrace("LinkOutput::Coalesce()");
+    const int keep = (offset > 0 && !frames.empty()) ? frames.front().redraw : 0;
+    auto moot = [&](const Frame &frame) {
+        return frame.redraw != 0 && frame.redraw != keep && frame.redraw != redraw;
+    };
+
+    for (const Frame &frame : frames)
+    {
+        if (moot(frame))
+        {
+            stats.queued -= frame.bytes->size();
+            ++stats.coalesced;
+        }
+    }
+    frames.erase(std::remove_if(frames.begin(), frames.end(), moot), frames.end());
+}
+
+void LinkOutput::Fail()
+{
+    failed = true;
+    frames.clear();
+    offset = 0;
+    stats.queued = 0;
+    Track();
+}
+
+/****
+ * Track:  keeps the peak and the behind state up to date with queued
+ ****/
+void LinkOutput::Track()
+{
+    stats.peak = std::max(stats.peak, stats.queued);
+    const auto now = std::chrono::steady_clock::now();
+    if (!behind && stats.queued > high_water)
+    {
+        behind = true;
+        behind_since = now;
+        ++stats.stalls;
+    }
+    else if (behind && stats.queued <= low_water)
+    {
+        behind = false;
+        stats.stall_ms += std::chrono::duration_cast<std::chrono::milliseconds>(now - behind_since).count();
+    }
+}
+
+/***********************************************************************
+ * LinkOutputPoll Class
+ ***********************************************************************/
+LinkOutputPoll::~LinkOutputPoll()
+{
+    if (poll_fd >= 0)
+        close(poll_fd);
+}
+
+int LinkOutputPoll::Fd()
+{
+    FnTrace("LinkOutputPoll::Fd()");
+    if (poll_fd < 0)
+        poll_fd = epoll_create1(EPOLL_CLOEXEC);
+    return poll_fd;
+}
+
+int LinkOutputPoll::Watch(int socket_no, void *owner)
+{
+    FnTrace("LinkOutputPoll::Watch()");
+    if (Fd() < 0)
+        return 1;
+    struct epoll_event event = {};
+    event.events   = EPOLLOUT;
+    event.data.ptr = owner;
+    if (epoll_ctl(poll_fd, EPOLL_CTL_ADD, socket_no, &event) == 0)
+        return 0;
+    if (errno == EEXIST && epoll_ctl(poll_fd, EPOLL_CTL_MOD, socket_no, &event) == 0)
+        return 0;
+    return 1;
+}
+
+int LinkOutputPoll::Unwatch(int socket_no)
+{
+    FnTrace("LinkOutputPoll::Unwatch()");
+    if (poll_fd < 0)
+        return 1;
+    struct epoll_event event = {};
+    return (epoll_ctl(poll_fd, EPOLL_CTL_DEL, socket_no, &event) == 0) ? 0 : 1;
+}
+
+int LinkOutputPoll::Ready(std::vector<void *> &owners)
+{
+    FnTrace("LinkOutputPoll::Ready()");
+    owners.clear();
+    if (poll_fd < 0)
+        return 0;
+
+    struct epoll_event events[32];
+    int count = epoll_wait(poll_fd, events, 32, 0);
+    for (int idx = 0; idx < count; ++idx)
+        owners.push_back(events[idx].data.ptr);
+    return static_cast<int>(owners.size());
+}
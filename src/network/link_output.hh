@@ -0,0 +1,133 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * link_output.hh
+ * Non-blocking outbound frame queue for a terminal link
+ */
+
+#ifndef LINK_OUTPUT_HH
+#define LINK_OUTPUT_HH
+
+#include "basic.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+// One framed message, as CharQueue::Frame() builds it.  Immutable once
+// made, so the same frame can be queued for a terminal and its clones
+// and is freed when the last of them has written it.
+using LinkFrame = std::shared_ptr<const std::vector<Uchar>>;
+
+/*********************************************************************
+ * LinkOutput
+ *
+ * One terminal's framed messages on their way out.  Add() queues a
+ * frame and writes whatever the socket takes right away; the rest goes
+ * out from Flush() once LinkOutputPoll reports the socket writable, so
+ * a slow terminal holds up nobody but itself.  Past high_water queued
+ * bytes the link is behind until it drains to low_water; while behind,
+ * queuing a full-page redraw drops the frames of earlier redraws not
+ * yet started, since the new one paints over them.  Past limit the
+ * link is given up on.
+ ********************************************************************/
+class LinkOutput
+{
+public:
+    struct Stats
+    {
+        std::size_t queued{0};     // bytes waiting
+        std::size_t peak{0};       // most bytes ever waiting
+        uint64_t    sent{0};       // bytes written
+        uint64_t    coalesced{0};  // redraw frames dropped unsent
+        int         stalls{0};     // times the link fell behind
+        int64_t     stall_ms{0};   // time spent behind, finished stalls
+    };
+
+    std::size_t high_water{256 * 1024};
+    std::size_t low_water{32 * 1024};
+    std::size_t limit{8 * 1024 * 1024};
+
+    void SetSocket(int new_socket) noexcept { socket_no = new_socket; }
+    // Queues frame (redraw:  the full-page redraw it belongs to, 0 for
+    // none) and writes what the socket takes; returns as Flush()
+    int Add(LinkFrame frame, int redraw = 0);
+    int Add(std::vector<Uchar> frame, int redraw = 0)
+    {
+        return Add(std::make_shared<const std::vector<Uchar>>(std::move(frame)), redraw);
+    }
+    // Writes what the socket takes:  0 drained, 1 still pending, -1 the
+    // link failed (write error or limit passed; the queue is dropped)
+    int Flush();
+    // Waits up to timeout_ms for the queue to drain, for closing links
+    int Finish(int timeout_ms);
+
+    [[nodiscard]] bool Pending() const noexcept { return !frames.empty(); }
+    [[nodiscard]] bool Behind() const noexcept { return behind; }
+    [[nodiscard]] bool Failed() const noexcept { return failed; }
+    [[nodiscard]] const Stats &GetStats() const noexcept { return stats; }
+
+private:
+    struct Frame
+    {
+        LinkFrame bytes;
+        int redraw{0};
+    };
+
+    std::deque<Frame> frames;
+    std::size_t offset{0};  // bytes of frames.front() already written
+    int socket_no{-1};
+    bool behind{false};
+    bool failed{false};
+    Stats stats;
+    std::chrono::steady_clock::time_point behind_since;
+
+    void Coalesce(int redraw);
+    void Fail();
+    void Track();
+};
+
+/*********************************************************************
+ * LinkOutputPoll
+ *
+ * An epoll set of the sockets whose LinkOutput has bytes pending.  Its
+ * descriptor turns readable when any of them can take more, so it is
+ * handed to AddInputFn() and the callback calls Ready() to find out
+ * which.
+ ********************************************************************/
+class LinkOutputPoll
+{
+public:
+    LinkOutputPoll() = default;
+    ~LinkOutputPoll();
+    LinkOutputPoll(const LinkOutputPoll&) = delete;
+    LinkOutputPoll& operator=(const LinkOutputPoll&) = delete;
+
+    // The epoll descriptor, created on first use; -1 if unavailable
+    int Fd();
+    int Watch(int socket_no, void *owner);
+    int Unwatch(int socket_no);
+    // Fills owners with those whose socket is writable, without waiting
+    int Ready(std::vector<void *> &owners);
+
+private:
+    int poll_fd{-1};
+};
+
+#endif
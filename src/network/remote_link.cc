@@ -21,6 +21,8 @@
 #include "remote_link.hh"
 #include "utility.hh"
 #include <sys/file.h>
+#include <sys/uio.h>
+#include <poll.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
@@ -72,122 +74,267 @@ void CharQueue::ReadError(int wanted, int got)
     FnPrintTrace();
 }
 
-int CharQueue::Send8(int val)
+std::span<Uchar> CharQueue::WriteSpan() noexcept
+{
+    if (size == 0)
+        start = end = 0;  // empty:  give the whole ring
+    if (size >= buffer_size)
+        return {};
+    const int stop = (end < start) ? start : buffer_size;
+    return {buffer.data() + end, static_cast<size_t>(stop - end)};
+}
+
+void CharQueue::Commit(int len) noexcept
+{
+    end += len;
+    if (end >= buffer_size)
+        end -= buffer_size;
+    size += len;
+}
+
+std::span<const Uchar> CharQueue::ReadSpan() const noexcept
+{
+    const int len = std::min(size, buffer_size - start);
+    return {buffer.data() + start, static_cast<size_t>(std::max(len, 0))};
+}
+
+void CharQueue::Consume(int len) noexcept
+{
+    start += len;
+    if (start >= buffer_size)
+        start -= buffer_size;
+    size -= len;
+}
+
+int CharQueue::PutBytes(std::span<const Uchar> data)
 {
-    FnTrace("CharQueue::Send8()");
     static int reported = 0;
 
-    if (size >= buffer_size)
+    const int len = static_cast<int>(data.size());
+    if (len <= 0)
+        return 0;
+    if (len > buffer_size - size)
     {
         if (reported == 0)
-            fprintf(stderr, "CharQueue::Put8() failed! - buffer full\n");
+            fprintf(stderr, "CharQueue::PutBytes() failed! - buffer full\n");
         reported = 1;
+        overflow = 1;
         return 1;
     }
 
-    buffer[end] = static_cast<uint8_t>(val & 255);
-    ++end;
-    ++size;
-    if (end >= buffer_size)
-        end = 0;
+    // at most two copies:  up to the end of the ring, then from its start
+    int done = 0;
+    while (done < len)
+    {
+        std::span<Uchar> room = WriteSpan();
+        const int n = std::min(len - done, static_cast<int>(room.size()));
+        memcpy(room.data(), data.data() + done, static_cast<size_t>(n));
+        Commit(n);
+        done += n;
+    }
     return 0;
 }
 
-int CharQueue::Read8()
+int CharQueue::GetBytes(std::span<Uchar> data)
 {
-    FnTrace("CharQueue::Read8()");
     static int reported = 0;
 
-    if (size <= 0)
+    const int len = static_cast<int>(data.size());
+    if (len <= 0)
+        return 0;
+    if (len > size)
     {
         if (reported == 0)
-            fprintf(stderr, "CharQueue::Get8() buffer empty (%d %d %d)\n", start, end, size);
+            fprintf(stderr, "CharQueue::GetBytes() buffer short (%d of %d)\n", size, len);
         reported = 1;
-        return -1;
+        return 1;
     }
 
-    int val = (int) buffer[start];
-    ++start;
-    --size;
-    if (start >= buffer_size)
-        start = 0;
+    int done = 0;
+    while (done < len)
+    {
+        std::span<const Uchar> queued = ReadSpan();
+        const int n = std::min(len - done, static_cast<int>(queued.size()));
+        memcpy(data.data() + done, queued.data(), static_cast<size_t>(n));
+        Consume(n);
+        done += n;
+    }
+    return 0;
+}
 
-    if (val < 0)
-        fprintf(stderr, "low value: %d\n", val);
+int CharQueue::Skip(int len)
+{
+    if (len <= 0)
+        return 0;
+    if (len > size)
+        return 1;
+    Consume(len);
+    return 0;
+}
+
+/****
+ * ZigZag:  folds signed values onto unsigned ones so small negative
+ *  numbers make short varints too (0, -1, 1, -2 -> 0, 1, 2, 3).
+ ****/
+static inline unsigned long long ZigZag(long long val)
+{
+    return (static_cast<unsigned long long>(val) << 1) ^ static_cast<unsigned long long>(val >> 63);
+}
+
+static inline long long UnZigZag(unsigned long long val)
+{
+    return static_cast<long long>(val >> 1) ^ -static_cast<long long>(val & 1);
+}
 
+/****
+ * ValueBytes:  one value's bytes (type byte included), staged on the
+ *  stack so the value goes into the ring with a single PutBytes().
+ ****/
+struct ValueBytes
+{
+    Uchar bytes[16];
+    int len = 0;
+
+    void Add(long long val) { bytes[len++] = static_cast<Uchar>(val & 255); }
+    void AddLittle(long long val, int count)
+    {
+        for (int i = 0; i < count; ++i)
+            Add(val >> (i * 8));
+    }
+    void AddVarint(unsigned long long val)
+    {
+        while (val >= 128)
+        {
+            bytes[len++] = static_cast<Uchar>((val & 127) | 128);
+            val >>= 7;
+        }
+        bytes[len++] = static_cast<Uchar>(val);
+    }
+    std::span<const Uchar> Span() const { return {bytes, static_cast<size_t>(len)}; }
+};
+
+int LinkEncodingLimit = LINK_ENCODING_MAX;
+int LinkFlags         = 0;
+int LinkPageMemory    = LINK_PAGE_MEMORY;
+
+unsigned long long CharQueue::GetVarint()
+{
+    unsigned long long val = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (size <= 0)
+        {
+            fprintf(stderr, "For %s code %d, varint cut short\n", name.c_str(), code);
+            return 0;
+        }
+        const Uchar byte = buffer[start];
+        Consume(1);
+        val |= static_cast<unsigned long long>(byte & 127) << shift;
+        if ((byte & 128) == 0)
+            return val;
+    }
+    fprintf(stderr, "For %s code %d, varint too long\n", name.c_str(), code);
+    return val;
+}
+
+/****
+ * GetUnsigned:  reads a count byte little-endian value (tagged encoding)
+ ****/
+unsigned long long CharQueue::GetUnsigned(int count)
+{
+    Uchar bytes[sizeof(long long)] = {};
+    if (GetBytes({bytes, static_cast<size_t>(count)}))
+        return 0;
+    unsigned long long val = 0;
+    for (int i = 0; i < count; ++i)
+        val |= static_cast<unsigned long long>(bytes[i]) << (i * 8);
     return val;
 }
 
+void CharQueue::GetType(int type)
+{
+    if (tagged == 0)
+        return;
+    Uchar got = 0;
+    if (GetBytes({&got, 1}))
+        ReadError(type, -1);
+    else if (got != type)
+        ReadError(type, got);
+}
+
 int CharQueue::Put8(int val)
 {
     FnTrace("CharQueue::Put8()");
-    Send8(TYPE_INT8);
-    Send8(val);
-    return 0;
+    ValueBytes v;
+    if (tagged)
+        v.Add(TYPE_INT8);
+    v.Add(val);
+    return PutBytes(v.Span());
 }
 
 int CharQueue::Get8()
 {
     FnTrace("CharQueue::Get8()");
-    int type = Read8();
-    if (type != TYPE_INT8)
-        ReadError(TYPE_INT8, type);
-    int v = Read8();
-    return v;
+    GetType(TYPE_INT8);
+    Uchar byte = 0;
+    if (GetBytes({&byte, 1}))
+        return -1;
+    return byte;
 }
 
 int CharQueue::Put16(int val)
 {
     FnTrace("CharQueue::Put16()");
-    Send8(TYPE_INT16);
-    Send8(val);
-    Send8(val >> 8);
-    return 0;
+    ValueBytes v;
+    if (tagged)
+        v.Add(TYPE_INT16);
+    if (encoding == LINK_ENCODING_COMPACT)
+        v.AddVarint(ZigZag(static_cast<int16_t>(val)));
+    else
+        v.AddLittle(val, 2);
+    return PutBytes(v.Span());
 }
 
 int CharQueue::Get16()
 {
     FnTrace("CharQueue::Get16()");
-    int type = Read8();
-    if (type != TYPE_INT16)
-        ReadError(TYPE_INT16, type);
-    int l = Read8();
-    int h = Read8();
-
-    int v = l + (h << 8);
-    if (v >= 32768)
-        v -= 65536;
-    return v;
+    GetType(TYPE_INT16);
+    if (encoding == LINK_ENCODING_COMPACT)
+        return static_cast<int16_t>(UnZigZag(GetVarint()));
+    return static_cast<int16_t>(GetUnsigned(2));
 }
 
 int CharQueue::Put32(int val)
 {
     FnTrace("CharQueue::Put32()");
-    Send8(TYPE_INT32);
-    int send = Abs(val);
-    Send8(send);
-    Send8(send >> 8);
-    Send8(send >> 16);
+    ValueBytes v;
+    if (tagged)
+        v.Add(TYPE_INT32);
+    if (encoding == LINK_ENCODING_COMPACT)
+    {
+        v.AddVarint(ZigZag(val));
+        return PutBytes(v.Span());
+    }
 
+    // tagged:  31 bit magnitude, sign in the top bit
+    int send = Abs(val);
+    v.AddLittle(send, 3);
     int tmp = (send >> 24) & 127;
     if (val < 0)
         tmp |= 128;
-    Send8(tmp);
-    return 0;
+    v.Add(tmp);
+    return PutBytes(v.Span());
 }
 
 int CharQueue::Get32()
 {
     FnTrace("CharQueue::Get32()");
-    int type = Read8();
-    if (type != TYPE_INT32)
-        ReadError(TYPE_INT32, type);
-    int b1 = Read8();
-    int b2 = Read8();
-    int b3 = Read8();
-    int b4 = Read8();
-    int val = b1 + (b2 << 8) + (b3 << 16) + ((b4 & 127) << 24);
-    if (b4 & 128)
+    GetType(TYPE_INT32);
+    if (encoding == LINK_ENCODING_COMPACT)
+        return static_cast<int>(UnZigZag(GetVarint()));
+    const unsigned long long bytes = GetUnsigned(4);
+    int val = static_cast<int>(bytes & 0x7fffffff);
+    if (bytes & 0x80000000)
         return -val;
     else
         return val;
@@ -196,92 +343,81 @@ int CharQueue::Get32()
 long CharQueue::PutLong(long val)
 {
     FnTrace("CharQueue::PutLong()");
-    Send8(TYPE_LONG);
-    int put = sizeof(long);    
-
-    while (put)
-    {
-        Send8(val);
-        val = val >> 8;
-        put -= 1;
-    }
-
-    return 0;
+    ValueBytes v;
+    if (tagged)
+        v.Add(TYPE_LONG);
+    if (encoding == LINK_ENCODING_COMPACT)
+        v.AddVarint(ZigZag(val));
+    else
+        v.AddLittle(val, sizeof(long));
+    return PutBytes(v.Span());
 }
 
 long CharQueue::GetLong()
 {
     FnTrace("CharQueue::GetLong()");
-    int type = Read8();
-    if (type != TYPE_LONG)
-        ReadError(TYPE_LONG, type);
-    int getbytes = sizeof(long);
-    int currshift = 0;
-    long retval = 0;
-    int currbyte;
-
-    while (getbytes > 0)
-    {
-        currbyte = Read8();
-        retval += (currbyte << (currshift * 8));
-        currshift += 1;
-        getbytes -= 1;
-    }
-
-    return retval;
+    GetType(TYPE_LONG);
+    if (encoding == LINK_ENCODING_COMPACT)
+        return static_cast<long>(UnZigZag(GetVarint()));
+    return static_cast<long>(GetUnsigned(sizeof(long)));
 }
 
 long long CharQueue::PutLLong(long long val)
 {
     FnTrace("CharQueue::PutLLong()");
-    Send8(TYPE_LLONG);
-    int putbytes = sizeof(long long);
-
-    while (putbytes > 0)
-    {
-        Send8(val);
-        val       = val >> 8;
-        putbytes -= 1;
-    }
-
-    return 0;
+    ValueBytes v;
+    if (tagged)
+        v.Add(TYPE_LLONG);
+    if (encoding == LINK_ENCODING_COMPACT)
+        v.AddVarint(ZigZag(val));
+    else
+        v.AddLittle(val, sizeof(long long));
+    return PutBytes(v.Span());
 }
 
 long long CharQueue::GetLLong()
 {
     FnTrace("CharQueue::GetLLong()");
-    int type = Read8();
-    if (type != TYPE_LLONG)
-        ReadError(TYPE_LLONG, type);
-    int getbytes = sizeof(long long);
-    int currshift = 0;
-    long long retval = 0;
-    int currbyte;
-
-    while (getbytes > 0)
-    {
-        currbyte = Read8();
-        retval += (currbyte << (currshift * 8));
-        currshift += 1;
-        getbytes -= 1;
-    }
-
-    return retval;
+    GetType(TYPE_LLONG);
+    if (encoding == LINK_ENCODING_COMPACT)
+        return UnZigZag(GetVarint());
+    return static_cast<long long>(GetUnsigned(sizeof(long long)));
 }
 
 int CharQueue::PutString(const std::string &str, int len)
 {
     FnTrace("CharQueue::PutString()");
-    Send8(TYPE_STRING);
-    if (len <= 0)
+    static int reported = 0;
+
+    if (len <= 0 || len > static_cast<int>(str.size()))
         len = static_cast<int>(str.size());
 
-    Put16(len);
-    for (int i = 0; i < len; ++i)
+    // the header (type bytes and length) goes in with the body, so a
+    // string that won't fit leaves nothing half written
+    ValueBytes v;
+    if (tagged)
+        v.Add(TYPE_STRING);
+    if (encoding == LINK_ENCODING_COMPACT)
     {
-        Send8((int) str[i]);
+        v.AddVarint(static_cast<unsigned long long>(len));
     }
-    return 0;
+    else
+    {
+        len = std::min(len, 32767);
+        v.Add(TYPE_INT16);
+        v.AddLittle(len, 2);
+    }
+    if (v.len + len > buffer_size - size)
+    {
+        if (reported == 0)
+            fprintf(stderr, "CharQueue::PutString() failed! - buffer full\n");
+        reported = 1;
+        overflow = 1;
+        return 1;
+    }
+
+    PutBytes(v.Span());
+    return PutBytes({reinterpret_cast<const Uchar*>(str.data()), static_cast<size_t>(len)});
 }
 
 int CharQueue::GetString(char* str, size_t max_len)
@@ -290,137 +426,145 @@ int CharQueue::GetString(char* str, size_t max_len)
     if (str == nullptr || max_len == 0)
         return 1;
 
-    int type = Read8();
-    if (type != TYPE_STRING)
-        ReadError(TYPE_STRING, type);
-    int len = Get16();
-    if (len < 0)
+    GetType(TYPE_STRING);
+    long long len = 0;
+    if (encoding == LINK_ENCODING_COMPACT)
+        len = static_cast<long long>(GetVarint());
+    else
+        len = Get16();
+    if (len < 0 || len > size)
     {
         str[0] = '\0';
         return 1;
     }
 
-    const size_t safe_len = (max_len > 0) ? max_len - 1 : 0;
-    const size_t copy_len = std::min(static_cast<size_t>(len), safe_len);
-    int onechar = 0;
-
-    for (int i = 0; i < len; ++i)
-    {
-        onechar = Read8();
-        if (onechar < 0)
-            return 1;
-        if (static_cast<size_t>(i) < copy_len)
-            str[i] = static_cast<char>(onechar);
-    }
+    const size_t copy_len = std::min(static_cast<size_t>(len), max_len - 1);
+    GetBytes({reinterpret_cast<Uchar*>(str), copy_len});
+    Skip(static_cast<int>(len - static_cast<long long>(copy_len)));
     str[copy_len] = '\0';
     return (static_cast<size_t>(len) >= max_len) ? 1 : 0;
 }
 
-int CharQueue::Read(int device_no)
+/****
+ * CharQueue::Read:  one readv() takes whatever the link has into the
+ *   inbox's free space, and a spill area past it for more; then every
+ *   whole frame read so far goes into the queue.  Frames still partial
+ *   wait in the inbox for the next call.
+ ****/
+int CharQueue::Read(int device_no, LinkInbox &from)
 {
     FnTrace("CharQueue::Read()");
     Clear();
 
-    Uchar buf[4];
-    int val = 0;  // Declare val at function scope
-    struct timeval timeout;
-    fd_set read_fds;
-
-    // Set socket to non-blocking mode for the header read
-    int flags = fcntl(device_no, F_GETFL, 0);
-    if (flags < 0) {
-        fprintf(stderr, "CharQueue::Read() - Failed to get socket flags\n");
-        return -1;
-    }
-    int original_flags = flags;
-    if (fcntl(device_no, F_SETFL, flags | O_NONBLOCK) < 0) {
-        fprintf(stderr, "CharQueue::Read() - Failed to set non-blocking mode\n");
-        return -1;
-    }
-
-    // Read header with timeout (4 bytes for size)
-    for (int i = 0; i < 4; ++i) {
-        FD_ZERO(&read_fds);
-        FD_SET(device_no, &read_fds);
-        timeout.tv_sec = 5;  // 5 second timeout for header
-        timeout.tv_usec = 0;
-
-        int select_result = select(device_no + 1, &read_fds, nullptr, nullptr, &timeout);
-        if (select_result <= 0) {
-            fprintf(stderr, "CharQueue::Read() - Timeout/header read failed\n");
-            fcntl(device_no, F_SETFL, original_flags); // Restore original flags
-            return -1;
+    // enough room for most reads without the spill area, and no more
+    // reading while a flood of unprocessed frames piles up
+    const int room_wanted = std::max(send_size, 4096);
+    if (from.used < 4 * (buffer_size + 4))
+    {
+        if (static_cast<int>(from.bytes.size()) - from.used < room_wanted)
+            from.bytes.resize(static_cast<size_t>(from.used + room_wanted));
+
+        Uchar spill[65536];
+        struct iovec iov[2];
+        iov[0].iov_base = from.bytes.data() + from.used;
+        iov[0].iov_len  = from.bytes.size() - static_cast<size_t>(from.used);
+        iov[1].iov_base = spill;
+        iov[1].iov_len  = sizeof(spill);
+
+        ssize_t got = 0;
+        do
+        {
+            got = readv(device_no, iov, 2);
         }
+        while (got < 0 && errno == EINTR);
 
-        val = read(device_no, &buf[i], 1);
-        if (val != 1) {
-            fprintf(stderr, "CharQueue::Read() - Header read failed at byte %d\n", i);
-            fcntl(device_no, F_SETFL, original_flags); // Restore original flags
+        if (got == 0)
+            return -1;  // connection closed
+        if (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
             return -1;
+
+        if (got > 0)
+        {
+            const int first = std::min(static_cast<int>(got), static_cast<int>(iov[0].iov_len));
+            from.used += first;
+            if (got > first)
+            {
+                from.bytes.insert(from.bytes.begin() + from.used, spill, spill + (got - first));
+                from.used += static_cast<int>(got) - first;
+            }
         }
     }
 
-    // Restore original blocking mode
-    fcntl(device_no, F_SETFL, original_flags);
-
-    int s = (Uint) buf[0] + ((Uint) buf[1] << 8) + ((Uint) buf[2] << 16) + ((Uint) buf[3] << 24);
-
-    // Critical fix: Validate size to prevent buffer overflow
-    if (s <= 0 || s > buffer_size)
-    {
-        fprintf(stderr, "CharQueue::Read() - Invalid size: %d (max: %d)\n", s, buffer_size);
-        return -1;
-    }
+    return Take(from);
+}
 
-    int todo = s;
-    while (todo > 0)
+int CharQueue::Take(LinkInbox &from)
+{
+    FnTrace("CharQueue::Take()");
+    const Uchar *data = from.bytes.data();
+    int pos = 0;
+    int queued = 0;
+    while (from.used - pos >= 4)
     {
-        // Critical fix: Use todo instead of s, and ensure we don't exceed buffer bounds
-        int read_size = (todo > buffer_size - end) ? (buffer_size - end) : todo;
-        if (read_size <= 0)
-        {
-            fprintf(stderr, "CharQueue::Read() - Buffer overflow prevented\n");
-            return -1;
-        }
-
-        // Prevent indefinite blocking on payload reads
-        FD_ZERO(&read_fds);
-        FD_SET(device_no, &read_fds);
-        timeout.tv_sec = 5;
-        timeout.tv_usec = 0;
+        const Uchar *head = data + pos;
+        const Uint word = static_cast<Uint>(head[0]) + (static_cast<Uint>(head[1]) << 8) +
+                          (static_cast<Uint>(head[2]) << 16) + (static_cast<Uint>(head[3]) << 24);
+        const int s = static_cast<int>(word & ~LINK_FRAME_DEFLATED);
 
-        int select_result = select(device_no + 1, &read_fds, nullptr, nullptr, &timeout);
-        if (select_result == -1 && errno == EINTR)
-            continue;
-        if (select_result <= 0)
+        // Critical fix: Validate size to prevent buffer overflow
+        if (s <= 0 || s > buffer_size)
         {
-            fprintf(stderr, "CharQueue::Read() - Payload read timed out\n");
+            fprintf(stderr, "CharQueue::Take() - Invalid size: %d (max: %d)\n", s, buffer_size);
+            from.Clear();
             return -1;
         }
+        if (from.used - pos - 4 < s)
+            break;  // not all here yet
 
-        val = read(device_no, buffer.data() + end, read_size);
-        if (val > 0)
+        const std::span<const Uchar> payload(head + 4, static_cast<size_t>(s));
+        if (word & LINK_FRAME_DEFLATED)
         {
-            size += val;
-            end  += val;
-            todo -= val;
-
-            // Handle circular buffer wrap-around
-            if (end >= buffer_size)
-                end = 0;
-        }
-        else if (val == 0)
-        {
-            // Connection closed
-            return -1;
+            const int raw = LinkDeflate::InflatedSize(payload);
+            if (raw <= 0 || raw > buffer_size)
+            {
+                fprintf(stderr, "CharQueue::Take() - Invalid inflated size: %d (max: %d)\n", raw, buffer_size);
+                from.Clear();
+                return -1;
+            }
+            if (buffer_size - size < raw)
+                break;  // no room until the queue is used up
+
+            // straight into the ring:  up to its end, then from its start
+            if (zip == nullptr)
+                zip = std::make_unique<LinkDeflate>();
+            std::span<Uchar> first = WriteSpan();
+            first = first.first(std::min(static_cast<size_t>(raw), first.size()));
+            const std::span<Uchar> second(buffer.data(), static_cast<size_t>(raw) - first.size());
+            if (zip->Unpack(payload, first, second))
+            {
+                fprintf(stderr, "CharQueue::Take() - Bad deflated frame\n");
+                from.Clear();
+                return -1;
+            }
+            Commit(raw);
+            queued += raw;
         }
-        else if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)
+        else
         {
-            // Error reading
-            return -1;
+            if (buffer_size - size < s)
+                break;  // no room until the queue is used up
+            PutBytes(payload);
+            queued += s;
         }
+        pos += 4 + s;
+    }
+
+    if (pos > 0)
+    {
+        std::memmove(from.bytes.data(), data + pos, static_cast<size_t>(from.used - pos));
+        from.used -= pos;
     }
-    return s;
+    return queued;
 }
 
 /****
@@ -440,8 +584,10 @@ int CharQueue::Write(int device_no, int do_clear)
         return -1;
     }
 
-    int val;
     const int payload_size = size;
+    std::vector<Uchar> packed;
+    if (deflating)
+        Frame(packed);
 
     auto write_all = [&](const Uchar* data, int bytes) -> int
     {
@@ -454,8 +600,16 @@ int CharQueue::Write(int device_no, int do_clear)
                 written += static_cast<int>(w);
                 continue;
             }
-            if (w == -1 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+            if (w == -1 && errno == EINTR)
                 continue;
+            if (w == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                // the link is non-blocking; wait for it to take more
+                struct pollfd pfd = {device_no, POLLOUT, 0};
+                if (poll(&pfd, 1, 5000) > 0)
+                    continue;
+                return -1;
+            }
             if (w == -1 && errno == EPIPE)
                 return -1; // connection lost
             return -1;
@@ -463,43 +617,30 @@ int CharQueue::Write(int device_no, int do_clear)
         return written;
     };
 
-    Uchar header[4] = {
-        static_cast<Uchar>(payload_size & 255),
-        static_cast<Uchar>((payload_size >> 8) & 255),
-        static_cast<Uchar>((payload_size >> 16) & 255),
-        static_cast<Uchar>((payload_size >> 24) & 255)
-    };
-    
-    // Write size header with error checking and SIGPIPE handling
-    if (write_all(header, static_cast<int>(sizeof(header))) != static_cast<int>(sizeof(header)))
-        return -1;
-
-    if (start > end)
+    if (deflating)
     {
-        // Handle circular buffer case - copy to temporary buffer
-        int s = payload_size;
-        std::vector<Uchar> temp_buffer(s);
-        Uchar* c = temp_buffer.data();
-        int temp_size = size;
-        int temp_start = start;
-        
-        while (temp_size > 0)
-        {
-            *c++ = buffer[temp_start];
-            temp_start++;
-            temp_size--;
-            if (temp_start >= buffer_size)
-                temp_start = 0;
-        }
-        
-        val = write_all(temp_buffer.data(), s);
-        if (val != s)
+        if (write_all(packed.data(), static_cast<int>(packed.size())) != static_cast<int>(packed.size()))
             return -1;
     }
     else
     {
-        val = write_all(buffer.data() + start, payload_size);
-        if (val != payload_size)
+        Uchar header[4] = {
+            static_cast<Uchar>(payload_size & 255),
+            static_cast<Uchar>((payload_size >> 8) & 255),
+            static_cast<Uchar>((payload_size >> 16) & 255),
+            static_cast<Uchar>((payload_size >> 24) & 255)
+        };
+
+        // Write size header with error checking and SIGPIPE handling
+        if (write_all(header, static_cast<int>(sizeof(header))) != static_cast<int>(sizeof(header)))
+            return -1;
+
+        // the queued bytes are one region, or two when they wrap
+        std::span<const Uchar> first = ReadSpan();
+        const int rest = payload_size - static_cast<int>(first.size());
+        if (write_all(first.data(), static_cast<int>(first.size())) != static_cast<int>(first.size()))
+            return -1;
+        if (rest > 0 && write_all(buffer.data(), rest) != rest)
             return -1;
     }
 
@@ -508,3 +649,29 @@ int CharQueue::Write(int device_no, int do_clear)
 
     return payload_size;
 }
+
+void CharQueue::Frame(std::vector<Uchar> &frame)
+{
+    FnTrace("CharQueue::Frame()");
+    if (deflating)
+    {
+        if (zip == nullptr)
+            zip = std::make_unique<LinkDeflate>();
+        const std::span<const Uchar> first = ReadSpan();
+        zip->Pack(first, {buffer.data(), static_cast<size_t>(size) - first.size()}, frame);
+        return;
+    }
+
+    const Uchar header[4] = {
+        static_cast<Uchar>(size & 255),
+        static_cast<Uchar>((size >> 8) & 255),
+        static_cast<Uchar>((size >> 16) & 255),
+        static_cast<Uchar>((size >> 24) & 255)
+    };
+    std::span<const Uchar> first = ReadSpan();
+    frame.clear();
+    frame.reserve(sizeof(header) + static_cast<size_t>(size));
+    frame.insert(frame.end(), header, header + sizeof(header));
+    frame.insert(frame.end(), first.begin(), first.end());
+    frame.insert(frame.end(), buffer.begin(), buffer.begin() + (size - static_cast<int>(first.size())));
+}
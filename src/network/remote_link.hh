@@ -22,9 +22,12 @@
 #define REMOTE_LINK_HH
 
 #include "basic.hh"
+#include "link_deflate.hh"
 
 #include <array>
 #include <cstring>
+#include <memory>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -32,7 +35,37 @@
 // systems like Raspberry Pi CM5 with 2GB RAM
 inline constexpr size_t QUEUE_SIZE = 262144;
 
+// Link encodings (see CharQueue::SetEncoding())
+#define LINK_ENCODING_TAGGED   1  // protocol v1:  type byte, then fixed width values
+#define LINK_ENCODING_COMPACT  2  // protocol v2:  zig-zag varints, no type bytes
+#define LINK_ENCODING_MAX      LINK_ENCODING_COMPACT
+
+// Link flags
+#define LINK_CHECKED           1  // compact encoding keeps the type bytes
+#define LINK_PAGECACHE         2  // vt_term keeps copies of pages (SrvLinkOffer only)
+#define LINK_DEFLATE           4  // large frames may go deflated (see link_deflate.hh)
+
+#define LINK_PAGE_SLOTS        6  // most pages vt_term keeps copies of
+#define LINK_PAGE_MEMORY      16  // default megabytes of copies asked of vt_term
+
+// What vt_main agrees to when a terminal offers an encoding
+// (linkencoding and linkchecked in .viewtouch_config), and the
+// megabytes of page copies it asks of each terminal (pagememory)
+extern int LinkEncodingLimit;
+extern int LinkFlags;
+extern int LinkPageMemory;
+
 /**** Types ****/
+// Raw bytes read from a link that aren't yet a whole frame; one per
+// connection, so links sharing a CharQueue don't mix their input
+struct LinkInbox
+{
+    std::vector<Uchar> bytes;
+    int used{0};
+
+    void Clear() noexcept { used = 0; }
+};
+
 class CharQueue
 {
     std::vector<Uchar> buffer;
@@ -40,15 +73,22 @@ class CharQueue
     int end{0};
     int code{0};
     std::string name;
+    int encoding{LINK_ENCODING_TAGGED};
+    int tagged{1};  // boolean - values carry a type byte
+    int deflating{0};  // boolean - Write() and Frame() may deflate
+    LinkInbox inbox;
+    std::unique_ptr<LinkDeflate> zip;
 
     void ReadError(int wanted, int got);
-    int Send8(int val);
-    int Read8();
+    unsigned long long GetVarint();
+    unsigned long long GetUnsigned(int count);
+    void GetType(int type);
 
 public:
     int buffer_size{0}; 
     int send_size{0};
     int size{0};
+    int overflow{0};  // boolean - something didn't fit since the last Clear()
 
     explicit CharQueue(int max_size);
     ~CharQueue();
@@ -68,7 +108,45 @@ public:
         code = new_code;
     }
     
-    void Clear() noexcept { size = 0; start = 0; end = 0; }
+    void Clear() noexcept { size = 0; start = 0; end = 0; overflow = 0; }
+
+    // Values put or got from here on use new_encoding; the queue's
+    // contents are untouched, so a switch can fall mid-buffer.
+    // LINK_DEFLATE applies to frames written from here on (deflated
+    // frames are marked, so they're always read)
+    void SetEncoding(int new_encoding, int flags) noexcept
+    {
+        encoding = (new_encoding == LINK_ENCODING_COMPACT) ? LINK_ENCODING_COMPACT : LINK_ENCODING_TAGGED;
+        tagged = (encoding == LINK_ENCODING_TAGGED || (flags & LINK_CHECKED)) ? 1 : 0;
+        deflating = (flags & LINK_DEFLATE) ? 1 : 0;
+    }
+    [[nodiscard]] int Encoding() const noexcept { return encoding; }
+    [[nodiscard]] int Flags() const noexcept
+    {
+        return ((encoding == LINK_ENCODING_COMPACT && tagged) ? LINK_CHECKED : 0) |
+               (deflating ? LINK_DEFLATE : 0);
+    }
+
+    // Appends data with at most two copies; 1 (nothing added) if it
+    // won't fit
+    int PutBytes(std::span<const Uchar> data);
+    // Fills data from the front of the queue; 1 (nothing taken) if the
+    // queue holds less
+    int GetBytes(std::span<Uchar> data);
+    // Drops len bytes from the front; 1 (nothing dropped) if short
+    int Skip(int len);
+
+    // Reservation:  fill or read the ring in place, one contiguous
+    // region at a time (a second call picks up past the wrap point).
+    // WriteSpan() is the free space from the write position to the wrap
+    // point or the queued bytes, whichever comes first
+    [[nodiscard]] std::span<Uchar> WriteSpan() noexcept;
+    // Queues len bytes written at the front of WriteSpan()
+    void Commit(int len) noexcept;
+    // Queued bytes from the read position to the wrap point
+    [[nodiscard]] std::span<const Uchar> ReadSpan() const noexcept;
+    // Drops len bytes from the front of ReadSpan()
+    void Consume(int len) noexcept;
 
     int Put8(int val);
     int Get8();
@@ -88,8 +166,30 @@ public:
     int PutString(const std::string &str, int len);
     int GetString(char* str, size_t max_len);
 
-    int Read(int device_no);
+    // Starts over for a new connection
+    void Reset() noexcept
+    {
+        Clear();
+        inbox.Clear();
+        SetEncoding(LINK_ENCODING_TAGGED, 0);
+    }
+
+    // Clears the queue, reads whatever the (non-blocking) link has in
+    // one call and queues the contents of every whole frame in it:
+    // returns the bytes queued, 0 if no whole frame has come yet, -1 if
+    // the link closed, failed or sent a bad frame
+    int Read(int device_no) { return Read(device_no, inbox); }
+    int Read(int device_no, LinkInbox &from);
+    // Queues the contents of whole frames already read that didn't fit
+    // before, without reading; returns the bytes queued
+    int Take() { return Take(inbox); }
+    int Take(LinkInbox &from);
     int Write(int device_no, int do_clear = 1);
+    // Sets frame to what Write() would send:  the length, then the
+    // contents (deflated, if so switched and worth it)
+    void Frame(std::vector<Uchar> &frame);
+    // Deflate counts, once a frame has been deflated or inflated
+    [[nodiscard]] const LinkDeflate *Zip() const noexcept { return zip.get(); }
 
     [[nodiscard]] int BuffSize() const noexcept { return buffer_size; }
     [[nodiscard]] int SendSize() const noexcept { return send_size; }
@@ -102,6 +202,29 @@ public:
 // I2  - integer 2 bytes (16 bits)
 // I4  - integer 4 bytes (32 bits)
 // STR - I2 for string length, then string contents
+//
+// Under LINK_ENCODING_TAGGED each value is preceded by its type byte.
+// Under LINK_ENCODING_COMPACT an I1 is the bare byte, wider integers
+// are zig-zag varints (7 bits a byte, low bits first) and STR is a
+// varint length and the bytes; LINK_CHECKED puts the type bytes back.
+//
+// Links start out tagged.  vt_term follows SrvTermInfo with
+// SrvLinkOffer; vt_main answers TERM_LINKSWITCH with the encoding it
+// picked and writes that encoding from the next byte on, and vt_term,
+// once switched, answers SrvLinkSwitch and does the same.  Cloned
+// terminals are sent TERM_LINKSWITCH when they connect, since they
+// are fed the primary terminal's output.
+//
+// A terminal that offers LINK_PAGECACHE keeps a copy of its page in
+// slot sl when sent TERM_PAGESTORE, and puts it back on TERM_PAGERECALL
+// if it still holds the copy hash names; if not, it answers
+// SrvPageMiss and vt_main sends the page whole.  vt_main only asks this
+// when every link to the terminal (clones included) offered it, and
+// uses only as many slots as full screen copies fit in LinkPageMemory.
+//
+// LINK_DEFLATE in TERM_LINKSWITCH lets both ends deflate large frames
+// (see LinkDeflate); vt_main grants it when the terminal offers it and
+// its TermInfo allows it.
 
 // x, y - coordinate positions (I2, I2)
 // w, h - width, height        (I2, I2)
@@ -120,6 +243,7 @@ public:
 // s    - string               (STR)
 // sec  - time in seconds      (I2)
 // sh   - shape                (I1)
+// sl   - page copy slot       (I1)
 // sz   - size                 (I1)
 // t    - texture              (I1)
 // ts   - time string          (STR)
@@ -152,6 +276,9 @@ namespace TerminalProtocol {
     inline constexpr int SOLID_RECTANGLE = 23;  // <x, y, w, h, color>
     inline constexpr int PIXMAP          = 25;  // <x, y, w, h, s> - draw pixmap from file path
     inline constexpr int FLUSH           = 26;  // flush commands to X server
+    inline constexpr int LINKSWITCH      = 27;  // <I1 encoding, m> - see Protocol Formats
+    inline constexpr int PAGESTORE       = 28;  // <sl, I4 hash> - keep a copy of the page shown
+    inline constexpr int PAGERECALL      = 29;  // <sl, I4 hash> - show the copy kept
     
     inline constexpr int FLUSH_TS        = 30;  // no args
     inline constexpr int CALIBRATE_TS    = 31;  // no args
@@ -240,6 +367,9 @@ namespace TerminalProtocol {
 #define TERM_SOLID_RECTANGLE  TerminalProtocol::SOLID_RECTANGLE
 #define TERM_PIXMAP           TerminalProtocol::PIXMAP
 #define TERM_FLUSH            TerminalProtocol::FLUSH
+#define TERM_LINKSWITCH       TerminalProtocol::LINKSWITCH
+#define TERM_PAGESTORE        TerminalProtocol::PAGESTORE
+#define TERM_PAGERECALL       TerminalProtocol::PAGERECALL
 #define TERM_FLUSH_TS         TerminalProtocol::FLUSH_TS
 #define TERM_CALIBRATE_TS     TerminalProtocol::CALIBRATE_TS
 #define TERM_USERINPUT        TerminalProtocol::USERINPUT
@@ -318,10 +448,14 @@ enum class ServerProtocol : int {
     SrvItemSelect      = 16, // <I2, I2, I2> - layer, menu/list, item
     SrvTextEntry       = 17, // <I2, I2, str> - layer, entry, value
     SrvShutdown        = 18, // no args
+    SrvLinkOffer       = 19, // <I1 encoding, m> - highest encoding the term handles
     
     SrvPrinterDone     = 20, // <str> - printer done printing file
     SrvBadFile         = 21, // <str> - invalid file given
     SrvDefPage         = 22, // see term_dialog.cc
+    SrvLinkSwitch      = 23, // <I1 encoding, m> - term writes encoding from here on
+    SrvPageMiss        = 24, // <sl> - term holds no copy for TERM_PAGERECALL
+    SrvImageReady      = 25, // <I2, I2, I2, I2> - x, y, w, h of button images decoded
     
     SrvCcProcessed     = 30, // see Terminal::ReadCreditCard()
     SrvCcSettled       = 31,
@@ -0,0 +1,402 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * image_scale.cc
+ * Scaling of decoded RGBA images, and packing them into the X server's
+ * pixel layout
+ */
+
+#include "image_scale.hh"
+#include "fntrace.hh"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SCALE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SCALE_NEON
+#endif
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+/*
+ * Both filters are done in two passes, across then down, each output
+ * pixel being a weighted sum of a run of input pixels ("taps").  The
+ * sums are of premultiplied colour (r * a / 255, g * a / 255, b * a / 255,
+ * a) in floats, one pixel to a 4-lane vector, so the same few kernels
+ * serve both passes and both filters.
+ */
+
+namespace {
+
+struct Taps
+{
+    std::vector<int>   first;    // first input pixel of each output pixel
+    std::vector<int>   count;    // how many input pixels it takes
+    std::vector<int>   start;    // where its weights begin
+    std::vector<float> weights;
+};
+
+/****
+ * BoxTaps:  each output pixel covers in / out input pixels, weighted by
+ *  how much of each it covers
+ ****/
+Taps BoxTaps(int in, int out)
+{
+    Taps taps;
+    const double scale = static_cast<double>(in) / out;
+    for (int idx = 0; idx < out; ++idx)
+    {
+        const double left = idx * scale;
+        const double right = std::min(static_cast<double>(in), (idx + 1) * scale);
+        const int first = std::min(in - 1, static_cast<int>(left));
+        const int last = std::max(first, std::min(in - 1, static_cast<int>(std::ceil(right)) - 1));
+        taps.first.push_back(first);
+        taps.count.push_back(last - first + 1);
+        taps.start.push_back(static_cast<int>(taps.weights.size()));
+        for (int src = first; src <= last; ++src)
+        {
+            const double covered = std::min(right, src + 1.0) - std::max(left, static_cast<double>(src));
+            taps.weights.push_back(static_cast<float>(std::max(0.0, covered) / (right - left)));
+        }
+    }
+    return taps;
+}
+
+/****
+ * BilinearTaps:  the two input pixels either side of each output
+ *  pixel's centre
+ ****/
+Taps BilinearTaps(int in, int out)
+{
+    Taps taps;
+    const double scale = static_cast<double>(in) / out;
+    for (int idx = 0; idx < out; ++idx)
+    {
+        const double centre = std::clamp((idx + 0.5) * scale - 0.5, 0.0, in - 1.0);
+        const int first = std::min(in - 1, static_cast<int>(centre));
+        const float frac = static_cast<float>(centre - first);
+        taps.first.push_back(first);
+        taps.start.push_back(static_cast<int>(taps.weights.size()));
+        if (first + 1 < in && frac > 0.0f)
+        {
+            taps.count.push_back(2);
+            taps.weights.push_back(1.0f - frac);
+            taps.weights.push_back(frac);
+        }
+        else
+        {
+            taps.count.push_back(1);
+            taps.weights.push_back(1.0f);
+        }
+    }
+    return taps;
+}
+
+/**** Kernels ****/
+// src:  pixels RGBA bytes; dst:  pixels premultiplied floats
+void PremultiplyRow(const Uchar *src, float *dst, int pixels)
+{
+#if defined(SCALE_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 inv255 = _mm_set1_ps(1.0f / 255.0f);
+    const __m128 colour = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+    const auto premultiply = [&](__m128i wide, float *out) {
+        const __m128 px = _mm_cvtepi32_ps(wide);
+        const __m128 alpha = _mm_mul_ps(_mm_shuffle_ps(px, px, _MM_SHUFFLE(3, 3, 3, 3)), inv255);
+        const __m128 scaled = _mm_mul_ps(px, alpha);
+        _mm_storeu_ps(out, _mm_or_ps(_mm_and_ps(colour, scaled), _mm_andnot_ps(colour, px)));
+    };
+    int idx = 0;
+    for (; idx + 4 <= pixels; idx += 4)
+    {
+        // four pixels at a time, widened 8 -> 16 -> 32 bits
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + idx * 4));
+        const __m128i low = _mm_unpacklo_epi8(bytes, zero);
+        const __m128i high = _mm_unpackhi_epi8(bytes, zero);
+        premultiply(_mm_unpacklo_epi16(low, zero), dst + idx * 4);
+        premultiply(_mm_unpackhi_epi16(low, zero), dst + idx * 4 + 4);
+        premultiply(_mm_unpacklo_epi16(high, zero), dst + idx * 4 + 8);
+        premultiply(_mm_unpackhi_epi16(high, zero), dst + idx * 4 + 12);
+    }
+    for (; idx < pixels; ++idx)
+    {
+        int bytes;
+        std::memcpy(&bytes, src + idx * 4, 4);
+        premultiply(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero), dst + idx * 4);
+    }
+#elif defined(SCALE_NEON)
+    for (int idx = 0; idx < pixels; ++idx)
+    {
+        uint32_t word;
+        std::memcpy(&word, src + idx * 4, 4);
+        const uint8x8_t bytes = vreinterpret_u8_u32(vdup_n_u32(word));
+        const float32x4_t px = vcvtq_f32_u32(vmovl_u16(vget_low_u16(vmovl_u8(bytes))));
+        float32x4_t scaled = vmulq_n_f32(px, vgetq_lane_f32(px, 3) * (1.0f / 255.0f));
+        scaled = vsetq_lane_f32(vgetq_lane_f32(px, 3), scaled, 3);
+        vst1q_f32(dst + idx * 4, scaled);
+    }
+#else
+    for (int idx = 0; idx < pixels; ++idx)
+    {
+        const Uchar *px = src + idx * 4;
+        const float alpha = px[3] * (1.0f / 255.0f);
+        float *out = dst + idx * 4;
+        out[0] = px[0] * alpha;
+        out[1] = px[1] * alpha;
+        out[2] = px[2] * alpha;
+        out[3] = px[3];
+    }
+#endif
+}
+
+// acc (floats) += weight * src (floats)
+void AccumulateRow(float *acc, const float *src, int floats, float weight)
+{
+#if defined(SCALE_SSE2)
+    const __m128 w = _mm_set1_ps(weight);
+    for (int idx = 0; idx < floats; idx += 4)
+        _mm_storeu_ps(acc + idx, _mm_add_ps(_mm_loadu_ps(acc + idx), _mm_mul_ps(_mm_loadu_ps(src + idx), w)));
+#elif defined(SCALE_NEON)
+    for (int idx = 0; idx < floats; idx += 4)
+        vst1q_f32(acc + idx, vmlaq_n_f32(vld1q_f32(acc + idx), vld1q_f32(src + idx), weight));
+#else
+    for (int idx = 0; idx < floats; ++idx)
+        acc[idx] += src[idx] * weight;
+#endif
+}
+
+// one output pixel of the pass across:  the sum of its taps in row
+void GatherPixel(float *out, const float *row, const float *weights, int count)
+{
+#if defined(SCALE_SSE2)
+    __m128 acc = _mm_setzero_ps();
+    for (int tap = 0; tap < count; ++tap)
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(row + tap * 4), _mm_set1_ps(weights[tap])));
+    _mm_storeu_ps(out, acc);
+#elif defined(SCALE_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (int tap = 0; tap < count; ++tap)
+        acc = vmlaq_n_f32(acc, vld1q_f32(row + tap * 4), weights[tap]);
+    vst1q_f32(out, acc);
+#else
+    out[0] = out[1] = out[2] = out[3] = 0.0f;
+    for (int tap = 0; tap < count; ++tap)
+        for (int ch = 0; ch < 4; ++ch)
+            out[ch] += row[tap * 4 + ch] * weights[tap];
+#endif
+}
+
+// premultiplied floats back to RGBA bytes
+void UnpremultiplyRow(const float *src, Uchar *dst, int pixels)
+{
+    for (int idx = 0; idx < pixels; ++idx)
+    {
+        const float *px = src + idx * 4;
+        Uchar *out = dst + idx * 4;
+        const float alpha = std::clamp(px[3], 0.0f, 255.0f);
+        if (alpha < 0.5f)
+        {
+            out[0] = out[1] = out[2] = out[3] = 0;
+            continue;
+        }
+        const float unscale = 255.0f / alpha;
+        for (int ch = 0; ch < 3; ++ch)
+            out[ch] = static_cast<Uchar>(std::clamp(px[ch] * unscale + 0.5f, 0.0f, 255.0f));
+        out[3] = static_cast<Uchar>(alpha + 0.5f);
+    }
+}
+
+// the shift of an 8-bit channel mask, or -1 if it isn't one
+int ChannelShift(unsigned long mask)
+{
+    for (int shift = 0; shift <= 24; ++shift)
+        if (mask == (0xFFUL << shift))
+            return shift;
+    return -1;
+}
+
+} // namespace
+
+int ScaleRgba(const RgbaImage &src, RgbaImage &dst, int w, int h, int filter)
+{
+    FnTrace("ScaleRgba()");
+    if (src.Empty() || w <= 0 || h <= 0 ||
+        src.pixels.size() < static_cast<size_t>(src.width) * src.height * 4)
+    {
+        return 1;
+    }
+
+    const bool box_x = (filter == SCALE_BOX) || (filter == SCALE_AUTO && w < src.width);
+    const bool box_y = (filter == SCALE_BOX) || (filter == SCALE_AUTO && h < src.height);
+    const Taps across = box_x ? BoxTaps(src.width, w) : BilinearTaps(src.width, w);
+    const Taps down = box_y ? BoxTaps(src.height, h) : BilinearTaps(src.height, h);
+
+    // across:  only the input rows something is taken from
+    std::vector<float> premultiplied(static_cast<size_t>(src.width) * 4);
+    std::vector<float> narrowed(static_cast<size_t>(src.height) * w * 4);
+    std::vector<bool> used(src.height, false);
+    for (int y = 0; y < h; ++y)
+        for (int tap = 0; tap < down.count[y]; ++tap)
+            used[down.first[y] + tap] = true;
+    for (int y = 0; y < src.height; ++y)
+    {
+        if (!used[y])
+            continue;
+        PremultiplyRow(src.Row(y), premultiplied.data(), src.width);
+        float *out = narrowed.data() + static_cast<size_t>(y) * w * 4;
+        for (int x = 0; x < w; ++x)
+        {
+            GatherPixel(out + x * 4, premultiplied.data() + across.first[x] * 4,
+                        across.weights.data() + across.start[x], across.count[x]);
+        }
+    }
+
+    // down
+    dst.Resize(w, h);
+    std::vector<float> acc(static_cast<size_t>(w) * 4);
+    for (int y = 0; y < h; ++y)
+    {
+        std::fill(acc.begin(), acc.end(), 0.0f);
+        for (int tap = 0; tap < down.count[y]; ++tap)
+        {
+            AccumulateRow(acc.data(), narrowed.data() + static_cast<size_t>(down.first[y] + tap) * w * 4,
+                          w * 4, down.weights[down.start[y] + tap]);
+        }
+        UnpremultiplyRow(acc.data(), dst.Row(y), w);
+    }
+    return 0;
+}
+
+int AlphaMask(const RgbaImage &image, std::vector<Uchar> &bits, int threshold)
+{
+    FnTrace("AlphaMask()");
+    const int stride = (image.width + 7) / 8;
+    bits.assign(static_cast<size_t>(stride) * std::max(0, image.height), 0);
+    int left_out = 0;
+    for (int y = 0; y < image.height; ++y)
+    {
+        const Uchar *row = image.Row(y);
+        Uchar *out = bits.data() + static_cast<size_t>(y) * stride;
+        for (int x = 0; x < image.width; ++x)
+        {
+            if (row[x * 4 + 3] >= threshold)
+                out[x >> 3] |= static_cast<Uchar>(1 << (x & 7));
+            else
+                ++left_out;
+        }
+    }
+    return left_out;
+}
+
+int NativeLayout(unsigned long red_mask, unsigned long green_mask, unsigned long blue_mask,
+                 int bits_per_pixel, bool msb_first, PixelLayout &layout)
+{
+    const int red = ChannelShift(red_mask);
+    const int green = ChannelShift(green_mask);
+    const int blue = ChannelShift(blue_mask);
+    if (red < 0 || green < 0 || blue < 0 || (bits_per_pixel != 24 && bits_per_pixel != 32))
+        return 1;
+    if (std::max({red, green, blue}) + 8 > bits_per_pixel)
+        return 1;
+    layout.bytes_per_pixel = bits_per_pixel / 8;
+    layout.red_shift = red;
+    layout.green_shift = green;
+    layout.blue_shift = blue;
+    layout.msb_first = msb_first;
+    return 0;
+}
+
+void PackRgbaRow(const Uchar *rgba, Uchar *dst, int pixels, const PixelLayout &layout, int threshold)
+{
+    int idx = 0;
+    // B, G, R, 0 in memory:  what nearly every 24-bit TrueColor server uses
+    const bool bgrx = layout.bytes_per_pixel == 4 && !layout.msb_first &&
+                      std::endian::native == std::endian::little &&
+                      layout.red_shift == 16 && layout.green_shift == 8 && layout.blue_shift == 0 &&
+                      threshold >= 0 && threshold <= 255;
+    if (bgrx)
+    {
+#if defined(SCALE_SSE2)
+        const __m128i low = _mm_set1_epi32(0xFF);
+        const __m128i middle = _mm_set1_epi32(0xFF00);
+        const __m128i limit = _mm_set1_epi32(threshold - 1);
+        for (; idx + 4 <= pixels; idx += 4)
+        {
+            const __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + idx * 4));
+            const __m128i opaque = _mm_cmpgt_epi32(_mm_srli_epi32(words, 24), limit);
+            const __m128i packed = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(_mm_and_si128(words, low), 16),
+                                                             _mm_and_si128(words, middle)),
+                                                _mm_and_si128(_mm_srli_epi32(words, 16), low));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + idx * 4), _mm_and_si128(packed, opaque));
+        }
+#elif defined(SCALE_NEON)
+        const uint8x8_t limit = vdup_n_u8(static_cast<Uchar>(threshold));
+        for (; idx + 8 <= pixels; idx += 8)
+        {
+            const uint8x8x4_t px = vld4_u8(rgba + idx * 4);
+            const uint8x8_t opaque = vcge_u8(px.val[3], limit);
+            uint8x8x4_t out;
+            out.val[0] = vand_u8(px.val[2], opaque);
+            out.val[1] = vand_u8(px.val[1], opaque);
+            out.val[2] = vand_u8(px.val[0], opaque);
+            out.val[3] = vdup_n_u8(0);
+            vst4_u8(dst + idx * 4, out);
+        }
+#endif
+    }
+
+    const int bytes = layout.bytes_per_pixel;
+    for (; idx < pixels; ++idx)
+    {
+        const Uchar *px = rgba + idx * 4;
+        std::uint32_t word = 0;
+        if (px[3] >= threshold)
+            word = (static_cast<std::uint32_t>(px[0]) << layout.red_shift) |
+                   (static_cast<std::uint32_t>(px[1]) << layout.green_shift) |
+                   (static_cast<std::uint32_t>(px[2]) << layout.blue_shift);
+        if (bgrx)
+        {
+            std::memcpy(dst + idx * 4, &word, 4);
+            continue;
+        }
+        Uchar *out = dst + idx * bytes;
+        for (int byte = 0; byte < bytes; ++byte)
+        {
+            const int shift = layout.msb_first ? 8 * (bytes - 1 - byte) : 8 * byte;
+            out[byte] = static_cast<Uchar>(word >> shift);
+        }
+    }
+}
+
+const char* ScaleKernel() noexcept
+{
+#if defined(SCALE_SSE2)
+    return "sse2";
+#elif defined(SCALE_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
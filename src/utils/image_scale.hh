@@ -0,0 +1,79 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * image_scale.hh
+ * Scaling of decoded RGBA images, and packing them into the X server's
+ * pixel layout
+ */
+
+#ifndef IMAGE_SCALE_HH
+#define IMAGE_SCALE_HH
+
+#include "basic.hh"
+
+#include <cstddef>
+#include <vector>
+
+// Filters for ScaleRgba()
+#define SCALE_AUTO      0  // box to shrink, bilinear to enlarge
+#define SCALE_BOX       1  // area average of the pixels each one covers
+#define SCALE_BILINEAR  2  // blend of the four nearest pixels
+
+#define ALPHA_OPAQUE    128  // AlphaMask() draws pixels at least this opaque
+
+/**** Types ****/
+struct RgbaImage
+{
+    int width{0};
+    int height{0};
+    std::vector<Uchar> pixels;  // R, G, B, A bytes, rows one after another
+
+    void Resize(int w, int h) { width = w; height = h; pixels.assign(static_cast<size_t>(w) * h * 4, 0); }
+    [[nodiscard]] bool Empty() const noexcept { return width <= 0 || height <= 0; }
+    [[nodiscard]] Uchar *Row(int y) noexcept { return pixels.data() + static_cast<size_t>(y) * width * 4; }
+    [[nodiscard]] const Uchar *Row(int y) const noexcept { return pixels.data() + static_cast<size_t>(y) * width * 4; }
+};
+
+struct PixelLayout
+{
+    int bytes_per_pixel{4};  // 3 or 4
+    int red_shift{16};
+    int green_shift{8};
+    int blue_shift{0};
+    bool msb_first{false};   // byte order of each pixel in memory
+};
+
+/**** Functions ****/
+int ScaleRgba(const RgbaImage &src, RgbaImage &dst, int w, int h, int filter = SCALE_AUTO);
+// Scales src into dst (w x h).  Colours are weighted by their alpha, so
+// transparent pixels don't bleed into the edges of what is drawn.
+// Returns 1 (dst untouched) if either size is empty, else 0.
+int AlphaMask(const RgbaImage &image, std::vector<Uchar> &bits, int threshold = ALPHA_OPAQUE);
+// Fills bits with a 1-bit mask of image, a row of (width + 7) / 8 bytes
+// per line, least significant bit leftmost, set where alpha is at least
+// threshold.  Returns how many pixels are left out (0:  no mask needed).
+int NativeLayout(unsigned long red_mask, unsigned long green_mask, unsigned long blue_mask,
+                 int bits_per_pixel, bool msb_first, PixelLayout &layout);
+// Fills layout for a TrueColor image with 8 bits a channel and 24 or 32
+// bits a pixel.  Returns 1 for any other layout, else 0.
+void PackRgbaRow(const Uchar *rgba, Uchar *dst, int pixels, const PixelLayout &layout,
+                 int threshold = ALPHA_OPAQUE);
+// Writes pixels from rgba to dst in layout.  Pixels less opaque than
+// threshold are written black, as they are left out by the mask.
+const char* ScaleKernel() noexcept;
+// The inner loops compiled in:  "sse2", "neon" or "scalar"
+
+#endif
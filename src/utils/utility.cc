@@ -147,6 +147,13 @@ bool Str::Set(const std::string &str)
     return true;
 }
 
+bool Str::Set(std::string_view str)
+{
+    FnTrace("Str::Set(std::string_view)");
+    data.assign(str);
+    return true;
+}
+
 bool Str::Set(const int val)
 {
     FnTrace("Str::Set(int)");
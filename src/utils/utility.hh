@@ -28,6 +28,7 @@
 #include "time_info.hh"
 
 #include <string>
+#include <string_view>
 #include <sys/stat.h>  // for mode_t
 
 extern int debug_mode;
@@ -83,6 +84,7 @@ public:
     int   Clear();
     bool  Set(const char *str);
     bool  Set(const std::string &str);
+    bool  Set(std::string_view str);
     bool  Set(const int val);
     bool  Set(const Flt val);
     bool  Set(const Str &s) { data = s.data; return true; }
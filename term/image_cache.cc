@@ -0,0 +1,554 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * image_cache.cc
+ * Button images decoded and scaled once, kept as server pixmaps
+ */
+
+#include "image_cache.hh"
+#include "term_view.hh"
+#include "image_scale.hh"
+#include "fntrace.hh"
+
+#include <X11/Xutil.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+ImageCache ButtonImages;
+
+// File types DecodeImageFile() knows, by extension
+#define IMAGE_FILE_OTHER  0  // XPM, loaded with libXpm on the Xt thread
+#define IMAGE_FILE_PNG    1
+#define IMAGE_FILE_JPEG   2
+#define IMAGE_FILE_GIF    3
+
+static int ImageFileType(const std::string &path)
+{
+    std::string lowered = path;
+    std::transform(lowered.begin(), lowered.end(), lowered.begin(), ::tolower);
+    if (lowered.find(".png") != std::string::npos)
+        return IMAGE_FILE_PNG;
+    if (lowered.find(".jpg") != std::string::npos || lowered.find(".jpeg") != std::string::npos)
+        return IMAGE_FILE_JPEG;
+    if (lowered.find(".gif") != std::string::npos)
+        return IMAGE_FILE_GIF;
+    return IMAGE_FILE_OTHER;
+}
+
+/****
+ * DecodeImageFile:  decodes a PNG, JPEG or GIF path by its extension.
+ *  Returns 0 on success, 1 on failure and -1 for anything else (XPM).
+ *  Makes no X calls, so the worker can use it.
+ ****/
+static int DecodeImageFile(const std::string &path, RgbaImage &image)
+{
+    FnTrace("DecodeImageFile()");
+    switch (ImageFileType(path))
+    {
+    case IMAGE_FILE_PNG:
+#ifdef HAVE_PNG
+        return DecodePNGFile(path.c_str(), image);
+#else
+        fprintf(stderr, "PNG support not available - please install libpng-dev\n");
+        return 1;
+#endif
+    case IMAGE_FILE_JPEG:
+#ifdef HAVE_JPEG
+        return DecodeJPEGFile(path.c_str(), image);
+#else
+        fprintf(stderr, "JPEG support not available - please install libjpeg-dev\n");
+        return 1;
+#endif
+    case IMAGE_FILE_GIF:
+#ifdef HAVE_GIF
+        return DecodeGIFFile(path.c_str(), image);
+#else
+        fprintf(stderr, "GIF support not available - please install libgif-dev\n");
+        return 1;
+#endif
+    default:
+        return -1;
+    }
+}
+
+/****
+ * MakeRgbaImage:  decoded scaled to w x h with ScaleRgba() and put on
+ *  the server
+ ****/
+static ImageCache::Image MakeRgbaImage(const RgbaImage &decoded, int w, int h)
+{
+    FnTrace("MakeRgbaImage()");
+    ImageCache::Image image;
+    RgbaImage scaled;
+    const RgbaImage *use = &decoded;
+    if (decoded.width != w || decoded.height != h)
+    {
+        if (ScaleRgba(decoded, scaled, w, h))
+            return image;
+        use = &scaled;
+    }
+
+    Xpm *xpm = RgbaToXpm(*use);
+    if (xpm == nullptr)
+        return image;
+    image.pixmap = xpm->pixmap;
+    image.mask = xpm->mask;
+    image.width = w;
+    image.height = h;
+    delete xpm;
+    return image;
+}
+
+/****
+ * ScalePlane:  nearest-neighbour copy of src (img_w x img_h) into a new
+ *  pixmap of w x h and the given depth
+ ****/
+static Pixmap ScalePlane(Display *dis, Drawable drawable, Pixmap src, int img_w, int img_h,
+                         int w, int h, int depth)
+{
+    FnTrace("ScalePlane()");
+    XImage *orig = XGetImage(dis, src, 0, 0, img_w, img_h, AllPlanes,
+                             (depth == 1) ? XYPixmap : ZPixmap);
+    if (orig == nullptr)
+        return 0;
+
+    XImage *scaled = nullptr;
+    if (depth == 1)
+    {
+        const int bytes_per_line = (w + 7) / 8;
+        scaled = XCreateImage(dis, DefaultVisual(dis, DefaultScreen(dis)), 1, XYBitmap, 0,
+                              static_cast<char*>(calloc(static_cast<size_t>(bytes_per_line) * h, 1)),
+                              w, h, 8, bytes_per_line);
+    }
+    else
+    {
+        const int bits_per_pixel = orig->bits_per_pixel;
+        const int bitmap_pad = orig->bitmap_pad;
+        const int bytes_per_line = ((w * bits_per_pixel + (bitmap_pad - 1)) / bitmap_pad) * (bitmap_pad / 8);
+        scaled = XCreateImage(dis, DefaultVisual(dis, DefaultScreen(dis)), orig->depth, ZPixmap, 0,
+                              static_cast<char*>(malloc(static_cast<size_t>(bytes_per_line) * h)),
+                              w, h, bitmap_pad, bytes_per_line);
+    }
+
+    Pixmap result = 0;
+    if (scaled && scaled->data)
+    {
+        const double inv_scale_x = static_cast<double>(img_w) / static_cast<double>(w);
+        const double inv_scale_y = static_cast<double>(img_h) / static_cast<double>(h);
+        for (int y = 0; y < h; ++y)
+        {
+            const int src_y = std::min(static_cast<int>(y * inv_scale_y), img_h - 1);
+            for (int x = 0; x < w; ++x)
+            {
+                const int src_x = std::min(static_cast<int>(x * inv_scale_x), img_w - 1);
+                XPutPixel(scaled, x, y, XGetPixel(orig, src_x, src_y));
+            }
+        }
+
+        result = XCreatePixmap(dis, drawable, w, h, depth);
+        // XYBitmap images are drawn in the GC's colours:  1 bits must stay 1
+        XGCValues values;
+        values.foreground = 1;
+        values.background = 0;
+        GC gc = XCreateGC(dis, result, (depth == 1) ? (GCForeground | GCBackground) : 0, &values);
+        XPutImage(dis, result, gc, scaled, 0, 0, 0, 0, w, h);
+        XFreeGC(dis, gc);
+    }
+
+    if (scaled)
+    {
+        free(scaled->data);
+        scaled->data = nullptr;
+        XDestroyImage(scaled);
+    }
+    XDestroyImage(orig);
+    return result;
+}
+
+/****
+ * MakeImage:  an XPM file's xpm scaled to w x h.  xpm's own pixmaps
+ *  are used when it is the right size already and freed otherwise.
+ ****/
+static ImageCache::Image MakeImage(Display *dis, Drawable drawable, Xpm *xpm, int w, int h)
+{
+    FnTrace("MakeImage()");
+    ImageCache::Image image;
+    image.width = w;
+    image.height = h;
+    const int img_w = xpm->Width();
+    const int img_h = xpm->Height();
+    if (img_w <= 0 || img_h <= 0)
+    {
+        image.width = 0;
+        image.height = 0;
+    }
+    else if (img_w == w && img_h == h)
+    {
+        image.pixmap = xpm->pixmap;
+        image.mask = xpm->mask;
+        xpm->pixmap = 0;
+        xpm->mask = 0;
+    }
+    else
+    {
+        image.pixmap = ScalePlane(dis, drawable, xpm->pixmap, img_w, img_h, w, h,
+                                  DefaultDepth(dis, DefaultScreen(dis)));
+        if (image.pixmap && xpm->mask)
+            image.mask = ScalePlane(dis, drawable, xpm->mask, img_w, img_h, w, h, 1);
+    }
+
+    if (xpm->pixmap)
+        XFreePixmap(dis, xpm->pixmap);
+    if (xpm->mask)
+        XFreePixmap(dis, xpm->mask);
+    delete xpm;
+    return image;
+}
+
+/***********************************************************************
+ * ImageCache Class
+ ***********************************************************************/
+const ImageCache::Image *ImageCache::Get(Display *d, Drawable drawable, const char* filename, int w, int h)
+{
+    FnTrace("ImageCache::Get()");
+    return Lookup(d, drawable, filename, w, h, nullptr);
+}
+
+const ImageCache::Image *ImageCache::Request(Display *d, Drawable drawable, const char* filename,
+                                             int x, int y, int w, int h)
+{
+    FnTrace("ImageCache::Request()");
+    const Area area{x, y, w, h};
+    return Lookup(d, drawable, filename, w, h, &area);
+}
+
+const ImageCache::Image *ImageCache::Lookup(Display *d, Drawable drawable, const char* filename,
+                                            int w, int h, const Area *area)
+{
+    FnTrace("ImageCache::Lookup()");
+    if (filename == nullptr || filename[0] == '\0' || w <= 0 || h <= 0)
+        return nullptr;
+    dis = d;
+
+    std::vector<std::string> paths;
+    if (filename[0] == '/')
+        paths.emplace_back(filename);
+    else
+    {
+        paths.push_back(std::string(VIEWTOUCH_PATH "/imgs/") + filename);
+        paths.push_back(std::string(VIEWTOUCH_PATH "/") + filename);
+        paths.emplace_back(filename);
+    }
+
+    for (const std::string &path : paths)
+    {
+        struct stat sb;
+        if (stat(path.c_str(), &sb) != 0)
+            continue;
+        std::string key = path + '\n' + std::to_string(static_cast<long long>(sb.st_mtime)) + '\n' +
+                          std::to_string(w) + 'x' + std::to_string(h);
+        const Image *image = Find(key);
+        if (image == nullptr && area && ready && ImageFileType(path) != IMAGE_FILE_OTHER)
+        {
+            ++stats.misses;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                jobs.push_back(Job{key, path, w, h});
+            }
+            wake.notify_one();
+            Image queued;
+            queued.pending = 1;
+            image = Add(key, queued);
+        }
+        else if (image == nullptr)
+        {
+            ++stats.misses;
+            RgbaImage decoded;
+            const int decode = DecodeImageFile(path, decoded);
+            if (decode == 0)
+                image = Add(std::move(key), MakeRgbaImage(decoded, w, h));
+            else if (decode > 0)
+                image = Add(std::move(key), Image{});
+            else
+            {
+                std::vector<char> mutable_path(path.begin(), path.end());
+                mutable_path.push_back('\0');
+                Xpm *xpm = LoadPixmapFile(mutable_path.data());
+                image = Add(std::move(key), xpm ? MakeImage(dis, drawable, xpm, w, h) : Image{});
+            }
+        }
+        else if (image->pending)
+            ++stats.waits;
+        else
+            ++stats.hits;
+
+        if (image->pending && area)
+            waiting[key].push_back(*area);
+        if (image->pixmap || image->pending)
+            return image;
+    }
+    return nullptr;
+}
+
+int ImageCache::Start(XtAppContext app, ImageReadyFn fn)
+{
+    FnTrace("ImageCache::Start()");
+    if (worker.joinable())
+        return 0;
+    if (pipe(wake_pipe) != 0)
+    {
+        wake_pipe[0] = wake_pipe[1] = -1;
+        return 1;
+    }
+    fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+    input = XtAppAddInput(app, wake_pipe[0], (XtPointer) XtInputReadMask,
+                          (XtInputCallbackProc) ReadyCB, this);
+    ready = fn;
+    stopping = false;
+    worker = std::thread([this] { Work(); });
+    return 0;
+}
+
+void ImageCache::Stop()
+{
+    FnTrace("ImageCache::Stop()");
+    if (!worker.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+        jobs.clear();
+    }
+    wake.notify_all();
+    worker.join();
+    decoded.clear();
+    waiting.clear();
+    ready = nullptr;
+
+    XtRemoveInput(input);
+    input = 0;
+    close(wake_pipe[0]);
+    close(wake_pipe[1]);
+    wake_pipe[0] = wake_pipe[1] = -1;
+
+    // nothing will fill these in now
+    for (auto entry = entries.begin(); entry != entries.end();)
+    {
+        if (entry->image.pending)
+        {
+            index.erase(entry->key);
+            entry = entries.erase(entry);
+        }
+        else
+            ++entry;
+    }
+    stats.images = entries.size();
+}
+
+/****
+ * Work:  the worker thread; decodes and scales jobs until stopped.  Only
+ *  pixels are made here; the Xt thread puts them on the server.
+ ****/
+void ImageCache::Work()
+{
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [this] { return stopping || !jobs.empty(); });
+            if (stopping)
+                return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        Decoded result{job.key, RgbaImage{}};
+        RgbaImage image;
+        if (DecodeImageFile(job.path, image) == 0)
+        {
+            if (image.width == job.w && image.height == job.h)
+                result.image = std::move(image);
+            else
+                ScaleRgba(image, result.image, job.w, job.h);
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (stopping)
+                return;
+            decoded.push_back(std::move(result));
+        }
+        // a full pipe already has the Xt loop on its way
+        const char byte = 1;
+        if (write(wake_pipe[1], &byte, 1) < 0 && errno != EAGAIN)
+            perror("ImageCache::Work");
+    }
+}
+
+/****
+ * Collect:  puts what the worker decoded on the server and reports the
+ *  areas that drew placeholders for it, as one rectangle
+ ****/
+void ImageCache::Collect()
+{
+    FnTrace("ImageCache::Collect()");
+    char bytes[64];
+    while (read(wake_pipe[0], bytes, sizeof(bytes)) > 0)
+        ;
+
+    std::vector<Decoded> done;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        done.swap(decoded);
+    }
+
+    int x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+    int areas = 0;
+    for (Decoded &result : done)
+    {
+        auto found = index.find(result.key);
+        if (found != index.end() && found->second->image.pending)
+        {
+            Entry &entry = *found->second;
+            entry.image = result.image.Empty() ? Image{} :
+                          MakeRgbaImage(result.image, result.image.width, result.image.height);
+            entry.bytes = Bytes(entry.image);
+            stats.bytes += entry.bytes;
+        }
+
+        auto waiters = waiting.find(result.key);
+        if (waiters == waiting.end())
+            continue;
+        for (const Area &area : waiters->second)
+        {
+            if (areas++ == 0)
+            {
+                x1 = area.x;
+                y1 = area.y;
+                x2 = area.x + area.w;
+                y2 = area.y + area.h;
+            }
+            else
+            {
+                x1 = std::min(x1, area.x);
+                y1 = std::min(y1, area.y);
+                x2 = std::max(x2, area.x + area.w);
+                y2 = std::max(y2, area.y + area.h);
+            }
+        }
+        waiting.erase(waiters);
+    }
+    Evict();
+
+    if (areas > 0 && ready)
+        ready(x1, y1, x2 - x1, y2 - y1);
+}
+
+void ImageCache::ReadyCB(XtPointer client_data, int *fid, XtInputId *id)
+{
+    static_cast<ImageCache *>(client_data)->Collect();
+}
+
+void ImageCache::Clear()
+{
+    FnTrace("ImageCache::Clear()");
+    for (Entry &entry : entries)
+    {
+        if (entry.image.pixmap)
+            XFreePixmap(dis, entry.image.pixmap);
+        if (entry.image.mask)
+            XFreePixmap(dis, entry.image.mask);
+    }
+    entries.clear();
+    index.clear();
+    stats.bytes = 0;
+    stats.images = 0;
+}
+
+const ImageCache::Image *ImageCache::Find(const std::string &key)
+{
+    auto found = index.find(key);
+    if (found == index.end())
+        return nullptr;
+    entries.splice(entries.begin(), entries, found->second);
+    return &found->second->image;
+}
+
+const ImageCache::Image *ImageCache::Add(std::string key, Image image)
+{
+    FnTrace("ImageCache::Add()");
+    const std::size_t bytes = Bytes(image);
+    entries.push_front(Entry{key, image, bytes});
+    index[std::move(key)] = entries.begin();
+    stats.bytes += bytes;
+    stats.images = entries.size();
+    Evict();
+    return &entries.front().image;
+}
+
+// server memory image takes, estimated
+std::size_t ImageCache::Bytes(const Image &image) const
+{
+    if (image.pixmap == 0)
+        return 0;
+    const int depth = DefaultDepth(dis, DefaultScreen(dis));
+    const std::size_t pixel_bytes = (depth > 16) ? 4 : (depth > 8) ? 2 : 1;
+    std::size_t bytes = pixel_bytes * image.width * image.height;
+    if (image.mask)
+        bytes += static_cast<std::size_t>((image.width + 7) / 8) * image.height;
+    return bytes;
+}
+
+/****
+ * Evict:  frees the least recently drawn images until the cache fits,
+ *  never the one just added.  Pending images are passed over:  they hold
+ *  no pixmap yet, and dropping one would only decode it again on the
+ *  next draw.
+ ****/
+void ImageCache::Evict()
+{
+    FnTrace("ImageCache::Evict()");
+    auto victim = entries.end();
+    while (stats.bytes > budget || entries.size() > IMAGE_CACHE_ENTRIES)
+    {
+        if (victim == entries.begin() || --victim == entries.begin())
+            break;
+        if (victim->image.pending)
+            continue;
+        if (victim->image.pixmap)
+            XFreePixmap(dis, victim->image.pixmap);
+        if (victim->image.mask)
+            XFreePixmap(dis, victim->image.mask);
+        stats.bytes -= victim->bytes;
+        ++stats.evictions;
+        index.erase(victim->key);
+        victim = entries.erase(victim);
+    }
+    stats.images = entries.size();
+}
@@ -0,0 +1,168 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * image_cache.hh
+ * Button images decoded and scaled once, kept as server pixmaps
+ */
+
+#ifndef IMAGE_CACHE_HH
+#define IMAGE_CACHE_HH
+
+#include "image_scale.hh"
+
+#include <X11/Xlib.h>
+#include <X11/Intrinsic.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#define IMAGE_CACHE_BYTES    (32 * 1024 * 1024)  // server memory the images may use
+#define IMAGE_CACHE_ENTRIES  1024                // most images (and failures) kept
+
+typedef void (*ImageReadyFn)(int x, int y, int w, int h);
+
+/*********************************************************************
+ * ImageCache
+ *
+ * Button images ready to copy to a layer:  decoded from their file
+ * and scaled to the size drawn, with their mask.  Each is known by the
+ * file it came from, the file's modification time and the size, so an
+ * image replaced on disk is loaded again.  Files that can't be decoded
+ * are remembered too, so they aren't tried on every redraw.  Past
+ * IMAGE_CACHE_BYTES (or IMAGE_CACHE_ENTRIES) the least recently drawn
+ * images are freed.
+ *
+ * Once Start() is called, PNG, JPEG and GIF files drawn with Request()
+ * are decoded and scaled on a worker thread.  Until they are ready the
+ * caller gets a pending Image to draw a placeholder for, and afterwards
+ * the ready function is called (on the Xt thread) with the area the
+ * image was asked for, so it can be drawn again.
+ ********************************************************************/
+class ImageCache
+{
+public:
+    struct Image
+    {
+        Pixmap pixmap{0};  // 0 for a file that couldn't be loaded
+        Pixmap mask{0};    // 0 for an opaque image
+        int width{0};
+        int height{0};
+        int pending{0};    // 1 while the worker decodes it
+    };
+
+    struct Stats
+    {
+        uint64_t    hits{0};
+        uint64_t    misses{0};     // images decoded and scaled
+        uint64_t    evictions{0};
+        uint64_t    waits{0};      // draws that found the image still decoding
+        std::size_t bytes{0};      // pixmap memory in use, estimated
+        std::size_t images{0};
+    };
+
+    std::size_t budget{IMAGE_CACHE_BYTES};
+
+    ImageCache() = default;
+    ImageCache(const ImageCache&) = delete;
+    ImageCache& operator=(const ImageCache&) = delete;
+    ~ImageCache() { Stop(); Clear(); }
+
+    // filename's image scaled to w x h, found where DrawPixmap() always
+    // looked (absolute, then under VIEWTOUCH_PATH/imgs, VIEWTOUCH_PATH,
+    // and the current directory); nullptr if none can be loaded
+    const Image *Get(Display *d, Drawable drawable, const char* filename, int w, int h);
+    // Get() for an image drawn at x, y:  one not cached yet is decoded on
+    // the worker (when started) and comes back pending
+    const Image *Request(Display *d, Drawable drawable, const char* filename, int x, int y, int w, int h);
+    // Starts decoding Request() misses on the worker; fn is told the
+    // area to draw again as each is ready.  Returns 1 on error.
+    int Start(XtAppContext app, ImageReadyFn fn);
+    // Stops the worker and forgets pending images
+    void Stop();
+    // Frees every image, before the display closes
+    void Clear();
+    [[nodiscard]] const Stats &GetStats() const noexcept { return stats; }
+    // Placeholders drawn are still waiting for their images
+    [[nodiscard]] bool Decoding() const noexcept { return !waiting.empty(); }
+
+private:
+    struct Entry
+    {
+        std::string key;
+        Image image;
+        std::size_t bytes{0};
+    };
+
+    struct Area
+    {
+        int x;
+        int y;
+        int w;
+        int h;
+    };
+
+    struct Job
+    {
+        std::string key;
+        std::string path;
+        int w;
+        int h;
+    };
+
+    struct Decoded
+    {
+        std::string key;
+        RgbaImage image;  // scaled to the size asked for; empty on failure
+    };
+
+    std::list<Entry> entries;  // most recently drawn first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    Display *dis{nullptr};
+    Stats stats;
+
+    // worker:  jobs and decoded are shared, under lock
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<Job> jobs;
+    std::vector<Decoded> decoded;
+    bool stopping{false};
+    std::thread worker;
+    int wake_pipe[2]{-1, -1};  // worker -> Xt loop
+    XtInputId input{0};
+    ImageReadyFn ready{nullptr};
+    std::unordered_map<std::string, std::vector<Area>> waiting;  // drawn while pending
+
+    const Image *Lookup(Display *d, Drawable drawable, const char* filename, int w, int h, const Area *area);
+    const Image *Find(const std::string &key);
+    const Image *Add(std::string key, Image image);
+    std::size_t Bytes(const Image &image) const;
+    void Evict();
+    void Work();
+    void Collect();
+    static void ReadyCB(XtPointer client_data, int *fid, XtInputId *id);
+};
+
+extern ImageCache ButtonImages;
+
+#endif
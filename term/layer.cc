@@ -17,6 +17,8 @@
 
 #include "generic_char.hh"
 #include "layer.hh"
+#include "image_cache.hh"
+#include "text_cache.hh"
 #include "term_view.hh"
 #include "image_data.hh"
 #include "remote_link.hh"
@@ -25,6 +27,8 @@
 #include <dmalloc.h>
 #endif
 
+#define IMAGE_PENDING_TEXTURE  IMAGE_GRAY_PARCHMENT  // drawn while a button image decodes
+
 /**** Layer Class ****/
 // Constructor
 Layer::Layer(Display *d, GC g, Window draw_win, int lw, int lh)
@@ -505,12 +509,12 @@ int Layer::Text(const char* string, int len, int tx, int ty, int c, int font,
         return 1;
     }
 
-    // Alignment logic can be improved with XftTextExtentsUtf8
+    // The string's glyphs and width, looked up once per font
+    const TextCache::Run *run = nullptr;
     int tw = 0;
     if (xftfont) {
-        XGlyphInfo extents;
-        XftTextExtentsUtf8(dis, xftfont, reinterpret_cast<const FcChar8*>(string), len, &extents);
-        tw = extents.xOff;
+        run = TextRuns.Get(dis, xftfont, string, len);
+        tw = run->Width();
     }
     if (align == ALIGN_CENTER)
     {
@@ -527,15 +531,24 @@ int Layer::Text(const char* string, int len, int tx, int ty, int c, int font,
     int screen_no = DefaultScreen(dis);
     XRenderColor render_color = g_color_cache.GetColor(dis, screen_no, c);
 
+    std::span<const FT_UInt> glyphs;
+    if (run)
+        glyphs = run->glyphs;
+
     // Draw text with Xft using enhanced rendering options
     if (embossed)
-        GenericDrawStringXftEmbossed(dis, pix, xftdraw, xftfont, &render_color, tx, ty, string, len, DefaultScreen(dis));
+        GenericDrawStringXftEmbossed(dis, pix, xftdraw, xftfont, &render_color, tx, ty, string, len, DefaultScreen(dis), glyphs);
     else if (use_drop_shadows)
-        GenericDrawStringXftWithShadow(dis, pix, xftdraw, xftfont, &render_color, tx, ty, string, len, DefaultScreen(dis), shadow_offset_x, shadow_offset_y, shadow_blur_radius);
+    {
+        const GenericShadowMask *shadow = nullptr;
+        if (run)
+            shadow = TextRuns.Shadow(dis, pix, xftfont, string, len, *run, shadow_offset_x, shadow_offset_y, shadow_blur_radius);
+        GenericDrawStringXftWithShadow(dis, pix, xftdraw, xftfont, &render_color, tx, ty, string, len, DefaultScreen(dis), shadow_offset_x, shadow_offset_y, shadow_blur_radius, glyphs, shadow);
+    }
     else if (use_text_antialiasing)
-        GenericDrawStringXftAntialiased(dis, pix, xftdraw, xftfont, &render_color, tx, ty, string, len, DefaultScreen(dis));
+        GenericDrawStringXftAntialiased(dis, pix, xftdraw, xftfont, &render_color, tx, ty, string, len, DefaultScreen(dis), glyphs);
     else
-        GenericDrawStringXft(dis, pix, xftdraw, xftfont, &render_color, tx, ty, string, len, DefaultScreen(dis));
+        GenericDrawStringXft(dis, pix, xftdraw, xftfont, &render_color, tx, ty, string, len, DefaultScreen(dis), glyphs);
     return 0;
 }
 
@@ -578,12 +591,13 @@ int Layer::ZoneText(const char* str, int tx, int ty, int tw, int th,
         {
             sub_string[line] = c;
             
-            // Use Xft for text width measurement
+            // Use Xft for text width measurement; the widths of the
+            // prefixes tried below come from the same cached run
+            const TextCache::Run *run = nullptr;
             int text_width = 0;
             if (xftfont) {
-                XGlyphInfo extents;
-                XftTextExtentsUtf8(dis, xftfont, reinterpret_cast<const FcChar8*>(c), len, &extents);
-                text_width = extents.xOff;
+                run = TextRuns.Get(dis, xftfont, c, len);
+                text_width = run->Width();
             } else {
                 // Fallback to old method
                 XFontStruct *font_info = GetFontInfo(f);
@@ -608,10 +622,8 @@ int Layer::ZoneText(const char* str, int tx, int ty, int tw, int th,
             for (lw = len; lw > 0; --lw)
             {
                 int lw_width = 0;
-                if (xftfont) {
-                    XGlyphInfo extents;
-                    XftTextExtentsUtf8(dis, xftfont, reinterpret_cast<const FcChar8*>(c), lw, &extents);
-                    lw_width = extents.xOff;
+                if (run) {
+                    lw_width = run->Width(lw);
                 } else {
                     XFontStruct *font_info = GetFontInfo(f);
                     lw_width = XTextWidth(font_info, c, lw);
@@ -628,10 +640,8 @@ int Layer::ZoneText(const char* str, int tx, int ty, int tw, int th,
                 for (lw = len; lw > 1; --lw)
                 {
                     int lw_width = 0;
-                    if (xftfont) {
-                        XGlyphInfo extents;
-                        XftTextExtentsUtf8(dis, xftfont, reinterpret_cast<const FcChar8*>(c), lw, &extents);
-                        lw_width = extents.xOff;
+                    if (run) {
+                        lw_width = run->Width(lw);
                     } else {
                         XFontStruct *font_info = GetFontInfo(f);
                         lw_width = XTextWidth(font_info, c, lw);
@@ -705,233 +715,39 @@ int Layer::DrawPixmap(int rx, int ry, int rw, int rh, const char* filename)
     if (filename == nullptr || filename[0] == '\0' || rw <= 0 || rh <= 0)
         return 0;
 
-    auto load_image = [&](const std::string& path) -> Xpm*
-    {
-        std::string lowered = path;
-        std::transform(lowered.begin(), lowered.end(), lowered.begin(), ::tolower);
-
-        if (lowered.find(".png") != std::string::npos)
-        {
-#ifdef HAVE_PNG
-            return LoadPNGFile(path.c_str());
-#else
-            fprintf(stderr, "PNG support not available - please install libpng-dev\n");
-            return nullptr;
-#endif
-        }
-        else if (lowered.find(".jpg") != std::string::npos || lowered.find(".jpeg") != std::string::npos)
-        {
-#ifdef HAVE_JPEG
-            return LoadJPEGFile(path.c_str());
-#else
-            fprintf(stderr, "JPEG support not available - please install libjpeg-dev\n");
-            return nullptr;
-#endif
-        }
-        else if (lowered.find(".gif") != std::string::npos)
-        {
-#ifdef HAVE_GIF
-            return LoadGIFFile(path.c_str());
-#else
-            fprintf(stderr, "GIF support not available - please install libgif-dev\n");
-            return nullptr;
-#endif
-        }
-        else
-        {
-            std::vector<char> mutable_path(path.begin(), path.end());
-            mutable_path.push_back('\0');
-            return LoadPixmapFile(mutable_path.data());
-        }
-    };
-
-    std::string resolved_path;
-    Xpm *xpm = nullptr;
-
-    if (filename[0] == '/')
-    {
-        resolved_path = filename;
-        xpm = load_image(resolved_path);
-    }
-    else
-    {
-        resolved_path = std::string(VIEWTOUCH_PATH "/imgs/") + filename;
-        xpm = load_image(resolved_path);
-
-        if (xpm == nullptr)
-        {
-            std::string viewtouch_relative = std::string(VIEWTOUCH_PATH "/") + filename;
-            resolved_path = viewtouch_relative;
-            xpm = load_image(resolved_path);
-        }
-
-        if (xpm == nullptr)
-        {
-            resolved_path = filename;
-            xpm = load_image(resolved_path);
-        }
-    }
-
-    if (xpm == nullptr)
-        return 0;
-
     RegionInfo r(rx, ry, rw, rh);
     if (use_clip)
         r.Intersect(clip);
+    if (r.w <= 0 || r.h <= 0)
+        return 0;
 
-    if (r.w > 0 && r.h > 0)
+    // the image is scaled to the whole zone, whatever part is drawn now,
+    // so partial redraws find it in the cache too
+    const ImageCache::Image *image = ButtonImages.Request(dis, pix, filename, rx, ry, rw, rh);
+    if (image == nullptr)
+        return 0;
+    if (image->pending)
     {
-        // Calculate scaling to fit the image within the given dimensions
-        int img_w = xpm->Width();
-        int img_h = xpm->Height();
-
-        if (img_w <= 0 || img_h <= 0)
-            return 0;
-
-        const int draw_w = r.w;
-        const int draw_h = r.h;
-        const int draw_x = page_x + r.x;
-        const int draw_y = page_y + r.y;
-
-        const double inv_scale_x = static_cast<double>(img_w) / static_cast<double>(draw_w);
-        const double inv_scale_y = static_cast<double>(img_h) / static_cast<double>(draw_h);
-
-        // Check if we need to scale the image
-        bool need_scaling = (draw_w != img_w || draw_h != img_h);
-        
-        if (need_scaling)
-        {
-            // Scale both image and mask if present
-            XImage *orig_image = XGetImage(dis, xpm->PixmapID(), 0, 0, img_w, img_h,
-                                          AllPlanes, ZPixmap);
-
-            if (orig_image)
-            {
-                const int bits_per_pixel = orig_image->bits_per_pixel;
-                const int bitmap_pad = orig_image->bitmap_pad;
-                const int bytes_per_line =
-                    ((draw_w * bits_per_pixel + (bitmap_pad - 1)) / bitmap_pad) * (bitmap_pad / 8);
-
-                XImage *scaled_image = XCreateImage(dis, DefaultVisual(dis, DefaultScreen(dis)),
-                                                  orig_image->depth, ZPixmap, 0,
-                                                  static_cast<char*>(malloc(static_cast<size_t>(bytes_per_line) * static_cast<size_t>(draw_h))),
-                                                  draw_w, draw_h, bitmap_pad, bytes_per_line);
-
-                Pixmap scaled_mask = 0;
-                if (scaled_image && scaled_image->data)
-                {
-                    // Scale the image
-                    for (int y = 0; y < draw_h; ++y)
-                    {
-                        for (int x = 0; x < draw_w; ++x)
-                        {
-                            int src_x = static_cast<int>(x * inv_scale_x);
-                            int src_y = static_cast<int>(y * inv_scale_y);
-
-                            if (src_x >= img_w)
-                                src_x = img_w - 1;
-                            if (src_y >= img_h)
-                                src_y = img_h - 1;
-
-                            const unsigned long pixel = XGetPixel(orig_image, src_x, src_y);
-                            XPutPixel(scaled_image, x, y, pixel);
-                        }
-                    }
-
-                    // Scale the mask if present
-                    if (xpm->MaskID())
-                    {
-                        XImage *orig_mask = XGetImage(dis, xpm->MaskID(), 0, 0, img_w, img_h,
-                                                     AllPlanes, XYPixmap);
-                        if (orig_mask)
-                        {
-                            scaled_mask = XCreatePixmap(dis, pix, draw_w, draw_h, 1);
-                            XImage *scaled_mask_img = XCreateImage(dis, DefaultVisual(dis, DefaultScreen(dis)),
-                                                                  1, XYBitmap, 0,
-                                                                  static_cast<char*>(malloc((draw_w + 7) / 8 * draw_h)),
-                                                                  draw_w, draw_h, 8, 0);
-                            if (scaled_mask_img && scaled_mask_img->data)
-                            {
-                                memset(scaled_mask_img->data, 0, (draw_w + 7) / 8 * draw_h);
-                                for (int y = 0; y < draw_h; ++y)
-                                {
-                                    for (int x = 0; x < draw_w; ++x)
-                                    {
-                                        int src_x = static_cast<int>(x * inv_scale_x);
-                                        int src_y = static_cast<int>(y * inv_scale_y);
-                                        if (src_x >= img_w) src_x = img_w - 1;
-                                        if (src_y >= img_h) src_y = img_h - 1;
-                                        
-                                        unsigned long mask_pixel = XGetPixel(orig_mask, src_x, src_y);
-                                        XPutPixel(scaled_mask_img, x, y, mask_pixel);
-                                    }
-                                }
-                                GC mask_gc = XCreateGC(dis, scaled_mask, 0, nullptr);
-                                XPutImage(dis, scaled_mask, mask_gc, scaled_mask_img, 0, 0, 0, 0, draw_w, draw_h);
-                                XFreeGC(dis, mask_gc);
-                                XDestroyImage(scaled_mask_img);
-                            }
-                            XDestroyImage(orig_mask);
-                        }
-                    }
-
-                    // Apply mask if we have one
-                    if (scaled_mask || xpm->MaskID())
-                    {
-                        XSetClipMask(dis, gfx, scaled_mask ? scaled_mask : xpm->MaskID());
-                        XSetClipOrigin(dis, gfx, draw_x, draw_y);
-                    }
-                    
-                    XPutImage(dis, pix, gfx, scaled_image, 0, 0, draw_x, draw_y, draw_w, draw_h);
-                    
-                    // Clear clip mask
-                    if (scaled_mask || xpm->MaskID())
-                    {
-                        XSetClipMask(dis, gfx, None);
-                        XSetClipOrigin(dis, gfx, 0, 0);
-                    }
-                    
-                    if (scaled_mask)
-                        XFreePixmap(dis, scaled_mask);
-                }
-
-                if (scaled_image)
-                {
-                    if (scaled_image->data)
-                        free(scaled_image->data);
-                    scaled_image->data = nullptr;
-                    XDestroyImage(scaled_image);
-                }
+        // vt_main draws the area again once the image is decoded
+        return Rectangle(rx, ry, rw, rh, IMAGE_PENDING_TEXTURE);
+    }
 
-                XDestroyImage(orig_image);
-            }
-        }
-        else
-        {
-            // No scaling needed - use XCopyArea with mask
-            if (xpm->MaskID())
-            {
-                XSetClipMask(dis, gfx, xpm->MaskID());
-                XSetClipOrigin(dis, gfx, draw_x, draw_y);
-            }
-            
-            XCopyArea(dis, xpm->PixmapID(), pix, gfx,
-                     0, 0, img_w, img_h,
-                     draw_x, draw_y);
-            
-            // Clear clip mask
-            if (xpm->MaskID())
-            {
-                XSetClipMask(dis, gfx, None);
-                XSetClipOrigin(dis, gfx, 0, 0);
-            }
-        }
+    const int image_x = page_x + rx;
+    const int image_y = page_y + ry;
+    if (image->mask)
+    {
+        XSetClipMask(dis, gfx, image->mask);
+        XSetClipOrigin(dis, gfx, image_x, image_y);
     }
 
-    // Clean up - remove from PixmapList if it was added there
-    // For now, we'll leak the pixmap since we don't have a good way to manage it
-    // In a full implementation, we'd want proper resource management
+    XCopyArea(dis, image->pixmap, pix, gfx, r.x - rx, r.y - ry, r.w, r.h,
+              page_x + r.x, page_y + r.y);
 
+    if (image->mask)
+    {
+        XSetClipMask(dis, gfx, None);
+        XSetClipOrigin(dis, gfx, 0, 0);
+    }
     return 0;
 }
 
@@ -2469,6 +2285,90 @@ int LayerList::SetCursor(Layer *l, int type)
     return 0;
 }
 
+/**** PageCopies Class ****/
+int PageCopies::Store(Layer *l, int slot, int hash)
+{
+    FnTrace("PageCopies::Store()");
+
+    if (l == nullptr || slot < 0 || slot >= LINK_PAGE_SLOTS)
+        return 1;
+    if (static_cast<int>(copies.size()) <= slot)
+        copies.resize(static_cast<size_t>(slot) + 1);
+    dis = l->dis;
+
+    Copy &copy = copies[static_cast<size_t>(slot)];
+    if (copy.pix && (copy.w != l->w || copy.h != l->h))
+    {
+        XFreePixmap(dis, copy.pix);
+        copy.pix = 0;
+    }
+    if (copy.pix == 0)
+    {
+        copy.pix = XCreatePixmap(dis, l->pix, l->w, l->h, DefaultDepth(dis, DefaultScreen(dis)));
+        copy.w = l->w;
+        copy.h = l->h;
+    }
+    l->ClearClip();
+    XCopyArea(dis, l->pix, copy.pix, l->gfx, 0, 0, l->w, l->h, 0, 0);
+
+    copy.hash        = hash;
+    copy.complete    = ButtonImages.Decoding() ? 0 : 1;
+    copy.title_mode  = l->title_mode;
+    copy.bg_texture  = l->bg_texture;
+    copy.page_split  = l->page_split;
+    copy.split_opt   = l->split_opt;
+    copy.title_color = l->title_color;
+    copy.page_x      = l->page_x;
+    copy.page_y      = l->page_y;
+    copy.page_w      = l->page_w;
+    copy.page_h      = l->page_h;
+    copy.frame_width = l->frame_width;
+    copy.page_title.Set(l->page_title);
+    copy.time.Set(TimeString);
+    return 0;
+}
+
+int PageCopies::Recall(Layer *l, int slot, int hash)
+{
+    FnTrace("PageCopies::Recall()");
+
+    if (l == nullptr || slot < 0 || slot >= static_cast<int>(copies.size()))
+        return 1;
+    const Copy &copy = copies[static_cast<size_t>(slot)];
+    if (copy.pix == 0 || copy.hash != hash || copy.w != l->w || copy.h != l->h)
+        return 1;
+    if (!copy.complete)
+        return 1;  // vt_main draws it whole, with the images decoded by now
+
+    l->ClearClip();
+    XCopyArea(dis, copy.pix, l->pix, l->gfx, 0, 0, l->w, l->h, 0, 0);
+    l->title_mode  = copy.title_mode;
+    l->bg_texture  = copy.bg_texture;
+    l->page_split  = copy.page_split;
+    l->split_opt   = copy.split_opt;
+    l->title_color = copy.title_color;
+    l->page_x      = copy.page_x;
+    l->page_y      = copy.page_y;
+    l->page_w      = copy.page_w;
+    l->page_h      = copy.page_h;
+    l->frame_width = copy.frame_width;
+    l->page_title.Set(copy.page_title);
+    TimeString.Set(copy.time);
+    return 0;
+}
+
+void PageCopies::Clear()
+{
+    FnTrace("PageCopies::Clear()");
+
+    for (Copy &copy : copies)
+    {
+        if (copy.pix)
+            XFreePixmap(dis, copy.pix);
+    }
+    copies.clear();
+}
+
 //****************************************************************
 // BAK --> It appears the LayerObject classes build the editor
 //  interface.  The toolbar window is an LO_SomethingOrOther.
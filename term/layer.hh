@@ -25,6 +25,7 @@
 #include "list_utility.hh"
 #include <X11/Xft/Xft.h>
 #include <functional>
+#include <vector>
 
 
 /**** Types ****/
@@ -247,6 +248,49 @@ public:
     Layer *Head() { return list.Head(); }
 };
 
+class PageCopies
+{
+    // a copy of a page layer vt_main asked to keep (TERM_PAGESTORE), with
+    // what BlankPage() set, so the background and title bar redraw as
+    // they did
+    struct Copy
+    {
+        Pixmap pix{0};
+        int hash{-1};
+        int complete{1};  // 0 if placeholders were drawn for images still decoding
+        int w{0};
+        int h{0};
+        int title_mode{0};
+        int bg_texture{0};
+        int page_split{0};
+        int split_opt{0};
+        int title_color{0};
+        int page_x{0};
+        int page_y{0};
+        int page_w{0};
+        int page_h{0};
+        int frame_width{0};
+        Str page_title;
+        Str time;
+    };
+    std::vector<Copy> copies;
+    Display *dis{nullptr};
+
+public:
+    PageCopies() = default;
+    PageCopies(const PageCopies&) = delete;
+    PageCopies& operator=(const PageCopies&) = delete;
+    ~PageCopies() { Clear(); }
+
+    // Copies l's page into slot, to be known as hash
+    int Store(Layer *l, int slot, int hash);
+    // Puts the copy back in l; 1 (l untouched) if slot doesn't hold hash,
+    // or holds it with placeholders
+    int Recall(Layer *l, int slot, int hash);
+    // Frees every copy
+    void Clear();
+};
+
 class LO_PushButton : public LayerObject
 {
 public:
@@ -27,6 +27,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/file.h>
+#include <fcntl.h>
 #include <sys/un.h>
 #include <cerrno>
 #include <unistd.h>
@@ -113,6 +114,9 @@ int main(int argc, const genericChar* *argv)
     setsockopt(SocketNo, SOL_SOCKET, SO_SNDBUF, &val, sizeof(val));
     val = 32768;
     setsockopt(SocketNo, SOL_SOCKET, SO_RCVBUF, &val, sizeof(val));
+    // SocketInputCB() takes what's there and leaves partial messages
+    // for the next call
+    fcntl(SocketNo, F_SETFL, fcntl(SocketNo, F_GETFL, 0) | O_NONBLOCK);
 
     if (argc >= 3)
         term_hardware = atoi(argv[2]);
@@ -13,6 +13,7 @@
 #include <X11/cursorfont.h>
 #include <X11/xpm.h>
 #include <X11/Xft/Xft.h>
+#include <X11/extensions/XShm.h>
 #include <fontconfig/fontconfig.h>
 
 #ifdef HAVE_PNG
@@ -27,6 +28,8 @@
 #include <gif_lib.h>
 #endif
 #include <sys/file.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
 #include <sys/time.h>
@@ -39,6 +42,7 @@
 #include <iostream>
 #include <string>
 #include "src/utils/cpp23_utils.hh"
+#include "src/utils/vt_logger.hh"
 #include <chrono>
 #include <vector>
 #include <array>
@@ -56,6 +60,9 @@
 #include "image_data.hh"
 #include "touch_screen.hh"
 #include "layer.hh"
+#include "image_cache.hh"
+#include "text_cache.hh"
+#include "image_scale.hh"
 #include "generic_char.hh"
 
 #ifdef CREDITMCVE
@@ -655,6 +662,7 @@ Xpm *Pixmaps::GetRandom()
 
 #define SCREENSAVER_DIR  VIEWTOUCH_PATH "/dat/screensaver"
 #define MAX_XPM_SIZE     4194304
+#define SHM_MIN_BYTES    65536  // smaller images are cheaper over the socket
 Pixmaps PixmapList;
 
 
@@ -664,6 +672,7 @@ Pixmaps PixmapList;
 
 LayerList Layers;
 Layer *MainLayer = nullptr;
+PageCopies KeptPages;  // pages vt_main asked to keep copies of
 
 int SocketNo = 0;
 
@@ -768,6 +777,7 @@ void X11ResourceManager::cleanup() {
     }
     
     // Clean up fonts
+    TextRuns.Clear();
     for (size_t i = 0; i < FONT_SPACE; ++i) {
         if (FontInfo[i]) {
             XFreeFont(Dis, FontInfo[i]);
@@ -1718,8 +1728,10 @@ void SocketInputCB(XtPointer client_data, int *fid, XtInputId *id)
 
     static int consecutive_failures = 0;
     int val = BufferIn.Read(SocketNo);
+    if (val == 0)
+        return;  // no whole message yet
 
-    if (val <= 0)
+    if (val < 0)
     {
         consecutive_failures++;
 
@@ -1823,7 +1835,9 @@ void SocketInputCB(XtPointer client_data, int *fid, XtInputId *id)
     std::array<genericChar, STRLENGTH> key{};
     std::array<genericChar, STRLENGTH> value{};
 
-    while (BufferIn.size > 0)
+    // every message read this time, including any that didn't fit in
+    // the queue at first
+    while (BufferIn.size > 0 || BufferIn.Take() > 0)
     {
         // Critical fix: Add bounds checking to prevent infinite loops
         if (BufferIn.size < 1)
@@ -1845,6 +1859,37 @@ void SocketInputCB(XtPointer client_data, int *fid, XtInputId *id)
         case TERM_FLUSH:
             ResetView();
             break;
+        case TERM_LINKSWITCH:
+            n1 = RInt8();
+            n2 = RInt8();
+            BufferIn.SetEncoding(n1, n2);
+            // the rest of vt_main's frame is in the new encoding; ours
+            // switches after telling it so
+            WInt8(ToInt(ServerProtocol::SrvLinkSwitch));
+            WInt8(n1);
+            WInt8(n2);
+            BufferOut.SetEncoding(n1, n2);
+            SendNow();
+            break;
+        case TERM_PAGESTORE:
+            n1 = RInt8();
+            n2 = RInt32();
+            KeptPages.Store(l, n1, n2);
+            break;
+        case TERM_PAGERECALL:
+            n1 = RInt8();
+            n2 = RInt32();
+            if (TScreen)
+                TScreen->Flush();
+            if (KeptPages.Recall(l, n1, n2))
+            {
+                // what follows is drawn over whatever is there until
+                // vt_main sends the page again
+                WInt8(ToInt(ServerProtocol::SrvPageMiss));
+                WInt8(n1);
+                SendNow();
+            }
+            break;
         case TERM_UPDATEALL:
             l->buttons.Render(l);
             if (CalibrateStage == 0)
@@ -2724,6 +2769,182 @@ Xpm *LoadPixmapFile(char* file_name)
     return retxpm;
 }
 
+/****
+ * ShmUsable:  whether images can go to the server through MIT-SHM, which
+ *  needs a display on this host with the extension
+ ****/
+static int ShmState = -1;  // -1 not checked yet, 0 no, 1 yes
+static int ShmAttachFailed = 0;
+
+static int ShmErrorHandler(Display *display, XErrorEvent *event)
+{
+    ShmAttachFailed = 1;
+    return 0;
+}
+
+static int ShmUsable()
+{
+    FnTrace("ShmUsable()");
+    if (ShmState < 0)
+    {
+        const char* name = DisplayString(Dis);
+        const bool local = name && (name[0] == ':' || strncmp(name, "unix:", 5) == 0);
+        ShmState = (local && XShmQueryExtension(Dis)) ? 1 : 0;
+    }
+    return ShmState;
+}
+
+/****
+ * CreateShmImage:  a ZPixmap XImage in a shared memory segment the server
+ *  has attached, or nullptr (and MIT-SHM is not tried again if the server
+ *  refused it)
+ ****/
+static XImage *CreateShmImage(Visual *visual, int depth, int width, int height, XShmSegmentInfo &shminfo)
+{
+    FnTrace("CreateShmImage()");
+    XImage *ximage = XShmCreateImage(Dis, visual, depth, ZPixmap, nullptr, &shminfo, width, height);
+    if (ximage == nullptr)
+        return nullptr;
+
+    shminfo.shmid = shmget(IPC_PRIVATE, static_cast<size_t>(ximage->bytes_per_line) * height, IPC_CREAT | 0600);
+    if (shminfo.shmid < 0)
+    {
+        XDestroyImage(ximage);
+        return nullptr;
+    }
+    shminfo.shmaddr = static_cast<char*>(shmat(shminfo.shmid, nullptr, 0));
+    if (shminfo.shmaddr == reinterpret_cast<char*>(-1))
+    {
+        shmctl(shminfo.shmid, IPC_RMID, nullptr);
+        XDestroyImage(ximage);
+        return nullptr;
+    }
+    ximage->data = shminfo.shmaddr;
+    shminfo.readOnly = False;
+
+    // a refused attach only shows up as an X error
+    ShmAttachFailed = 0;
+    XErrorHandler old_handler = XSetErrorHandler(ShmErrorHandler);
+    XShmAttach(Dis, &shminfo);
+    XSync(Dis, False);
+    XSetErrorHandler(old_handler);
+    // the segment goes away once both sides have detached
+    shmctl(shminfo.shmid, IPC_RMID, nullptr);
+    if (ShmAttachFailed)
+    {
+        fprintf(stderr, "CreateShmImage: server refused MIT-SHM, using XPutImage\n");
+        ShmState = 0;
+        shmdt(shminfo.shmaddr);
+        ximage->data = nullptr;
+        XDestroyImage(ximage);
+        return nullptr;
+    }
+    return ximage;
+}
+
+/****
+ * RgbaToXpm:  puts a decoded image on the server, with a mask when any
+ *  pixel is less than ALPHA_OPAQUE.  Rows are packed straight into the
+ *  visual's layout when it is 8-bit TrueColor, and big images go through
+ *  MIT-SHM on a local display.
+ ****/
+Xpm *RgbaToXpm(const RgbaImage &image)
+{
+    FnTrace("RgbaToXpm()");
+    if (image.Empty())
+        return nullptr;
+
+    const int width = image.width;
+    const int height = image.height;
+    Visual *visual = DefaultVisual(Dis, DefaultScreen(Dis));
+    int depth = DefaultDepth(Dis, DefaultScreen(Dis));
+    Pixmap pixmap = XCreatePixmap(Dis, MainWin, width, height, depth);
+    if (!pixmap)
+    {
+        fprintf(stderr, "RgbaToXpm: Cannot create pixmap\n");
+        return nullptr;
+    }
+
+    XShmSegmentInfo shminfo{};
+    XImage *ximage = nullptr;
+    if (width * height * 4 >= SHM_MIN_BYTES && ShmUsable())
+        ximage = CreateShmImage(visual, depth, width, height, shminfo);
+    const bool shared = (ximage != nullptr);
+    if (!shared)
+        ximage = XCreateImage(Dis, visual, depth, ZPixmap, 0,
+                              (char*)malloc(width * height * 4), width, height, 32, 0);
+    if (!ximage)
+    {
+        fprintf(stderr, "RgbaToXpm: Cannot create XImage\n");
+        XFreePixmap(Dis, pixmap);
+        return nullptr;
+    }
+
+    PixelLayout layout;
+    if (visual->c_class == TrueColor &&
+        NativeLayout(visual->red_mask, visual->green_mask, visual->blue_mask,
+                     ximage->bits_per_pixel, ximage->byte_order == MSBFirst, layout) == 0)
+    {
+        for (int y = 0; y < height; y++)
+            PackRgbaRow(image.Row(y), reinterpret_cast<Uchar*>(ximage->data) + y * ximage->bytes_per_line,
+                        width, layout);
+    }
+    else
+    {
+        for (int y = 0; y < height; y++)
+        {
+            const Uchar *row = image.Row(y);
+            for (int x = 0; x < width; x++)
+            {
+                const Uchar *px = row + x * 4;
+                // transparent areas are black under the mask
+                unsigned long pixel = 0;
+                if (px[3] >= ALPHA_OPAQUE)
+                    pixel = (px[0] << 16) | (px[1] << 8) | px[2];
+                XPutPixel(ximage, x, y, pixel);
+            }
+        }
+    }
+
+    if (shared)
+    {
+        // the server has read the segment by the time it handles the detach
+        XShmPutImage(Dis, pixmap, Gfx, ximage, 0, 0, 0, 0, width, height, False);
+        XShmDetach(Dis, &shminfo);
+        shmdt(shminfo.shmaddr);
+        ximage->data = nullptr;
+    }
+    else
+        XPutImage(Dis, pixmap, Gfx, ximage, 0, 0, 0, 0, width, height);
+    XDestroyImage(ximage);
+
+    Pixmap mask = 0;
+    std::vector<Uchar> bits;
+    if (AlphaMask(image, bits) > 0)
+    {
+        mask = XCreatePixmap(Dis, MainWin, width, height, 1);
+        XImage *mask_image = XCreateImage(Dis, visual, 1, XYBitmap, 0, reinterpret_cast<char*>(bits.data()),
+                                          width, height, 8, (width + 7) / 8);
+        if (mask && mask_image)
+        {
+            mask_image->bitmap_bit_order = LSBFirst;
+            // XYBitmap images are drawn in the GC's colours:  1 bits must stay 1
+            XGCValues values;
+            values.foreground = 1;
+            values.background = 0;
+            GC mask_gc = XCreateGC(Dis, mask, GCForeground | GCBackground, &values);
+            XPutImage(Dis, mask, mask_gc, mask_image, 0, 0, 0, 0, width, height);
+            XFreeGC(Dis, mask_gc);
+        }
+        if (mask_image)
+        {
+            mask_image->data = nullptr;  // bits owns it
+            XDestroyImage(mask_image);
+        }
+    }
+    return new Xpm(pixmap, mask, width, height);
+}
+
 #ifdef HAVE_PNG
 /****
  * RemoveCheckeredBackground: Detect and remove checkered/checked backgrounds
@@ -2952,57 +3173,61 @@ static bool RemoveCheckeredBackground(png_bytep** row_pointers_ptr, int width, i
 }
 
 /****
- * LoadPNGFile: Load a PNG file and convert it to an Xpm object
+ * DecodePNGFile:  reads a PNG file as RGBA, with any checkered background
+ *  made transparent.  Returns 0 on success.
  ****/
-Xpm *LoadPNGFile(const char* file_name)
+int DecodePNGFile(const char* file_name, RgbaImage &image)
 {
-    FnTrace("LoadPNGFile()");
+    FnTrace("DecodePNGFile()");
 
     if (!file_name) {
-        fprintf(stderr, "LoadPNGFile: No filename provided\n");
-        return nullptr;
+        fprintf(stderr, "DecodePNGFile: No filename provided\n");
+        return 1;
     }
 
     FILE *fp = fopen(file_name, "rb");
     if (!fp) {
-        fprintf(stderr, "LoadPNGFile: Cannot open file %s\n", file_name);
-        return nullptr;
+        fprintf(stderr, "DecodePNGFile: Cannot open file %s\n", file_name);
+        return 1;
     }
 
     // Read PNG header to verify format
     std::array<png_byte, 8> header{};
     if (fread(header.data(), 1, header.size(), fp) != header.size()) {
-        fprintf(stderr, "LoadPNGFile: Cannot read PNG header from %s\n", file_name);
+        fprintf(stderr, "DecodePNGFile: Cannot read PNG header from %s\n", file_name);
         fclose(fp);
-        return nullptr;
+        return 1;
     }
 
     if (png_sig_cmp(header.data(), 0, header.size())) {
-        fprintf(stderr, "LoadPNGFile: File %s is not a valid PNG\n", file_name);
+        fprintf(stderr, "DecodePNGFile: File %s is not a valid PNG\n", file_name);
         fclose(fp);
-        return nullptr;
+        return 1;
     }
 
     png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
     if (!png_ptr) {
-        fprintf(stderr, "LoadPNGFile: Cannot create PNG read struct\n");
+        fprintf(stderr, "DecodePNGFile: Cannot create PNG read struct\n");
         fclose(fp);
-        return nullptr;
+        return 1;
     }
 
     png_infop info_ptr = png_create_info_struct(png_ptr);
     if (!info_ptr) {
-        fprintf(stderr, "LoadPNGFile: Cannot create PNG info struct\n");
+        fprintf(stderr, "DecodePNGFile: Cannot create PNG info struct\n");
         png_destroy_read_struct(&png_ptr, nullptr, nullptr);
         fclose(fp);
-        return nullptr;
+        return 1;
     }
 
+    // declared before setjmp() so a read error still frees it
+    std::vector<png_bytep> row_pointers;
     if (setjmp(png_jmpbuf(png_ptr))) {
-        fprintf(stderr, "LoadPNGFile: PNG read error in %s\n", file_name);
+        fprintf(stderr, "DecodePNGFile: PNG read error in %s\n", file_name);
         png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
         fclose(fp);
-        return nullptr;
+        image = RgbaImage{};
+        return 1;
     }
 
     png_init_io(png_ptr, fp);
@@ -3014,7 +3239,7 @@ Xpm *LoadPNGFile(const char* file_name)
     png_byte color_type = png_get_color_type(png_ptr, info_ptr);
     png_byte bit_depth = png_get_bit_depth(png_ptr, info_ptr);
 
-    fprintf(stderr, "LoadPNGFile: Loading %s - %dx%d, color_type=%d, bit_depth=%d\n",
+    fprintf(stderr, "DecodePNGFile: Loading %s - %dx%d, color_type=%d, bit_depth=%d\n",
             file_name, width, height, color_type, bit_depth);
 
     // Convert palette images to RGB
@@ -3029,9 +3254,15 @@ Xpm *LoadPNGFile(const char* file_name)
     if (color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
         png_set_gray_to_rgb(png_ptr);
 
-    // Add alpha channel if missing for consistency
-    if (color_type != PNG_COLOR_TYPE_RGBA && png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS))
+    // Turn a tRNS chunk into alpha, and give everything else opaque alpha
+    bool has_alpha = (color_type & PNG_COLOR_MASK_ALPHA) != 0;
+    if (!has_alpha && png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS))
+    {
         png_set_tRNS_to_alpha(png_ptr);
+        has_alpha = true;
+    }
+    if (!has_alpha)
+        png_set_filler(png_ptr, 0xFF, PNG_FILLER_AFTER);
 
     // Ensure 8-bit depth
     if (bit_depth == 16)
@@ -3041,186 +3272,69 @@ Xpm *LoadPNGFile(const char* file_name)
 
     int rowbytes = png_get_rowbytes(png_ptr, info_ptr);
     int channels = png_get_channels(png_ptr, info_ptr);
-    fprintf(stderr, "LoadPNGFile: Row bytes = %d, channels = %d\n", rowbytes, channels);
-
-    // Allocate image data
-    auto* row_pointers = (png_bytep*)malloc(sizeof(png_bytep) * height);
-    if (!row_pointers) {
-        fprintf(stderr, "LoadPNGFile: Cannot allocate row pointers\n");
+    if (channels != 4 || rowbytes != width * 4) {
+        fprintf(stderr, "DecodePNGFile: Unexpected layout in %s (%d channels, %d row bytes)\n",
+                file_name, channels, rowbytes);
         png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
         fclose(fp);
-        return nullptr;
-    }
-
-    for (int y = 0; y < height; y++) {
-        row_pointers[y] = (png_byte*)malloc(rowbytes);
-        if (!row_pointers[y]) {
-            fprintf(stderr, "LoadPNGFile: Cannot allocate row data\n");
-            for (int i = 0; i < y; i++) free(row_pointers[i]);
-            free(row_pointers);
-            png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
-            fclose(fp);
-            return nullptr;
-        }
-    }
-
-    png_read_image(png_ptr, row_pointers);
-
-    // Remove checkered backgrounds if detected
-    png_bytep* original_row_pointers = row_pointers;
-    bool checkered_removed = RemoveCheckeredBackground(&row_pointers, width, height, channels, rowbytes);
-    if (checkered_removed && row_pointers != original_row_pointers) {
-        // Free original row pointers if they were replaced
-        for (int y = 0; y < height; y++) {
-            free(original_row_pointers[y]);
-        }
-        free(original_row_pointers);
-        fprintf(stderr, "LoadPNGFile: Checkered background removed, image converted to RGBA\n");
+        return 1;
     }
 
-    // Convert to X11 Pixmap with transparency mask
-    Pixmap pixmap = 0;
-    Pixmap mask = 0;
-    bool has_transparency = (channels == 4);  // RGBA format
-    
-    if (width <= WinWidth && height <= WinHeight) {
-        Visual *visual = DefaultVisual(Dis, DefaultScreen(Dis));
-        int depth = DefaultDepth(Dis, DefaultScreen(Dis));
+    // Decode straight into image, one row pointer per line
+    image.Resize(width, height);
+    row_pointers.resize(height);
+    for (int y = 0; y < height; y++)
+        row_pointers[y] = image.Row(y);
+    png_read_image(png_ptr, row_pointers.data());
 
-        fprintf(stderr, "LoadPNGFile: Creating pixmap %dx%d, depth=%d, has_transparency=%d\n", 
-                width, height, depth, has_transparency);
+    // Remove checkered backgrounds if detected; with 4 channels the rows
+    // are changed in place
+    png_bytep* rows = row_pointers.data();
+    if (RemoveCheckeredBackground(&rows, width, height, channels, rowbytes))
+        fprintf(stderr, "DecodePNGFile: Checkered background removed\n");
 
-        pixmap = XCreatePixmap(Dis, MainWin, width, height, depth);
-        if (!pixmap) {
-            fprintf(stderr, "LoadPNGFile: Cannot create pixmap\n");
-        } else {
-            // Create mask pixmap if we have transparency
-            if (has_transparency) {
-                mask = XCreatePixmap(Dis, MainWin, width, height, 1);  // 1-bit depth for mask
-                if (!mask) {
-                    fprintf(stderr, "LoadPNGFile: Cannot create mask pixmap\n");
-                }
-            }
-            
-            // Create XImage with proper format for the visual
-            XImage *ximage = XCreateImage(Dis, visual, depth, ZPixmap, 0,
-                                         (char*)malloc(width * height * 4), width, height, 32, 0);
-            if (!ximage) {
-                fprintf(stderr, "LoadPNGFile: Cannot create XImage\n");
-                XFreePixmap(Dis, pixmap);
-                if (mask) XFreePixmap(Dis, mask);
-                pixmap = 0;
-                mask = 0;
-            } else {
-                // Create mask image if needed
-                XImage *mask_image = nullptr;
-                if (mask) {
-                    mask_image = XCreateImage(Dis, visual, 1, XYBitmap, 0,
-                                            (char*)malloc((width + 7) / 8 * height), 
-                                            width, height, 8, 0);
-                    if (mask_image) {
-                        // Initialize mask to all transparent
-                        memset(mask_image->data, 0, (width + 7) / 8 * height);
-                    }
-                }
-                
-                // Copy PNG data to XImage pixels
-                for (int y = 0; y < height; y++) {
-                    png_bytep row = row_pointers[y];
-                    for (int x = 0; x < width; x++) {
-                        unsigned long pixel;
-                        bool is_opaque = true;
-                        
-                        if (channels >= 3) {
-                            // RGB or RGBA format
-                            unsigned char r = row[x*channels + 0];
-                            unsigned char g = row[x*channels + 1];
-                            unsigned char b = row[x*channels + 2];
-
-                            if (channels == 4) {
-                                // RGBA format - handle alpha transparency
-                                unsigned char a = row[x*channels + 3];
-                                is_opaque = (a >= 128);  // Threshold for transparency
-                                
-                                if (!is_opaque) {
-                                    // Set pixel to black for transparent areas (will be masked)
-                                    pixel = 0;
-                                } else {
-                                    pixel = (r << 16) | (g << 8) | b;
-                                }
-                            } else {
-                                // RGB format - fully opaque
-                                pixel = (r << 16) | (g << 8) | b;
-                            }
-                        } else if (channels == 1) {
-                            // Grayscale - fully opaque
-                            unsigned char gray = row[x];
-                            pixel = (gray << 16) | (gray << 8) | gray;
-                        } else {
-                            // Unknown format, use black
-                            pixel = 0;
-                        }
-                        XPutPixel(ximage, x, y, pixel);
-                        
-                        // Update mask if we have one
-                        if (mask_image && is_opaque) {
-                            XPutPixel(mask_image, x, y, 1);  // 1 = opaque, 0 = transparent
-                        }
-                    }
-                }
-
-                // Put image to pixmap
-                XPutImage(Dis, pixmap, Gfx, ximage, 0, 0, 0, 0, width, height);
-                
-                // Put mask to mask pixmap
-                if (mask && mask_image) {
-                    GC mask_gc = XCreateGC(Dis, mask, 0, nullptr);
-                    XPutImage(Dis, mask, mask_gc, mask_image, 0, 0, 0, 0, width, height);
-                    XFreeGC(Dis, mask_gc);
-                    XDestroyImage(mask_image);
-                }
-                
-                XDestroyImage(ximage);
-                fprintf(stderr, "LoadPNGFile: Successfully loaded PNG with%s transparency\n",
-                        mask ? "" : "out");
-            }
-        }
-    } else {
-        fprintf(stderr, "LoadPNGFile: Image too large (%dx%d > %dx%d)\n",
-                width, height, WinWidth, WinHeight);
-    }
-
-    // Cleanup
-    for (int y = 0; y < height; y++) {
-        free(row_pointers[y]);
-    }
-    free(row_pointers);
     png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
     fclose(fp);
+    return 0;
+}
+
+/****
+ * LoadPNGFile: Load a PNG file and convert it to an Xpm object
+ ****/
+Xpm *LoadPNGFile(const char* file_name)
+{
+    FnTrace("LoadPNGFile()");
 
-    if (pixmap) {
-        return new Xpm(pixmap, mask, width, height);
+    RgbaImage image;
+    if (DecodePNGFile(file_name, image))
+        return nullptr;
+    if (image.width > WinWidth || image.height > WinHeight) {
+        fprintf(stderr, "LoadPNGFile: Image too large (%dx%d > %dx%d)\n",
+                image.width, image.height, WinWidth, WinHeight);
+        return nullptr;
     }
 
-    fprintf(stderr, "LoadPNGFile: Failed to load PNG %s\n", file_name);
-    return nullptr;
+    Xpm *xpm = RgbaToXpm(image);
+    if (xpm == nullptr)
+        fprintf(stderr, "LoadPNGFile: Failed to load PNG %s\n", file_name);
+    return xpm;
 }
 #endif
 
 #ifdef HAVE_JPEG
 /****
- * LoadJPEGFile: Load a JPEG file and convert it to an Xpm object
+ * DecodeJPEGFile:  reads a JPEG file as opaque RGBA.  Returns 0 on success.
  ****/
-Xpm *LoadJPEGFile(const char* file_name)
+int DecodeJPEGFile(const char* file_name, RgbaImage &image)
 {
-    FnTrace("LoadJPEGFile()");
+    FnTrace("DecodeJPEGFile()");
 
     if (!file_name)
-        return nullptr;
+        return 1;
 
     FILE *fp = fopen(file_name, "rb");
     if (!fp)
-        return nullptr;
+        return 1;
 
     struct jpeg_decompress_struct cinfo;
     struct jpeg_error_mgr jerr;
@@ -3229,6 +3343,9 @@ Xpm *LoadJPEGFile(const char* file_name)
     jpeg_create_decompress(&cinfo);
     jpeg_stdio_src(&cinfo, fp);
     jpeg_read_header(&cinfo, TRUE);
+    // let libjpeg expand grayscale; other colour spaces come as they are
+    if (cinfo.jpeg_color_space == JCS_GRAYSCALE)
+        cinfo.out_color_space = JCS_RGB;
     jpeg_start_decompress(&cinfo);
 
     int width = cinfo.output_width;
@@ -3239,120 +3356,118 @@ Xpm *LoadJPEGFile(const char* file_name)
     JSAMPARRAY buffer = (*cinfo.mem->alloc_sarray)
         ((j_common_ptr) &cinfo, JPOOL_IMAGE, width * num_components, 1);
 
-    Pixmap pixmap = 0;
-    if (width <= WinWidth && height <= WinHeight) {
-        pixmap = XCreatePixmap(Dis, MainWin, width, height, DefaultDepth(Dis, DefaultScreen(Dis)));
-
-        XImage *ximage = XCreateImage(Dis, DefaultVisual(Dis, DefaultScreen(Dis)),
-                                     DefaultDepth(Dis, DefaultScreen(Dis)), ZPixmap, 0,
-                                     (char*)malloc(width * height * 4), width, height, 32, 0);
-
-        // Read and convert JPEG data
-        while (cinfo.output_scanline < height) {
-            jpeg_read_scanlines(&cinfo, buffer, 1);
-            int y = cinfo.output_scanline - 1;
-
-            for (int x = 0; x < width; x++) {
-                unsigned long pixel = 0;
-                if (num_components >= 3) {
-                    pixel = (buffer[0][x*num_components+0] << 16) |
-                           (buffer[0][x*num_components+1] << 8) |
-                           buffer[0][x*num_components+2];
-                }
-                XPutPixel(ximage, x, y, pixel);
+    image.Resize(width, height);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        jpeg_read_scanlines(&cinfo, buffer, 1);
+        Uchar *row = image.Row(cinfo.output_scanline - 1);
+        for (int x = 0; x < width; x++) {
+            // anything but RGB is drawn black, as before
+            if (num_components >= 3) {
+                row[x * 4 + 0] = buffer[0][x * num_components + 0];
+                row[x * 4 + 1] = buffer[0][x * num_components + 1];
+                row[x * 4 + 2] = buffer[0][x * num_components + 2];
             }
+            row[x * 4 + 3] = 255;
         }
-
-        XPutImage(Dis, pixmap, Gfx, ximage, 0, 0, 0, 0, width, height);
-        XDestroyImage(ximage);
     }
 
     jpeg_finish_decompress(&cinfo);
     jpeg_destroy_decompress(&cinfo);
     fclose(fp);
+    return 0;
+}
 
-    if (pixmap) {
-        return new Xpm(pixmap, width, height);
-    }
+/****
+ * LoadJPEGFile: Load a JPEG file and convert it to an Xpm object
+ ****/
+Xpm *LoadJPEGFile(const char* file_name)
+{
+    FnTrace("LoadJPEGFile()");
 
-    return nullptr;
+    RgbaImage image;
+    if (DecodeJPEGFile(file_name, image))
+        return nullptr;
+    if (image.width > WinWidth || image.height > WinHeight)
+        return nullptr;
+    return RgbaToXpm(image);
 }
 #endif
 
 #ifdef HAVE_GIF
 /****
- * LoadGIFFile: Load a GIF file and convert it to an Xpm object
+ * DecodeGIFFile:  reads the first frame of a GIF file as opaque RGBA.
+ *  Returns 0 on success.
  ****/
-Xpm *LoadGIFFile(const char* file_name)
+int DecodeGIFFile(const char* file_name, RgbaImage &image)
 {
-    FnTrace("LoadGIFFile()");
+    FnTrace("DecodeGIFFile()");
 
     if (!file_name)
-        return nullptr;
+        return 1;
 
     // For simplicity, we'll use libgif to load the first frame
     GifFileType *gif = DGifOpenFileName(file_name, NULL);
     if (!gif) {
-        return nullptr;
+        return 1;
     }
 
     if (DGifSlurp(gif) != GIF_OK) {
         DGifCloseFile(gif, NULL);
-        return nullptr;
+        return 1;
     }
 
     if (gif->ImageCount == 0) {
         DGifCloseFile(gif, NULL);
-        return nullptr;
+        return 1;
     }
 
-    SavedImage *image = &gif->SavedImages[0];
-    GifImageDesc *desc = &image->ImageDesc;
-    ColorMapObject *color_map = image->ImageDesc.ColorMap ?
-                               image->ImageDesc.ColorMap : gif->SColorMap;
+    SavedImage *saved = &gif->SavedImages[0];
+    GifImageDesc *desc = &saved->ImageDesc;
+    ColorMapObject *color_map = saved->ImageDesc.ColorMap ?
+                               saved->ImageDesc.ColorMap : gif->SColorMap;
 
     if (!color_map) {
         DGifCloseFile(gif, NULL);
-        return nullptr;
+        return 1;
     }
 
     int width = desc->Width;
     int height = desc->Height;
 
-    Pixmap pixmap = 0;
-    if (width <= WinWidth && height <= WinHeight) {
-        pixmap = XCreatePixmap(Dis, MainWin, width, height, DefaultDepth(Dis, DefaultScreen(Dis)));
-
-        XImage *ximage = XCreateImage(Dis, DefaultVisual(Dis, DefaultScreen(Dis)),
-                                     DefaultDepth(Dis, DefaultScreen(Dis)), ZPixmap, 0,
-                                     (char*)malloc(width * height * 4), width, height, 32, 0);
-
-        // Convert GIF pixels to X11 pixels
-        GifPixelType *gif_pixels = image->RasterBits;
-        for (int y = 0; y < height; y++) {
-            for (int x = 0; x < width; x++) {
-                int pixel_index = y * width + x;
-                GifPixelType color_index = gif_pixels[pixel_index];
-
-                if (color_index < color_map->ColorCount) {
-                    GifColorType *color = &color_map->Colors[color_index];
-                    unsigned long pixel = (color->Red << 16) | (color->Green << 8) | color->Blue;
-                    XPutPixel(ximage, x, y, pixel);
-                }
+    // Convert GIF pixels to RGBA; indexes past the colour map stay black
+    image.Resize(width, height);
+    GifPixelType *gif_pixels = saved->RasterBits;
+    for (int y = 0; y < height; y++) {
+        Uchar *row = image.Row(y);
+        for (int x = 0; x < width; x++) {
+            GifPixelType color_index = gif_pixels[y * width + x];
+            if (color_index < color_map->ColorCount) {
+                GifColorType *color = &color_map->Colors[color_index];
+                row[x * 4 + 0] = color->Red;
+                row[x * 4 + 1] = color->Green;
+                row[x * 4 + 2] = color->Blue;
             }
+            row[x * 4 + 3] = 255;
         }
-
-        XPutImage(Dis, pixmap, Gfx, ximage, 0, 0, 0, 0, width, height);
-        XDestroyImage(ximage);
     }
 
     DGifCloseFile(gif, NULL);
+    return 0;
+}
 
-    if (pixmap) {
-        return new Xpm(pixmap, width, height);
-    }
+/****
+ * LoadGIFFile: Load a GIF file and convert it to an Xpm object
+ ****/
+Xpm *LoadGIFFile(const char* file_name)
+{
+    FnTrace("LoadGIFFile()");
 
-    return nullptr;
+    RgbaImage image;
+    if (DecodeGIFFile(file_name, image))
+        return nullptr;
+    if (image.width > WinWidth || image.height > WinHeight)
+        return nullptr;
+    return RgbaToXpm(image);
 }
 #endif
 
@@ -3768,6 +3883,21 @@ static bool IsRaspberryPi()
     return is_pi;
 }
 
+/****
+ * ButtonImagesReady:  button images drawn as placeholders are decoded;
+ *  asks vt_main to draw their area again
+ ****/
+static void ButtonImagesReady(int x, int y, int w, int h)
+{
+    FnTrace("ButtonImagesReady()");
+    WInt8(ToInt(ServerProtocol::SrvImageReady));
+    WInt16(x);
+    WInt16(y);
+    WInt16(w);
+    WInt16(h);
+    SendNow();
+}
+
 int OpenTerm(const char* display, TouchScreen *ts, int is_term_local, int term_hardware,
              int set_width, int set_height)
 {
@@ -4023,6 +4153,8 @@ int OpenTerm(const char* display, TouchScreen *ts, int is_term_local, int term_h
 
     SocketInputID = XtAppAddInput(App, SocketNo, (XtPointer) XtInputReadMask,
                                   (XtInputCallbackProc) SocketInputCB, nullptr);
+    if (ButtonImages.Start(App, ButtonImagesReady))
+        fprintf(stderr, "OpenTerm: decoding button images in place\n");
 
     // Send server term size
     int screen_size = PAGE_SIZE_640x480;
@@ -4065,6 +4197,9 @@ int OpenTerm(const char* display, TouchScreen *ts, int is_term_local, int term_h
     WInt16(WinWidth);
     WInt16(WinHeight);
     WInt16(ScrDepth);
+    WInt8(ToInt(ServerProtocol::SrvLinkOffer));
+    WInt8(LINK_ENCODING_MAX);
+    WInt8(LinkFlags | LINK_PAGECACHE | LINK_DEFLATE);
     SendNow();
     if (TScreen)
         TScreen->Flush();
@@ -4281,12 +4416,14 @@ int ReconnectToServer()
         close(SocketNo);
     }
 
-    // Update the global socket
+    // Update the global socket; SocketInputCB() only reads what's there
+    fcntl(new_socket, F_SETFL, fcntl(new_socket, F_GETFL, 0) | O_NONBLOCK);
     SocketNo = new_socket;
 
-    // Clear and reset buffers
-    BufferIn.Clear();
-    BufferOut.Clear();
+    // Clear and reset buffers; a new connection starts out tagged
+    BufferIn.Reset();
+    BufferOut.Reset();
+    KeptPages.Clear();
 
     // Re-add the input handler
     SocketInputID = XtAppAddInput(App, SocketNo, (XtPointer) XtInputReadMask,
@@ -4353,6 +4490,22 @@ int KillTerm()
         XmuReleaseStippledPixmap(ScrPtr, ShadowPix);
         ShadowPix = 0;
     }
+    KeptPages.Clear();
+    const ImageCache::Stats &images = ButtonImages.GetStats();
+    if (images.hits + images.misses > 0)
+    {
+        vt::Logger::debug("Button images: {} hits, {} misses, {} waits, {} evicted, {} KB in {}",
+                          images.hits, images.misses, images.waits, images.evictions,
+                          images.bytes / 1024, images.images);
+    }
+    ButtonImages.Stop();
+    ButtonImages.Clear();
+    const TextCache::Stats &text = TextRuns.GetStats();
+    if (text.hits + text.misses > 0)
+    {
+        vt::Logger::debug("Text runs: {} hits, {} misses, {} evicted; shadow masks: {} hits, {} misses",
+                          text.hits, text.misses, text.evictions, text.mask_hits, text.mask_misses);
+    }
     Layers.Purge();
 
     for (auto& texture : Texture)
@@ -4392,6 +4545,7 @@ int KillTerm()
         }
 
     // Clean up Xft fonts
+    TextRuns.Clear();
     for (auto& xftFont : XftFontsArr)
         if (xftFont)
         {
@@ -4532,6 +4686,7 @@ XftFont *GetXftFontInfo(const int font_id) noexcept
 void TerminalReloadFonts()
 {
     // Free existing Xft fonts
+    TextRuns.Clear();
     for (const auto& fontData : FontData) {
         int f = fontData.id;
         if (XftFontsArr[f]) {
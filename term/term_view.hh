@@ -299,6 +299,7 @@ enum page_sizes : std::uint8_t {
 
 /**** Types ****/
 class TouchScreen;
+struct RgbaImage;
 
 class Xpm {
 public:
@@ -356,17 +357,21 @@ extern int          GetCachedTextureCount() noexcept;  // Get number of currentl
 // Image loading functions
 extern Pixmap LoadPixmap(const char** image_data);
 extern Xpm *LoadPixmapFile(char* file_name);
+extern Xpm *RgbaToXpm(const RgbaImage &image);  // pixmap plus a mask if any pixel is transparent
 
 #ifdef HAVE_PNG
 extern Xpm *LoadPNGFile(const char* file_name);
+extern int  DecodePNGFile(const char* file_name, RgbaImage &image);  // 0 on success
 #endif
 
 #ifdef HAVE_JPEG
 extern Xpm *LoadJPEGFile(const char* file_name);
+extern int  DecodeJPEGFile(const char* file_name, RgbaImage &image);  // 0 on success
 #endif
 
 #ifdef HAVE_GIF
 extern Xpm *LoadGIFFile(const char* file_name);
+extern int  DecodeGIFFile(const char* file_name, RgbaImage &image);  // 0 on success
 #endif
 
 extern int   WInt8(int val) noexcept;
@@ -0,0 +1,153 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * text_cache.cc
+ * Glyphs and widths of the strings drawn, looked up once per font
+ */
+
+#include "text_cache.hh"
+#include "fntrace.hh"
+
+#include <algorithm>
+#include <cstdio>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+TextCache TextRuns;
+
+/****
+ * Shape:  looks up text's glyphs in font the way XftTextExtentsUtf8()
+ *  and XftDrawStringUtf8() do, stopping at the first bad UTF-8 sequence
+ ****/
+static void Shape(Display *d, XftFont *font, const char* text, int len, TextCache::Run &run)
+{
+    const FcChar8 *utf8 = reinterpret_cast<const FcChar8 *>(text);
+    int pos = 0;
+    int pen = 0;
+    while (pos < len)
+    {
+        FcChar32 ucs4;
+        const int bytes = FcUtf8ToUcs4(utf8 + pos, &ucs4, len - pos);
+        if (bytes <= 0)
+            break;
+        pos += bytes;
+
+        const FT_UInt glyph = XftCharIndex(d, font, ucs4);
+        XGlyphInfo info;
+        XftGlyphExtents(d, font, &glyph, 1, &info);
+        pen += info.xOff;
+        run.glyphs.push_back(glyph);
+        run.ends.push_back(pos);
+        run.advance.push_back(pen);
+    }
+}
+
+// key for a shadow mask:  the font, how the shadow is drawn, and the text
+static std::string MaskKey(XftFont *font, int offset_x, int offset_y, int blur_radius, const char* text, int len)
+{
+    char prefix[64];
+    const int prefix_len = snprintf(prefix, sizeof(prefix), "%p %d %d %d ",
+                                    static_cast<void *>(font), offset_x, offset_y, blur_radius);
+    std::string key(prefix, static_cast<std::size_t>(prefix_len));
+    key.append(text, static_cast<std::size_t>(len));
+    return key;
+}
+
+int TextCache::Run::Width(int bytes) const noexcept
+{
+    const auto past = std::upper_bound(ends.begin(), ends.end(), bytes);
+    if (past == ends.begin())
+        return 0;
+    return advance[static_cast<std::size_t>(past - ends.begin()) - 1];
+}
+
+const TextCache::Run *TextCache::Get(Display *d, XftFont *font, const char* text, int len)
+{
+    FnTrace("TextCache::Get()");
+    if (len < 0)
+        len = 0;
+    FontRuns &runs = fonts[font];
+    auto found = runs.index.find(std::string_view(text, static_cast<std::size_t>(len)));
+    if (found != runs.index.end())
+    {
+        ++stats.hits;
+        runs.entries.splice(runs.entries.begin(), runs.entries, found->second);
+        return &found->second->run;
+    }
+
+    ++stats.misses;
+    dis = d;
+    runs.entries.push_front(Entry{std::string(text, static_cast<std::size_t>(len)), Run{}});
+    Entry &entry = runs.entries.front();
+    Shape(d, font, entry.text.data(), len, entry.run);
+    runs.index[entry.text] = runs.entries.begin();
+    ++stats.runs;
+
+    while (runs.entries.size() > TEXT_CACHE_RUNS)
+    {
+        runs.index.erase(runs.entries.back().text);
+        runs.entries.pop_back();
+        --stats.runs;
+        ++stats.evictions;
+    }
+    return &entry.run;
+}
+
+const GenericShadowMask *TextCache::Shadow(Display *d, Drawable drawable, XftFont *font, const char* text, int len,
+                                           const Run &run, int offset_x, int offset_y, int blur_radius)
+{
+    FnTrace("TextCache::Shadow()");
+    std::string key = MaskKey(font, offset_x, offset_y, blur_radius, text, len);
+    auto found = mask_index.find(key);
+    if (found != mask_index.end())
+    {
+        ++stats.mask_hits;
+        masks.splice(masks.begin(), masks, found->second);
+        const GenericShadowMask &mask = found->second->mask;
+        return (mask.picture != None) ? &mask : nullptr;
+    }
+
+    ++stats.mask_misses;
+    dis = d;
+    GenericShadowMask mask;
+    GenericMakeShadowMask(d, drawable, font, run.glyphs, offset_x, offset_y, blur_radius, mask);
+    masks.push_front(MaskEntry{key, mask});
+    mask_index[std::move(key)] = masks.begin();
+
+    while (masks.size() > TEXT_CACHE_MASKS)
+    {
+        MaskEntry &oldest = masks.back();
+        GenericFreeShadowMask(dis, oldest.mask);
+        mask_index.erase(oldest.key);
+        masks.pop_back();
+    }
+    stats.masks = masks.size();
+    return (masks.front().mask.picture != None) ? &masks.front().mask : nullptr;
+}
+
+void TextCache::Clear()
+{
+    FnTrace("TextCache::Clear()");
+    for (MaskEntry &entry : masks)
+        GenericFreeShadowMask(dis, entry.mask);
+    masks.clear();
+    mask_index.clear();
+    fonts.clear();
+    stats.runs = 0;
+    stats.masks = 0;
+}
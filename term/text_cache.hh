@@ -0,0 +1,121 @@
+/*
+ * Copyright ViewTouch, Inc., 1995, 1996, 1997, 1998, 2025, 2026
+
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * text_cache.hh
+ * Glyphs and widths of the strings drawn, looked up once per font
+ */
+
+#ifndef TEXT_CACHE_HH
+#define TEXT_CACHE_HH
+
+#include "generic_char.hh"
+
+#include <X11/Xlib.h>
+#include <X11/Xft/Xft.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#define TEXT_CACHE_RUNS   1024  // strings kept per font
+#define TEXT_CACHE_MASKS  256   // drop shadow masks kept, all fonts
+
+/*********************************************************************
+ * TextCache
+ *
+ * Strings drawn with Xft, each turned into its glyphs and pen positions
+ * once per font.  Widths of the string, or of any leading part of it as
+ * word wrapping asks for, then come from the run without another trip
+ * through XftTextExtentsUtf8(), and the glyphs are drawn directly.  Each
+ * font keeps its TEXT_CACHE_RUNS most recently drawn strings.
+ *
+ * Drop shadows are kept the same way, as alpha masks on the server,
+ * for the TEXT_CACHE_MASKS most recently drawn.  Fonts must not be
+ * closed without Clear(), as they're known by their XftFont.
+ ********************************************************************/
+class TextCache
+{
+public:
+    struct Run
+    {
+        std::vector<FT_UInt> glyphs;
+        std::vector<int> ends;     // byte offset just past each glyph
+        std::vector<int> advance;  // pen position after each glyph
+
+        [[nodiscard]] int Width() const noexcept { return advance.empty() ? 0 : advance.back(); }
+        // Width of the first bytes of the string, as XftTextExtentsUtf8()
+        // gives it (glyphs cut off by bytes aren't counted)
+        [[nodiscard]] int Width(int bytes) const noexcept;
+    };
+
+    struct Stats
+    {
+        uint64_t    hits{0};
+        uint64_t    misses{0};       // strings looked up
+        uint64_t    evictions{0};
+        uint64_t    mask_hits{0};
+        uint64_t    mask_misses{0};  // shadows drawn into masks
+        std::size_t runs{0};
+        std::size_t masks{0};
+    };
+
+    TextCache() = default;
+    TextCache(const TextCache&) = delete;
+    TextCache& operator=(const TextCache&) = delete;
+
+    // text's run in font; valid until the next Get() or Clear()
+    const Run *Get(Display *d, XftFont *font, const char* text, int len);
+    // The drop shadow for run (text's run in font); nullptr if there's no
+    // ink to draw or the server can't make a mask
+    const GenericShadowMask *Shadow(Display *d, Drawable drawable, XftFont *font, const char* text, int len,
+                                    const Run &run, int offset_x, int offset_y, int blur_radius);
+    // Forgets every run and frees every mask, before fonts are closed
+    void Clear();
+    [[nodiscard]] const Stats &GetStats() const noexcept { return stats; }
+
+private:
+    struct Entry
+    {
+        std::string text;
+        Run run;
+    };
+
+    struct FontRuns
+    {
+        std::list<Entry> entries;  // most recently drawn first
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index;  // views of entry text
+    };
+
+    struct MaskEntry
+    {
+        std::string key;
+        GenericShadowMask mask;  // no picture for a shadow with no ink
+    };
+
+    std::unordered_map<XftFont *, FontRuns> fonts;
+    std::list<MaskEntry> masks;  // most recently drawn first
+    std::unordered_map<std::string, std::list<MaskEntry>::iterator> mask_index;
+    Display *dis{nullptr};
+    Stats stats;
+};
+
+extern TextCache TextRuns;
+
+#endif
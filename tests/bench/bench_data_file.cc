@@ -0,0 +1,139 @@
+/*
+ * bench_data_file.cc - Text tokenizer microbenchmark
+ * Times InputDataFile against the old per-byte gzgetc() tokenizer on
+ * real data files:
+ *
+ *   vt_bench_data_file [-n RUNS] /usr/viewtouch/dat/current/check_* \
+ *                      /usr/viewtouch/dat/archive/archive_*
+ */
+
+#include "data_file.hh"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr std::string_view kNewEncodeDigits = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+struct Totals
+{
+    std::size_t tokens = 0;
+    uint64_t    checksum = 0;
+};
+
+// The tokenizer InputDataFile used before it buffered its input: one
+// gzgetc() and one isspace() per byte.  Every token is decoded as a
+// new-style value, which is what GetValue() spends its time on.
+Totals ReadPerByte(const std::string &path)
+{
+    static const auto decode = [] {
+        std::array<uint8_t, 256> table{};
+        for (std::size_t idx = 0; idx < kNewEncodeDigits.size(); ++idx)
+            table[static_cast<unsigned char>(kNewEncodeDigits[idx])] = static_cast<uint8_t>(idx);
+        return table;
+    }();
+
+    Totals totals;
+    gzFile fp = gzopen(path.c_str(), "r");
+    if (fp == nullptr)
+        return totals;
+    gzbuffer(fp, static_cast<unsigned int>(DataFileBlockSize));
+
+    int ch = gzgetc(fp);
+    while (ch >= 0)
+    {
+        while (ch >= 0 && std::isspace(ch))
+            ch = gzgetc(fp);
+        if (ch < 0)
+            break;
+        uint64_t value = 0;
+        while (ch >= 0 && !std::isspace(ch))
+        {
+            value = (value << 6) + decode[static_cast<unsigned char>(ch)];
+            ch = gzgetc(fp);
+        }
+        totals.checksum += value;
+        ++totals.tokens;
+    }
+    gzclose(fp);
+    return totals;
+}
+
+Totals ReadBuffered(const std::string &path)
+{
+    Totals totals;
+    InputDataFile df;
+    int version = 0;
+    if (df.Open(path, version))
+        return totals;
+
+    // the header tokens are read by Open(); count them like the old path
+    totals.tokens = df.IsLegacyEncoding() ? 1 : 3;
+    for (;;)
+    {
+        const uint64_t value = df.GetValue();
+        if (df.end_of_file)
+            break;
+        totals.checksum += value;
+        ++totals.tokens;
+    }
+    return totals;
+}
+
+template <typename Fn>
+double TimeRuns(Fn &&fn, const std::vector<std::string> &files, int runs, Totals &totals)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (int run = 0; run < runs; ++run)
+    {
+        totals = Totals{};
+        for (const std::string &path : files)
+        {
+            const Totals file_totals = fn(path);
+            totals.tokens   += file_totals.tokens;
+            totals.checksum += file_totals.checksum;
+        }
+    }
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / runs;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int runs = 20;
+    std::vector<std::string> files;
+    for (int idx = 1; idx < argc; ++idx)
+    {
+        const std::string arg = argv[idx];
+        if (arg == "-n" && idx + 1 < argc)
+            runs = std::max(1, std::atoi(argv[++idx]));
+        else
+            files.push_back(arg);
+    }
+    if (files.empty())
+    {
+        std::fprintf(stderr, "Usage:  %s [-n RUNS] FILE...\n", argv[0]);
+        return 1;
+    }
+
+    Totals per_byte;
+    Totals buffered;
+    const double per_byte_ms = TimeRuns(ReadPerByte, files, runs, per_byte);
+    const double buffered_ms = TimeRuns(ReadBuffered, files, runs, buffered);
+
+    std::printf("%zu files, %d runs\n", files.size(), runs);
+    std::printf("  gzgetc per byte:  %10.3f ms  %zu tokens\n", per_byte_ms, per_byte.tokens);
+    std::printf("  block buffered:   %10.3f ms  %zu tokens\n", buffered_ms, buffered.tokens);
+    std::printf("  speedup:          %10.2fx\n", (buffered_ms > 0) ? per_byte_ms / buffered_ms : 0.0);
+    return 0;
+}
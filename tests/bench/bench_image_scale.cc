@@ -0,0 +1,190 @@
+/*
+ * bench_image_scale.cc - Button image scaling microbenchmark
+ * Times ScaleRgba() against the nearest-neighbour XGetPixel()/XPutPixel()
+ * loop DrawPixmap() used, scaling a 1920x1080 photo to button sizes.
+ * The old loop's XGetImage() round trip isn't counted, so it does
+ * better here than on a terminal.  Then times filling the XImage for the
+ * whole photo with XPutPixel() as the loaders did, against PackRgbaRow():
+ *
+ *   vt_bench_image_scale [-n RUNS] [-s WIDTHxHEIGHT]
+ */
+
+#include "image_scale.hh"
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Size
+{
+    int w;
+    int h;
+};
+
+// a photo-like source:  smooth gradients with some texture
+void Photo(RgbaImage &image, int w, int h)
+{
+    image.Resize(w, h);
+    for (int y = 0; y < h; ++y)
+    {
+        Uchar *row = image.Row(y);
+        for (int x = 0; x < w; ++x)
+        {
+            row[x * 4]     = static_cast<Uchar>((x * 255 / w + ((x ^ y) & 15)) & 255);
+            row[x * 4 + 1] = static_cast<Uchar>(y * 255 / h);
+            row[x * 4 + 2] = static_cast<Uchar>(((x + y) * 255 / (w + h)) ^ (y & 7));
+            row[x * 4 + 3] = 255;
+        }
+    }
+}
+
+// a 24-bit TrueColor ZPixmap image, as XGetImage() returns on most terminals
+XImage MakeXImage(std::vector<char> &data, int w, int h)
+{
+    data.assign(static_cast<size_t>(w) * h * 4, 0);
+    XImage image{};
+    image.width = w;
+    image.height = h;
+    image.format = ZPixmap;
+    image.data = data.data();
+    image.byte_order = LSBFirst;
+    image.bitmap_unit = 32;
+    image.bitmap_bit_order = LSBFirst;
+    image.bitmap_pad = 32;
+    image.depth = 24;
+    image.bytes_per_line = w * 4;
+    image.bits_per_pixel = 32;
+    image.red_mask = 0xff0000;
+    image.green_mask = 0x00ff00;
+    image.blue_mask = 0x0000ff;
+    XInitImage(&image);
+    return image;
+}
+
+// the scaling loop DrawPixmap() had
+void NearestXImage(XImage *orig, XImage *scaled, int img_w, int img_h, int draw_w, int draw_h)
+{
+    const double inv_scale_x = static_cast<double>(img_w) / static_cast<double>(draw_w);
+    const double inv_scale_y = static_cast<double>(img_h) / static_cast<double>(draw_h);
+    for (int y = 0; y < draw_h; ++y)
+    {
+        for (int x = 0; x < draw_w; ++x)
+        {
+            int src_x = static_cast<int>(x * inv_scale_x);
+            int src_y = static_cast<int>(y * inv_scale_y);
+            if (src_x >= img_w)
+                src_x = img_w - 1;
+            if (src_y >= img_h)
+                src_y = img_h - 1;
+            XPutPixel(scaled, x, y, XGetPixel(orig, src_x, src_y));
+        }
+    }
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int runs = 20;
+    Size source{1920, 1080};
+    for (int idx = 1; idx < argc; ++idx)
+    {
+        const std::string arg = argv[idx];
+        if (arg == "-n" && idx + 1 < argc)
+            runs = std::max(1, std::atoi(argv[++idx]));
+        else if (arg == "-s" && idx + 1 < argc &&
+                 std::sscanf(argv[++idx], "%dx%d", &source.w, &source.h) == 2 && source.w > 0 && source.h > 0)
+        {
+        }
+        else
+        {
+            std::fprintf(stderr, "Usage:  %s [-n RUNS] [-s WIDTHxHEIGHT]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    RgbaImage photo;
+    Photo(photo, source.w, source.h);
+    std::vector<char> orig_data;
+    XImage orig = MakeXImage(orig_data, source.w, source.h);
+    for (int y = 0; y < source.h; ++y)
+    {
+        for (int x = 0; x < source.w; ++x)
+        {
+            const Uchar *px = photo.Row(y) + x * 4;
+            XPutPixel(&orig, x, y, (static_cast<unsigned long>(px[0]) << 16) | (px[1] << 8) | px[2]);
+        }
+    }
+
+    std::printf("%dx%d source, %d runs, %s kernels\n", source.w, source.h, runs, ScaleKernel());
+    std::printf("  %-9s %12s %12s %12s\n", "button", "XPutPixel", "box", "bilinear");
+    for (const Size &button : {Size{120, 80}, Size{240, 160}, Size{480, 320}, Size{960, 540}})
+    {
+        std::vector<char> scaled_data;
+        XImage scaled = MakeXImage(scaled_data, button.w, button.h);
+        auto start = std::chrono::steady_clock::now();
+        for (int run = 0; run < runs; ++run)
+            NearestXImage(&orig, &scaled, source.w, source.h, button.w, button.h);
+        const double nearest_ms = MillisecondsSince(start) / runs;
+
+        RgbaImage out;
+        start = std::chrono::steady_clock::now();
+        for (int run = 0; run < runs; ++run)
+            ScaleRgba(photo, out, button.w, button.h, SCALE_BOX);
+        const double box_ms = MillisecondsSince(start) / runs;
+
+        start = std::chrono::steady_clock::now();
+        for (int run = 0; run < runs; ++run)
+            ScaleRgba(photo, out, button.w, button.h, SCALE_BILINEAR);
+        const double bilinear_ms = MillisecondsSince(start) / runs;
+
+        const std::string name = std::to_string(button.w) + "x" + std::to_string(button.h);
+        std::printf("  %-9s %9.2f ms %9.2f ms %9.2f ms\n", name.c_str(), nearest_ms, box_ms, bilinear_ms);
+    }
+
+    // the loaders' conversion of a decoded image, before XPutImage()
+    std::vector<char> put_data;
+    XImage put = MakeXImage(put_data, source.w, source.h);
+    auto start = std::chrono::steady_clock::now();
+    for (int run = 0; run < runs; ++run)
+    {
+        for (int y = 0; y < source.h; ++y)
+        {
+            const Uchar *row = photo.Row(y);
+            for (int x = 0; x < source.w; ++x)
+            {
+                const Uchar *px = row + x * 4;
+                unsigned long pixel = 0;
+                if (px[3] >= ALPHA_OPAQUE)
+                    pixel = (px[0] << 16) | (px[1] << 8) | px[2];
+                XPutPixel(&put, x, y, pixel);
+            }
+        }
+    }
+    const double put_ms = MillisecondsSince(start) / runs;
+
+    PixelLayout layout;
+    NativeLayout(put.red_mask, put.green_mask, put.blue_mask, put.bits_per_pixel, put.byte_order == MSBFirst, layout);
+    start = std::chrono::steady_clock::now();
+    for (int run = 0; run < runs; ++run)
+        for (int y = 0; y < source.h; ++y)
+            PackRgbaRow(photo.Row(y), reinterpret_cast<Uchar *>(put.data) + y * put.bytes_per_line, source.w, layout);
+    const double pack_ms = MillisecondsSince(start) / runs;
+    std::printf("\n  fill %dx%d XImage:  XPutPixel %.2f ms, PackRgbaRow %.2f ms\n",
+                source.w, source.h, put_ms, pack_ms);
+    return 0;
+}
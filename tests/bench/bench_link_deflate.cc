@@ -0,0 +1,138 @@
+/*
+ * bench_link_deflate.cc - Link frame deflate microbenchmark
+ * Times LinkDeflate packing and unpacking report page redraws in each
+ * link encoding, to see what LINK_DEFLATE costs a terminal's host:
+ *
+ *   vt_bench_link_deflate [-n RUNS] [-l LINES]
+ */
+
+#include "remote_link.hh"
+#include "link_deflate.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Encoding
+{
+    const char *name;
+    int encoding;
+    int flags;
+};
+
+// what a report page puts out:  the page header, then a rule and a
+// label, count and amount per line
+void PutReportPage(CharQueue &q, int lines)
+{
+    static const char *labels[] = {"Food Sales", "Beverage Sales", "Room Charges", "Merchandise",
+                                   "Comps", "Discounts", "Coupons", "Tips"};
+    q.Put8(TERM_BLANKPAGE);
+    q.Put8(0);
+    q.Put8(12);
+    q.Put8(3);
+    q.Put8(5);
+    q.PutString("Daily Revenue", 0);
+    q.PutString("12:30 PM", 0);
+    for (int line = 0; line < lines; ++line)
+    {
+        const int y = 96 + line * 24;
+        const std::string amount = "$" + std::to_string(line * 137 % 9000) + "." +
+                                   std::to_string(10 + line % 90);
+        q.Put8(TERM_HLINE);
+        q.Put16(20);
+        q.Put16(y);
+        q.Put16(600);
+        q.Put8(1);
+        q.Put8(0);
+        q.Put8(TERM_TEXTL);
+        q.PutString(labels[line % 8], 0);
+        q.Put16(24);
+        q.Put16(y + 4);
+        q.Put8(0);
+        q.Put8(2);
+        q.Put16(0);
+        q.Put8(TERM_TEXTC);
+        q.PutString(std::to_string(line % 40).c_str(), 0);
+        q.Put16(320);
+        q.Put16(y + 4);
+        q.Put8(0);
+        q.Put8(2);
+        q.Put16(0);
+        q.Put8(TERM_TEXTR);
+        q.PutString(amount.c_str(), 0);
+        q.Put16(616);
+        q.Put16(y + 4);
+        q.Put8(0);
+        q.Put8(2);
+        q.Put16(0);
+    }
+    q.Put8(TERM_UPDATEALL);
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int runs = 200;
+    int lines = 400;
+    for (int idx = 1; idx < argc; ++idx)
+    {
+        const std::string arg = argv[idx];
+        if (arg == "-n" && idx + 1 < argc)
+            runs = std::max(1, std::atoi(argv[++idx]));
+        else if (arg == "-l" && idx + 1 < argc)
+            lines = std::max(1, std::atoi(argv[++idx]));
+        else
+        {
+            std::fprintf(stderr, "Usage:  %s [-n RUNS] [-l LINES]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::printf("report page of %d lines, %d runs\n", lines, runs);
+    for (const Encoding &link : {Encoding{"tagged", LINK_ENCODING_TAGGED, 0},
+                                 Encoding{"compact", LINK_ENCODING_COMPACT, 0},
+                                 Encoding{"checked", LINK_ENCODING_COMPACT, LINK_CHECKED}})
+    {
+        CharQueue page(static_cast<int>(QUEUE_SIZE * 4));
+        page.SetEncoding(link.encoding, link.flags);
+        PutReportPage(page, lines);
+        const std::span<const Uchar> raw = page.ReadSpan();
+
+        LinkDeflate zip;
+        std::vector<Uchar> frame;
+        auto start = std::chrono::steady_clock::now();
+        for (int run = 0; run < runs; ++run)
+            zip.Pack(raw, {}, frame);
+        const double pack_ms = MillisecondsSince(start) / runs;
+
+        std::vector<Uchar> back(raw.size());
+        const std::span<const Uchar> payload(frame.data() + 4, frame.size() - 4);
+        int bad = 0;
+        start = std::chrono::steady_clock::now();
+        for (int run = 0; run < runs; ++run)
+            bad += zip.Unpack(payload, back, {});
+        const double unpack_ms = MillisecondsSince(start) / runs;
+        if (bad || !std::equal(back.begin(), back.end(), raw.begin()))
+        {
+            std::fprintf(stderr, "%s: frame didn't come back the same\n", link.name);
+            return 1;
+        }
+
+        std::printf("  %-8s %8zu -> %7zu bytes (%4.1f%%)  deflate %8.3f ms  inflate %8.3f ms\n",
+                    link.name, raw.size(), frame.size(), 100.0 * frame.size() / raw.size(),
+                    pack_ms, unpack_ms);
+    }
+    return 0;
+}
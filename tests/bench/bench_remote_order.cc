@@ -0,0 +1,273 @@
+/*
+ * bench_remote_order.cc - Remote order port load generator
+ * Replays orders to a running vt_main over one pipelined ("remotebatch")
+ * connection at each rate given, for SECONDS at each, and reports how
+ * many were answered and how long the answers took.  The rate where the
+ * answers stop keeping up is the port's saturation point:
+ *
+ *   vt_bench_remote_order [-h HOST] [-p PORT] [-r RATE[,RATE...]]
+ *                         [-t SECONDS] [-f ORDER_FILE] [-i FIRST_ID]
+ *
+ * ORDER_FILE holds one order as key:value lines (use item codes from the
+ * site's menu); its OrderID and EndOrder lines are supplied for each
+ * order sent.  Without one a one-item order for ItemCode 101 is sent.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Run
+{
+    int    offered = 0;   // orders per second asked for
+    int    sent = 0;
+    int    answered = 0;
+    int    complete = 0;  // answered COMPLETE
+    int    backlog = 0;   // most sent and not yet answered
+    double seconds = 0;   // first order sent to last answer
+    std::vector<double> latency_ms;
+};
+
+int Connect(const std::string &host, const std::string &port)
+{
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *found = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0)
+        return -1;
+    int fd = -1;
+    for (addrinfo *addr = found; addr != nullptr && fd < 0; addr = addr->ai_next)
+    {
+        fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+        if (fd >= 0 && connect(fd, addr->ai_addr, addr->ai_addrlen) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    return fd;
+}
+
+// reads what has come into pending; false once the server has closed
+bool Receive(int fd, std::string &pending)
+{
+    char buffer[4096];
+    const ssize_t got = read(fd, buffer, sizeof(buffer));
+    if (got <= 0)
+        return false;
+    pending.append(buffer, static_cast<size_t>(got));
+    return true;
+}
+
+std::string LoadOrder(const char *path)
+{
+    if (path == nullptr)
+        return "OrderType: T\nFirstName: Load\nLastName: Test\nItemCode: 101\nItemQTY: 1\nEndItem\n";
+    std::ifstream file(path);
+    std::string body;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.starts_with("OrderID") || line.starts_with("EndOrder") ||
+            line.starts_with("CorrelationID"))
+        {
+            continue;
+        }
+        body += line + "\n";
+    }
+    return body;
+}
+
+double Percentile(std::vector<double> &sorted, double part)
+{
+    if (sorted.empty())
+        return 0;
+    const size_t idx = std::min(sorted.size() - 1, static_cast<size_t>(part * sorted.size()));
+    return sorted[idx];
+}
+
+/****
+ * Replay:  sends orders for seconds at rate, one every 1/rate seconds,
+ *  reading answers as they come, then waits up to 10 seconds for the
+ *  answers still owed
+ ****/
+int Replay(int fd, const std::string &body, int rate, int seconds, int &next_id, Run &run)
+{
+    run.offered = rate;
+    std::string pending;
+    const std::string_view ready = "SENDORDERS\n";
+    if (write(fd, "remotebatch\n", 12) != 12)
+        return 1;
+    while (pending.size() < ready.size())
+    {
+        if (!Receive(fd, pending))
+            return 1;
+    }
+    if (!pending.starts_with(ready))
+        return 1;
+    pending.erase(0, ready.size());
+
+    const int total = rate * seconds;
+    std::unordered_map<std::string, Clock::time_point> sent_at;
+    const Clock::time_point start = Clock::now();
+    Clock::time_point last_answer = start;
+    const Clock::time_point give_up = start + std::chrono::seconds(seconds + 10);
+    bool closed = false;
+    while (!closed && (run.sent < total || run.answered < run.sent) && Clock::now() < give_up)
+    {
+        const Clock::time_point due = start + std::chrono::microseconds(
+            static_cast<int64_t>(run.sent) * 1000000 / rate);
+        int wait_ms = 100;
+        if (run.sent < total)
+        {
+            const auto until = std::chrono::duration_cast<std::chrono::milliseconds>(due - Clock::now());
+            wait_ms = std::max(0, static_cast<int>(until.count()));
+        }
+
+        pollfd watch{fd, POLLIN, 0};
+        if (poll(&watch, 1, wait_ms) > 0)
+            closed = !Receive(fd, pending);
+        size_t end;
+        while ((end = pending.find('\n')) != std::string::npos)
+        {
+            // RESULT correlation id:serial:status:printed
+            const std::string line = pending.substr(0, end);
+            pending.erase(0, end + 1);
+            if (!line.starts_with("RESULT "))
+                continue;
+            const size_t space = line.find(' ', 7);
+            auto found = sent_at.find(line.substr(7, space - 7));
+            if (space == std::string::npos || found == sent_at.end())
+                continue;
+            last_answer = Clock::now();
+            const std::chrono::duration<double, std::milli> took = last_answer - found->second;
+            run.latency_ms.push_back(took.count());
+            sent_at.erase(found);
+            ++run.answered;
+            if (line.find(":COMPLETE:", space) != std::string::npos)
+                ++run.complete;
+        }
+
+        while (run.sent < total && Clock::now() >= start + std::chrono::microseconds(
+                   static_cast<int64_t>(run.sent) * 1000000 / rate))
+        {
+            const std::string correlation = std::to_string(next_id);
+            const std::string order = "OrderID: " + correlation + "\nCorrelationID: " + correlation +
+                                      "\n" + body + "EndOrder\n";
+            sent_at[correlation] = Clock::now();
+            size_t done = 0;
+            while (done < order.size())
+            {
+                const ssize_t put = write(fd, order.data() + done, order.size() - done);
+                if (put <= 0)
+                    return 1;
+                done += static_cast<size_t>(put);
+            }
+            ++next_id;
+            ++run.sent;
+            run.backlog = std::max(run.backlog, run.sent - run.answered);
+        }
+    }
+    const std::chrono::duration<double> took = last_answer - start;
+    run.seconds = took.count();
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::string host = "127.0.0.1";
+    std::string port = "10001";
+    std::vector<int> rates{50};
+    int seconds = 10;
+    const char *order_file = nullptr;
+    int next_id = static_cast<int>(std::time(nullptr) % 100000000) * 10;  // clear of earlier runs
+    for (int idx = 1; idx < argc; ++idx)
+    {
+        const std::string arg = argv[idx];
+        const bool has_value = idx + 1 < argc;
+        if (arg == "-h" && has_value)
+            host = argv[++idx];
+        else if (arg == "-p" && has_value)
+            port = argv[++idx];
+        else if (arg == "-t" && has_value)
+            seconds = std::max(1, std::atoi(argv[++idx]));
+        else if (arg == "-f" && has_value)
+            order_file = argv[++idx];
+        else if (arg == "-i" && has_value)
+            next_id = std::max(1, std::atoi(argv[++idx]));
+        else if (arg == "-r" && has_value)
+        {
+            rates.clear();
+            std::string_view list = argv[++idx];
+            while (!list.empty())
+            {
+                const size_t comma = std::min(list.find(','), list.size());
+                rates.push_back(std::max(1, std::atoi(std::string(list.substr(0, comma)).c_str())));
+                list.remove_prefix(std::min(comma + 1, list.size()));
+            }
+        }
+        else
+        {
+            std::fprintf(stderr, "Usage:  %s [-h HOST] [-p PORT] [-r RATE[,RATE...]] [-t SECONDS] "
+                                 "[-f ORDER_FILE] [-i FIRST_ID]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (rates.empty())
+        rates.push_back(50);
+
+    const std::string body = LoadOrder(order_file);
+    if (body.empty())
+    {
+        std::fprintf(stderr, "%s: no order in %s\n", argv[0], order_file);
+        return 1;
+    }
+
+    std::printf("%s:%s, %d seconds at each rate\n", host.c_str(), port.c_str(), seconds);
+    std::printf("  offered    sent answered complete   per sec  backlog     p50 ms     p99 ms     max ms\n");
+    for (int rate : rates)
+    {
+        const int fd = Connect(host, port);
+        if (fd < 0)
+        {
+            std::fprintf(stderr, "%s: can't connect to %s:%s\n", argv[0], host.c_str(), port.c_str());
+            return 1;
+        }
+        Run run;
+        const int failed = Replay(fd, body, rate, seconds, next_id, run);
+        close(fd);
+        if (failed)
+        {
+            std::fprintf(stderr, "%s: the server didn't take a remotebatch connection\n", argv[0]);
+            return 1;
+        }
+
+        std::sort(run.latency_ms.begin(), run.latency_ms.end());
+        const double answered_rate = (run.seconds > 0) ? run.answered / run.seconds : 0;
+        std::printf("  %7d %7d %8d %8d %9.1f %8d %10.2f %10.2f %10.2f\n",
+                    run.offered, run.sent, run.answered, run.complete, answered_rate, run.backlog,
+                    Percentile(run.latency_ms, 0.50), Percentile(run.latency_ms, 0.99),
+                    run.latency_ms.empty() ? 0.0 : run.latency_ms.back());
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * test_check_index.cc - Unit tests for check_index.hh
+ * Tests filing, refiling and removing checks
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "check_index.hh"
+
+#include <array>
+
+namespace {
+
+// the index never looks inside a check, so any distinct addresses do
+std::array<char, 8> storage;
+
+Check *FakeCheck(int idx)
+{
+    return reinterpret_cast<Check *>(&storage[static_cast<std::size_t>(idx)]);
+}
+
+} // namespace
+
+TEST_CASE("CheckIndex files checks by serial, table and owner", "[check_index]")
+{
+    CheckIndex index;
+    index.Update(FakeCheck(2), 30, "12", 0, 7);
+    index.Update(FakeCheck(0), 10, "12", 0, 7);
+    index.Update(FakeCheck(1), 20, "14", 0, 8);
+    index.Update(FakeCheck(3), 40, "12", 1, 7);   // training
+
+    REQUIRE(index.Size() == 4);
+    REQUIRE(index.FindSerial(20) == FakeCheck(1));
+    REQUIRE(index.FindSerial(50) == nullptr);
+
+    const CheckIndex::Entries *at_12 = index.AtTable("12", 0);
+    REQUIRE(at_12 != nullptr);
+    REQUIRE(at_12->size() == 2);
+    REQUIRE((*at_12)[0].serial == 10);   // serial number order
+    REQUIRE((*at_12)[1].serial == 30);
+    REQUIRE(index.AtTable("12", 1)->size() == 1);
+    REQUIRE(index.AtTable("99", 0) == nullptr);
+    REQUIRE(index.OwnedBy(7)->size() == 3);
+
+    SECTION("a check moved to another table and owner")
+    {
+        index.Update(FakeCheck(2), 30, "14", 0, 8);
+        REQUIRE(index.AtTable("12", 0)->size() == 1);
+        REQUIRE(index.AtTable("14", 0)->size() == 2);
+        REQUIRE(index.OwnedBy(7)->size() == 2);
+        REQUIRE(index.OwnedBy(8)->size() == 2);
+        REQUIRE(index.Size() == 4);
+    }
+
+    SECTION("an unchanged update files nothing twice")
+    {
+        index.Update(FakeCheck(0), 10, "12", 0, 7);
+        REQUIRE(index.AtTable("12", 0)->size() == 2);
+        REQUIRE(index.OwnedBy(7)->size() == 3);
+    }
+
+    SECTION("removed checks leave no empty buckets")
+    {
+        index.Remove(FakeCheck(1));
+        index.Remove(FakeCheck(1));
+        REQUIRE(index.FindSerial(20) == nullptr);
+        REQUIRE(index.AtTable("14", 0) == nullptr);
+        REQUIRE(index.OwnedBy(8) == nullptr);
+        REQUIRE(index.Size() == 3);
+
+        index.Clear();
+        REQUIRE(index.Size() == 0);
+        REQUIRE(index.FindSerial(10) == nullptr);
+        REQUIRE(index.AtTable("12", 0) == nullptr);
+    }
+}
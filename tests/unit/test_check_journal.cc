@@ -0,0 +1,251 @@
+/*
+ * test_check_journal.cc - Unit tests for check_journal.hh
+ * Tests recording, replaying and checkpointing check images
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "main/business/check_journal.hh"
+#include "src/core/data_file.hh"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const std::string kDir = "/tmp/vt_test_check_journal";
+
+std::string JournalPath()
+{
+    return kDir + "/checks.journal";
+}
+
+void ResetDir()
+{
+    mkdir(kDir.c_str(), 0755);
+    std::remove(JournalPath().c_str());
+    std::remove((JournalPath() + ".old").c_str());
+    std::remove((kDir + "/check_5").c_str());
+}
+
+long FileSize(const std::string &path)
+{
+    struct stat info{};
+    return (stat(path.c_str(), &info) == 0) ? static_cast<long>(info.st_size) : -1;
+}
+
+JournalPart Part(const std::string &text, int parts = 1)
+{
+    return JournalPart{text, 25, parts};
+}
+
+// a check with one subcheck holding orders, each with its modifiers
+JournalImage Image(int serial, int orders)
+{
+    JournalImage image;
+    image.header = Part(std::to_string(serial) + " 1000 7 7 0\n");
+    JournalSub &sub = image.subs.emplace_back();
+    sub.head = Part("1 0 0 -1\n");
+    for (int i = 0; i < orders; ++i)
+        sub.orders.push_back(Part("\"Burger " + std::to_string(i) + "\" 550\n\"No Onion\" 0\n", 2));
+    sub.payments.push_back(Part("3 1200\n"));
+    sub.tail = Part("0 0 0 0\n");
+    return image;
+}
+
+// check files as LoadCurrentData() would find them
+struct Files
+{
+    std::map<int, JournalImage> checks;
+
+    CheckJournal::ImageSource Source()
+    {
+        return [this](int serial, JournalImage &image) {
+            auto found = checks.find(serial);
+            if (found == checks.end())
+                return 1;
+            image = found->second;
+            return 0;
+        };
+    }
+};
+
+} // namespace
+
+TEST_CASE("Check journal records replay onto the saved checks", "[check_journal]")
+{
+    ResetDir();
+    CheckJournal journal;
+    REQUIRE(journal.Open(kDir) == 0);
+
+    JournalImage five = Image(5, 2);
+    REQUIRE(journal.Record(5, five) == 0);
+    five.subs[0].orders.push_back(Part("\"Fries\" 300\n"));
+    five.subs[0].tail = Part("0 0 1200 0\n");
+    REQUIRE(journal.Record(5, five) == 0);
+    const JournalImage six = Image(6, 1);
+    REQUIRE(journal.Record(6, six) == 0);
+    REQUIRE(journal.Record(6, six) == 0);  // unchanged, so not recorded
+    REQUIRE(journal.IsDirty(5));
+    journal.Close();
+
+    Files files;
+    files.checks[5] = Image(5, 2);
+
+    SECTION("Record then replay")
+    {
+        CheckJournal replayer;
+        JournalReplay replay;
+        REQUIRE(replayer.Replay(kDir, files.Source(), replay) == 3);
+        REQUIRE(replay.images[5] == five);
+        REQUIRE(replay.images[6] == six);
+        REQUIRE(replay.changed.size() == 2);
+        REQUIRE(replay.dropped.empty());
+        REQUIRE(replayer.IsDirty(5));
+        REQUIRE(replayer.IsDirty(6));
+    }
+
+    SECTION("A torn tail is cut off")
+    {
+        const long whole = FileSize(JournalPath());
+        {
+            std::ofstream out(JournalPath(), std::ios::binary | std::ios::app);
+            out << "vtj 25 400 12345\n1 5 0 0 1\n";
+        }
+        REQUIRE(FileSize(JournalPath()) > whole);
+
+        CheckJournal replayer;
+        JournalReplay replay;
+        REQUIRE(replayer.Replay(kDir, files.Source(), replay) == 3);
+        REQUIRE(replay.images[5] == five);
+        REQUIRE(FileSize(JournalPath()) == whole);
+
+        // records appended afterwards replay after the old ones
+        REQUIRE(replayer.Open(kDir) == 0);
+        REQUIRE(replayer.Record(7, Image(7, 1)) == 0);
+        replayer.Close();
+        JournalReplay again;
+        REQUIRE(CheckJournal().Replay(kDir, files.Source(), again) == 4);
+        REQUIRE(again.images[7] == Image(7, 1));
+    }
+
+    SECTION("Replaying twice gives the same checks")
+    {
+        JournalReplay first;
+        REQUIRE(CheckJournal().Replay(kDir, files.Source(), first) == 3);
+
+        // as if the replayed checks were written out but the journal kept
+        Files written;
+        for (const auto &[serial, image] : first.images)
+            written.checks[serial] = image;
+        JournalReplay second;
+        CheckJournal().Replay(kDir, written.Source(), second);
+        REQUIRE(second.images[5] == first.images[5]);
+        REQUIRE(second.images[6] == first.images[6]);
+        REQUIRE(CheckJournal::Print(second.images[5]).digest == CheckJournal::Print(five).digest);
+    }
+
+    SECTION("A delta whose base is gone is skipped")
+    {
+        files.checks[5] = Image(5, 9);
+        {
+            std::ifstream in(JournalPath(), std::ios::binary);
+            std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            in.close();
+            // keep only the second record of check 5, a delta on the first
+            const std::size_t second = data.find("vtj ", 1);
+            const std::size_t third = data.find("vtj ", second + 1);
+            std::ofstream out(JournalPath(), std::ios::binary | std::ios::trunc);
+            out << data.substr(second, third - second);
+        }
+        JournalReplay replay;
+        REQUIRE(CheckJournal().Replay(kDir, files.Source(), replay) == 0);
+        REQUIRE(replay.images[5] == Image(5, 9));
+        REQUIRE(replay.changed.empty());
+    }
+
+    SECTION("A dropped check stays dropped")
+    {
+        REQUIRE(journal.Open(kDir) == 0);
+        REQUIRE(journal.Drop(5) == 0);
+        REQUIRE_FALSE(journal.IsDirty(5));
+        journal.Close();
+
+        JournalReplay replay;
+        REQUIRE(CheckJournal().Replay(kDir, files.Source(), replay) == 4);
+        REQUIRE(replay.dropped.count(5) == 1);
+        REQUIRE(replay.images.count(5) == 0);
+        REQUIRE(replay.changed.count(5) == 0);
+        REQUIRE(replay.images[6] == six);
+    }
+
+    SECTION("A checkpoint folds the journal into the check files")
+    {
+        REQUIRE(journal.Open(kDir) == 0);
+        OutputDataFile body;
+        REQUIRE(body.OpenMemory() == 0);
+        body.Write(77, 1);
+        std::vector<JournalFile> written;
+        written.push_back({kDir + "/check_5", 25, std::string(body.Contents())});
+        REQUIRE(journal.Checkpoint(std::move(written), true) == 0);
+
+        REQUIRE_FALSE(journal.Checkpointing());
+        REQUIRE_FALSE(journal.IsDirty(5));
+        REQUIRE(journal.Size() == 0);
+        REQUIRE(FileSize(JournalPath()) == 0);
+        REQUIRE(FileSize(JournalPath() + ".old") == -1);
+
+        InputDataFile df;
+        int version = 0;
+        int value = 0;
+        REQUIRE(df.Open(kDir + "/check_5", version) == 0);
+        df.Read(value);
+        REQUIRE(version == 25);
+        REQUIRE(value == 77);
+
+        // new records go to the fresh journal, on top of the checkpoint
+        files.checks[5] = five;
+        five.subs[0].payments.push_back(Part("4 100\n"));
+        REQUIRE(journal.Record(5, five) == 0);
+        journal.Close();
+        JournalReplay replay;
+        REQUIRE(CheckJournal().Replay(kDir, files.Source(), replay) == 1);
+        REQUIRE(replay.images[5] == five);
+    }
+}
+
+TEST_CASE("A checkpoint writes checks as they were journaled", "[check_journal]")
+{
+    ResetDir();
+    CheckJournal journal;
+    REQUIRE(journal.Open(kDir) == 0);
+
+    const JournalImage saved = Image(5, 1);
+    REQUIRE(journal.Record(5, saved) == 0);
+    REQUIRE(journal.Journaled(5) != nullptr);
+    REQUIRE(*journal.Journaled(5) == saved);
+    REQUIRE(journal.Journaled(6) == nullptr);
+
+    // an edit the check holds but hasn't saved must not reach check_5
+    JournalImage edited = saved;
+    edited.subs[0].orders.push_back(Part("\"Shake\" 400\n"));
+    Files files;
+    files.checks[5] = *journal.Journaled(5);
+    REQUIRE(journal.Checkpoint({{kDir + "/check_5", 25, std::string()}}, true) == 0);
+    REQUIRE(journal.Journaled(5) == nullptr);
+
+    // saved later, on top of what the checkpoint wrote
+    edited.subs[0].payments.push_back(Part("4 400\n"));
+    REQUIRE(journal.Record(5, edited) == 0);
+    journal.Close();
+
+    JournalReplay replay;
+    REQUIRE(CheckJournal().Replay(kDir, files.Source(), replay) == 1);
+    REQUIRE(replay.images[5] == edited);
+    REQUIRE(replay.changed.count(5) == 1);
+}
@@ -0,0 +1,581 @@
+/*
+ * test_data_file.cc - Unit tests for data_file.hh
+ * Tests text/binary round trips and schema-free conversion
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "src/core/data_file.hh"
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// A fresh mkdtemp() directory for one test case, removed with everything
+// in it, so parallel runs never share files.
+class TempDir
+{
+    std::string dir;
+
+public:
+    TempDir()
+    {
+        std::string pattern = "/tmp/vt_test_data_file_XXXXXX";
+        if (mkdtemp(pattern.data()) != nullptr)
+            dir = pattern;
+        REQUIRE_FALSE(dir.empty());
+    }
+    ~TempDir()
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(dir, ec);
+    }
+    TempDir(const TempDir &) = delete;
+    TempDir &operator=(const TempDir &) = delete;
+
+    [[nodiscard]] std::string Path(const char* name) const { return dir + "/" + name; }
+
+    // counts the hidden ".name.tmpN" files left behind by saves
+    [[nodiscard]] int CountTempFiles() const
+    {
+        int count = 0;
+        DIR* listing = opendir(dir.c_str());
+        if (listing == nullptr)
+            return 0;
+        while (const dirent* entry = readdir(listing))
+        {
+            if (entry->d_name[0] == '.' && std::strcmp(entry->d_name, ".") != 0 &&
+                std::strcmp(entry->d_name, "..") != 0)
+                ++count;
+        }
+        closedir(listing);
+        return count;
+    }
+};
+
+void WriteSampleFields(OutputDataFile &df)
+{
+    for (int i = -3; i < 2000; ++i)
+    {
+        df.Write(i);
+        df.Write(static_cast<Flt>(i) / 4);
+    }
+    Str name;
+    name.Set("Table 12");
+    df.Write(name, 1);
+    df.Write("");
+    df.Write(static_cast<uint64_t>(~0ULL), 1);
+}
+
+void WriteSample(const std::string &path, DataFileFormat format, int compress)
+{
+    OutputDataFile df;
+    REQUIRE(df.Open(path, 42, compress, format) == 0);
+    WriteSampleFields(df);
+    df.Close();
+}
+
+void CheckSample(const std::string &path)
+{
+    InputDataFile df;
+    int version = 0;
+    REQUIRE(df.Open(path, version) == 0);
+    REQUIRE(version == 42);
+    for (int i = -3; i < 2000; ++i)
+    {
+        int ival = 0;
+        Flt fval = 0;
+        df.Read(ival);
+        df.Read(fval);
+        REQUIRE(ival == i);
+        REQUIRE(fval == static_cast<Flt>(i) / 4);
+    }
+    Str name;
+    df.Read(name);
+    REQUIRE(std::strcmp(name.Value(), "Table 12") == 0);
+    df.Read(name);
+    REQUIRE(name.empty());
+    uint64_t big = 0;
+    df.Read(big);
+    REQUIRE(big == ~0ULL);
+    REQUIRE_FALSE(df.end_of_file);
+    int past_end = 0;
+    df.Read(past_end);
+    REQUIRE(df.end_of_file);
+}
+
+int ReadFirst(const std::string &path)
+{
+    InputDataFile df;
+    int version = 0;
+    int val = -1;
+    if (df.Open(path, version) == 0)
+        df.Read(val);
+    return val;
+}
+
+void WriteFirst(const std::string &path, int val)
+{
+    OutputDataFile df;
+    REQUIRE(df.Open(path, 1) == 0);
+    df.Write(val, 1);
+    REQUIRE(df.Close() == 0);
+}
+
+} // namespace
+
+TEST_CASE("Data files round trip in every format", "[data_file]") {
+    const TempDir dir;
+    const std::string path = dir.Path("roundtrip");
+
+    SECTION("Text") {
+        WriteSample(path, DataFileFormat::Text, 0);
+        CheckSample(path);
+    }
+
+    SECTION("Compressed text") {
+        WriteSample(path, DataFileFormat::Text, 1);
+        CheckSample(path);
+    }
+
+    SECTION("Binary") {
+        WriteSample(path, DataFileFormat::Binary, 0);
+        CheckSample(path);
+    }
+
+    SECTION("Compressed binary") {
+        WriteSample(path, DataFileFormat::Binary, 1);
+        CheckSample(path);
+    }
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Text files convert to binary field by field", "[data_file]") {
+    const TempDir dir;
+    const std::string text_path = dir.Path("text");
+    const std::string bin_path = dir.Path("binary");
+    WriteSample(text_path, DataFileFormat::Text, 0);
+
+    InputDataFile in;
+    int version = 0;
+    REQUIRE(in.Open(text_path, version) == 0);
+    OutputDataFile out;
+    REQUIRE(out.Open(bin_path, version, 1, DataFileFormat::Binary) == 0);
+    DataFileField field;
+    while (in.ReadField(field) == 0)
+        REQUIRE(out.WriteField(field) == 0);
+    in.Close();
+    out.Close();
+
+    CheckSample(bin_path);
+
+    std::remove(text_path.c_str());
+    std::remove(bin_path.c_str());
+}
+
+TEST_CASE("Binary files peek at line breaks like text files", "[data_file]") {
+    const TempDir dir;
+    const std::string path = dir.Path("peek");
+    for (DataFileFormat format : {DataFileFormat::Text, DataFileFormat::Binary})
+    {
+        OutputDataFile out;
+        REQUIRE(out.Open(path, 1, 0, format) == 0);
+        for (int i = 0; i < 5; ++i)
+            out.Write(i, (i == 4) ? 1 : 0);
+        out.Write(7, 1);
+        out.Close();
+
+        InputDataFile in;
+        int version = 0;
+        REQUIRE(in.Open(path, version) == 0);
+        REQUIRE(in.IsBinary() == (format == DataFileFormat::Binary));
+        REQUIRE(in.PeekTokens() == 4);
+        int first = -1;
+        in.Read(first);
+        REQUIRE(first == 0);
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Text tokens survive buffer refills and peeks", "[data_file]") {
+    const TempDir dir;
+    const std::string path = dir.Path("refill");
+    const std::string long_text(DataFileBlockSize + 100, 'x');
+    for (int compress : {0, 1})
+    {
+        OutputDataFile out;
+        REQUIRE(out.Open(path, 3, compress, DataFileFormat::Text) == 0);
+        for (int i = 0; i < 5000; ++i)
+            out.Write(i * 37, (i % 7 == 6) ? 1 : 0);
+        out.Write(long_text.c_str(), 1);
+        out.Write(-1, 1);
+        out.Close();
+
+        InputDataFile in;
+        int version = 0;
+        REQUIRE(in.Open(path, version) == 0);
+        for (int i = 0; i < 5000; ++i)
+        {
+            if (i == 4000)
+            {
+                REQUIRE(in.PeekTokens() == 3);
+                REQUIRE(std::string(in.ShowTokens()) == "kIg kJF kJq kKP");
+            }
+            int val = 0;
+            in.Read(val);
+            REQUIRE(val == i * 37);
+        }
+        // a buffer too short takes what fits and leaves the rest
+        std::array<char, 101> head{};
+        REQUIRE(in.GetToken(head.data(), static_cast<int>(head.size())) == 1);
+        REQUIRE(std::string(head.data()) == long_text.substr(0, 100));
+        std::string token(long_text.size() + 1, '\0');
+        REQUIRE(in.GetToken(token.data(), static_cast<int>(token.size())) == 0);
+        REQUIRE(token.c_str() == long_text.substr(100));
+        int last = 0;
+        in.Read(last);
+        REQUIRE(last == -1);
+        REQUIRE_FALSE(in.end_of_file);
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Strings too long for a Str leave the rest for the next read", "[data_file]") {
+    const TempDir dir;
+    const std::string path = dir.Path("long_str");
+    const std::string long_text(STRLONG + 50, 'y');
+    for (int compress : {0, 1})
+    {
+        OutputDataFile out;
+        REQUIRE(out.Open(path, 3, compress, DataFileFormat::Text) == 0);
+        out.Write("short_one");
+        out.Write(long_text.c_str(), 1);
+        out.Write(-1, 1);
+        out.Close();
+
+        InputDataFile in;
+        int version = 0;
+        REQUIRE(in.Open(path, version) == 0);
+        Str str;
+        REQUIRE(in.Read(str) == 0);
+        REQUIRE(std::strcmp(str.Value(), "short one") == 0);
+        // the same split GetToken() makes with a Str-sized buffer
+        REQUIRE(in.Read(str) == 1);
+        REQUIRE(std::strcmp(str.Value(), "short one") == 0);
+        REQUIRE(in.Read(str) == 0);
+        REQUIRE(str.Value() == long_text.substr(STRLONG - 1));
+        int last = 0;
+        in.Read(last);
+        REQUIRE(last == -1);
+        REQUIRE_FALSE(in.end_of_file);
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Pre-1998 encoded values keep their legacy rules", "[data_file]") {
+    const TempDir dir;
+    const std::string path = dir.Path("legacy");
+    std::FILE* fp = std::fopen(path.c_str(), "w");
+    REQUIRE(fp != nullptr);
+    std::fputs("version_3\nb c  d", fp);
+    std::fclose(fp);
+
+    InputDataFile in;
+    int version = 0;
+    REQUIRE(in.Open(path, version) == 0);
+    REQUIRE(version == 3);
+    REQUIRE(in.IsLegacyEncoding());
+    REQUIRE(in.GetValue() == 1);
+    REQUIRE(in.GetValue() == 2);
+    REQUIRE(in.GetValue() == 0);  // empty token between two blanks
+    REQUIRE_FALSE(in.end_of_file);
+    REQUIRE(in.GetValue() == 0);  // cut short by end of file
+    REQUIRE(in.end_of_file);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Saves replace data files atomically", "[data_file]") {
+    const TempDir dir;
+    const std::string path = dir.Path("atomic");
+    const DataFileSync saved = GetDataFileSync();
+
+    for (DataFileSync sync : {DataFileSync::Direct, DataFileSync::None, DataFileSync::File})
+    {
+        SetDataFileSync(sync);
+        WriteFirst(path, 11);
+        WriteFirst(path, 12);
+        REQUIRE(ReadFirst(path) == 12);
+        REQUIRE(dir.CountTempFiles() == 0);
+    }
+
+    SECTION("Group commit holds renames until the batch is synced") {
+        SetDataFileSync(DataFileSync::Group);
+        WriteFirst(path, 21);
+        WriteFirst(path, 22);
+        REQUIRE(DataFileGroupPending() == 2);
+        REQUIRE(dir.CountTempFiles() == 2);
+        REQUIRE(DataFileGroupCommit() == 0);
+        REQUIRE(DataFileGroupPending() == 0);
+        REQUIRE(dir.CountTempFiles() == 0);
+        REQUIRE(ReadFirst(path) == 22);
+
+        // reading commits first, so readers never see a stale file
+        WriteFirst(path, 23);
+        REQUIRE(ReadFirst(path) == 23);
+        REQUIRE(DataFileGroupPending() == 0);
+    }
+
+    SECTION("Reading commits only the file being read") {
+        SetDataFileSync(DataFileSync::Group);
+        const std::string other = dir.Path("atomic_other");
+        WriteFirst(path, 25);
+        WriteFirst(other, 26);
+        REQUIRE(ReadFirst(path) == 25);
+        REQUIRE(DataFileGroupPending() == 1);
+        REQUIRE(DataFileGroupCommit() == 0);
+        REQUIRE(ReadFirst(other) == 26);
+        std::remove(other.c_str());
+    }
+
+    SECTION("A file deleted before the group commit stays deleted") {
+        SetDataFileSync(DataFileSync::Group);
+        WriteFirst(path, 24);
+        REQUIRE(DataFileForget(path) == 1);
+        REQUIRE(std::remove(path.c_str()) == 0);
+        REQUIRE(dir.CountTempFiles() == 0);
+        REQUIRE(DataFileGroupCommit() == 0);
+        REQUIRE(access(path.c_str(), F_OK) != 0);
+        REQUIRE(DataFileForget(path) == 0);
+    }
+
+    SECTION("Running out of descriptors keeps the old file") {
+        SetDataFileSync(DataFileSync::None);
+        // leave room for the temp file but not for its duplicate
+        const int spare = open("/dev/null", O_RDONLY);
+        REQUIRE(spare >= 0);
+        close(spare);
+        rlimit saved_limit{};
+        REQUIRE(getrlimit(RLIMIT_NOFILE, &saved_limit) == 0);
+        rlimit tight = saved_limit;
+        tight.rlim_cur = static_cast<rlim_t>(spare) + 1;
+        REQUIRE(setrlimit(RLIMIT_NOFILE, &tight) == 0);
+        OutputDataFile df;
+        const int opened = df.Open(path, 1);
+        const int closed = df.Close();
+        setrlimit(RLIMIT_NOFILE, &saved_limit);
+        REQUIRE(opened != 0);
+        REQUIRE(closed == 0);
+        REQUIRE(dir.CountTempFiles() == 0);
+        REQUIRE(ReadFirst(path) == 12);
+    }
+
+    SECTION("A failed write keeps the old file") {
+        SetDataFileSync(DataFileSync::None);
+        OutputDataFile df;
+        REQUIRE(df.Open(dir.Path("missing_dir/file"), 1) != 0);
+        REQUIRE(dir.CountTempFiles() == 0);
+        REQUIRE(ReadFirst(path) == 12);
+    }
+
+    SECTION("A replaced file keeps its permissions") {
+        REQUIRE(chmod(path.c_str(), 0640) == 0);
+        for (DataFileSync sync : {DataFileSync::None, DataFileSync::Group})
+        {
+            SetDataFileSync(sync);
+            WriteFirst(path, 31);
+            REQUIRE(DataFileGroupCommit() == 0);
+            struct stat info{};
+            REQUIRE(stat(path.c_str(), &info) == 0);
+            REQUIRE((info.st_mode & 07777) == 0640);
+            REQUIRE(ReadFirst(path) == 31);
+        }
+    }
+
+    SetDataFileSync(saved);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Data file formats parse from config names", "[data_file]") {
+    DataFileFormat format = DataFileFormat::Text;
+    REQUIRE(ParseDataFileFormat("binary", format));
+    REQUIRE(format == DataFileFormat::Binary);
+    REQUIRE(ParseDataFileFormat("text", format));
+    REQUIRE(format == DataFileFormat::Text);
+    REQUIRE_FALSE(ParseDataFileFormat("xml", format));
+
+    SetDataFileFormat(DataFileKind::Check, DataFileFormat::Binary);
+    REQUIRE(DataFileFormatFor(DataFileKind::Check) == DataFileFormat::Binary);
+    REQUIRE(DataFileFormatFor(DataFileKind::Drawer) == DataFileFormat::Text);
+    REQUIRE(DataFileFormatFor(DataFileKind::Archive) == DataFileFormat::Binary);
+    SetDataFileFormat(DataFileKind::Check, DataFileFormat::Text);
+
+    DataFileSync sync = DataFileSync::Direct;
+    REQUIRE(ParseDataFileSync("group", sync));
+    REQUIRE(sync == DataFileSync::Group);
+    REQUIRE(ParseDataFileSync("direct", sync));
+    REQUIRE(sync == DataFileSync::Direct);
+    REQUIRE_FALSE(ParseDataFileSync("always", sync));
+}
+
+TEST_CASE("Memory data files round trip without touching disk", "[data_file]") {
+    OutputDataFile out;
+    REQUIRE(out.OpenMemory() == 0);
+    out.Write(5);
+    const std::size_t mark = out.Contents().size();
+    out.Write(-6, 1);
+    out.Write("two words", 1);
+    const std::string slice(out.Contents().substr(mark));
+
+    OutputDataFile copy;
+    REQUIRE(copy.OpenMemory() == 0);
+    copy.Write(5);
+    REQUIRE(copy.WriteRaw(slice) == 0);
+    REQUIRE(copy.Contents() == out.Contents());
+
+    InputDataFile in;
+    REQUIRE(in.OpenMemory(copy.Contents()) == 0);
+    int first = 0;
+    int second = 0;
+    Str words;
+    REQUIRE(in.PeekTokens() == 1);
+    in.Read(first);
+    in.Read(second);
+    in.Read(words);
+    REQUIRE(first == 5);
+    REQUIRE(second == -6);
+    REQUIRE(std::strcmp(words.Value(), "two words") == 0);
+    REQUIRE_FALSE(in.end_of_file);
+    in.Read(first);
+    REQUIRE(in.end_of_file);
+}
+
+TEST_CASE("Queued binary saves are compressed like direct ones", "[data_file]") {
+    const TempDir dir;
+    const std::string direct = dir.Path("packed_direct");
+    const std::string queued = dir.Path("packed_queued");
+    WriteSample(direct, DataFileFormat::Binary, 1);
+
+    OutputDataFile body;
+    REQUIRE(body.OpenMemory(DataFileFormat::Binary) == 0);
+    WriteSampleFields(body);
+    REQUIRE(QueueDataFile(queued, 42, 1, body) == 0);
+    REQUIRE(DataFileFlushQueue() == 0);
+
+    CheckSample(queued);
+    struct stat direct_st{};
+    struct stat queued_st{};
+    REQUIRE(::stat(direct.c_str(), &direct_st) == 0);
+    REQUIRE(::stat(queued.c_str(), &queued_st) == 0);
+    REQUIRE(queued_st.st_size == direct_st.st_size);
+    std::remove(direct.c_str());
+    std::remove(queued.c_str());
+}
+
+TEST_CASE("Queued saves are written behind the caller", "[data_file]") {
+    const TempDir dir;
+    const std::string path = dir.Path("queued");
+    const auto queue_first = [&path](int val) {
+        OutputDataFile body;
+        REQUIRE(body.OpenMemory() == 0);
+        body.Write(val, 1);
+        REQUIRE(QueueDataFile(path, 1, 1, body) == 0);
+    };
+
+    DataFileHoldQueue();
+    queue_first(31);
+    queue_first(32);  // replaces the queued save
+    REQUIRE(GetDataFileWriterStats().depth == 1);
+    REQUIRE(DataFileFlushQueue() == 0);
+    REQUIRE(GetDataFileWriterStats().depth == 0);
+    REQUIRE(ReadFirst(path) == 32);  // readers wait for the queue anyway
+
+    // a direct save is newer than anything queued before it
+    queue_first(33);
+    WriteFirst(path, 34);
+    REQUIRE(DataFileFlushQueue() == 0);
+    REQUIRE(ReadFirst(path) == 34);
+
+    // a reader writes the save it needs instead of waiting for the queue
+    std::remove(path.c_str());
+    queue_first(35);
+    REQUIRE(ReadFirst(path) == 35);
+
+    // settling lands the queued save on disk without reading it
+    std::remove(path.c_str());
+    queue_first(37);
+    REQUIRE(DataFileSettle(path) == 0);
+    REQUIRE(access(path.c_str(), F_OK) == 0);
+
+    SECTION("A forgotten save is never written") {
+        std::remove(path.c_str());
+        DataFileHoldQueue();
+        queue_first(36);
+        REQUIRE(DataFileForget(path) == 1);
+        REQUIRE(DataFileFlushQueue() == 0);
+        REQUIRE(access(path.c_str(), F_OK) != 0);
+    }
+
+    const DataFileWriterStats stats = GetDataFileWriterStats();
+    REQUIRE(stats.failed == 0);
+    REQUIRE(stats.written >= 1);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Readers seek back to positions they reported", "[data_file]") {
+    const TempDir dir;
+    const std::string path = dir.Path("seek");
+    for (DataFileFormat format : {DataFileFormat::Text, DataFileFormat::Binary})
+    {
+        for (int compress : {0, 1})
+        {
+            WriteSample(path, format, compress);
+
+            InputDataFile in;
+            int version = 0;
+            REQUIRE(in.Open(path, version) == 0);
+            std::vector<uint64_t> marks;
+            for (int i = -3; i < 2000; ++i)
+            {
+                marks.push_back(in.Tell());
+                int ival = 0;
+                Flt fval = 0;
+                in.Read(ival);
+                in.Read(fval);
+            }
+            const uint64_t name_mark = in.Tell();
+
+            for (int i : {1500, 7, 1999, -3})
+            {
+                REQUIRE(in.Seek(marks[static_cast<std::size_t>(i + 3)]) == 0);
+                int ival = 0;
+                Flt fval = 0;
+                in.Read(ival);
+                in.Read(fval);
+                REQUIRE(ival == i);
+                REQUIRE(fval == static_cast<Flt>(i) / 4);
+            }
+            REQUIRE(in.Seek(name_mark) == 0);
+            Str name;
+            in.Read(name);
+            REQUIRE(std::strcmp(name.Value(), "Table 12") == 0);
+
+            // a fresh reader goes straight to the block a mark names
+            InputDataFile again;
+            REQUIRE(again.Open(path, version) == 0);
+            REQUIRE(again.Seek(marks[1800]) == 0);
+            int ival = 0;
+            again.Read(ival);
+            REQUIRE(ival == 1797);
+        }
+    }
+}
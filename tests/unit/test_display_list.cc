@@ -0,0 +1,269 @@
+/*
+ * test_display_list.cc - Unit tests for display_list.hh
+ * Tests finding the changed area of a page between redraws, and going
+ * back to pages the terminal kept copies of
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "display_list.hh"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Button
+{
+    RegionInfo area;
+    std::string label;
+};
+
+// records a page the way Terminal::RenderPage() does:  a header ending
+// in the title time, then one item per button
+std::vector<Uchar> Record(DisplayList &list, const void *page,
+                          const std::vector<Button> &buttons, const std::string &time)
+{
+    std::vector<Uchar> out = {4, 0, 12, 3};
+    list.Start(page, RegionInfo(0, 0, 1024, 768));
+    list.Title(static_cast<int>(out.size()));
+    out.insert(out.end(), time.begin(), time.end());
+    for (const Button &button : buttons)
+    {
+        list.Begin(DISPLAY_ZONE, &button, button.area, static_cast<int>(out.size()));
+        out.push_back(7);
+        out.insert(out.end(), button.label.begin(), button.label.end());
+        list.End(static_cast<int>(out.size()));
+    }
+    list.Finish(out);
+    return out;
+}
+
+} // namespace
+
+TEST_CASE("DisplayList sends the first page whole", "[display_list]")
+{
+    DisplayList list;
+    const int page = 0;
+    std::vector<Button> buttons = {{RegionInfo(10, 40, 100, 50), "Fries"}};
+    Record(list, &page, buttons, "12:30");
+
+    RegionInfo changed;
+    int title_changed = 0;
+    REQUIRE(list.Compare(changed, title_changed) == 1);
+    list.Commit();
+    Record(list, &page, buttons, "12:30");
+    REQUIRE(list.Compare(changed, title_changed) == 0);
+    REQUIRE_FALSE(changed.IsSet());
+    REQUIRE(title_changed == 0);
+}
+
+TEST_CASE("DisplayList finds the zones that changed", "[display_list]")
+{
+    DisplayList list;
+    const int page = 0;
+    std::vector<Button> buttons = {
+        {RegionInfo(10, 40, 100, 50), "Fries"},
+        {RegionInfo(120, 40, 100, 50), "Soda"},
+        {RegionInfo(10, 100, 210, 50), "Total $4.50"},
+    };
+    Record(list, &page, buttons, "12:30");
+    list.Commit();
+
+    RegionInfo changed;
+    int title_changed = 0;
+
+    SECTION("one zone")
+    {
+        buttons[2].label = "Total $6.25";
+        Record(list, &page, buttons, "12:30");
+        REQUIRE(list.Compare(changed, title_changed) == 0);
+        REQUIRE(changed.x == 10);
+        REQUIRE(changed.y == 100);
+        REQUIRE(changed.w == 210);
+        REQUIRE(changed.h == 50);
+        REQUIRE(title_changed == 0);
+        REQUIRE(list.Items().size() == 3);
+        REQUIRE(list.Largest() == 12);
+    }
+
+    SECTION("two zones make one area around both")
+    {
+        buttons[0].label = "Onion Rings";
+        buttons[1].label = "Coffee";
+        Record(list, &page, buttons, "12:30");
+        REQUIRE(list.Compare(changed, title_changed) == 0);
+        REQUIRE(changed.x == 10);
+        REQUIRE(changed.y == 40);
+        REQUIRE(changed.w == 210);
+        REQUIRE(changed.h == 50);
+    }
+
+    SECTION("a zone that moved covers both places")
+    {
+        buttons[1].area = RegionInfo(300, 40, 100, 50);
+        Record(list, &page, buttons, "12:30");
+        REQUIRE(list.Compare(changed, title_changed) == 0);
+        REQUIRE(changed.x == 120);
+        REQUIRE(changed.w == 280);
+    }
+
+    SECTION("only the title time")
+    {
+        const std::vector<Uchar> out = Record(list, &page, buttons, "12:31");
+        REQUIRE(list.Compare(changed, title_changed) == 0);
+        REQUIRE_FALSE(changed.IsSet());
+        REQUIRE(title_changed == 1);
+        const std::span<const Uchar> title = list.TitleBytes(out);
+        REQUIRE(std::string(title.begin(), title.end()) == "12:31");
+    }
+
+    SECTION("drawing since the last redraw")
+    {
+        list.Clip(130, 50, 10, 10);
+        list.Updated();
+        Record(list, &page, buttons, "12:30");
+        REQUIRE(list.Compare(changed, title_changed) == 0);
+        REQUIRE(changed.x == 120);
+        REQUIRE(changed.w == 100);
+    }
+
+    SECTION("an unclipped update means the whole page")
+    {
+        list.Updated();
+        Record(list, &page, buttons, "12:30");
+        REQUIRE(list.Compare(changed, title_changed) == 1);
+    }
+
+    SECTION("another page")
+    {
+        const int other = 0;
+        Record(list, &other, buttons, "12:30");
+        REQUIRE(list.Compare(changed, title_changed) == 1);
+    }
+
+    SECTION("a zone more or less")
+    {
+        buttons.pop_back();
+        Record(list, &page, buttons, "12:30");
+        REQUIRE(list.Compare(changed, title_changed) == 1);
+    }
+}
+
+TEST_CASE("DisplayList goes back to kept pages", "[display_list]")
+{
+    DisplayList list;
+    const int menu = 0;
+    const int order = 0;
+    std::vector<Button> menu_buttons = {
+        {RegionInfo(10, 40, 100, 50), "Burgers"},
+        {RegionInfo(120, 40, 100, 50), "Drinks"},
+    };
+    std::vector<Button> order_buttons = {{RegionInfo(10, 40, 300, 400), "Check 12"}};
+
+    RegionInfo changed;
+    int title_changed = 0;
+    int menu_hash = 0;
+    Record(list, &menu, menu_buttons, "12:30");
+    list.Commit();
+    const int menu_slot = list.Keep(2, menu_hash);
+    REQUIRE(menu_slot == 0);
+
+    int hash = 0;
+    Record(list, &order, order_buttons, "12:30");
+    REQUIRE(list.Compare(changed, title_changed) == 1);
+    REQUIRE(list.Recall(hash) == -1);
+    list.Commit();
+    REQUIRE(list.Keep(2, hash) == 1);
+    REQUIRE(hash != menu_hash);
+
+    SECTION("as it was")
+    {
+        Record(list, &menu, menu_buttons, "12:30");
+        REQUIRE(list.Compare(changed, title_changed) == 1);
+        REQUIRE(list.Recall(hash) == menu_slot);
+        REQUIRE(hash == menu_hash);
+        REQUIRE(list.Compare(changed, title_changed) == 0);
+        REQUIRE_FALSE(changed.IsSet());
+        REQUIRE(title_changed == 0);
+    }
+
+    SECTION("with a zone changed since")
+    {
+        menu_buttons[1].label = "Drinks (2)";
+        Record(list, &menu, menu_buttons, "12:32");
+        REQUIRE(list.Recall(hash) == menu_slot);
+        REQUIRE(list.Compare(changed, title_changed) == 0);
+        REQUIRE(changed.x == 120);
+        REQUIRE(changed.w == 100);
+        REQUIRE(title_changed == 1);
+
+        // kept again as it is now, in the same slot
+        list.Commit();
+        REQUIRE(list.Keep(2, hash) == menu_slot);
+        REQUIRE(hash != menu_hash);
+    }
+
+    SECTION("with other zones")
+    {
+        menu_buttons.pop_back();
+        Record(list, &menu, menu_buttons, "12:30");
+        REQUIRE(list.Recall(hash) == -1);
+    }
+
+    SECTION("least recently used goes first")
+    {
+        const int other = 0;
+        Record(list, &other, order_buttons, "12:30");
+        list.Commit();
+        REQUIRE(list.Keep(2, hash) == menu_slot);
+        Record(list, &menu, menu_buttons, "12:30");
+        REQUIRE(list.Recall(hash) == -1);
+    }
+
+    SECTION("forgotten")
+    {
+        list.Forget();
+        Record(list, &menu, menu_buttons, "12:30");
+        REQUIRE(list.Recall(hash) == -1);
+    }
+}
+
+TEST_CASE("DisplayList keeps stray commands as a page-wide gap", "[display_list]")
+{
+    DisplayList list;
+    const int page = 0;
+    const Button button{RegionInfo(10, 40, 100, 50), "Fries"};
+
+    std::vector<Uchar> out = {4, 0};
+    list.Start(&page, RegionInfo(0, 0, 800, 600));
+    list.Begin(DISPLAY_ZONE, &button, button.area, 2);
+    out.push_back(7);
+    list.End(3);
+    out.push_back(26);  // something between zones
+    list.Begin(DISPLAY_CURSOR, &button, button.area, 4);
+    out.push_back(21);
+    list.End(5);
+    list.Finish(out);
+
+    REQUIRE(list.HeaderSize() == 2);
+    REQUIRE(list.Items().size() == 3);
+    REQUIRE(list.Items()[1].kind == DISPLAY_GAP);
+    REQUIRE(list.Items()[1].area.w == 800);
+    REQUIRE(list.Items()[1].len == 1);
+}
+
+TEST_CASE("DisplayList counts bytes by update type", "[display_list]")
+{
+    DisplayList list;
+    list.Count(1, 3000, 3000, 1);
+    list.Count(1, 3000, 120, 0);
+    list.Count(1, 3000, 0, 2);
+    list.Count(1, 3000, 40, 3);
+    const DisplayList::Stats &count = list.GetStats().at(1);
+    REQUIRE(count.redraws == 4);
+    REQUIRE(count.changes == 1);
+    REQUIRE(count.unchanged == 1);
+    REQUIRE(count.recalled == 1);
+    REQUIRE(count.whole == 12000);
+    REQUIRE(count.sent == 3160);
+}
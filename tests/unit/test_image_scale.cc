@@ -0,0 +1,255 @@
+/*
+ * test_image_scale.cc - Unit tests for image_scale.hh
+ * Tests box and bilinear scaling of RGBA images against a plain area
+ * average, alpha weighting, the 1-bit masks made from alpha and packing
+ * into X server pixel layouts
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "image_scale.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+void Fill(RgbaImage &image, int w, int h, Uchar r, Uchar g, Uchar b, Uchar a)
+{
+    image.Resize(w, h);
+    for (size_t idx = 0; idx < image.pixels.size(); idx += 4)
+    {
+        image.pixels[idx] = r;
+        image.pixels[idx + 1] = g;
+        image.pixels[idx + 2] = b;
+        image.pixels[idx + 3] = a;
+    }
+}
+
+// a photo-like image with every channel varying
+void Pattern(RgbaImage &image, int w, int h)
+{
+    image.Resize(w, h);
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            Uchar *px = image.Row(y) + x * 4;
+            px[0] = static_cast<Uchar>((x * 7 + y * 3) & 255);
+            px[1] = static_cast<Uchar>((x * y) & 255);
+            px[2] = static_cast<Uchar>((255 - x * 5) & 255);
+            px[3] = 255;
+        }
+    }
+}
+
+// the largest channel difference between two images of the same size
+int Difference(const RgbaImage &one, const RgbaImage &two)
+{
+    int most = 0;
+    for (size_t idx = 0; idx < one.pixels.size(); ++idx)
+        most = std::max(most, std::abs(static_cast<int>(one.pixels[idx]) - static_cast<int>(two.pixels[idx])));
+    return most;
+}
+
+} // namespace
+
+TEST_CASE("ScaleRgba box filter averages the area covered", "[image_scale]")
+{
+    RgbaImage src;
+    RgbaImage dst;
+
+    SECTION("same size comes back the same")
+    {
+        Pattern(src, 37, 23);
+        REQUIRE(ScaleRgba(src, dst, 37, 23, SCALE_BOX) == 0);
+        REQUIRE(dst.width == 37);
+        REQUIRE(dst.height == 23);
+        REQUIRE(Difference(src, dst) == 0);
+    }
+
+    SECTION("halving averages each 2x2 block")
+    {
+        Pattern(src, 64, 48);
+        REQUIRE(ScaleRgba(src, dst, 32, 24, SCALE_BOX) == 0);
+        RgbaImage expected;
+        expected.Resize(32, 24);
+        for (int y = 0; y < 24; ++y)
+        {
+            for (int x = 0; x < 32; ++x)
+            {
+                for (int ch = 0; ch < 4; ++ch)
+                {
+                    const int sum = src.Row(y * 2)[x * 8 + ch] + src.Row(y * 2)[x * 8 + 4 + ch] +
+                                    src.Row(y * 2 + 1)[x * 8 + ch] + src.Row(y * 2 + 1)[x * 8 + 4 + ch];
+                    expected.Row(y)[x * 4 + ch] = static_cast<Uchar>((sum + 2) / 4);
+                }
+            }
+        }
+        REQUIRE(Difference(expected, dst) <= 1);
+    }
+
+    SECTION("a flat colour stays flat at any size")
+    {
+        Fill(src, 1920, 1080, 200, 30, 90, 255);
+        for (auto [w, h] : {std::pair{240, 160}, std::pair{97, 31}, std::pair{1, 1}})
+        {
+            REQUIRE(ScaleRgba(src, dst, w, h) == 0);
+            RgbaImage expected;
+            Fill(expected, w, h, 200, 30, 90, 255);
+            REQUIRE(Difference(expected, dst) <= 1);
+        }
+    }
+
+    SECTION("transparent pixels don't darken the edges")
+    {
+        src.Resize(2, 1);
+        const Uchar pixels[] = {255, 0, 0, 255, 0, 255, 0, 0};
+        std::copy(std::begin(pixels), std::end(pixels), src.pixels.begin());
+        REQUIRE(ScaleRgba(src, dst, 1, 1, SCALE_BOX) == 0);
+        REQUIRE(dst.pixels[0] == 255);
+        REQUIRE(dst.pixels[1] == 0);
+        REQUIRE(dst.pixels[2] == 0);
+        REQUIRE(dst.pixels[3] == 128);
+    }
+
+    SECTION("empty sizes are refused")
+    {
+        Pattern(src, 4, 4);
+        REQUIRE(ScaleRgba(src, dst, 0, 4) == 1);
+        REQUIRE(ScaleRgba(RgbaImage{}, dst, 4, 4) == 1);
+        REQUIRE(dst.Empty());
+    }
+}
+
+TEST_CASE("ScaleRgba bilinear filter blends neighbours", "[image_scale]")
+{
+    RgbaImage src;
+    RgbaImage dst;
+
+    SECTION("enlarging a ramp keeps it a ramp")
+    {
+        src.Resize(4, 1);
+        for (int x = 0; x < 4; ++x)
+        {
+            Uchar *px = src.Row(0) + x * 4;
+            px[0] = px[1] = px[2] = static_cast<Uchar>(x * 80);
+            px[3] = 255;
+        }
+        REQUIRE(ScaleRgba(src, dst, 16, 3, SCALE_BILINEAR) == 0);
+        for (int y = 0; y < 3; ++y)
+        {
+            REQUIRE(dst.Row(y)[0] == 0);
+            REQUIRE(dst.Row(y)[15 * 4] == 240);
+            for (int x = 1; x < 16; ++x)
+                REQUIRE(dst.Row(y)[x * 4] >= dst.Row(y)[(x - 1) * 4]);
+        }
+    }
+
+    SECTION("auto picks box to shrink and bilinear to enlarge")
+    {
+        Pattern(src, 120, 80);
+        RgbaImage box;
+        REQUIRE(ScaleRgba(src, dst, 30, 20) == 0);
+        REQUIRE(ScaleRgba(src, box, 30, 20, SCALE_BOX) == 0);
+        REQUIRE(Difference(box, dst) == 0);
+
+        RgbaImage bilinear;
+        REQUIRE(ScaleRgba(src, dst, 300, 200) == 0);
+        REQUIRE(ScaleRgba(src, bilinear, 300, 200, SCALE_BILINEAR) == 0);
+        REQUIRE(Difference(bilinear, dst) == 0);
+    }
+}
+
+TEST_CASE("AlphaMask marks what is opaque enough to draw", "[image_scale]")
+{
+    RgbaImage image;
+    Fill(image, 10, 2, 0, 0, 0, 255);
+    std::vector<Uchar> bits;
+    REQUIRE(AlphaMask(image, bits) == 0);
+    REQUIRE(bits.size() == 4);
+    REQUIRE(bits[0] == 0xFF);
+    REQUIRE(bits[1] == 0x03);
+
+    image.Row(0)[0 * 4 + 3] = 0;
+    image.Row(0)[9 * 4 + 3] = ALPHA_OPAQUE - 1;
+    image.Row(1)[8 * 4 + 3] = ALPHA_OPAQUE;
+    REQUIRE(AlphaMask(image, bits) == 2);
+    REQUIRE(bits[0] == 0xFE);
+    REQUIRE(bits[1] == 0x01);
+    REQUIRE(bits[2] == 0xFF);
+    REQUIRE(bits[3] == 0x03);
+}
+
+TEST_CASE("PackRgbaRow writes the server's pixel layout", "[image_scale]")
+{
+    PixelLayout layout;
+
+    SECTION("only 8-bit channels in 24 or 32 bits are packed")
+    {
+        REQUIRE(NativeLayout(0xFF0000, 0x00FF00, 0x0000FF, 32, false, layout) == 0);
+        REQUIRE(layout.bytes_per_pixel == 4);
+        REQUIRE(layout.red_shift == 16);
+        REQUIRE(layout.green_shift == 8);
+        REQUIRE(layout.blue_shift == 0);
+        REQUIRE(NativeLayout(0xF800, 0x07E0, 0x001F, 16, false, layout) == 1);
+        REQUIRE(NativeLayout(0x3FF00000, 0x000FFC00, 0x000003FF, 32, false, layout) == 1);
+        REQUIRE(NativeLayout(0xFF000000, 0x00FF0000, 0x0000FF00, 24, false, layout) == 1);
+    }
+
+    // 7 pixels, so any 4 or 8 at a time loop has a tail to finish
+    RgbaImage row;
+    row.Resize(7, 1);
+    for (int x = 0; x < 7; ++x)
+    {
+        Uchar *px = row.Row(0) + x * 4;
+        px[0] = static_cast<Uchar>(0x10 + x);
+        px[1] = static_cast<Uchar>(0x40 + x);
+        px[2] = static_cast<Uchar>(0x80 + x);
+        px[3] = (x == 2 || x == 6) ? ALPHA_OPAQUE - 1 : 255;
+    }
+    const auto expected = [&](int x, int ch) -> Uchar {
+        return (x == 2 || x == 6) ? 0 : row.Row(0)[x * 4 + ch];
+    };
+
+    SECTION("B, G, R, 0 for the usual 32-bit visual")
+    {
+        REQUIRE(NativeLayout(0xFF0000, 0x00FF00, 0x0000FF, 32, false, layout) == 0);
+        std::vector<Uchar> out(7 * 4, 0xAA);
+        PackRgbaRow(row.Row(0), out.data(), 7, layout);
+        for (int x = 0; x < 7; ++x)
+        {
+            REQUIRE(out[x * 4] == expected(x, 2));
+            REQUIRE(out[x * 4 + 1] == expected(x, 1));
+            REQUIRE(out[x * 4 + 2] == expected(x, 0));
+            REQUIRE(out[x * 4 + 3] == 0);
+        }
+    }
+
+    SECTION("0, R, G, B for a most significant byte first server")
+    {
+        REQUIRE(NativeLayout(0xFF0000, 0x00FF00, 0x0000FF, 32, true, layout) == 0);
+        std::vector<Uchar> out(7 * 4, 0xAA);
+        PackRgbaRow(row.Row(0), out.data(), 7, layout);
+        for (int x = 0; x < 7; ++x)
+        {
+            REQUIRE(out[x * 4] == 0);
+            REQUIRE(out[x * 4 + 1] == expected(x, 0));
+            REQUIRE(out[x * 4 + 2] == expected(x, 1));
+            REQUIRE(out[x * 4 + 3] == expected(x, 2));
+        }
+    }
+
+    SECTION("R, G, B in three bytes for a BGR 24-bit visual")
+    {
+        REQUIRE(NativeLayout(0x0000FF, 0x00FF00, 0xFF0000, 24, false, layout) == 0);
+        std::vector<Uchar> out(7 * 3, 0xAA);
+        PackRgbaRow(row.Row(0), out.data(), 7, layout);
+        for (int x = 0; x < 7; ++x)
+        {
+            REQUIRE(out[x * 3] == expected(x, 0));
+            REQUIRE(out[x * 3 + 1] == expected(x, 1));
+            REQUIRE(out[x * 3 + 2] == expected(x, 2));
+        }
+    }
+}
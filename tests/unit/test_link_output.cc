@@ -0,0 +1,198 @@
+/*
+ * test_link_output.cc - Unit tests for link_output.hh
+ * Tests non-blocking frame output, watermarks, redraw coalescing and
+ * frames shared between links
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "src/network/link_output.hh"
+
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <array>
+#include <vector>
+
+namespace {
+
+// a socket pair with the writing end non-blocking and small buffers,
+// so a reader that stops reading backs the writer up quickly
+struct Link
+{
+    std::array<int, 2> fds{-1, -1};
+
+    Link()
+    {
+        REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()) == 0);
+        int size = 4096;
+        setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL, 0) | O_NONBLOCK);
+        fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL, 0) | O_NONBLOCK);
+    }
+    ~Link()
+    {
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    // reads everything waiting at the far end
+    std::size_t Drain()
+    {
+        std::size_t total = 0;
+        std::array<char, 4096> buf{};
+        ssize_t got = 0;
+        while ((got = read(fds[1], buf.data(), buf.size())) > 0)
+            total += static_cast<std::size_t>(got);
+        return total;
+    }
+};
+
+std::vector<Uchar> MakeFrame(std::size_t len, Uchar fill)
+{
+    return std::vector<Uchar>(len, fill);
+}
+
+} // namespace
+
+TEST_CASE("LinkOutput writes frames straight through an open socket", "[link_output]")
+{
+    Link link;
+    LinkOutput out;
+    out.SetSocket(link.fds[0]);
+
+    REQUIRE(out.Add(MakeFrame(100, 1)) == 0);
+    REQUIRE(out.Add(MakeFrame(200, 2)) == 0);
+    REQUIRE_FALSE(out.Pending());
+    REQUIRE(link.Drain() == 300);
+    REQUIRE(out.GetStats().sent == 300);
+    REQUIRE(out.GetStats().queued == 0);
+}
+
+TEST_CASE("LinkOutput queues for a stalled reader and catches up", "[link_output]")
+{
+    Link link;
+    LinkOutput out;
+    out.SetSocket(link.fds[0]);
+    out.high_water = 16 * 1024;
+    out.low_water  = 1024;
+
+    // fill past the socket buffers and the high watermark
+    int result = 0;
+    for (int idx = 0; idx < 64; ++idx)
+        result = out.Add(MakeFrame(1024, 3));
+    REQUIRE(result == 1);
+    REQUIRE(out.Pending());
+    REQUIRE(out.Behind());
+    REQUIRE(out.GetStats().stalls == 1);
+
+    std::size_t received = 0;
+    while (out.Flush() == 1)
+        received += link.Drain();
+    received += link.Drain();
+    REQUIRE(received == 64 * 1024);
+    REQUIRE_FALSE(out.Behind());
+    REQUIRE(out.GetStats().peak > out.high_water);
+    REQUIRE(out.GetStats().stall_ms >= 0);
+}
+
+TEST_CASE("LinkOutput drops unsent redraws while behind", "[link_output]")
+{
+    Link link;
+    LinkOutput out;
+    out.SetSocket(link.fds[0]);
+    out.high_water = 8 * 1024;
+    out.low_water  = 1024;
+
+    // a plain frame, then redraw 1, which backs the link up
+    out.Add(MakeFrame(1024, 9), 0);
+    for (int idx = 0; idx < 48; ++idx)
+        out.Add(MakeFrame(1024, 1), 1);
+    REQUIRE(out.Behind());
+    const std::size_t queued = out.GetStats().queued;
+
+    // redraw 2 makes the unsent frames of redraw 1 moot
+    out.Add(MakeFrame(512, 2), 2);
+    out.Add(MakeFrame(512, 2), 2);
+    REQUIRE(out.GetStats().coalesced > 0);
+    REQUIRE(out.GetStats().queued < queued);
+
+    // what arrives:  the plain frame, any of redraw 1 already on its
+    // way, then all of redraw 2
+    std::vector<Uchar> got;
+    std::array<Uchar, 4096> buf{};
+    for (;;)
+    {
+        const int result = out.Flush();
+        ssize_t n = 0;
+        while ((n = read(link.fds[1], buf.data(), buf.size())) > 0)
+            got.insert(got.end(), buf.begin(), buf.begin() + n);
+        if (result == 0)
+            break;
+    }
+    REQUIRE(got.size() >= 2048);
+    REQUIRE(got.front() == 9);
+    REQUIRE(got.size() % 512 == 0);
+    REQUIRE(got[got.size() - 1024] == 2);
+    REQUIRE(got.back() == 2);
+    REQUIRE(got.size() == 1024 + 1024 + (48 - out.GetStats().coalesced) * 1024);
+}
+
+TEST_CASE("LinkOutput gives up past its limit", "[link_output]")
+{
+    Link link;
+    LinkOutput out;
+    out.SetSocket(link.fds[0]);
+    out.limit = 32 * 1024;
+
+    int result = 0;
+    for (int idx = 0; idx < 64 && result >= 0; ++idx)
+        result = out.Add(MakeFrame(1024, 4));
+    REQUIRE(result == -1);
+    REQUIRE(out.Failed());
+    REQUIRE_FALSE(out.Pending());
+    REQUIRE(out.Add(MakeFrame(10, 5)) == -1);
+}
+
+TEST_CASE("LinkOutput shares one frame between links", "[link_output]")
+{
+    Link primary;
+    Link clone;
+    LinkOutput primary_out;
+    LinkOutput clone_out;
+    primary_out.SetSocket(primary.fds[0]);
+    clone_out.SetSocket(clone.fds[0]);
+
+    // the clone's reader has stalled, so it keeps its reference
+    for (int idx = 0; idx < 16; ++idx)
+        clone_out.Add(MakeFrame(1024, 6));
+    REQUIRE(clone_out.Pending());
+
+    const LinkFrame frame = std::make_shared<const std::vector<Uchar>>(MakeFrame(2048, 7));
+    REQUIRE(primary_out.Add(frame) == 0);
+    REQUIRE(clone_out.Add(frame) == 1);
+    REQUIRE(frame.use_count() == 2);
+    REQUIRE(primary.Drain() == 2048);
+
+    while (clone_out.Flush() == 1)
+        clone.Drain();
+    clone.Drain();
+    REQUIRE(frame.use_count() == 1);
+}
+
+TEST_CASE("LinkOutputPoll reports writable sockets", "[link_output]")
+{
+    Link link;
+    LinkOutputPoll poll;
+    REQUIRE(poll.Fd() >= 0);
+
+    int owner = 0;
+    REQUIRE(poll.Watch(link.fds[0], &owner) == 0);
+    std::vector<void *> ready;
+    REQUIRE(poll.Ready(ready) == 1);
+    REQUIRE(ready[0] == &owner);
+
+    REQUIRE(poll.Unwatch(link.fds[0]) == 0);
+    REQUIRE(poll.Ready(ready) == 0);
+}
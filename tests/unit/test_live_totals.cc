@@ -0,0 +1,127 @@
+/*
+ * test_live_totals.cc - Unit tests for live_totals.hh
+ * Tests that shares replace and drop out of the running totals
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "live_totals.hh"
+
+namespace {
+
+// a check settled to drawer 5:  a cash payment, change back, one server
+LiveTotals::Totals CashShare(int amount, int change, int user_id)
+{
+    LiveTotals::Totals share;
+    LiveTotals::DrawerTally &drawer = share.drawers[5];
+    drawer.checks = 1;
+    drawer.tenders[{0, 0}] = {amount - change, 1};
+    if (change)
+        drawer.tenders[{18, 0}] = {change, 1};
+
+    LiveTotals::SalesTally &sales = share.sales;
+    sales.guests = 2;
+    sales.families[2] = {amount - change, 1};
+    sales.tenders[{0, 0}] = {amount, 1};
+    sales.meals[1] = {amount - change, 1};
+    sales.tax[LIVE_TAX_FOOD] = (amount - change) / 10;
+
+    LiveTotals::ItemTally &item = share.items[user_id][{"Burger", amount - change, 2}];
+    item.counted = {1, 1};
+    item.modifiers[{"Cheese", 50}].priced = {1, 1};
+
+    LiveTotals::ServerTally &server = share.servers[user_id];
+    server.opened = 1;
+    server.closed = 1;
+    server.sitdown_sales = amount - change;
+    share.everyone = server;
+    share.first_open = share.last_open = 1000 + user_id;
+    share.last_close = 2000 + user_id;
+    return share;
+}
+
+} // namespace
+
+TEST_CASE("LiveTotals adds, replaces and drops check shares", "[live_totals]")
+{
+    LiveTotals live;
+    live.Update(101, CashShare(1000, 0, 7));
+    live.Update(102, CashShare(2500, 500, 8));
+
+    const LiveTotals::DrawerTally *drawer = live.FindDrawer(5);
+    REQUIRE(drawer != nullptr);
+    REQUIRE(drawer->checks == 2);
+    REQUIRE(drawer->tenders.at({0, 0}).amount == 3000);
+    REQUIRE(drawer->tenders.at({0, 0}).count == 2);
+    REQUIRE(drawer->tenders.at({18, 0}).amount == 500);
+    REQUIRE(live.Current().everyone.sitdown_sales == 3000);
+    REQUIRE(live.FindServer(8)->sitdown_sales == 2000);
+    REQUIRE(live.Current().sales.guests == 4);
+    REQUIRE(live.Current().sales.families.at(2).amount == 3000);
+    REQUIRE(live.Current().sales.tenders.at({0, 0}).amount == 3500);
+    REQUIRE(live.Current().sales.meals.at(1).count == 2);
+    REQUIRE(live.Current().sales.tax[LIVE_TAX_FOOD] == 300);
+    REQUIRE(live.FindItems(8)->count({"Burger", 2000, 2}) == 1);
+
+    SECTION("an update replaces the check's old share")
+    {
+        live.Update(102, CashShare(2000, 0, 8));
+        drawer = live.FindDrawer(5);
+        REQUIRE(drawer->checks == 2);
+        REQUIRE(drawer->tenders.at({0, 0}).amount == 3000);
+        REQUIRE(drawer->tenders.count({18, 0}) == 0);
+        REQUIRE(live.Current().sales.tenders.at({0, 0}).amount == 3000);
+        REQUIRE(live.FindItems(8)->size() == 1);
+        REQUIRE(live.FindItems(8)->at({"Burger", 2000, 2}).modifiers.at({"Cheese", 50}).priced.amount == 1);
+        REQUIRE(live.CheckCount() == 2);
+    }
+
+    SECTION("a check moved to another server")
+    {
+        live.Update(102, CashShare(2500, 500, 7));
+        REQUIRE(live.FindServer(8) == nullptr);
+        REQUIRE(live.FindServer(7)->closed == 2);
+        REQUIRE(live.Current().everyone.closed == 2);
+    }
+
+    SECTION("dropping every check empties the totals")
+    {
+        live.Drop(101);
+        live.Drop(102);
+        live.Drop(103);
+        REQUIRE(live.CheckCount() == 0);
+        REQUIRE(live.FindDrawer(5) == nullptr);
+        REQUIRE(live.Current().drawers.empty());
+        REQUIRE(live.Current().servers.empty());
+        REQUIRE(live.Current().sales.families.empty());
+        REQUIRE(live.Current().sales.tenders.empty());
+        REQUIRE(live.Current().sales.tax[LIVE_TAX_FOOD] == 0);
+        REQUIRE(live.Current().items.empty());
+        REQUIRE(live.Current().everyone.opened == 0);
+    }
+}
+
+TEST_CASE("LiveTotals knows the time span it covers", "[live_totals]")
+{
+    LiveTotals live;
+    REQUIRE(live.Covers(0, 0));
+
+    live.Update(101, CashShare(1000, 0, 7));   // open 1007, closed 2007
+    live.Update(102, CashShare(1000, 0, 9));   // open 1009, closed 2009
+    REQUIRE(live.Covers(1000, 3000));
+    REQUIRE(live.Covers(1007, 2010));
+    REQUIRE_FALSE(live.Covers(1008, 3000));
+    REQUIRE_FALSE(live.Covers(1000, 2009));
+    REQUIRE_FALSE(live.Covers(0, 3000));
+
+    // a subcheck settled after the check closed still bounds the span
+    LiveTotals::Totals late = CashShare(1000, 0, 9);
+    late.last_settle = 2500;
+    live.Update(102, late);
+    REQUIRE(live.Covers(1007, 2501));
+    REQUIRE_FALSE(live.Covers(1007, 2500));
+
+    live.Clear();
+    REQUIRE(live.CheckCount() == 0);
+    REQUIRE(live.sale_credit == -1);
+    REQUIRE(live.Covers(1008, 1009));
+}
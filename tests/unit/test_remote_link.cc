@@ -0,0 +1,422 @@
+/*
+ * test_remote_link.cc - Unit tests for remote_link.hh
+ * Tests the tagged and compact CharQueue encodings, a switch between them,
+ * framed reads from a non-blocking link and deflated frames
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "src/network/remote_link.hh"
+
+#include <array>
+#include <climits>
+#include <string>
+
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+void PutSample(CharQueue &q)
+{
+    q.Put8(200);
+    q.Put16(-2);
+    q.Put16(1024);
+    q.Put32(INT_MAX);
+    q.Put32(-123456);
+    q.PutLLong(-5000000000LL);
+    q.PutString("Cheeseburger", 0);
+    q.PutString("", 0);
+}
+
+void GetSample(CharQueue &q)
+{
+    std::array<char, 64> str{};
+    REQUIRE(q.Get8() == 200);
+    REQUIRE(q.Get16() == -2);
+    REQUIRE(q.Get16() == 1024);
+    REQUIRE(q.Get32() == INT_MAX);
+    REQUIRE(q.Get32() == -123456);
+    REQUIRE(q.GetLLong() == -5000000000LL);
+    REQUIRE(q.GetString(str.data(), str.size()) == 0);
+    REQUIRE(std::string(str.data()) == "Cheeseburger");
+    REQUIRE(q.GetString(str.data(), str.size()) == 0);
+    REQUIRE(str[0] == '\0');
+}
+
+// what Terminal::Draw() sends for a page of buttons:  the page header,
+// then a frame and a centered label per button
+void PutPageRedraw(CharQueue &q)
+{
+    static const std::array<const char*, 8> labels = {
+        "Cheeseburger", "Fries", "Soda", "Coffee",
+        "Caesar Salad", "Soup of the Day", "Ice Cream", "Done"
+    };
+    q.Put8(TERM_BLANKPAGE);
+    q.Put8(0);
+    q.Put8(12);
+    q.Put8(3);
+    q.Put8(5);
+    q.PutString("Dinner Menu", 0);
+    q.PutString("12:30 PM", 0);
+    for (int row = 0; row < 6; ++row)
+    {
+        for (int col = 0; col < 8; ++col)
+        {
+            const int x = 12 + col * 126;
+            const int y = 96 + row * 110;
+            q.Put8(TERM_ZONE);
+            q.Put16(x);
+            q.Put16(y);
+            q.Put16(120);
+            q.Put16(104);
+            q.Put8(2);
+            q.Put8(4);
+            q.Put8(1);
+            q.Put8(TERM_ZONETEXTC);
+            q.PutString(labels[static_cast<std::size_t>(col)], 0);
+            q.Put16(x + 8);
+            q.Put16(y + 8);
+            q.Put16(104);
+            q.Put16(88);
+            q.Put8(7);
+            q.Put8(20);
+        }
+    }
+    q.Put8(TERM_UPDATEALL);
+}
+
+} // namespace
+
+TEST_CASE("CharQueue round trips each encoding", "[remote_link]")
+{
+    CharQueue q(256);
+
+    SECTION("tagged")
+    {
+        PutSample(q);
+        GetSample(q);
+    }
+
+    SECTION("compact")
+    {
+        q.SetEncoding(LINK_ENCODING_COMPACT, 0);
+        PutSample(q);
+        GetSample(q);
+        REQUIRE(q.Flags() == 0);
+    }
+
+    SECTION("compact, checked")
+    {
+        q.SetEncoding(LINK_ENCODING_COMPACT, LINK_CHECKED);
+        PutSample(q);
+        GetSample(q);
+        REQUIRE(q.Flags() == LINK_CHECKED);
+    }
+    REQUIRE(q.CurrSize() == 0);
+}
+
+TEST_CASE("CharQueue compact values wrap around the ring", "[remote_link]")
+{
+    CharQueue q(32);
+    q.SetEncoding(LINK_ENCODING_COMPACT, 0);
+    for (int pass = 0; pass < 10; ++pass)
+    {
+        q.PutString("abcdefghij", 0);
+        q.Put32(-pass * 100000);
+        std::array<char, 16> str{};
+        REQUIRE(q.GetString(str.data(), str.size()) == 0);
+        REQUIRE(std::string(str.data()) == "abcdefghij");
+        REQUIRE(q.Get32() == -pass * 100000);
+    }
+}
+
+TEST_CASE("CharQueue compact strings are cut to the reader's buffer", "[remote_link]")
+{
+    CharQueue q(64);
+    q.SetEncoding(LINK_ENCODING_COMPACT, 0);
+    q.PutString("Soup of the Day", 0);
+    q.Put8(42);
+
+    std::array<char, 5> str{};
+    REQUIRE(q.GetString(str.data(), str.size()) == 1);
+    REQUIRE(std::string(str.data()) == "Soup");
+    REQUIRE(q.Get8() == 42);
+}
+
+TEST_CASE("CharQueue switches encoding mid-frame", "[remote_link]")
+{
+    CharQueue out(256);
+    out.Put8(TERM_LINKSWITCH);
+    out.Put8(LINK_ENCODING_COMPACT);
+    out.Put8(0);
+    out.SetEncoding(LINK_ENCODING_COMPACT, 0);
+    out.Put16(640);
+    out.PutString("Table 12", 0);
+
+    std::array<int, 2> fds{};
+    REQUIRE(pipe(fds.data()) == 0);
+    const int sent = out.Write(fds[1]);
+    CharQueue in(256);
+    REQUIRE(in.Read(fds[0]) == sent);
+    close(fds[0]);
+    close(fds[1]);
+
+    // the reader switches once it has read the switch command
+    REQUIRE(in.Get8() == TERM_LINKSWITCH);
+    const int encoding = in.Get8();
+    const int flags = in.Get8();
+    in.SetEncoding(encoding, flags);
+    REQUIRE(in.Get16() == 640);
+    std::array<char, 16> str{};
+    REQUIRE(in.GetString(str.data(), str.size()) == 0);
+    REQUIRE(std::string(str.data()) == "Table 12");
+    REQUIRE(in.CurrSize() == 0);
+}
+
+TEST_CASE("CharQueue compact encoding shrinks a page redraw", "[remote_link]")
+{
+    CharQueue tagged(QUEUE_SIZE);
+    CharQueue compact(QUEUE_SIZE);
+    CharQueue checked(QUEUE_SIZE);
+    compact.SetEncoding(LINK_ENCODING_COMPACT, 0);
+    checked.SetEncoding(LINK_ENCODING_COMPACT, LINK_CHECKED);
+    PutPageRedraw(tagged);
+    PutPageRedraw(compact);
+    PutPageRedraw(checked);
+
+    // 48 buttons:  2457 bytes tagged, 1569 compact (36% less), 2345 checked
+    REQUIRE(tagged.CurrSize() == 2457);
+    REQUIRE(compact.CurrSize() == 1569);
+    REQUIRE(checked.CurrSize() == 2345);
+}
+
+TEST_CASE("CharQueue bulk bytes cross the wrap point", "[remote_link]")
+{
+    CharQueue q(16);
+    const std::array<Uchar, 10> out = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    std::array<Uchar, 10> in{};
+
+    REQUIRE(q.PutBytes(out) == 0);
+    REQUIRE(q.Skip(8) == 0);
+    REQUIRE(q.PutBytes(out) == 0);  // 6 bytes to the end, 4 from the start
+    REQUIRE(q.PutBytes(out) == 1);  // only 4 free
+    REQUIRE(q.CurrSize() == 12);
+    REQUIRE(q.Skip(2) == 0);
+    REQUIRE(q.GetBytes(in) == 0);
+    REQUIRE(in == out);
+    REQUIRE(q.GetBytes(in) == 1);
+    REQUIRE(q.CurrSize() == 0);
+}
+
+TEST_CASE("CharQueue reservation fills the ring in place", "[remote_link]")
+{
+    CharQueue q(16);
+    REQUIRE(q.WriteSpan().size() == 16);
+
+    // leave the read position at 12 so the free space wraps
+    std::span<Uchar> room = q.WriteSpan();
+    for (std::size_t i = 0; i < 14; ++i)
+        room[i] = static_cast<Uchar>(i);
+    q.Commit(14);
+    q.Consume(12);
+    REQUIRE(q.ReadSpan().size() == 2);
+    REQUIRE(q.ReadSpan()[0] == 12);
+
+    // free space runs from 14 to the end, then from 0 up to 12
+    REQUIRE(q.WriteSpan().size() == 2);
+    q.WriteSpan()[0] = 100;
+    q.WriteSpan()[1] = 101;
+    q.Commit(2);
+    REQUIRE(q.WriteSpan().size() == 12);
+    q.WriteSpan()[0] = 102;
+    q.Commit(1);
+
+    // queued bytes run from 12 to the end, then the one at 0
+    REQUIRE(q.ReadSpan().size() == 4);
+    q.Consume(4);
+    REQUIRE(q.ReadSpan().size() == 1);
+    REQUIRE(q.ReadSpan()[0] == 102);
+    q.Consume(1);
+    REQUIRE(q.CurrSize() == 0);
+    REQUIRE(q.WriteSpan().size() == 16);
+}
+
+TEST_CASE("CharQueue reads every whole frame waiting on a link", "[remote_link]")
+{
+    std::array<int, 2> fds{};
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()) == 0);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL, 0) | O_NONBLOCK);
+
+    CharQueue out(256);
+    CharQueue in(256);
+
+    SECTION("nothing waiting")
+    {
+        REQUIRE(in.Read(fds[1]) == 0);
+    }
+
+    SECTION("several frames in one read")
+    {
+        int sent = 0;
+        for (int idx = 0; idx < 3; ++idx)
+        {
+            out.Put16(idx * 100);
+            out.PutString("Table 12", 0);
+            sent += out.Write(fds[0]);
+        }
+        REQUIRE(in.Read(fds[1]) == sent);
+        for (int idx = 0; idx < 3; ++idx)
+        {
+            std::array<char, 16> str{};
+            REQUIRE(in.Get16() == idx * 100);
+            REQUIRE(in.GetString(str.data(), str.size()) == 0);
+            REQUIRE(std::string(str.data()) == "Table 12");
+        }
+        REQUIRE(in.CurrSize() == 0);
+    }
+
+    SECTION("a frame in pieces")
+    {
+        out.Put32(-123456);
+        std::vector<Uchar> frame;
+        out.Frame(frame);
+        REQUIRE(write(fds[0], frame.data(), 2) == 2);
+        REQUIRE(in.Read(fds[1]) == 0);
+        REQUIRE(write(fds[0], frame.data() + 2, 4) == 4);
+        REQUIRE(in.Read(fds[1]) == 0);
+        REQUIRE(write(fds[0], frame.data() + 6, frame.size() - 6) ==
+                static_cast<ssize_t>(frame.size() - 6));
+        REQUIRE(in.Read(fds[1]) == out.CurrSize());
+        REQUIRE(in.Get32() == -123456);
+    }
+
+    SECTION("more than the queue holds at once")
+    {
+        // two 150 byte frames don't fit in 256 together; the second
+        // waits for Take()
+        const std::array<Uchar, 150> bytes{};
+        for (int idx = 0; idx < 2; ++idx)
+        {
+            out.PutBytes(bytes);
+            REQUIRE(out.Write(fds[0]) == 150);
+        }
+        REQUIRE(in.Read(fds[1]) == 150);
+        REQUIRE(in.Take() == 0);
+        REQUIRE(in.Skip(150) == 0);
+        REQUIRE(in.Take() == 150);
+        REQUIRE(in.Take() == 0);
+    }
+
+    SECTION("a closed link")
+    {
+        close(fds[0]);
+        fds[0] = -1;
+        REQUIRE(in.Read(fds[1]) == -1);
+    }
+
+    SECTION("a bad length")
+    {
+        const std::array<Uchar, 4> header = {0, 0, 0, 1};  // 16MB
+        REQUIRE(write(fds[0], header.data(), header.size()) == 4);
+        REQUIRE(in.Read(fds[1]) == -1);
+    }
+
+    if (fds[0] >= 0)
+        close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_CASE("CharQueue deflates large frames when switched to", "[remote_link]")
+{
+    std::array<int, 2> fds{};
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()) == 0);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL, 0) | O_NONBLOCK);
+
+    CharQueue out(8192);
+    CharQueue in(8192);
+    CharQueue expect(8192);
+    std::vector<Uchar> frame;
+
+    SECTION("a page redraw in each encoding")
+    {
+        for (int flags : {0, LINK_CHECKED})
+        {
+            for (int encoding : {LINK_ENCODING_TAGGED, LINK_ENCODING_COMPACT})
+            {
+                out.SetEncoding(encoding, flags | LINK_DEFLATE);
+                expect.SetEncoding(encoding, flags);
+                PutPageRedraw(out);
+                PutPageRedraw(expect);
+                out.Frame(frame);
+                REQUIRE((frame[3] & 0x80) != 0);
+                REQUIRE(static_cast<int>(frame.size()) < expect.CurrSize() / 3);
+                REQUIRE(out.Write(fds[0]) == expect.CurrSize());
+
+                REQUIRE(in.Read(fds[1]) == expect.CurrSize());
+                std::vector<Uchar> got(static_cast<std::size_t>(expect.CurrSize()));
+                std::vector<Uchar> want(got.size());
+                REQUIRE(in.GetBytes(got) == 0);
+                REQUIRE(expect.GetBytes(want) == 0);
+                REQUIRE(got == want);
+            }
+        }
+        REQUIRE(out.Zip()->GetStats().frames == 8);
+        REQUIRE(out.Zip()->GetStats().deflated == 8);
+        REQUIRE(in.Zip()->GetStats().inflated == 4);
+    }
+
+    SECTION("small frames go as they are")
+    {
+        out.SetEncoding(LINK_ENCODING_COMPACT, LINK_DEFLATE);
+        out.Put16(1024);
+        out.PutString("Table 12", 0);
+        out.Frame(frame);
+        REQUIRE(frame.size() == 4 + static_cast<std::size_t>(out.CurrSize()));
+        REQUIRE((frame[3] & 0x80) == 0);
+    }
+
+    SECTION("both ends wrap around their rings")
+    {
+        // a byte left over keeps each ring from starting over at 0
+        const std::array<Uchar, 7000> filler{};
+        out.PutBytes(filler);
+        out.Skip(6999);
+        in.PutBytes(filler);
+        in.Skip(6999);
+
+        out.SetEncoding(LINK_ENCODING_TAGGED, LINK_DEFLATE);
+        PutPageRedraw(out);
+        PutPageRedraw(expect);
+        out.Skip(1);
+        REQUIRE(out.ReadSpan().size() < static_cast<std::size_t>(out.CurrSize()));
+        out.Frame(frame);
+
+        // Take() adds to what's queued, where Read() starts over
+        LinkInbox inbox;
+        inbox.bytes = frame;
+        inbox.used  = static_cast<int>(frame.size());
+        REQUIRE(in.Take(inbox) == expect.CurrSize());
+        REQUIRE(inbox.used == 0);
+        in.Skip(1);
+        REQUIRE(in.ReadSpan().size() < static_cast<std::size_t>(in.CurrSize()));
+        std::vector<Uchar> got(static_cast<std::size_t>(expect.CurrSize()));
+        std::vector<Uchar> want(got.size());
+        REQUIRE(in.GetBytes(got) == 0);
+        REQUIRE(expect.GetBytes(want) == 0);
+        REQUIRE(got == want);
+    }
+
+    SECTION("a bad inflated length")
+    {
+        out.SetEncoding(LINK_ENCODING_TAGGED, LINK_DEFLATE);
+        PutPageRedraw(out);
+        out.Frame(frame);
+        frame[4] += 1;
+        REQUIRE(write(fds[0], frame.data(), frame.size()) == static_cast<ssize_t>(frame.size()));
+        REQUIRE(in.Read(fds[1]) == -1);
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+}
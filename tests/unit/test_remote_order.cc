@@ -0,0 +1,187 @@
+/*
+ * test_remote_order.cc - Unit tests for remote_order.hh
+ * Tests reading remote orders and requests as they trickle in on a
+ * non-blocking connection, pipelined orders, and answering orders sent
+ * again
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "remote_order.hh"
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+void Send(int fd, std::string_view text)
+{
+    REQUIRE(write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size()));
+}
+
+std::string Receive(int fd)
+{
+    std::array<char, 256> buffer{};
+    const ssize_t got = read(fd, buffer.data(), buffer.size());
+    return (got > 0) ? std::string(buffer.data(), static_cast<size_t>(got)) : std::string();
+}
+
+} // namespace
+
+TEST_CASE("RemoteOrderLink reads an order as it arrives", "[remote_order]")
+{
+    std::array<int, 2> fds{};
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()) == 0);
+    RemoteOrderLink link(fds[1]);
+    std::vector<RemoteOrder> orders;
+
+    REQUIRE(link.Read(orders) == 0);
+    REQUIRE(link.Kind() == REMOTE_LINK_WAITING);
+
+    SECTION("whole lines and pieces of lines")
+    {
+        Send(fds[0], "remote");
+        REQUIRE(link.Read(orders) == 0);
+        REQUIRE(link.Kind() == REMOTE_LINK_WAITING);
+        Send(fds[0], "order\n");
+        REQUIRE(link.Read(orders) == 0);
+        REQUIRE(link.Kind() == REMOTE_LINK_ORDER);
+        REQUIRE(Receive(fds[0]) == "SENDORDER\n");
+
+        Send(fds[0], "OrderID: 42\nFirstName: Pat\nItemCo");
+        REQUIRE(link.Read(orders) == 0);
+        REQUIRE(orders.empty());
+        Send(fds[0], "de: 101\n# a comment\nEndItem\n");
+        REQUIRE(link.Read(orders) == 0);
+        REQUIRE(orders.empty());
+        Send(fds[0], "EndOrder\nOrderID: 43\n");
+        REQUIRE(link.Read(orders) == -1);
+        REQUIRE(link.Ended());
+
+        REQUIRE(orders.size() == 1);
+        REQUIRE(orders[0].id == 42);
+        REQUIRE(orders[0].fields.size() == 4);
+        REQUIRE(orders[0].fields[1].key == "FirstName");
+        REQUIRE(orders[0].fields[1].value == "Pat");
+        REQUIRE(orders[0].fields[2].key == "ItemCode");
+        REQUIRE(orders[0].fields[2].value == "101");
+        REQUIRE(orders[0].fields[3].key == "EndItem");
+
+        REQUIRE(link.Awaiting() == 1);
+        REQUIRE_FALSE(link.Idle(std::chrono::steady_clock::now() + std::chrono::hours(1)));
+        REQUIRE(link.Reply("42:7:COMPLETE:PRINTED") == 0);
+        link.Answered();
+        REQUIRE(link.Awaiting() == 0);
+        REQUIRE(Receive(fds[0]) == "42:7:COMPLETE:PRINTED");
+    }
+
+    SECTION("the client leaves partway")
+    {
+        Send(fds[0], "remoteorder\nOrderID: 42\n");
+        REQUIRE(link.Read(orders) == 0);
+        shutdown(fds[0], SHUT_WR);
+        REQUIRE(link.Read(orders) == -1);
+        REQUIRE(orders.empty());
+        REQUIRE(link.Awaiting() == 0);
+    }
+
+    SECTION("a one-line request")
+    {
+        Send(fds[0], "openterm 192.168.1.20:0.0 1\n");
+        REQUIRE(link.Read(orders) == -1);
+        REQUIRE(link.Kind() == REMOTE_LINK_REQUEST);
+        REQUIRE(link.Request() == "openterm 192.168.1.20:0.0 1\n");
+        REQUIRE(orders.empty());
+    }
+
+    SECTION("quiet too long")
+    {
+        REQUIRE_FALSE(link.Idle(std::chrono::steady_clock::now()));
+        REQUIRE(link.Idle(std::chrono::steady_clock::now() + std::chrono::seconds(REMOTE_ORDER_IDLE + 1)));
+    }
+
+    close(fds[0]);
+}
+
+TEST_CASE("RemoteOrderLink takes pipelined orders", "[remote_order]")
+{
+    std::array<int, 2> fds{};
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()) == 0);
+    RemoteOrderLink link(fds[1]);
+    std::vector<RemoteOrder> orders;
+
+    SECTION("answered by correlation id")
+    {
+        Send(fds[0], "remotebatch\nOrderID: 42\nCorrelationID: web-7 extra\nEndOrder\n"
+                     "OrderID: 43\nEndOrder\nOrderID: 44\n");
+        REQUIRE(link.Read(orders) == 0);
+        REQUIRE(link.Kind() == REMOTE_LINK_PIPELINE);
+        REQUIRE(Receive(fds[0]) == "SENDORDERS\n");
+        REQUIRE(orders.size() == 2);
+        REQUIRE(orders[0].id == 42);
+        REQUIRE(orders[0].correlation == "web-7");
+        REQUIRE(orders[0].fields.size() == 1);
+        REQUIRE(orders[1].correlation == "2");
+        REQUIRE(link.Awaiting() == 2);
+
+        Send(fds[0], "EndOrder\n");
+        REQUIRE(link.Read(orders) == 0);
+        REQUIRE(orders.size() == 3);
+        REQUIRE(orders[2].id == 44);
+        REQUIRE_FALSE(link.Ended());
+
+        REQUIRE(link.Answer(orders[1], "43:8:COMPLETE:PRINTED") == 0);
+        REQUIRE(link.Answer(orders[0], "42:7:COMPLETE:PRINTED") == 0);
+        REQUIRE(link.Awaiting() == 1);
+        REQUIRE(Receive(fds[0]) == "RESULT 2 43:8:COMPLETE:PRINTED\n"
+                                   "RESULT web-7 42:7:COMPLETE:PRINTED\n");
+
+        shutdown(fds[0], SHUT_WR);
+        REQUIRE(link.Read(orders) == -1);
+        REQUIRE(link.Awaiting() == 1);
+    }
+
+    SECTION("stops reading while too many are unanswered")
+    {
+        Send(fds[0], "remotebatch\n");
+        REQUIRE(link.Read(orders) == 0);
+        std::string lot;
+        for (int order = 0; order < REMOTE_ORDER_PIPELINE + 2; ++order)
+            lot += "ItemCode: 101\nEndOrder\n";
+        Send(fds[0], lot);
+        REQUIRE(link.Read(orders) == 0);
+        REQUIRE(link.Full());
+        REQUIRE(orders.size() == REMOTE_ORDER_PIPELINE);
+
+        link.Answer(orders[0], "0:1:COMPLETE:PRINTED");
+        REQUIRE(link.Read(orders) == 0);
+        REQUIRE(orders.size() == REMOTE_ORDER_PIPELINE + 1);
+        link.Answer(orders[1], "0:2:COMPLETE:PRINTED");
+        REQUIRE(link.Read(orders) == 0);
+        REQUIRE(orders.size() == REMOTE_ORDER_PIPELINE + 2);
+        REQUIRE(orders.back().correlation == std::to_string(REMOTE_ORDER_PIPELINE + 2));
+    }
+
+    close(fds[0]);
+}
+
+TEST_CASE("RemoteOrderLedger remembers recent answers", "[remote_order]")
+{
+    RemoteOrderLedger ledger;
+    REQUIRE(ledger.Find(42) == nullptr);
+    ledger.Record(42, "42:7:COMPLETE:PRINTED");
+    ledger.Record(0, "0:8:COMPLETE:PRINTED");
+    REQUIRE(ledger.Find(0) == nullptr);
+    REQUIRE(ledger.Find(42) != nullptr);
+    REQUIRE(*ledger.Find(42) == "42:7:COMPLETE:PRINTED");
+
+    for (int id = 1000; id < 1000 + REMOTE_ORDER_LEDGER; ++id)
+        ledger.Record(id, std::to_string(id));
+    REQUIRE(ledger.Size() == REMOTE_ORDER_LEDGER);
+    REQUIRE(ledger.Find(42) == nullptr);
+    REQUIRE(ledger.Find(1000) != nullptr);
+}
@@ -0,0 +1,198 @@
+/*
+ * test_sales_facts.cc - Unit tests for sales_facts.hh
+ * Tests the columnar round trip and rejection of damaged files
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "src/core/sales_facts.hh"
+
+#include <zlib.h>
+
+#include <cstdio>
+#include <string>
+
+namespace {
+
+std::string TempPath(const char* name)
+{
+    return std::string("/tmp/vt_test_sales_facts_") + name;
+}
+
+// two checks:  one subcheck with a burger, its modifier and a cash
+// payment, then a training check with a coffee
+void FillSample(SalesFacts &facts)
+{
+    facts.source_size  = 1234;
+    facts.source_mtime = 5678;
+
+    auto &c = facts.checks;
+    for (int32_t serial : {101, 102})
+    {
+        c.serial.push_back(serial);
+        c.type.push_back(1);
+        c.flags.push_back(serial == 102 ? FACT_TRAINING : 0);
+        c.user_open.push_back(7);
+        c.user_owner.push_back(8);
+        c.guests.push_back(2);
+        c.time_open.push_back(1700000000 + serial);
+        c.time_closed.push_back(1700003600 + serial);
+    }
+
+    auto &s = facts.subchecks;
+    for (int32_t check : {0, 1})
+    {
+        s.check.push_back(check);
+        s.number.push_back(1);
+        s.status.push_back(1);
+        s.drawer_id.push_back(3);
+        s.meal.push_back(2);
+        s.total_sales.push_back(check == 0 ? 1150 : 200);
+        s.total_tax.push_back(92);
+        s.tip.push_back(0);
+        s.payment.push_back(1242);
+        s.settle_time.push_back(1700003600);
+    }
+
+    auto &o = facts.orders;
+    const auto add_order = [&](int32_t sub, int32_t parent, const char* name, int32_t cost) {
+        o.sub.push_back(sub);
+        o.parent.push_back(parent);
+        o.name.push_back(facts.Intern(name));
+        o.family.push_back(4);
+        o.item_type.push_back(0);
+        o.sales_type.push_back(0);
+        o.qualifier.push_back(0);
+        o.status.push_back(0);
+        o.item_cost.push_back(cost);
+        o.cost.push_back(cost);
+        o.total_cost.push_back(cost);
+        o.total_comp.push_back(0);
+        o.count.push_back(1);
+        o.seat.push_back(0);
+        o.user_id.push_back(7);
+        o.employee_meal.push_back(0);
+        o.is_reduced.push_back(0);
+    };
+    add_order(0, -1, "Burger", 1000);
+    add_order(0, 0, "Cheese", 150);
+    add_order(1, -1, "Coffee", 200);
+    add_order(0, -1, "Burger", 1000);
+
+    auto &p = facts.payments;
+    p.sub.push_back(0);
+    p.tender_type.push_back(0);
+    p.tender_id.push_back(0);
+    p.value.push_back(1242);
+    p.amount.push_back(1242);
+    p.flags.push_back(0);
+    p.user_id.push_back(7);
+    p.drawer_id.push_back(3);
+    p.credit.push_back(0);
+}
+
+} // namespace
+
+TEST_CASE("SalesFacts interns each string once", "[sales_facts]")
+{
+    SalesFacts facts;
+    const int32_t burger = facts.Intern("Burger");
+    REQUIRE(facts.Intern("Fries") != burger);
+    REQUIRE(facts.Intern("Burger") == burger);
+    REQUIRE(facts.StringCount() == 2);
+    REQUIRE(facts.String(burger) == "Burger");
+    REQUIRE(facts.String(99).empty());
+}
+
+TEST_CASE("SalesFacts round trip through a file", "[sales_facts]")
+{
+    const std::string path = TempPath("round_trip");
+    SalesFacts facts;
+    FillSample(facts);
+    REQUIRE(facts.Valid());
+    REQUIRE(facts.Write(path) == 0);
+
+    SalesFacts read;
+    REQUIRE(read.Read(path) == 0);
+    REQUIRE(read.source_size == 1234);
+    REQUIRE(read.source_mtime == 5678);
+    REQUIRE(read.CheckCount() == 2);
+    REQUIRE(read.SubCheckCount() == 2);
+    REQUIRE(read.OrderCount() == 4);
+    REQUIRE(read.PaymentCount() == 1);
+    REQUIRE(read.StringCount() == 3);
+    REQUIRE(read.checks.flags == facts.checks.flags);
+    REQUIRE(read.checks.time_closed == facts.checks.time_closed);
+    REQUIRE(read.subchecks.total_sales == facts.subchecks.total_sales);
+    REQUIRE(read.orders.parent == facts.orders.parent);
+    REQUIRE(read.orders.total_cost == facts.orders.total_cost);
+    REQUIRE(read.payments.amount == facts.payments.amount);
+    REQUIRE(read.String(read.orders.name[3]) == "Burger");
+    REQUIRE(read.orders.name[0] == read.orders.name[3]);
+
+    // strings read back are interned like new ones
+    REQUIRE(read.Intern("Coffee") == read.orders.name[2]);
+
+    // a scan by column:  sales of non-training checks
+    int sales = 0;
+    for (std::size_t row = 0; row < read.SubCheckCount(); ++row)
+    {
+        if ((read.checks.flags[read.subchecks.check[row]] & FACT_TRAINING) == 0)
+            sales += read.subchecks.total_sales[row];
+    }
+    REQUIRE(sales == 1150);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("SalesFacts rejects damaged files", "[sales_facts]")
+{
+    const std::string path = TempPath("damaged");
+    SalesFacts facts;
+    FillSample(facts);
+
+    SECTION("missing file")
+    {
+        SalesFacts read;
+        REQUIRE(read.Read(TempPath("missing")) != 0);
+    }
+
+    SECTION("row reference out of range")
+    {
+        facts.orders.sub[1] = 5;
+        REQUIRE_FALSE(facts.Valid());
+        REQUIRE(facts.Write(path) == 0);
+        SalesFacts read;
+        REQUIRE(read.Read(path) != 0);
+        REQUIRE(read.OrderCount() == 0);
+    }
+
+    SECTION("modifier ahead of its order")
+    {
+        facts.orders.parent[0] = 1;
+        REQUIRE_FALSE(facts.Valid());
+    }
+
+    SECTION("columns of different lengths")
+    {
+        facts.payments.amount.push_back(1);
+        REQUIRE_FALSE(facts.Valid());
+    }
+
+    SECTION("truncated file")
+    {
+        REQUIRE(facts.Write(path) == 0);
+        SalesFacts read;
+        REQUIRE(read.Read(path) == 0);
+
+        // copy all but the tail of the uncompressed contents
+        gzFile in = gzopen(path.c_str(), "rb");
+        std::string bytes(1 << 16, '\0');
+        const int len = gzread(in, bytes.data(), static_cast<unsigned int>(bytes.size()));
+        gzclose(in);
+        REQUIRE(len > 16);
+        gzFile out = gzopen(path.c_str(), "wb");
+        gzwrite(out, bytes.data(), static_cast<unsigned int>(len - 8));
+        gzclose(out);
+        REQUIRE(read.Read(path) != 0);
+    }
+    std::remove(path.c_str());
+}
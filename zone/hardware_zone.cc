@@ -87,6 +87,7 @@ HardwareZone::HardwareZone()
     AddListField("The Drawer Opens On", DrawerPulseName, DrawerPulseValue);
     drawer_pulse_field = FieldListEnd();
     AddListField("Is A Card Reader Attached To This Display?", NoYesName, NoYesValue);
+    AddListField("Compress What Is Sent To This Display?", NoYesName, NoYesValue);
     AddNewLine();
     AddListField("If This Is A Customer Display Then Its Type Is", CustDispUnitName, CustDispUnitValue);
     AddTextField("If This Is A Customer Display Then Its Customer Display Device Path is", 20);
@@ -490,6 +491,7 @@ int HardwareZone::LoadRecord(Terminal *term, int record)
             thisForm->active = 1;
         thisForm = thisForm->next;
         thisForm->Set(ti->stripe_reader); thisForm->active = 1; thisForm = thisForm->next;
+        thisForm->Set(ti->link_deflate); thisForm->active = 1; thisForm = thisForm->next;
         thisForm->Set(ti->cdu_type); thisForm->active = 1; thisForm = thisForm->next;
         thisForm->Set(ti->cdu_path); thisForm->active = 1; thisForm = thisForm->next;
 
@@ -592,6 +594,7 @@ int HardwareZone::SaveRecord(Terminal *term, int record, int write_file)
             field->Get(ti->drawers); field = field->next;
             field->Get(ti->dpulse); field = field->next;
             field->Get(ti->stripe_reader); field = field->next;
+            field->Get(ti->link_deflate); field = field->next;
             field->Get(ti->cdu_type); field = field->next;
             field->Get(ti->cdu_path); field = field->next;
 
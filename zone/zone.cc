@@ -19,6 +19,7 @@
 #include "safe_string_utils.hh"
 #include "src/utils/cpp23_utils.hh"
 
+#include <algorithm>
 #include <cstring>
 #include <cerrno>
 #include <dirent.h>
@@ -661,6 +662,15 @@ int Page::Purge()
     return 0;
 }
 
+/****
+ * ShadowArea:  what a zone covers, shadow included, for the display list
+ ****/
+static RegionInfo ShadowArea(Terminal *term, Zone *zone)
+{
+    const int s = std::max(zone->ShadowVal(term), 0);
+    return RegionInfo(zone->x, zone->y, zone->w + s, zone->h + s);
+}
+
 RenderResult Page::Render(Terminal *term, int update_flag, int no_parent)
 {
     FnTrace("Page::Render()");
@@ -677,7 +687,11 @@ RenderResult Page::Render(Terminal *term, int update_flag, int no_parent)
 				currZone->RenderInit(term, update_flag);
 
 			if (currZone->shadow > 0)
+			{
+				term->BeginItem(DISPLAY_SHADOW, currZone, ShadowArea(term, currZone));
 				currZone->RenderShadow(term);
+				term->EndItem();
+			}
 
 			currZone = currZone->next;
 		}
@@ -695,10 +709,12 @@ RenderResult Page::Render(Terminal *term, int update_flag, int no_parent)
         currZone = currPage->ZoneListEnd();  // grab last zone in list
         while (currZone)
         {
+            term->BeginItem(DISPLAY_ZONE, currZone, *currZone);
             if (currZone->update)
                 currZone->Render(term, currZone->update);
             else
                 currZone->Render(term, update_flag);
+            term->EndItem();
 
             currZone = currZone->fore;
         }
@@ -730,7 +746,11 @@ RenderResult Page::Render(Terminal *term, int update_flag, int no_parent)
                     if (update_flag)
                         currZone->RenderInit(term, update_flag);
                     if (currZone->shadow > 0)
+                    {
+                        term->BeginItem(DISPLAY_SHADOW, currZone, ShadowArea(term, currZone));
                         currZone->RenderShadow(term);
+                        term->EndItem();
+                    }
                 }
                 currZone = currZone->next;
             }
@@ -741,10 +761,12 @@ RenderResult Page::Render(Terminal *term, int update_flag, int no_parent)
             {
                 if (currZone->Type() == ZONE_INDEX_TAB)
                 {
+                    term->BeginItem(DISPLAY_ZONE, currZone, *currZone);
                     if (currZone->update)
                         currZone->Render(term, currZone->update);
                     else
                         currZone->Render(term, update_flag);
+                    term->EndItem();
                 }
                 currZone = currZone->fore;
             }
@@ -759,7 +781,11 @@ RenderResult Page::Render(Terminal *term, int update_flag, int no_parent)
         while (currZone)
         {
             if (currZone->edit)
+            {
+                term->BeginItem(DISPLAY_CURSOR, currZone, *currZone);
                 term->RenderEditCursor(currZone->x, currZone->y, currZone->w, currZone->h);
+                term->EndItem();
+            }
             currZone = currZone->fore;
         }
         currPage = currPage->parent_page;
@@ -780,7 +806,11 @@ RenderResult Page::Render(Terminal *term, int update_flag, int no_parent)
             while (currZone)
             {
                 if (currZone->Type() == ZONE_INDEX_TAB && currZone->edit)
+                {
+                    term->BeginItem(DISPLAY_CURSOR, currZone, *currZone);
                     term->RenderEditCursor(currZone->x, currZone->y, currZone->w, currZone->h);
+                    term->EndItem();
+                }
                 currZone = currZone->fore;
             }
         }
@@ -790,11 +820,15 @@ RenderResult Page::Render(Terminal *term, int update_flag, int no_parent)
     currZone = term->dialog;
     if (currZone)
     {
+        term->BeginItem(DISPLAY_SHADOW, currZone, ShadowArea(term, currZone));
         currZone->RenderShadow(term);
+        term->EndItem();
+        term->BeginItem(DISPLAY_ZONE, currZone, *currZone);
         if (currZone->update)
             currZone->Render(term, currZone->update);
         else
             currZone->Render(term, update_flag);
+        term->EndItem();
     }
     return RENDER_OKAY;
 }